@@ -0,0 +1,163 @@
+#include "archive.h"
+#include <stdlib.h>
+#include <string.h>
+#ifdef MULTITAIL_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#define ARCHIVE_GUESS_RATIO 8   // Decoded size per compressed byte when the file does not say
+
+static bool read_head(PlatHandle file, int64_t offset, unsigned char *buf, size_t len) {
+    size_t got;
+    return plat_file_read_at(file, offset, buf, len, &got) && got == len;
+}
+
+ArchiveFormat archive_format(PlatHandle file) {
+    unsigned char magic[4];
+    if (!read_head(file, 0, magic, sizeof(magic))) {
+        return ARCHIVE_PLAIN;   // Too short to be compressed
+    }
+    if (magic[0] == 0x1f && magic[1] == 0x8b) {
+        return ARCHIVE_GZIP;
+    }
+    if (magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) {
+        return ARCHIVE_ZSTD;
+    }
+    return ARCHIVE_PLAIN;
+}
+
+static bool fill_from_file(void *ctx, unsigned char *buf, size_t cap, size_t *got) {
+    Archive *archive = (Archive *)ctx;
+    if (!plat_file_read_at(archive->file, archive->pos, buf, cap, got)) {
+        return false;
+    }
+    archive->pos += (int64_t)*got;
+    return true;
+}
+
+bool archive_open(Archive *archive, PlatHandle file) {
+    memset(archive, 0, sizeof(Archive));
+    archive->file = file;
+    archive->format = archive_format(file);
+
+    switch (archive->format) {
+    case ARCHIVE_GZIP:
+        return inflate_init(&archive->inflater, fill_from_file, archive);
+    case ARCHIVE_ZSTD:
+#ifdef MULTITAIL_HAVE_ZSTD
+        archive->zstd = ZSTD_createDStream();
+        archive->in = (unsigned char *)malloc(INFLATE_INPUT);
+        archive->out = (unsigned char *)malloc(INFLATE_BLOCK);
+        if (!archive->zstd || !archive->in || !archive->out || ZSTD_isError(ZSTD_initDStream(archive->zstd))) {
+            archive_close(archive);
+            return false;
+        }
+        return true;
+#else
+        return false;
+#endif
+    default:
+        archive->out = (unsigned char *)malloc(INFLATE_BLOCK);
+        return archive->out != NULL;
+    }
+}
+
+void archive_close(Archive *archive) {
+    if (archive->format == ARCHIVE_GZIP) {
+        inflate_free(&archive->inflater);
+    }
+#ifdef MULTITAIL_HAVE_ZSTD
+    ZSTD_freeDStream((ZSTD_DStream *)archive->zstd);
+#endif
+    free(archive->in);
+    free(archive->out);
+    memset(archive, 0, sizeof(Archive));
+    archive->file = PLAT_INVALID_HANDLE;
+}
+
+#ifdef MULTITAIL_HAVE_ZSTD
+static bool zstd_next(Archive *archive, size_t *len) {
+    ZSTD_outBuffer out = {archive->out, INFLATE_BLOCK, 0};
+    while (out.pos < out.size) {
+        if (archive->in_pos == archive->in_len) {
+            size_t got;
+            if (!fill_from_file(archive, archive->in, INFLATE_INPUT, &got)) {
+                return false;
+            }
+            if (got == 0) {
+                if (archive->frame_open) {
+                    return false;   // Truncated
+                }
+                break;
+            }
+            archive->in_pos = 0;
+            archive->in_len = got;
+        }
+
+        ZSTD_inBuffer in = {archive->in, archive->in_len, archive->in_pos};
+        size_t ret = ZSTD_decompressStream((ZSTD_DStream *)archive->zstd, &out, &in);
+        if (ZSTD_isError(ret)) {
+            return false;
+        }
+        archive->in_pos = in.pos;
+        archive->frame_open = ret != 0;
+    }
+    *len = out.pos;
+    return true;
+}
+#endif
+
+bool archive_next(Archive *archive, const char **data, size_t *len) {
+    *len = 0;
+    switch (archive->format) {
+    case ARCHIVE_GZIP: {
+        const unsigned char *block;
+        if (!inflate_next(&archive->inflater, &block, len)) {
+            return false;
+        }
+        *data = (const char *)block;
+        return true;
+    }
+    case ARCHIVE_ZSTD:
+#ifdef MULTITAIL_HAVE_ZSTD
+        *data = (const char *)archive->out;
+        return zstd_next(archive, len);
+#else
+        return false;
+#endif
+    default:
+        *data = (const char *)archive->out;
+        return fill_from_file(archive, archive->out, INFLATE_BLOCK, len);
+    }
+}
+
+int64_t archive_decoded_size(PlatHandle file, int64_t size) {
+    switch (archive_format(file)) {
+    case ARCHIVE_GZIP: {
+        // The last member's size modulo 4 GB (less than the file: it wrapped)
+        unsigned char trailer[4];
+        if (size >= 18 && read_head(file, size - 4, trailer, sizeof(trailer))) {
+            uint32_t decoded = (uint32_t)trailer[0] | (uint32_t)trailer[1] << 8 | (uint32_t)trailer[2] << 16 |
+                               (uint32_t)trailer[3] << 24;
+            return decoded > size ? decoded : size * ARCHIVE_GUESS_RATIO;
+        }
+        return size * ARCHIVE_GUESS_RATIO;
+    }
+    case ARCHIVE_ZSTD: {
+#ifdef MULTITAIL_HAVE_ZSTD
+        unsigned char header[ZSTD_FRAMEHEADERSIZE_MAX];
+        size_t got;
+        if (plat_file_read_at(file, 0, header, sizeof(header), &got)) {
+            unsigned long long decoded = ZSTD_getFrameContentSize(header, got);
+            if (decoded != ZSTD_CONTENTSIZE_UNKNOWN && decoded != ZSTD_CONTENTSIZE_ERROR &&
+                decoded <= INT64_MAX) {
+                return (int64_t)decoded;
+            }
+        }
+#endif
+        return size * ARCHIVE_GUESS_RATIO;
+    }
+    default:
+        return size;
+    }
+}
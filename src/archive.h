@@ -0,0 +1,52 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "inflate.h"
+#include "platform.h"
+
+// Input stage for rotated logs kept compressed next to the live one. gzip
+// is always supported (inflate.h); zstd when built with libzstd
+// (MULTITAIL_HAVE_ZSTD). Plain files pass through. Text comes out a block
+// at a time, ready for the line splitter.
+
+typedef enum {
+    ARCHIVE_PLAIN,
+    ARCHIVE_GZIP,
+    ARCHIVE_ZSTD
+} ArchiveFormat;
+
+typedef struct {
+    ArchiveFormat format;
+    PlatHandle file;
+    int64_t pos;                // Next file byte to read
+    Inflater inflater;          // gzip
+    void *zstd;                 // ZSTD_DStream
+    unsigned char *in;          // zstd input
+    size_t in_pos;
+    size_t in_len;
+    bool frame_open;            // zstd: a frame is still being decoded
+    unsigned char *out;         // Plain and zstd output block
+} Archive;
+
+// Tell the format of an open file from its first bytes
+ArchiveFormat archive_format(PlatHandle file);
+
+// Start reading file (which stays the caller's) from its beginning. Returns
+// false if its format is not supported in this build, or out of memory.
+bool archive_open(Archive *archive, PlatHandle file);
+
+// Free the decoder
+void archive_close(Archive *archive);
+
+// Decode the next block. *data stays valid until the next call; *len is 0
+// at the end. Returns false if the file is corrupt, truncated or unreadable.
+bool archive_next(Archive *archive, const char **data, size_t *len);
+
+// Rough decoded size of a file of size bytes, from the gzip trailer or zstd
+// frame header where there is one
+int64_t archive_decoded_size(PlatHandle file, int64_t size);
+
+#endif // ARCHIVE_H
@@ -0,0 +1,757 @@
+// Headless benchmark of the ingest and render paths.
+//
+// Each scenario appends synthetic log lines to temporary files while the
+// real reader pool tails them. The main thread drains, renders and presents
+// into a headless console the way the interactive main loop does, so the
+// numbers cover read -> split -> queue -> scrollback -> frame. File watching
+// is left out: the writer kicks the pool itself after every batch it flushes.
+//
+// Results go to stdout as a table and, with --json, to a file as one JSON
+// object per scenario. --compare reads such a file back and fails if a
+// scenario's throughput dropped by more than --tolerance percent.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "console.h"
+#include "linescan.h"
+#include "pane.h"
+#include "platform.h"
+#include "reader.h"
+#include "statusbar.h"
+
+#define BENCH_WIDTH 160                 // Headless console size
+#define BENCH_HEIGHT 50
+#define BENCH_BATCH_LINES 256           // Lines per write when unpaced
+#define BENCH_PACED_BATCH_LINES 16      // Lines per write when paced
+#define BENCH_TEXT_POOL 65536           // Random text lines are cut from
+#define BENCH_WAIT_MS 10                // Main loop wait for the readers
+#define BENCH_STALL_US 10000000         // No progress for this long fails the scenario
+#define BENCH_DEFAULT_TOLERANCE 10.0    // Allowed throughput drop for --compare, percent
+#define BENCH_JSON_OVERHEAD 256         // Room for the fields around a JSON line's message
+
+#define HIST_SUB_BITS 4                 // 16 buckets per power of two (about 6% resolution)
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS (HIST_SUB + (64 - HIST_SUB_BITS) * HIST_SUB)
+
+typedef struct {
+    const char *name;
+    int panes;                  // Files tailed
+    bool merged;                // One multiplexed view instead of a pane per file
+    size_t line_len;            // Mean line length; lengths vary from half to 1.5x
+    int crlf_percent;           // Lines ending in CRLF instead of LF
+    size_t lines;               // Lines written per file
+    unsigned rate;              // Lines per second over all files, 0 = as fast as possible
+    bool json;                  // Write JSON log lines (the text as their message)
+    bool json_view;             // ...and pick their fields out into columns
+} Scenario;
+
+static const Scenario scenarios[] = {
+    {"short-lf",     1, false,   40,   0, 1000000,      0, false, false},
+    {"medium-lf",    1, false,  120,   0,  500000,      0, false, false},
+    {"long-lf",      1, false, 1000,   0,  100000,      0, false, false},
+    {"medium-crlf",  1, false,  120, 100,  500000,      0, false, false},
+    {"mixed-4",      4, false,  120,  50,  200000,      0, false, false},
+    {"mixed-16",    16, false,  120,  50,   50000,      0, false, false},
+    {"merged-64",   64, true,   120,  50,   10000,      0, false, false},
+    {"paced-4",      4, false,  120,  50,   25000, 100000, false, false},
+    {"json-4k-raw",  1, false, 4096,   0,   50000,      0, true, false},
+    {"json-4k",      1, false, 4096,   0,   50000,      0, true, true},
+};
+
+#define SCENARIO_COUNT (sizeof(scenarios) / sizeof(scenarios[0]))
+
+// Log-linear histogram of microsecond values: exact below HIST_SUB, then
+// HIST_SUB buckets per power of two
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+} Histogram;
+
+// Batches the writer has flushed to one file
+typedef struct {
+    uint64_t written;           // Lines in the file once the batch was flushed
+    uint64_t time_us;           // When the flush returned
+} BatchMark;
+
+typedef struct {
+    FILE *file;
+    char path[PLAT_MAX_PATH];
+    BatchMark *marks;
+    volatile size_t mark_count; // Published by the writer
+    size_t mark_next;           // First mark not displayed yet (main thread)
+    uint64_t drained;           // Lines that reached the scrollback (main thread)
+} BenchFile;
+
+typedef struct {
+    const Scenario *scenario;
+    size_t lines;               // Lines per file in this run
+    BenchFile *files;
+    TailPane *panes;            // One per file
+    ReaderPool *pool;
+    uint64_t bytes_written;     // Writer only
+    bool failed;                // Writer could not write
+} BenchRun;
+
+typedef struct {
+    double seconds;
+    double lines_per_sec;
+    double mb_per_sec;
+    double allocs_per_line;     // -1 when allocations are not counted
+    uint64_t latency_p50_us;
+    uint64_t latency_p99_us;
+    uint64_t frames;
+    uint64_t frame_p50_us;
+    uint64_t frame_p99_us;
+    uint64_t frame_bytes;
+    size_t peak_rss_kb;
+} BenchResult;
+
+typedef struct {
+    bool quick;
+    const char *only;
+    const char *json_path;
+    const char *compare_path;
+    double tolerance;
+    const char *dir;
+} BenchOptions;
+
+// Allocation counting. Where the linker can redirect malloc and friends
+// (--wrap, set up by CMake), every call made by the program is counted.
+#ifdef BENCH_COUNT_ALLOCS
+static volatile size_t alloc_count;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    __atomic_fetch_add(&alloc_count, 1, __ATOMIC_RELAXED);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    __atomic_fetch_add(&alloc_count, 1, __ATOMIC_RELAXED);
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    __atomic_fetch_add(&alloc_count, 1, __ATOMIC_RELAXED);
+    return __real_realloc(ptr, size);
+}
+
+static size_t allocations(void) {
+    return __atomic_load_n(&alloc_count, __ATOMIC_RELAXED);
+}
+#define ALLOCS_COUNTED true
+#else
+static size_t allocations(void) {
+    return 0;
+}
+#define ALLOCS_COUNTED false
+#endif
+
+static void hist_add(Histogram *hist, uint64_t value) {
+    int index;
+    if (value < HIST_SUB) {
+        index = (int)value;
+    } else {
+        int msb = 63;
+        while (!(value >> msb)) {
+            msb--;
+        }
+        int shift = msb - HIST_SUB_BITS;
+        index = HIST_SUB + shift * HIST_SUB + (int)((value >> shift) & (HIST_SUB - 1));
+    }
+    hist->counts[index]++;
+    hist->total++;
+}
+
+// Value at fraction (0..1) of the recorded values: the middle of its bucket
+static uint64_t hist_percentile(const Histogram *hist, double fraction) {
+    if (hist->total == 0) {
+        return 0;
+    }
+
+    uint64_t rank = (uint64_t)(fraction * (double)hist->total + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += hist->counts[i];
+        if (seen >= rank) {
+            if (i < HIST_SUB) {
+                return (uint64_t)i;
+            }
+            int shift = (i - HIST_SUB) / HIST_SUB;
+            uint64_t low = (uint64_t)(HIST_SUB + (i - HIST_SUB) % HIST_SUB) << shift;
+            return low + ((1ULL << shift) >> 1);
+        }
+    }
+    return 0;
+}
+
+// Small deterministic generator so every run writes the same text
+static uint32_t next_random(uint32_t *state) {
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+static void fill_text_pool(char *pool, size_t size) {
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789=:/.-_";
+    uint32_t state = 12345;
+    for (size_t i = 0; i < size; i++) {
+        uint32_t r = next_random(&state);
+        pool[i] = (r % 7 == 0) ? ' ' : alphabet[r % (sizeof(alphabet) - 1)];
+    }
+}
+
+// A JSON log line around len bytes of text, the message in the middle and
+// the trace id last so every field is only found at the end of the line
+static size_t json_line(char *out, const char *text, size_t len, uint32_t *state) {
+    static const char *const levels[] = {"debug", "info", "info", "info", "warn", "error"};
+    uint32_t r = next_random(state);
+    int n = snprintf(out, BENCH_JSON_OVERHEAD, "{\"timestamp\":\"2026-10-17T12:%02u:%02u.%03uZ\",\"level\":\"%s\",\"msg\":\"",
+                     r % 60, (r >> 6) % 60, (r >> 12) % 1000, levels[(r >> 22) % 6]);
+    memcpy(out + n, text, len);
+    n += (int)len;
+    n += snprintf(out + n, BENCH_JSON_OVERHEAD,
+                  "\",\"ctx\":{\"user\":\"u%u\",\"attempt\":%u,\"tags\":[\"a\",\"b\"]},\"trace_id\":\"%08x%08x\"}",
+                  r % 10000, r % 5, next_random(state), r);
+    return (size_t)n;
+}
+
+static size_t batch_lines(const Scenario *scenario) {
+    return scenario->rate ? BENCH_PACED_BATCH_LINES : BENCH_BATCH_LINES;
+}
+
+// Writer thread: round-robin batches over the files, kicking the pool after each
+static void writer_main(void *arg) {
+    BenchRun *run = (BenchRun *)arg;
+    const Scenario *scenario = run->scenario;
+    size_t per_batch = batch_lines(scenario);
+    size_t max_line = scenario->line_len + scenario->line_len / 2 + 2 + (scenario->json ? 2 * BENCH_JSON_OVERHEAD : 0);
+
+    char *pool = (char *)malloc(BENCH_TEXT_POOL);
+    char *batch = (char *)malloc(per_batch * max_line);
+    if (!pool || !batch) {
+        free(pool);
+        free(batch);
+        run->failed = true;
+        return;
+    }
+    fill_text_pool(pool, BENCH_TEXT_POOL);
+
+    uint32_t state = 67890;
+    uint64_t start_us = plat_now_us();
+    uint64_t total = 0;
+
+    for (size_t done = 0; done < run->lines; done += per_batch) {
+        size_t count = run->lines - done < per_batch ? run->lines - done : per_batch;
+
+        for (int f = 0; f < scenario->panes; f++) {
+            BenchFile *file = &run->files[f];
+            size_t len = 0;
+            for (size_t i = 0; i < count; i++) {
+                size_t line_len = scenario->line_len / 2 + next_random(&state) % (scenario->line_len + 1);
+                if (line_len == 0) {
+                    line_len = 1;
+                }
+                size_t offset = next_random(&state) % (BENCH_TEXT_POOL - line_len);
+                if (scenario->json) {
+                    size_t text_len = line_len > BENCH_JSON_OVERHEAD ? line_len - BENCH_JSON_OVERHEAD / 2 : 1;
+                    len += json_line(batch + len, pool + offset, text_len, &state);
+                } else {
+                    memcpy(batch + len, pool + offset, line_len);
+                    len += line_len;
+                }
+                if ((int)(next_random(&state) % 100) < scenario->crlf_percent) {
+                    batch[len++] = '\r';
+                }
+                batch[len++] = '\n';
+            }
+
+            if (fwrite(batch, 1, len, file->file) != len || fflush(file->file) != 0) {
+                run->failed = true;
+                break;
+            }
+            run->bytes_written += len;
+
+            size_t index = file->mark_count;
+            file->marks[index].written = done + count;
+            file->marks[index].time_us = plat_now_us();
+            plat_atomic_store(&file->mark_count, index + 1);
+            reader_pool_kick(run->pool, &run->panes[f]);
+        }
+        if (run->failed) {
+            break;
+        }
+
+        // Hold the requested rate
+        total += count * (size_t)scenario->panes;
+        if (scenario->rate) {
+            uint64_t due = start_us + total * 1000000 / scenario->rate;
+            while (plat_now_us() < due) {
+                plat_sleep_ms(1);
+            }
+        }
+    }
+
+    free(pool);
+    free(batch);
+}
+
+// Same layout as the interactive view: panes split the rows above the status bar
+static void layout(TailPane *views, int view_count, int height) {
+    int available = height - 1;
+    int top = 0;
+    for (int i = 0; i < view_count; i++) {
+        int rows = available / view_count + (i < available % view_count ? 1 : 0);
+        pane_set_region(&views[i], top, rows);
+        top += rows;
+    }
+}
+
+// Wait until the pool has serviced every pane once (startup scans done), so
+// none of the benchmark's lines are skipped as old scrollback
+static void wait_pool_idle(ReaderPool *pool, TailPane *panes, int count) {
+    for (;;) {
+        bool idle = true;
+        plat_mutex_lock(&pool->lock);
+        for (int i = 0; i < count; i++) {
+            if (panes[i].queued || panes[i].active) {
+                idle = false;
+                break;
+            }
+        }
+        plat_mutex_unlock(&pool->lock);
+        if (idle) {
+            return;
+        }
+        plat_sleep_ms(1);
+    }
+}
+
+static uint64_t buffer_end(const TailPane *pane) {
+    const TailPane *target = pane->sink ? pane->sink : pane;
+    return target->buffer.first_seq + target->buffer.count;
+}
+
+static bool run_scenario(const Scenario *scenario, const BenchOptions *options, BenchResult *result) {
+    static Histogram latency;
+    static Histogram frame_time;
+    memset(&latency, 0, sizeof(latency));
+    memset(&frame_time, 0, sizeof(frame_time));
+    memset(result, 0, sizeof(BenchResult));
+
+    int count = scenario->panes;
+    size_t lines = options->quick ? scenario->lines / 10 : scenario->lines;
+    size_t mark_cap = (lines + batch_lines(scenario) - 1) / batch_lines(scenario);
+    bool ok = false;
+
+    BenchRun run;
+    memset(&run, 0, sizeof(run));
+    run.scenario = scenario;
+    run.lines = lines;
+    run.files = (BenchFile *)calloc((size_t)count, sizeof(BenchFile));
+    run.panes = (TailPane *)calloc((size_t)count, sizeof(TailPane));
+    TailPane mux;
+    memset(&mux, 0, sizeof(mux));
+    LineBudget budget;
+    linebudget_init(&budget, LINEBUF_DEFAULT_BUDGET);
+    Console con;
+    memset(&con, 0, sizeof(con));
+    PlatSignal ui_wake;
+    ReaderPool pool;
+    int files_ready = 0;
+    int panes_ready = 0;
+    bool pool_ready = false;
+    bool signal_ready = false;
+    bool mux_ready = false;
+
+    if (!run.files || !run.panes || !console_init_headless(&con, BENCH_WIDTH, BENCH_HEIGHT)) {
+        fprintf(stderr, "%s: out of memory\n", scenario->name);
+        goto done;
+    }
+
+    // Empty files to tail
+    uint64_t unique = plat_now_us();
+    for (; files_ready < count; files_ready++) {
+        BenchFile *file = &run.files[files_ready];
+        snprintf(file->path, sizeof(file->path), "%s/multitail_bench_%llu_%d.log",
+                 options->dir, (unsigned long long)unique, files_ready);
+        file->file = fopen(file->path, "wb");
+        file->marks = (BatchMark *)malloc(mark_cap * sizeof(BatchMark));
+        if (!file->file || !file->marks) {
+            fprintf(stderr, "%s: cannot create %s\n", scenario->name, file->path);
+            if (file->file) {
+                fclose(file->file);
+                remove(file->path);
+            }
+            free(file->marks);
+            goto done;
+        }
+    }
+
+    if (scenario->merged) {
+        if (!pane_init_mux(&mux, run.panes, count, &budget)) {
+            fprintf(stderr, "%s: out of memory\n", scenario->name);
+            goto done;
+        }
+        mux_ready = true;
+    }
+    for (; panes_ready < count; panes_ready++) {
+        if (!pane_init(&run.panes[panes_ready], run.files[panes_ready].path, (uint32_t)panes_ready,
+                       scenario->merged ? &mux : NULL, &budget)) {
+            fprintf(stderr, "%s: cannot open %s\n", scenario->name, run.files[panes_ready].path);
+            goto done;
+        }
+        run.panes[panes_ready].initial_bytes = budget.limit / (size_t)count;
+    }
+    TailPane *views = scenario->merged ? &mux : run.panes;
+    int view_count = scenario->merged ? 1 : count;
+    layout(views, view_count, con.height);
+    JsonFields fields;
+    char error[64];
+    if (scenario->json_view && !json_fields_parse(&fields, JSON_DEFAULT_FIELDS, error, sizeof(error))) {
+        fprintf(stderr, "%s: %s\n", scenario->name, error);
+        goto done;
+    }
+    for (int i = 0; i < view_count && scenario->json_view; i++) {
+        pane_set_json(&views[i], &fields);
+    }
+
+    if (!plat_signal_init(&ui_wake)) {
+        fprintf(stderr, "%s: cannot create wake signal\n", scenario->name);
+        goto done;
+    }
+    signal_ready = true;
+    if (!reader_pool_init(&pool, (size_t)count, 0, &ui_wake)) {
+        fprintf(stderr, "%s: out of memory\n", scenario->name);
+        goto done;
+    }
+    pool_ready = true;
+    run.pool = &pool;
+    if (!reader_pool_start(&pool)) {
+        fprintf(stderr, "%s: cannot start readers\n", scenario->name);
+        goto done;
+    }
+    for (int i = 0; i < count; i++) {
+        reader_pool_kick(&pool, &run.panes[i]);
+    }
+    wait_pool_idle(&pool, run.panes, count);
+
+    // Go: the writer appends while this thread plays the main loop
+    size_t allocs_before = allocations();
+    uint64_t start_us = plat_now_us();
+    PlatThread writer;
+    if (!plat_thread_start(&writer, writer_main, &run)) {
+        fprintf(stderr, "%s: cannot start writer\n", scenario->name);
+        goto done;
+    }
+
+    uint64_t total = (uint64_t)lines * (uint64_t)count;
+    uint64_t shown = 0;
+    uint64_t last_progress_us = start_us;
+    bool stalled = false;
+
+    while (shown < total) {
+        plat_signal_wait(&ui_wake, BENCH_WAIT_MS);
+
+        for (int i = 0; i < count; i++) {
+            uint64_t before = buffer_end(&run.panes[i]);
+            pane_drain(&run.panes[i], SIZE_MAX);
+            run.files[i].drained += buffer_end(&run.panes[i]) - before;
+        }
+        if (linebudget_trim(&budget)) {
+            for (int i = 0; i < view_count; i++) {
+                pane_trim(&views[i]);
+            }
+        }
+
+        bool redraw = false;
+        for (int i = 0; i < view_count; i++) {
+            redraw = redraw || views[i].dirty;
+        }
+        if (redraw) {
+            uint64_t frame_start = plat_now_us();
+            for (int i = 0; i < view_count; i++) {
+                if (views[i].dirty) {
+                    pane_render(&views[i], &con, i == 0);
+                }
+            }
+            statusbar_render(&con, views, view_count, 0, NULL, false);
+            console_present(&con);
+            hist_add(&frame_time, plat_now_us() - frame_start);
+            result->frames++;
+            result->frame_bytes += con.last_frame.bytes;
+        }
+
+        // Every flushed batch whose lines are all on screen now is done
+        uint64_t now = plat_now_us();
+        uint64_t before = shown;
+        shown = 0;
+        for (int i = 0; i < count; i++) {
+            BenchFile *file = &run.files[i];
+            size_t published = plat_atomic_load(&file->mark_count);
+            while (file->mark_next < published && file->marks[file->mark_next].written <= file->drained) {
+                hist_add(&latency, now - file->marks[file->mark_next].time_us);
+                file->mark_next++;
+            }
+            shown += file->drained;
+        }
+
+        if (shown > before) {
+            last_progress_us = now;
+        } else if (now - last_progress_us > BENCH_STALL_US) {
+            stalled = true;
+            break;
+        }
+    }
+    uint64_t end_us = plat_now_us();
+    size_t allocs_after = allocations();
+    plat_thread_join(writer);
+
+    if (stalled || run.failed) {
+        fprintf(stderr, "%s: %s after %llu of %llu lines\n", scenario->name,
+                run.failed ? "write failed" : "stalled", (unsigned long long)shown, (unsigned long long)total);
+        goto done;
+    }
+
+    result->seconds = (double)(end_us - start_us) / 1e6;
+    if (result->seconds <= 0) {
+        result->seconds = 1e-6;
+    }
+    result->lines_per_sec = (double)total / result->seconds;
+    result->mb_per_sec = (double)run.bytes_written / result->seconds / (1024.0 * 1024.0);
+    result->allocs_per_line = ALLOCS_COUNTED ? (double)(allocs_after - allocs_before) / (double)total : -1;
+    result->latency_p50_us = hist_percentile(&latency, 0.50);
+    result->latency_p99_us = hist_percentile(&latency, 0.99);
+    result->frame_p50_us = hist_percentile(&frame_time, 0.50);
+    result->frame_p99_us = hist_percentile(&frame_time, 0.99);
+    result->peak_rss_kb = plat_peak_memory() / 1024;
+    ok = true;
+
+done:
+    if (pool_ready) {
+        reader_pool_destroy(&pool);
+    }
+    for (int i = 0; i < panes_ready; i++) {
+        pane_destroy(&run.panes[i]);
+    }
+    if (mux_ready) {
+        pane_destroy(&mux);
+    }
+    linebudget_destroy(&budget);
+    if (signal_ready) {
+        plat_signal_destroy(&ui_wake);
+    }
+    for (int i = 0; i < files_ready; i++) {
+        fclose(run.files[i].file);
+        remove(run.files[i].path);
+        free(run.files[i].marks);
+    }
+    console_cleanup(&con);
+    free(run.files);
+    free(run.panes);
+    return ok;
+}
+
+static void write_json(FILE *out, const Scenario *scenario, size_t lines, const BenchResult *r) {
+    fprintf(out,
+            "{\"scenario\":\"%s\",\"panes\":%d,\"merged\":%s,\"line_len\":%zu,\"crlf_percent\":%d,"
+            "\"lines\":%zu,\"rate\":%u,\"seconds\":%.3f,\"lines_per_sec\":%.0f,\"mb_per_sec\":%.2f,"
+            "\"allocs_per_line\":%.4f,\"latency_p50_us\":%llu,\"latency_p99_us\":%llu,\"frames\":%llu,"
+            "\"frame_p50_us\":%llu,\"frame_p99_us\":%llu,\"frame_bytes\":%llu,\"peak_rss_kb\":%zu}\n",
+            scenario->name, scenario->panes, scenario->merged ? "true" : "false", scenario->line_len,
+            scenario->crlf_percent, lines, scenario->rate, r->seconds, r->lines_per_sec, r->mb_per_sec,
+            r->allocs_per_line, (unsigned long long)r->latency_p50_us, (unsigned long long)r->latency_p99_us,
+            (unsigned long long)r->frames, (unsigned long long)r->frame_p50_us,
+            (unsigned long long)r->frame_p99_us, (unsigned long long)r->frame_bytes, r->peak_rss_kb);
+}
+
+static void print_header(void) {
+    printf("%-12s %12s %8s %8s %10s %10s %8s %9s %9s %8s\n", "scenario", "lines/s", "MB/s", "alloc/ln",
+           "lat p50ms", "lat p99ms", "frames", "frm p50us", "frm p99us", "peak MB");
+}
+
+static void print_row(const Scenario *scenario, const BenchResult *r) {
+    char allocs[16];
+    if (r->allocs_per_line < 0) {
+        snprintf(allocs, sizeof(allocs), "n/a");
+    } else {
+        snprintf(allocs, sizeof(allocs), "%.4f", r->allocs_per_line);
+    }
+    printf("%-12s %12.0f %8.1f %8s %10.2f %10.2f %8llu %9llu %9llu %8.1f\n", scenario->name, r->lines_per_sec,
+           r->mb_per_sec, allocs, (double)r->latency_p50_us / 1000.0, (double)r->latency_p99_us / 1000.0,
+           (unsigned long long)r->frames, (unsigned long long)r->frame_p50_us,
+           (unsigned long long)r->frame_p99_us, (double)r->peak_rss_kb / 1024.0);
+}
+
+// Number after "key": in one line of our own JSON output, or -1 if missing
+static double json_number(const char *line, const char *key) {
+    char needle[64];
+    snprintf(needle, sizeof(needle), "\"%s\":", key);
+    const char *at = strstr(line, needle);
+    return at ? strtod(at + strlen(needle), NULL) : -1;
+}
+
+// Look up a scenario's line in a results file. Returns false if absent.
+static bool find_baseline(FILE *file, const char *name, char *line, size_t size) {
+    char needle[80];
+    snprintf(needle, sizeof(needle), "\"scenario\":\"%s\"", name);
+    rewind(file);
+    while (fgets(line, (int)size, file)) {
+        if (strstr(line, needle)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Compare a result with the baseline. Returns false on a throughput regression.
+static bool compare_result(FILE *baseline, const Scenario *scenario, const BenchResult *r, double tolerance) {
+    char line[1024];
+    if (!find_baseline(baseline, scenario->name, line, sizeof(line))) {
+        printf("  %-12s no baseline\n", scenario->name);
+        return true;
+    }
+
+    double old_rate = json_number(line, "lines_per_sec");
+    double old_p99 = json_number(line, "latency_p99_us");
+    double rate_change = old_rate > 0 ? (r->lines_per_sec - old_rate) / old_rate * 100.0 : 0;
+    double p99_change = old_p99 > 0 ? ((double)r->latency_p99_us - old_p99) / old_p99 * 100.0 : 0;
+    bool regressed = rate_change < -tolerance;
+
+    printf("  %-12s throughput %+6.1f%%  latency p99 %+6.1f%%%s\n", scenario->name, rate_change, p99_change,
+           regressed ? "  REGRESSION" : "");
+    return !regressed;
+}
+
+static void print_usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [options]\n", prog);
+    fprintf(stderr, "Benchmark the ingest and render paths against synthetic logs.\n\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  --quick            - Write a tenth of the lines\n");
+    fprintf(stderr, "  --scenario NAME    - Run only this scenario (see --list)\n");
+    fprintf(stderr, "  --list             - List the scenarios\n");
+    fprintf(stderr, "  --json FILE        - Also write results as JSON lines to FILE\n");
+    fprintf(stderr, "  --compare FILE     - Compare with results from --json; exit 1 on a regression\n");
+    fprintf(stderr, "  --tolerance PCT    - Throughput drop --compare accepts (default %.0f)\n", BENCH_DEFAULT_TOLERANCE);
+    fprintf(stderr, "  --dir DIR          - Where to write the temporary logs\n\n");
+    fprintf(stderr, "Peak memory is the process high-water mark; run one scenario at a\n");
+    fprintf(stderr, "time to see each one's own.\n");
+}
+
+static const char *default_dir(void) {
+    const char *names[] = {"TMPDIR", "TEMP", "TMP"};
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        const char *dir = getenv(names[i]);
+        if (dir && dir[0]) {
+            return dir;
+        }
+    }
+#ifdef _WIN32
+    return ".";
+#else
+    return "/tmp";
+#endif
+}
+
+int main(int argc, char *argv[]) {
+    BenchOptions options;
+    memset(&options, 0, sizeof(options));
+    options.tolerance = BENCH_DEFAULT_TOLERANCE;
+    options.dir = default_dir();
+
+    for (int i = 1; i < argc; i++) {
+        const char *opt = argv[i];
+        bool has_value = i + 1 < argc;
+        if (strcmp(opt, "--quick") == 0) {
+            options.quick = true;
+        } else if (strcmp(opt, "--list") == 0) {
+            for (size_t s = 0; s < SCENARIO_COUNT; s++) {
+                const Scenario *sc = &scenarios[s];
+                printf("%-12s %2d file(s)%s, %4zu byte lines, %3d%% CRLF, %zu lines each%s%s\n", sc->name,
+                       sc->panes, sc->merged ? " merged" : "", sc->line_len, sc->crlf_percent, sc->lines,
+                       sc->rate ? ", paced" : "", sc->json ? (sc->json_view ? ", JSON as columns" : ", JSON") : "");
+            }
+            return 0;
+        } else if (strcmp(opt, "--scenario") == 0 && has_value) {
+            options.only = argv[++i];
+        } else if (strcmp(opt, "--json") == 0 && has_value) {
+            options.json_path = argv[++i];
+        } else if (strcmp(opt, "--compare") == 0 && has_value) {
+            options.compare_path = argv[++i];
+        } else if (strcmp(opt, "--tolerance") == 0 && has_value) {
+            options.tolerance = atof(argv[++i]);
+        } else if (strcmp(opt, "--dir") == 0 && has_value) {
+            options.dir = argv[++i];
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    bool known = !options.only;
+    for (size_t s = 0; s < SCENARIO_COUNT && !known; s++) {
+        known = strcmp(options.only, scenarios[s].name) == 0;
+    }
+    if (!known) {
+        fprintf(stderr, "Error: No scenario named %s (see --list)\n", options.only);
+        return 1;
+    }
+
+    FILE *json = NULL;
+    if (options.json_path && !(json = fopen(options.json_path, "w"))) {
+        fprintf(stderr, "Error: Cannot write %s\n", options.json_path);
+        return 1;
+    }
+    FILE *baseline = NULL;
+    if (options.compare_path && !(baseline = fopen(options.compare_path, "r"))) {
+        fprintf(stderr, "Error: Cannot read %s\n", options.compare_path);
+        if (json) {
+            fclose(json);
+        }
+        return 1;
+    }
+
+    linescan_init();
+
+    static BenchResult results[SCENARIO_COUNT];
+    bool ran[SCENARIO_COUNT] = {false};
+    int status = 0;
+
+    print_header();
+    for (size_t s = 0; s < SCENARIO_COUNT; s++) {
+        const Scenario *scenario = &scenarios[s];
+        if (options.only && strcmp(options.only, scenario->name) != 0) {
+            continue;
+        }
+        if (!run_scenario(scenario, &options, &results[s])) {
+            status = 1;
+            continue;
+        }
+        ran[s] = true;
+        print_row(scenario, &results[s]);
+        fflush(stdout);
+        if (json) {
+            write_json(json, scenario, options.quick ? scenario->lines / 10 : scenario->lines, &results[s]);
+        }
+    }
+    if (baseline) {
+        printf("\nCompared with %s (tolerance %.0f%%):\n", options.compare_path, options.tolerance);
+        for (size_t s = 0; s < SCENARIO_COUNT; s++) {
+            if (ran[s] && !compare_result(baseline, &scenarios[s], &results[s], options.tolerance)) {
+                status = 1;
+            }
+        }
+        fclose(baseline);
+    }
+    if (json) {
+        fclose(json);
+    }
+    return status;
+}
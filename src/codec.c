@@ -0,0 +1,226 @@
+#include "codec.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Block layout: a run of sequences, each a token byte (literal count in the
+// high nibble, match length - 4 in the low one; 15 means more length bytes
+// follow, 255 at a time), the literals, a 16-bit little endian offset back
+// into the output and the match length bytes. The last sequence has only
+// literals.
+#define MIN_MATCH 4
+#define LAST_LITERALS 5         // Input tail always sent as literals
+#define MATCH_MARGIN 12         // No match starts this close to the end
+#define MAX_OFFSET 65535
+#define HASH_BITS 14
+
+static uint32_t read32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint64_t read64(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t hash4(uint32_t v) {
+    return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Bytes needed to write a length over 15 as continuation bytes
+static size_t extra_bytes(size_t len) {
+    return len >= 15 ? (len - 15) / 255 + 1 : 0;
+}
+
+static unsigned char *put_length(unsigned char *op, size_t len) {
+    len -= 15;
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (unsigned char)len;
+    return op;
+}
+
+// Write literals plus a match (match_len 0: literals only, ends the block).
+// Returns NULL if it does not fit before oend.
+static unsigned char *put_sequence(unsigned char *op, unsigned char *oend, const unsigned char *lit,
+                                   size_t lit_len, size_t offset, size_t match_len) {
+    size_t need = 1 + extra_bytes(lit_len) + lit_len;
+    if (match_len > 0) {
+        need += 2 + extra_bytes(match_len - MIN_MATCH);
+    }
+    if ((size_t)(oend - op) < need) {
+        return NULL;
+    }
+
+    unsigned char *token = op++;
+    *token = (unsigned char)((lit_len >= 15 ? 15 : lit_len) << 4);
+    if (lit_len >= 15) {
+        op = put_length(op, lit_len);
+    }
+    memcpy(op, lit, lit_len);
+    op += lit_len;
+
+    if (match_len > 0) {
+        size_t code = match_len - MIN_MATCH;
+        *token |= (unsigned char)(code >= 15 ? 15 : code);
+        *op++ = (unsigned char)(offset & 0xFF);
+        *op++ = (unsigned char)(offset >> 8);
+        if (code >= 15) {
+            op = put_length(op, code);
+        }
+    }
+    return op;
+}
+
+size_t codec_compress(const void *src, size_t len, void *dst, size_t cap) {
+    const unsigned char *in = (const unsigned char *)src;
+    const unsigned char *end = in + len;
+    const unsigned char *anchor = in;
+    unsigned char *out = (unsigned char *)dst;
+    unsigned char *op = out;
+    unsigned char *oend = out + cap;
+
+    if (len > MATCH_MARGIN) {
+        uint32_t *table = (uint32_t *)calloc((size_t)1 << HASH_BITS, sizeof(uint32_t));
+        if (!table) {
+            return 0;
+        }
+
+        const unsigned char *limit = end - MATCH_MARGIN;
+        const unsigned char *match_end = end - LAST_LITERALS;
+        const unsigned char *ip = in + 1;
+        while (ip < limit) {
+            uint32_t seq = read32(ip);
+            uint32_t h = hash4(seq);
+            const unsigned char *ref = in + table[h];
+            table[h] = (uint32_t)(ip - in);
+
+            if (ref >= ip || (size_t)(ip - ref) > MAX_OFFSET || read32(ref) != seq) {
+                // Step faster the longer nothing has matched
+                ip += 1 + ((size_t)(ip - anchor) >> 6);
+                continue;
+            }
+
+            // Widen the match both ways
+            while (ip > anchor && ref > in && ip[-1] == ref[-1]) {
+                ip--;
+                ref--;
+            }
+            const unsigned char *mp = ip + MIN_MATCH;
+            const unsigned char *rp = ref + MIN_MATCH;
+            while (mp + 8 <= match_end && read64(mp) == read64(rp)) {
+                mp += 8;
+                rp += 8;
+            }
+            while (mp < match_end && *mp == *rp) {
+                mp++;
+                rp++;
+            }
+
+            op = put_sequence(op, oend, anchor, (size_t)(ip - anchor), (size_t)(ip - ref), (size_t)(mp - ip));
+            if (!op) {
+                free(table);
+                return 0;
+            }
+            ip = mp;
+            anchor = ip;
+
+            // Let the bytes just covered seed later matches
+            if (ip < limit) {
+                table[hash4(read32(ip - 2))] = (uint32_t)(ip - 2 - in);
+            }
+        }
+        free(table);
+    }
+
+    op = put_sequence(op, oend, anchor, (size_t)(end - anchor), 0, 0);
+    return op ? (size_t)(op - out) : 0;
+}
+
+// Read continuation bytes onto a length of 15
+static bool get_length(const unsigned char **ip, const unsigned char *iend, size_t *len) {
+    unsigned char b;
+    do {
+        if (*ip >= iend) {
+            return false;
+        }
+        b = *(*ip)++;
+        *len += b;
+    } while (b == 255);
+    return true;
+}
+
+bool codec_decompress(const void *src, size_t len, void *dst, size_t out_len) {
+    const unsigned char *ip = (const unsigned char *)src;
+    const unsigned char *iend = ip + len;
+    unsigned char *out = (unsigned char *)dst;
+    unsigned char *op = out;
+    unsigned char *oend = out + out_len;
+
+    while (ip < iend) {
+        unsigned token = *ip++;
+
+        size_t lit_len = token >> 4;
+        if (lit_len == 15 && !get_length(&ip, iend, &lit_len)) {
+            return false;
+        }
+        if (lit_len > (size_t)(iend - ip) || lit_len > (size_t)(oend - op)) {
+            return false;
+        }
+        if (lit_len <= 16 && iend - ip >= 16 && oend - op >= 16) {
+            memcpy(op, ip, 16);     // Short runs: one fixed copy, the excess is overwritten
+        } else {
+            memcpy(op, ip, lit_len);
+        }
+        op += lit_len;
+        ip += lit_len;
+        if (ip == iend) {
+            break;      // Final literals-only sequence
+        }
+
+        if (iend - ip < 2) {
+            return false;
+        }
+        size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        size_t match_len = token & 15;
+        if (match_len == 15 && !get_length(&ip, iend, &match_len)) {
+            return false;
+        }
+        match_len += MIN_MATCH;
+        if (offset == 0 || offset > (size_t)(op - out) || match_len > (size_t)(oend - op)) {
+            return false;
+        }
+
+        // Copies may overlap their own output (runs); only far ones go wide
+        const unsigned char *ref = op - offset;
+        if (offset >= 8 && (size_t)(oend - op) >= match_len + 8) {
+            unsigned char *target = op + match_len;
+            do {
+                memcpy(op, ref, 8);
+                op += 8;
+                ref += 8;
+            } while (op < target);
+            op = target;
+            continue;
+        }
+        if (offset >= 8) {
+            while (match_len >= 8) {
+                memcpy(op, ref, 8);
+                op += 8;
+                ref += 8;
+                match_len -= 8;
+            }
+        }
+        while (match_len > 0) {
+            *op++ = *ref++;
+            match_len--;
+        }
+    }
+    return op == oend;
+}
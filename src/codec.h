@@ -0,0 +1,20 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Small LZ77 block codec in the LZ4 block layout, used to keep old
+// scrollback compressed. Favours speed over ratio: repeated log structure
+// (timestamps, levels, paths) is where it gains.
+
+// Compress len bytes of src into dst. Returns the compressed size, or 0 if
+// it would not fit in cap bytes (pass cap < len to only accept output that
+// is actually smaller).
+size_t codec_compress(const void *src, size_t len, void *dst, size_t cap);
+
+// Decompress a block made by codec_compress into exactly out_len bytes.
+// Returns false if the block is corrupt or does not fill out_len.
+bool codec_decompress(const void *src, size_t len, void *dst, size_t out_len);
+
+#endif // CODEC_H
@@ -1,161 +1,244 @@
 #include "console.h"
+#include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
+#include "linescan.h"
+#include "utf8.h"
+
+// SSE2 is always there on x64, so no runtime check is needed
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CONSOLE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Map control characters to spaces so log content can never drive the terminal
+static uint32_t printable(uint32_t ch) {
+    return (ch < 0x20 || (ch >= 0x7F && ch < 0xA0)) ? ' ' : ch;
+}
 
-bool console_init(Console *con) {
-    if (!con) {
-        return false;
+static void fill_cells(ConsoleCell *cells, size_t count, uint32_t ch, ConsoleAttr attr) {
+    for (size_t i = 0; i < count; i++) {
+        cells[i].ch = ch;
+        cells[i].attr = attr;
     }
+}
 
-    // Get handles
-    con->out_handle = GetStdHandle(STD_OUTPUT_HANDLE);
-    con->in_handle = GetStdHandle(STD_INPUT_HANDLE);
-
-    if (con->out_handle == INVALID_HANDLE_VALUE ||
-        con->in_handle == INVALID_HANDLE_VALUE) {
-        return false;
+// Copy n ASCII bytes into as many cells
+static void put_ascii(ConsoleCell *cell, const char *text, size_t n, ConsoleAttr attr) {
+    size_t i = 0;
+#ifdef CONSOLE_SSE2
+    // Sixteen bytes at a time: control bytes become spaces, then each byte is
+    // widened to a code point with the attribute beside it (cells are 8 bytes)
+    if (sizeof(ConsoleCell) == 8 && offsetof(ConsoleCell, attr) == 4) {
+        const __m128i space = _mm_set1_epi8(' ');
+        const __m128i del = _mm_set1_epi8(0x7F);
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i attrs = _mm_set1_epi32(attr);
+        for (; i + 16 <= n; i += 16) {
+            __m128i bytes = _mm_loadu_si128((const __m128i *)(text + i));
+            __m128i control = _mm_or_si128(_mm_cmplt_epi8(bytes, space), _mm_cmpeq_epi8(bytes, del));
+            bytes = _mm_or_si128(_mm_andnot_si128(control, bytes), _mm_and_si128(control, space));
+
+            __m128i low = _mm_unpacklo_epi8(bytes, zero);
+            __m128i high = _mm_unpackhi_epi8(bytes, zero);
+            __m128i points[4] = {
+                _mm_unpacklo_epi16(low, zero), _mm_unpackhi_epi16(low, zero),
+                _mm_unpacklo_epi16(high, zero), _mm_unpackhi_epi16(high, zero),
+            };
+            __m128i *out = (__m128i *)(cell + i);
+            for (int k = 0; k < 4; k++) {
+                _mm_storeu_si128(out + 2 * k, _mm_unpacklo_epi32(points[k], attrs));
+                _mm_storeu_si128(out + 2 * k + 1, _mm_unpackhi_epi32(points[k], attrs));
+            }
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        cell[i].ch = printable((unsigned char)text[i]);
+        cell[i].attr = attr;
     }
+}
 
-    // Save original modes
-    GetConsoleMode(con->out_handle, &con->original_out_mode);
-    GetConsoleMode(con->in_handle, &con->original_in_mode);
+// Lay UTF-8 text out over the cells from x up to end. Returns the cell after
+// the last one written.
+static int put_text(ConsoleCell *cell, int x, int end, const char *text, size_t len, ConsoleAttr attr) {
+    size_t i = 0;
+    while (i < len && x < end) {
+        // Runs of ASCII are copied a byte a cell
+        size_t room = (size_t)(end - x);
+        size_t ascii = linescan_find_non_ascii(text + i, len - i < room ? len - i : room);
+        put_ascii(cell + x, text + i, ascii, attr);
+        x += (int)ascii;
+        i += ascii;
+        if (i >= len || x >= end) {
+            break;
+        }
 
-    // Save original attributes
-    CONSOLE_SCREEN_BUFFER_INFO csbi;
-    if (GetConsoleScreenBufferInfo(con->out_handle, &csbi)) {
-        con->original_attributes = csbi.wAttributes;
-    } else {
-        con->original_attributes = COLOR_DEFAULT;
+        uint32_t cp;
+        i += utf8_decode(text + i, len - i, &cp);
+        int width = utf8_char_width(cp);
+        if (width == 0) {
+            continue;       // Combining marks and the like are left out
+        }
+        if (width == 2) {
+            if (x + 2 > end) {
+                break;
+            }
+            cell[x].ch = cp;
+            cell[x].attr = attr;
+            cell[x + 1].ch = CONSOLE_WIDE_TAIL;
+            cell[x + 1].attr = attr;
+            x += 2;
+            continue;
+        }
+        cell[x].ch = printable(cp);
+        cell[x].attr = attr;
+        x++;
     }
+    return x;
+}
 
-    // Set input mode: disable line input, enable window/mouse events
-    DWORD in_mode = ENABLE_EXTENDED_FLAGS | ENABLE_WINDOW_INPUT;
-    SetConsoleMode(con->in_handle, in_mode);
-
-    // Hide cursor
-    CONSOLE_CURSOR_INFO cursor_info;
-    cursor_info.dwSize = 100;
-    cursor_info.bVisible = FALSE;
-    SetConsoleCursorInfo(con->out_handle, &cursor_info);
+bool console_buffers_resize(Console *con, int width, int height) {
+    if (width <= 0 || height <= 0) {
+        return false;
+    }
 
-    // Get initial size
-    console_update_size(con);
+    size_t count = (size_t)width * (size_t)height;
+    ConsoleCell *cells = (ConsoleCell *)malloc(count * sizeof(ConsoleCell));
+    ConsoleCell *shown = (ConsoleCell *)malloc(count * sizeof(ConsoleCell));
+    if (!cells || !shown) {
+        free(cells);
+        free(shown);
+        return false;
+    }
 
-    // Clear screen
-    console_clear(con);
+    free(con->cells);
+    free(con->shown);
+    con->cells = cells;
+    con->shown = shown;
 
+    con->width = width;
+    con->height = height;
+    fill_cells(con->cells, count, ' ', con->clear_attr);
+    console_buffers_invalidate(con);
     return true;
 }
 
-void console_cleanup(Console *con) {
-    if (!con) {
+void console_buffers_invalidate(Console *con) {
+    if (!con->shown) {
         return;
     }
+    fill_cells(con->shown, (size_t)con->width * (size_t)con->height, ' ', CONSOLE_ATTR_INVALID);
+}
 
-    // Restore modes
-    SetConsoleMode(con->out_handle, con->original_out_mode);
-    SetConsoleMode(con->in_handle, con->original_in_mode);
-
-    // Show cursor
-    CONSOLE_CURSOR_INFO cursor_info;
-    cursor_info.dwSize = 100;
-    cursor_info.bVisible = TRUE;
-    SetConsoleCursorInfo(con->out_handle, &cursor_info);
-
-    // Restore attributes
-    SetConsoleTextAttribute(con->out_handle, con->original_attributes);
-
-    // Clear and reset cursor
-    console_clear(con);
-    COORD pos = {0, 0};
-    SetConsoleCursorPosition(con->out_handle, pos);
+void console_buffers_free(Console *con) {
+    free(con->cells);
+    free(con->shown);
+    free(con->frame_buf);
+    con->cells = NULL;
+    con->shown = NULL;
+    con->frame_buf = NULL;
+    con->frame_cap = 0;
 }
 
-bool console_update_size(Console *con) {
-    if (!con) {
-        return false;
+bool console_frame_reserve(Console *con, size_t size) {
+    if (size <= con->frame_cap) {
+        return true;
+    }
+
+    size_t new_cap = con->frame_cap ? con->frame_cap : 4096;
+    while (new_cap < size) {
+        new_cap *= 2;
     }
 
-    CONSOLE_SCREEN_BUFFER_INFO csbi;
-    if (!GetConsoleScreenBufferInfo(con->out_handle, &csbi)) {
+    char *buf = (char *)realloc(con->frame_buf, new_cap);
+    if (!buf) {
         return false;
     }
+    con->frame_buf = buf;
+    con->frame_cap = new_cap;
+    return true;
+}
 
-    int new_width = csbi.srWindow.Right - csbi.srWindow.Left + 1;
-    int new_height = csbi.srWindow.Bottom - csbi.srWindow.Top + 1;
+bool console_cell_is_wide(const ConsoleCell *row, int col, int width) {
+    return col + 1 < width && row[col + 1].ch == CONSOLE_WIDE_TAIL && row[col].ch != CONSOLE_WIDE_TAIL &&
+           utf8_char_width(row[col].ch) == 2;
+}
 
-    bool changed = (new_width != con->width || new_height != con->height);
-    con->width = new_width;
-    con->height = new_height;
+bool console_init_headless(Console *con, int width, int height) {
+    if (!con) {
+        return false;
+    }
 
-    return changed;
+    memset(con, 0, sizeof(Console));
+    con->out_handle = PLAT_INVALID_HANDLE;
+    con->in_handle = PLAT_INVALID_HANDLE;
+    con->wake_handle = PLAT_INVALID_HANDLE;
+    con->clear_attr = COLOR_DEFAULT;
+    return console_buffers_resize(con, width, height);
 }
 
-void console_write_at(Console *con, int row, int col, const char *text, WORD attr) {
-    if (!con || !text || row < 0 || col < 0) {
+void console_write_at(Console *con, int row, int col, const char *text, ConsoleAttr attr) {
+    if (!con || !con->cells || !text || row < 0 || col < 0 || row >= con->height) {
         return;
     }
 
-    COORD pos;
-    pos.X = (SHORT)col;
-    pos.Y = (SHORT)row;
-
-    SetConsoleCursorPosition(con->out_handle, pos);
-    SetConsoleTextAttribute(con->out_handle, attr);
+    put_text(con->cells + (size_t)row * con->width, col, con->width, text, strlen(text), attr);
+}
 
-    DWORD written;
-    WriteConsoleA(con->out_handle, text, (DWORD)strlen(text), &written, NULL);
+void console_write_fixed(Console *con, int row, int col, const char *text, int width, ConsoleAttr attr) {
+    console_write_span(con, row, col, text, text ? strlen(text) : 0, width, attr);
 }
 
-void console_write_fixed(Console *con, int row, int col, const char *text, int width, WORD attr) {
-    if (!con || row < 0 || col < 0 || width <= 0) {
+void console_write_span(Console *con, int row, int col, const char *text, size_t len, int width, ConsoleAttr attr) {
+    if (!con || !con->cells || row < 0 || col < 0 || width <= 0 || row >= con->height) {
         return;
     }
 
-    // Create a buffer padded with spaces
-    char *buf = (char *)malloc(width + 1);
-    if (!buf) {
-        return;
+    int end = col + width;
+    if (end > con->width) {
+        end = con->width;
     }
 
-    memset(buf, ' ', width);
-    buf[width] = '\0';
+    // Copy text, truncating if necessary, then pad with spaces
+    ConsoleCell *cell = con->cells + (size_t)row * con->width;
+    int x = text ? put_text(cell, col, end, text, len, attr) : col;
+    for (; x < end; x++) {
+        cell[x].ch = ' ';
+        cell[x].attr = attr;
+    }
+}
 
-    // Copy text, truncating if necessary
-    if (text) {
-        size_t len = strlen(text);
-        if (len > (size_t)width) {
-            len = width;
-        }
-        memcpy(buf, text, len);
+void console_fill_row(Console *con, int row, char ch, ConsoleAttr attr) {
+    if (!con || !con->cells || row < 0 || row >= con->height) {
+        return;
     }
 
-    console_write_at(con, row, col, buf, attr);
-    free(buf);
+    fill_cells(con->cells + (size_t)row * con->width, (size_t)con->width, printable((unsigned char)ch), attr);
 }
 
-void console_fill_row(Console *con, int row, char ch, WORD attr) {
-    if (!con || row < 0) {
+void console_set_attr(Console *con, int row, int col, int width, ConsoleAttr attr) {
+    if (!con || !con->cells || row < 0 || row >= con->height || col >= con->width) {
         return;
     }
+    if (col < 0) {
+        width += col;
+        col = 0;
+    }
+    if (width > con->width - col) {
+        width = con->width - col;
+    }
 
-    COORD pos;
-    pos.X = 0;
-    pos.Y = (SHORT)row;
-
-    DWORD written;
-    FillConsoleOutputAttribute(con->out_handle, attr, con->width, pos, &written);
-    FillConsoleOutputCharacterA(con->out_handle, ch, con->width, pos, &written);
+    ConsoleCell *cells = con->cells + (size_t)row * con->width + col;
+    for (int i = 0; i < width; i++) {
+        cells[i].attr = attr;
+    }
 }
 
 void console_clear(Console *con) {
-    if (!con) {
+    if (!con || !con->cells) {
         return;
     }
 
-    COORD origin = {0, 0};
-    DWORD size = con->width * con->height;
-    DWORD written;
-
-    FillConsoleOutputCharacterA(con->out_handle, ' ', size, origin, &written);
-    FillConsoleOutputAttribute(con->out_handle, con->original_attributes, size, origin, &written);
+    fill_cells(con->cells, (size_t)con->width * (size_t)con->height, ' ', con->clear_attr);
 }
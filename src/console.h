@@ -2,44 +2,129 @@
 #define CONSOLE_H
 
 #include <stdbool.h>
-#include <windows.h>
+#include <stdint.h>
+#include "platform.h"
+
+// Cell attributes. The bit layout matches the Win32 console attributes so
+// that backend can pass them straight through; others translate them.
+typedef uint16_t ConsoleAttr;
+
+#define CONSOLE_FG_BLUE       0x0001
+#define CONSOLE_FG_GREEN      0x0002
+#define CONSOLE_FG_RED        0x0004
+#define CONSOLE_FG_INTENSITY  0x0008
+#define CONSOLE_BG_BLUE       0x0010
+#define CONSOLE_BG_GREEN      0x0020
+#define CONSOLE_BG_RED        0x0040
+#define CONSOLE_BG_INTENSITY  0x0080
 
 // Color attributes
-#define COLOR_DEFAULT       (FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE)
-#define COLOR_HEADER        (BACKGROUND_INTENSITY | FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE)
-#define COLOR_HEADER_ACTIVE (BACKGROUND_GREEN | FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE | FOREGROUND_INTENSITY)
-#define COLOR_STATUS        (BACKGROUND_BLUE | FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE | FOREGROUND_INTENSITY)
-#define COLOR_SEPARATOR     (FOREGROUND_BLUE | FOREGROUND_INTENSITY)
+#define COLOR_DEFAULT       (CONSOLE_FG_RED | CONSOLE_FG_GREEN | CONSOLE_FG_BLUE)
+#define COLOR_HEADER        (CONSOLE_BG_INTENSITY | CONSOLE_FG_RED | CONSOLE_FG_GREEN | CONSOLE_FG_BLUE)
+#define COLOR_HEADER_ACTIVE (CONSOLE_BG_GREEN | CONSOLE_FG_RED | CONSOLE_FG_GREEN | CONSOLE_FG_BLUE | CONSOLE_FG_INTENSITY)
+#define COLOR_STATUS        (CONSOLE_BG_BLUE | CONSOLE_FG_RED | CONSOLE_FG_GREEN | CONSOLE_FG_BLUE | CONSOLE_FG_INTENSITY)
+#define COLOR_SEPARATOR     (CONSOLE_FG_BLUE | CONSOLE_FG_INTENSITY)
+#define COLOR_SOURCE_TAG    (CONSOLE_FG_GREEN | CONSOLE_FG_BLUE)
+#define COLOR_MATCH         (CONSOLE_BG_RED | CONSOLE_BG_GREEN)
+#define COLOR_MATCH_CURRENT (CONSOLE_BG_RED | CONSOLE_BG_GREEN | CONSOLE_BG_INTENSITY)
+
+#define CONSOLE_ATTR_INVALID 0xFFFF     // Never a real attribute; forces a cell to be redrawn
+#define CONSOLE_WIDE_TAIL 0xFFFFFFFFu   // Cell holding the right half of the wide character before it
+
+// One character cell of the screen: a Unicode code point. A wide character
+// takes its cell and the next, which holds CONSOLE_WIDE_TAIL.
+typedef struct {
+    uint32_t ch;
+    ConsoleAttr attr;
+} ConsoleCell;
 
+// Output cost of the last presented frame
 typedef struct {
-    HANDLE out_handle;
-    HANDLE in_handle;
-    DWORD original_out_mode;
-    DWORD original_in_mode;
-    WORD original_attributes;
+    size_t bytes;               // Bytes handed to the OS
+    size_t calls;               // Output calls made
+    size_t cells;               // Cells that differed from the previous frame
+} ConsoleFrameStats;
+
+typedef struct {
+    PlatHandle out_handle;
+    PlatHandle in_handle;
+    PlatHandle wake_handle;         // Becomes readable on resize (POSIX), unused on Win32
+#ifdef _WIN32
+    uint32_t original_out_mode;
+    uint32_t original_in_mode;
+    ConsoleAttr original_attributes;
+#endif
     int width;
     int height;
+
+    // Drawing goes to the back buffer; console_present diffs it against the
+    // front buffer (what the screen shows) and writes only the changes
+    ConsoleCell *cells;         // Back buffer, width * height
+    ConsoleCell *shown;         // Front buffer, width * height
+    ConsoleAttr clear_attr;     // Attribute of blank cells
+    char *frame_buf;            // Scratch space for encoding a frame
+    size_t frame_cap;
+
+    ConsoleFrameStats last_frame;
+    bool show_frame_stats;      // MULTITAIL_FRAME_STATS is set
 } Console;
 
 // Initialize console, hide cursor, set modes
 bool console_init(Console *con);
 
+// Set up a width x height console with no terminal behind it: drawing and
+// console_present work as usual, frame stats included, but nothing is
+// written. Release it with console_cleanup.
+bool console_init_headless(Console *con, int width, int height);
+
 // Restore original console state
 void console_cleanup(Console *con);
 
 // Update cached console size. Returns true if size changed.
 bool console_update_size(Console *con);
 
-// Write text at specific position with given attributes
-void console_write_at(Console *con, int row, int col, const char *text, WORD attr);
+// Write the changes since the last present to the screen in one call
+void console_present(Console *con);
 
-// Write text at position, truncating/padding to fit width
-void console_write_fixed(Console *con, int row, int col, const char *text, int width, WORD attr);
+// Write UTF-8 text at specific position with given attributes
+void console_write_at(Console *con, int row, int col, const char *text, ConsoleAttr attr);
+
+// Write UTF-8 text at position, truncating/padding to fit width. Text is cut
+// between characters: a wide character that would straddle the edge is
+// left out and its column padded.
+void console_write_fixed(Console *con, int row, int col, const char *text, int width, ConsoleAttr attr);
+
+// Write len bytes of UTF-8 text (need not be NUL-terminated) at position,
+// truncating/padding to fit width
+void console_write_span(Console *con, int row, int col, const char *text, size_t len, int width, ConsoleAttr attr);
 
 // Fill a row with a character
-void console_fill_row(Console *con, int row, char ch, WORD attr);
+void console_fill_row(Console *con, int row, char ch, ConsoleAttr attr);
+
+// Change the attributes of width cells starting at (row, col), keeping their text
+void console_set_attr(Console *con, int row, int col, int width, ConsoleAttr attr);
 
 // Clear entire screen
 void console_clear(Console *con);
 
+// Backend helpers (console.c)
+
+// Resize the cell buffers to width x height (both set to the clear
+// attribute) and mark every cell for redraw. Returns false on allocation failure.
+bool console_buffers_resize(Console *con, int width, int height);
+
+// Mark every cell for redraw on the next present
+void console_buffers_invalidate(Console *con);
+
+// Release the cell buffers and frame scratch space
+void console_buffers_free(Console *con);
+
+// Make sure frame_buf holds at least size bytes
+bool console_frame_reserve(Console *con, size_t size);
+
+// True if the cell at col of a row starts a wide character that has its
+// tail cell. Backends show a wide character without its tail, or a tail
+// without its character (half overwritten by other text), as a space.
+bool console_cell_is_wide(const ConsoleCell *row, int col, int width);
+
 #endif // CONSOLE_H
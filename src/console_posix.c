@@ -0,0 +1,262 @@
+#include "console.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+#include "utf8.h"
+
+#define PRESENT_MAX_GAP 4       // Unchanged cells rewritten instead of moving the cursor
+#define PRESENT_CELL_MAX 48     // Worst-case bytes to emit one cell (cursor move + SGR + UTF-8 char)
+
+static struct termios original_termios;
+static bool termios_saved = false;
+static int resize_pipe[2] = {-1, -1};
+
+// Write the whole buffer, retrying short writes
+static void write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+}
+
+static void on_sigwinch(int sig) {
+    (void)sig;
+    int saved_errno = errno;
+    char byte = 1;
+    if (write(resize_pipe[1], &byte, 1) < 0) {
+        // Pipe full - a wakeup is already pending
+    }
+    errno = saved_errno;
+}
+
+// Map a color triple in Win32 bit order (B=1, G=2, R=4) to the ANSI order (R=1, G=2, B=4)
+static int ansi_color(int bits) {
+    return ((bits & 4) >> 2) | (bits & 2) | ((bits & 1) << 2);
+}
+
+// Append the SGR sequence selecting attr. COLOR_DEFAULT maps to the
+// terminal's own default colors.
+static size_t format_attr(char *out, ConsoleAttr attr) {
+    if (attr == COLOR_DEFAULT) {
+        memcpy(out, "\x1b[0m", 4);
+        return 4;
+    }
+
+    int fg = ansi_color(attr & 0x7);
+    int bg = ansi_color((attr >> 4) & 0x7);
+    int fg_base = (attr & CONSOLE_FG_INTENSITY) ? 90 : 30;
+    int bg_base = (attr & CONSOLE_BG_INTENSITY) ? 100 : 40;
+    return (size_t)sprintf(out, "\x1b[0;%d;%dm", fg_base + fg, bg_base + bg);
+}
+
+static size_t format_move(char *out, int row, int col) {
+    return (size_t)sprintf(out, "\x1b[%d;%dH", row + 1, col + 1);
+}
+
+bool console_init(Console *con) {
+    if (!con) {
+        return false;
+    }
+
+    con->out_handle = STDOUT_FILENO;
+    con->in_handle = STDIN_FILENO;
+    con->wake_handle = PLAT_INVALID_HANDLE;
+    con->clear_attr = COLOR_DEFAULT;
+    con->show_frame_stats = getenv("MULTITAIL_FRAME_STATS") != NULL;
+
+    if (!isatty(con->in_handle) || !isatty(con->out_handle)) {
+        return false;
+    }
+
+    // Raw, non-blocking keyboard input: no echo, no line editing, no signals
+    if (tcgetattr(con->in_handle, &original_termios) != 0) {
+        return false;
+    }
+    termios_saved = true;
+
+    struct termios raw = original_termios;
+    raw.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+    raw.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+    raw.c_cflag |= CS8;
+    raw.c_cc[VMIN] = 0;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(con->in_handle, TCSAFLUSH, &raw);
+
+    // Resize notifications go through a self-pipe so the main loop can wait on them
+    if (pipe(resize_pipe) == 0) {
+        for (int i = 0; i < 2; i++) {
+            fcntl(resize_pipe[i], F_SETFL, fcntl(resize_pipe[i], F_GETFL) | O_NONBLOCK);
+            fcntl(resize_pipe[i], F_SETFD, FD_CLOEXEC);
+        }
+
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = on_sigwinch;
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = SA_RESTART;
+        sigaction(SIGWINCH, &sa, NULL);
+
+        con->wake_handle = resize_pipe[0];
+    }
+
+    // Alternate screen, hidden cursor, blank screen
+    static const char enter[] = "\x1b[?1049h\x1b[?25l\x1b[0m\x1b[2J";
+    write_all(con->out_handle, enter, sizeof(enter) - 1);
+
+    // Get initial size (allocates the cell buffers)
+    if (!console_update_size(con) && !con->cells) {
+        console_cleanup(con);
+        return false;
+    }
+
+    return true;
+}
+
+void console_cleanup(Console *con) {
+    if (!con) {
+        return;
+    }
+    if (con->out_handle == PLAT_INVALID_HANDLE) {
+        console_buffers_free(con);      // Headless
+        return;
+    }
+
+    // Reset attributes, show cursor, leave the alternate screen
+    static const char leave[] = "\x1b[0m\x1b[?25h\x1b[?1049l";
+    write_all(con->out_handle, leave, sizeof(leave) - 1);
+
+    if (termios_saved) {
+        tcsetattr(con->in_handle, TCSAFLUSH, &original_termios);
+        termios_saved = false;
+    }
+
+    if (resize_pipe[0] >= 0) {
+        signal(SIGWINCH, SIG_DFL);
+        close(resize_pipe[0]);
+        close(resize_pipe[1]);
+        resize_pipe[0] = resize_pipe[1] = -1;
+        con->wake_handle = PLAT_INVALID_HANDLE;
+    }
+
+    console_buffers_free(con);
+}
+
+bool console_update_size(Console *con) {
+    if (!con || con->out_handle == PLAT_INVALID_HANDLE) {
+        return false;
+    }
+
+    struct winsize ws;
+    int new_width = 80;
+    int new_height = 24;
+    if (ioctl(con->out_handle, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0 && ws.ws_row > 0) {
+        new_width = ws.ws_col;
+        new_height = ws.ws_row;
+    }
+
+    bool changed = (new_width != con->width || new_height != con->height);
+    if (changed || !con->cells) {
+        if (!console_buffers_resize(con, new_width, new_height)) {
+            return false;
+        }
+    }
+
+    return changed;
+}
+
+void console_present(Console *con) {
+    if (!con || !con->cells || !con->shown) {
+        return;
+    }
+
+    ConsoleFrameStats stats = {0};
+    size_t len = 0;
+    int cur_row = -1;
+    int cur_col = -1;
+    ConsoleAttr cur_attr = CONSOLE_ATTR_INVALID;
+
+    for (int row = 0; row < con->height; row++) {
+        ConsoleCell *cells = con->cells + (size_t)row * con->width;
+        ConsoleCell *shown = con->shown + (size_t)row * con->width;
+
+        for (int col = 0; col < con->width; col++) {
+            if (cells[col].ch == shown[col].ch && cells[col].attr == shown[col].attr) {
+                continue;
+            }
+            stats.cells++;
+
+            if (!console_frame_reserve(con, len + PRESENT_CELL_MAX * (PRESENT_MAX_GAP + 3))) {
+                return;
+            }
+            char *out = con->frame_buf;
+
+            // A wide character is written whole: from its first cell through its tail
+            int first = col;
+            int last = col;
+            if (cells[col].ch >= 0x300) {
+                if (col > 0 && cells[col].ch == CONSOLE_WIDE_TAIL && console_cell_is_wide(cells, col - 1, con->width)) {
+                    first = col - 1;
+                }
+                if (console_cell_is_wide(cells, col, con->width)) {
+                    last = col + 1;
+                }
+            }
+
+            // Close small gaps by rewriting the cells in between; otherwise move the cursor
+            int start = first;
+            if (row == cur_row && first >= cur_col && first - cur_col <= PRESENT_MAX_GAP) {
+                start = cur_col;
+            } else {
+                len += format_move(out + len, row, first);
+            }
+
+            for (int x = start; x <= last; x++) {
+                uint32_t ch = cells[x].ch;
+                shown[x] = cells[x];
+                if (ch >= 0x300) {
+                    if (ch == CONSOLE_WIDE_TAIL && x > 0 && console_cell_is_wide(cells, x - 1, con->width)) {
+                        continue;       // Covered by the character before it
+                    }
+                    if (ch == CONSOLE_WIDE_TAIL ||
+                        (utf8_char_width(ch) == 2 && !console_cell_is_wide(cells, x, con->width))) {
+                        ch = ' ';
+                    }
+                }
+                if (cells[x].attr != cur_attr) {
+                    len += format_attr(out + len, cells[x].attr);
+                    cur_attr = cells[x].attr;
+                }
+                if (ch < 0x80) {
+                    out[len++] = (char)ch;
+                } else {
+                    len += utf8_encode(ch, out + len);
+                }
+            }
+            cur_row = row;
+            cur_col = last + 1;
+            col = last;
+        }
+    }
+
+    if (len > 0) {
+        if (con->out_handle != PLAT_INVALID_HANDLE) {
+            write_all(con->out_handle, con->frame_buf, len);
+        }
+        stats.calls = 1;
+        stats.bytes = len;
+    }
+    con->last_frame = stats;
+}
@@ -0,0 +1,203 @@
+#include "console.h"
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+#include "utf8.h"
+
+// Blank the whole console buffer window directly (outside the cell buffers)
+static void clear_screen(Console *con, WORD attr) {
+    COORD origin = {0, 0};
+    DWORD size = con->width * con->height;
+    DWORD written;
+
+    FillConsoleOutputCharacterA(con->out_handle, ' ', size, origin, &written);
+    FillConsoleOutputAttribute(con->out_handle, attr, size, origin, &written);
+}
+
+bool console_init(Console *con) {
+    if (!con) {
+        return false;
+    }
+
+    // Get handles
+    con->out_handle = GetStdHandle(STD_OUTPUT_HANDLE);
+    con->in_handle = GetStdHandle(STD_INPUT_HANDLE);
+    con->wake_handle = PLAT_INVALID_HANDLE;   // Resizes arrive as input events
+
+    if (con->out_handle == INVALID_HANDLE_VALUE ||
+        con->in_handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    // Save original modes
+    DWORD saved_out_mode = 0;
+    DWORD saved_in_mode = 0;
+    GetConsoleMode(con->out_handle, &saved_out_mode);
+    GetConsoleMode(con->in_handle, &saved_in_mode);
+    con->original_out_mode = saved_out_mode;
+    con->original_in_mode = saved_in_mode;
+
+    // Save original attributes
+    CONSOLE_SCREEN_BUFFER_INFO csbi;
+    if (GetConsoleScreenBufferInfo(con->out_handle, &csbi)) {
+        con->original_attributes = csbi.wAttributes;
+    } else {
+        con->original_attributes = COLOR_DEFAULT;
+    }
+    con->clear_attr = con->original_attributes;
+    con->show_frame_stats = getenv("MULTITAIL_FRAME_STATS") != NULL;
+
+    // Set input mode: disable line input, enable window/mouse events
+    DWORD in_mode = ENABLE_EXTENDED_FLAGS | ENABLE_WINDOW_INPUT;
+    SetConsoleMode(con->in_handle, in_mode);
+
+    // Hide cursor
+    CONSOLE_CURSOR_INFO cursor_info;
+    cursor_info.dwSize = 100;
+    cursor_info.bVisible = FALSE;
+    SetConsoleCursorInfo(con->out_handle, &cursor_info);
+
+    // Get initial size (allocates the cell buffers)
+    if (!console_update_size(con) && !con->cells) {
+        console_cleanup(con);
+        return false;
+    }
+
+    // Clear screen
+    clear_screen(con, con->original_attributes);
+
+    return true;
+}
+
+void console_cleanup(Console *con) {
+    if (!con) {
+        return;
+    }
+    if (con->out_handle == PLAT_INVALID_HANDLE) {
+        console_buffers_free(con);      // Headless
+        return;
+    }
+
+    // Restore modes
+    SetConsoleMode(con->out_handle, con->original_out_mode);
+    SetConsoleMode(con->in_handle, con->original_in_mode);
+
+    // Show cursor
+    CONSOLE_CURSOR_INFO cursor_info;
+    cursor_info.dwSize = 100;
+    cursor_info.bVisible = TRUE;
+    SetConsoleCursorInfo(con->out_handle, &cursor_info);
+
+    // Restore attributes
+    SetConsoleTextAttribute(con->out_handle, con->original_attributes);
+
+    // Clear and reset cursor
+    clear_screen(con, con->original_attributes);
+    COORD pos = {0, 0};
+    SetConsoleCursorPosition(con->out_handle, pos);
+
+    console_buffers_free(con);
+}
+
+bool console_update_size(Console *con) {
+    if (!con || con->out_handle == PLAT_INVALID_HANDLE) {
+        return false;
+    }
+
+    CONSOLE_SCREEN_BUFFER_INFO csbi;
+    if (!GetConsoleScreenBufferInfo(con->out_handle, &csbi)) {
+        return false;
+    }
+
+    int new_width = csbi.srWindow.Right - csbi.srWindow.Left + 1;
+    int new_height = csbi.srWindow.Bottom - csbi.srWindow.Top + 1;
+
+    bool changed = (new_width != con->width || new_height != con->height);
+    if (changed || !con->cells) {
+        if (!console_buffers_resize(con, new_width, new_height)) {
+            return false;
+        }
+    }
+
+    return changed;
+}
+
+void console_present(Console *con) {
+    if (!con || !con->cells || !con->shown) {
+        return;
+    }
+
+    ConsoleFrameStats stats = {0};
+    int first_row = -1;
+    int last_row = -1;
+
+    // Find the band of rows that changed
+    for (int row = 0; row < con->height; row++) {
+        const ConsoleCell *cells = con->cells + (size_t)row * con->width;
+        const ConsoleCell *shown = con->shown + (size_t)row * con->width;
+        size_t changed = 0;
+
+        for (int col = 0; col < con->width; col++) {
+            if (cells[col].ch != shown[col].ch || cells[col].attr != shown[col].attr) {
+                changed++;
+            }
+        }
+
+        if (changed > 0) {
+            if (first_row < 0) {
+                first_row = row;
+            }
+            last_row = row;
+            stats.cells += changed;
+        }
+    }
+
+    if (first_row < 0) {
+        con->last_frame = stats;
+        return;
+    }
+
+    // Write the whole band with a single WriteConsoleOutput call
+    int rows = last_row - first_row + 1;
+    size_t count = (size_t)rows * con->width;
+    if (!console_frame_reserve(con, count * sizeof(CHAR_INFO))) {
+        return;
+    }
+
+    // A wide character goes in both its cells, marked as the leading and
+    // trailing half. CHAR_INFO holds one UTF-16 unit, so characters beyond
+    // the BMP show as U+FFFD.
+    CHAR_INFO *out = (CHAR_INFO *)con->frame_buf;
+    const ConsoleCell *cells = con->cells + (size_t)first_row * con->width;
+    for (int row = 0; row < rows; row++) {
+        const ConsoleCell *line = cells + (size_t)row * con->width;
+        CHAR_INFO *dest = out + (size_t)row * con->width;
+        for (int col = 0; col < con->width; col++) {
+            uint32_t ch = line[col].ch;
+            WORD attr = line[col].attr;
+            if (console_cell_is_wide(line, col, con->width)) {
+                attr |= COMMON_LVB_LEADING_BYTE;
+            } else if (ch == CONSOLE_WIDE_TAIL && col > 0 && console_cell_is_wide(line, col - 1, con->width)) {
+                ch = line[col - 1].ch;
+                attr = line[col - 1].attr | COMMON_LVB_TRAILING_BYTE;
+            } else if (ch == CONSOLE_WIDE_TAIL || (ch >= 0x300 && utf8_char_width(ch) == 2)) {
+                ch = ' ';
+            }
+            dest[col].Char.UnicodeChar = (WCHAR)(ch > 0xFFFF ? UTF8_REPLACEMENT : ch);
+            dest[col].Attributes = attr;
+        }
+    }
+
+    COORD size = {(SHORT)con->width, (SHORT)rows};
+    COORD origin = {0, 0};
+    SMALL_RECT region = {0, (SHORT)first_row, (SHORT)(con->width - 1), (SHORT)last_row};
+    if (con->out_handle != PLAT_INVALID_HANDLE) {
+        WriteConsoleOutputW(con->out_handle, out, size, origin, &region);
+    }
+
+    memcpy(con->shown + (size_t)first_row * con->width, cells, count * sizeof(ConsoleCell));
+
+    stats.calls = 1;
+    stats.bytes = count * sizeof(CHAR_INFO);
+    con->last_frame = stats;
+}
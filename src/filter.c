@@ -0,0 +1,166 @@
+#include "filter.h"
+#include <stdlib.h>
+#include <string.h>
+
+static bool line_passes(LineFilter *filter, const LineEntry *entry) {
+    if (filter->include.source && !pattern_match(&filter->include, entry->text, entry->length)) {
+        return false;
+    }
+    if (filter->exclude.source && pattern_match(&filter->exclude, entry->text, entry->length)) {
+        return false;
+    }
+    return true;
+}
+
+static void index_push(LineFilter *filter, uint64_t seq) {
+    if (filter->count == filter->cap) {
+        size_t new_cap = filter->cap ? filter->cap * 2 : 1024;
+        uint64_t *seqs = (uint64_t *)malloc(new_cap * sizeof(uint64_t));
+        if (!seqs) {
+            if (filter->count == 0) {
+                return;
+            }
+            // Drop the oldest entry rather than the new line
+            filter->head = (filter->head + 1) % filter->cap;
+            filter->count--;
+        } else {
+            for (size_t i = 0; i < filter->count; i++) {
+                seqs[i] = filter->seqs[(filter->head + i) % filter->cap];
+            }
+            free(filter->seqs);
+            filter->seqs = seqs;
+            filter->cap = new_cap;
+            filter->head = 0;
+        }
+    }
+
+    filter->seqs[(filter->head + filter->count) % filter->cap] = seq;
+    filter->count++;
+}
+
+// Empty the index and start re-testing the scrollback from its oldest line
+static void restart(LineFilter *filter, const LineBuffer *buf) {
+    filter->head = 0;
+    filter->count = 0;
+    filter->rescanning = filter_active(filter);
+    filter->scan_seq = buf->first_seq;
+}
+
+void filter_init(LineFilter *filter) {
+    memset(filter, 0, sizeof(LineFilter));
+}
+
+void filter_destroy(LineFilter *filter) {
+    if (!filter) {
+        return;
+    }
+    pattern_free(&filter->include);
+    pattern_free(&filter->exclude);
+    free(filter->seqs);
+    filter->seqs = NULL;
+    filter->cap = 0;
+    filter->count = 0;
+}
+
+bool filter_active(const LineFilter *filter) {
+    return filter && (filter->include.source || filter->exclude.source);
+}
+
+bool filter_set(LineFilter *filter, bool exclude, const char *text, const LineBuffer *buf,
+                char *error, size_t error_size) {
+    if (!filter || !text) {
+        return false;
+    }
+
+    Pattern *slot = exclude ? &filter->exclude : &filter->include;
+    Pattern compiled;
+    memset(&compiled, 0, sizeof(compiled));
+
+    if (text[0] != '\0' && !pattern_compile_text(&compiled, text, error, error_size)) {
+        return false;
+    }
+
+    pattern_free(slot);
+    *slot = compiled;
+    restart(filter, buf);
+    return true;
+}
+
+void filter_clear(LineFilter *filter) {
+    if (!filter) {
+        return;
+    }
+    pattern_free(&filter->include);
+    pattern_free(&filter->exclude);
+    filter->head = 0;
+    filter->count = 0;
+    filter->rescanning = false;
+}
+
+void filter_line_added(LineFilter *filter, const LineBuffer *buf) {
+    if (!filter_active(filter) || filter->rescanning || buf->count == 0) {
+        return;     // A running rescan reaches the new line on its own
+    }
+
+    const LineEntry *entry = linebuf_entry(buf, buf->count - 1);
+    if (entry && line_passes(filter, entry)) {
+        index_push(filter, buf->first_seq + buf->count - 1);
+    }
+}
+
+void filter_trim(LineFilter *filter, const LineBuffer *buf) {
+    while (filter->count > 0 && filter->seqs[filter->head] < buf->first_seq) {
+        filter->head = (filter->head + 1) % filter->cap;
+        filter->count--;
+    }
+    if (filter->rescanning && filter->scan_seq < buf->first_seq) {
+        filter->scan_seq = buf->first_seq;
+    }
+}
+
+bool filter_rescan(LineFilter *filter, const LineBuffer *buf, size_t budget) {
+    if (!filter->rescanning) {
+        return false;
+    }
+
+    filter_trim(filter, buf);
+    uint64_t end_seq = buf->first_seq + buf->count;
+    while (budget > 0 && filter->scan_seq < end_seq) {
+        // A line that cannot be read back from its file is left out
+        const LineEntry *entry = linebuf_entry(buf, (size_t)(filter->scan_seq - buf->first_seq));
+        if (entry && line_passes(filter, entry)) {
+            index_push(filter, filter->scan_seq);
+        }
+        filter->scan_seq++;
+        budget--;
+    }
+
+    filter->rescanning = filter->scan_seq < end_seq;
+    return filter->rescanning;
+}
+
+size_t filter_count(const LineFilter *filter) {
+    return filter ? filter->count : 0;
+}
+
+size_t filter_line(const LineFilter *filter, const LineBuffer *buf, size_t index) {
+    if (!filter || index >= filter->count) {
+        return SIZE_MAX;
+    }
+    return (size_t)(filter->seqs[(filter->head + index) % filter->cap] - buf->first_seq);
+}
+
+size_t filter_row_of(const LineFilter *filter, const LineBuffer *buf, size_t line) {
+    uint64_t seq = buf->first_seq + line;
+    size_t lo = 0;
+    size_t hi = filter->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (filter->seqs[(filter->head + mid) % filter->cap] < seq) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
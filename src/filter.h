@@ -0,0 +1,70 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "linebuf.h"
+#include "pattern.h"
+
+#define FILTER_RESCAN_BATCH 20000   // Lines re-checked per main loop pass after a filter change
+
+// Include/exclude filter for one pane plus the index of lines that pass it.
+//
+// New lines are tested once as they are pushed. The index holds the
+// sequence numbers (LineBuffer.first_seq based) of passing lines in order,
+// so a filtered view maps row -> line in O(1). When the filter changes the
+// existing scrollback is re-tested in batches from the main loop; until the
+// scan reaches the newest line, lines are left for the scan to pick up.
+typedef struct {
+    Pattern include;            // Line must match (unless include.source is NULL)
+    Pattern exclude;            // Line must not match (unless exclude.source is NULL)
+
+    uint64_t *seqs;             // Ring of passing line sequence numbers
+    size_t head;
+    size_t count;
+    size_t cap;                 // Allocated entries (grows as needed)
+
+    bool rescanning;            // Scrollback not fully re-tested yet
+    uint64_t scan_seq;          // Next line the rescan tests
+} LineFilter;
+
+// Set up an empty (inactive) filter
+void filter_init(LineFilter *filter);
+
+// Free patterns and index
+void filter_destroy(LineFilter *filter);
+
+// True if an include or exclude pattern is set
+bool filter_active(const LineFilter *filter);
+
+// Set the include (or exclude) pattern from user text (see
+// pattern_compile_text). Empty text removes that pattern. On failure returns
+// false with a reason in error and leaves the filter unchanged. The index is
+// rebuilt from buf by filter_rescan.
+bool filter_set(LineFilter *filter, bool exclude, const char *text, const LineBuffer *buf,
+                char *error, size_t error_size);
+
+// Remove both patterns
+void filter_clear(LineFilter *filter);
+
+// Record a line just pushed to buf (the newest one)
+void filter_line_added(LineFilter *filter, const LineBuffer *buf);
+
+// Drop index entries for lines buf no longer holds
+void filter_trim(LineFilter *filter, const LineBuffer *buf);
+
+// Re-test up to budget lines of an unfinished rescan. Returns true if the
+// rescan still has lines left.
+bool filter_rescan(LineFilter *filter, const LineBuffer *buf, size_t budget);
+
+// Number of indexed (passing) lines
+size_t filter_count(const LineFilter *filter);
+
+// Logical buffer index of the index'th passing line
+size_t filter_line(const LineFilter *filter, const LineBuffer *buf, size_t index);
+
+// Index of the first passing line at or after logical buffer index line
+size_t filter_row_of(const LineFilter *filter, const LineBuffer *buf, size_t line);
+
+#endif // FILTER_H
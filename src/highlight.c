@@ -0,0 +1,472 @@
+#include "highlight.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const char *name;
+    ConsoleAttr attr;
+} HighlightColor;
+
+static const HighlightColor colors[] = {
+    {"red", CONSOLE_FG_RED | CONSOLE_FG_INTENSITY},
+    {"green", CONSOLE_FG_GREEN | CONSOLE_FG_INTENSITY},
+    {"yellow", CONSOLE_FG_RED | CONSOLE_FG_GREEN | CONSOLE_FG_INTENSITY},
+    {"blue", CONSOLE_FG_BLUE | CONSOLE_FG_INTENSITY},
+    {"magenta", CONSOLE_FG_RED | CONSOLE_FG_BLUE | CONSOLE_FG_INTENSITY},
+    {"cyan", CONSOLE_FG_GREEN | CONSOLE_FG_BLUE | CONSOLE_FG_INTENSITY},
+    {"white", CONSOLE_FG_RED | CONSOLE_FG_GREEN | CONSOLE_FG_BLUE | CONSOLE_FG_INTENSITY},
+};
+
+static uint8_t fold(uint8_t c) {
+    return (c >= 'A' && c <= 'Z') ? (uint8_t)(c + ('a' - 'A')) : c;
+}
+
+static void free_automaton(HighlightRules *rules) {
+    free(rules->next);
+    free(rules->out_start);
+    free(rules->outputs);
+    rules->next = NULL;
+    rules->out_start = NULL;
+    rules->outputs = NULL;
+    rules->state_count = 0;
+}
+
+void highlight_rules_init(HighlightRules *rules) {
+    memset(rules, 0, sizeof(HighlightRules));
+}
+
+void highlight_rules_destroy(HighlightRules *rules) {
+    if (!rules) {
+        return;
+    }
+    for (int i = 0; i < rules->rule_count; i++) {
+        pattern_free(&rules->rules[i].pattern);
+    }
+    free_automaton(rules);
+    rules->rule_count = 0;
+}
+
+static bool add_rule(HighlightRules *rules, const char *text, ConsoleAttr attr, bool whole_line, char *error,
+                     size_t error_size) {
+    if (rules->rule_count >= HIGHLIGHT_MAX_RULES) {
+        snprintf(error, error_size, "more than %d rules", HIGHLIGHT_MAX_RULES);
+        return false;
+    }
+    if (text[0] == '\0') {
+        snprintf(error, error_size, "empty pattern");
+        return false;
+    }
+
+    HighlightRule *rule = &rules->rules[rules->rule_count];
+    if (!pattern_compile_text(&rule->pattern, text, error, error_size)) {
+        return false;
+    }
+    rule->attr = attr;
+    rule->whole_line = whole_line;
+    rules->rule_count++;
+    return true;
+}
+
+bool highlight_rules_add(HighlightRules *rules, const char *spec, bool whole_line, char *error, size_t error_size) {
+    const char *colon = strchr(spec, ':');
+    if (!colon) {
+        snprintf(error, error_size, "expected COLOR:PATTERN");
+        return false;
+    }
+
+    size_t name_len = (size_t)(colon - spec);
+    for (size_t i = 0; i < sizeof(colors) / sizeof(colors[0]); i++) {
+        if (strlen(colors[i].name) == name_len && strncmp(colors[i].name, spec, name_len) == 0) {
+            return add_rule(rules, colon + 1, colors[i].attr, whole_line, error, error_size);
+        }
+    }
+    snprintf(error, error_size, "unknown color '%.*s'", (int)name_len, spec);
+    return false;
+}
+
+bool highlight_rules_add_levels(HighlightRules *rules) {
+    static const struct {
+        const char *text;
+        ConsoleAttr attr;
+    } levels[] = {
+        {"FATAL", CONSOLE_FG_RED | CONSOLE_FG_INTENSITY},
+        {"ERROR", CONSOLE_FG_RED | CONSOLE_FG_INTENSITY},
+        {"CRIT", CONSOLE_FG_RED | CONSOLE_FG_INTENSITY},
+        {"WARN", CONSOLE_FG_RED | CONSOLE_FG_GREEN | CONSOLE_FG_INTENSITY},
+    };
+
+    char error[64];
+    for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+        if (!add_rule(rules, levels[i].text, levels[i].attr, true, error, sizeof(error))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool highlight_rules_compile(HighlightRules *rules) {
+    free_automaton(rules);
+    rules->has_regex = false;
+
+    // One class per byte some literal contains (folded), class 0 for the rest
+    memset(rules->byte_class, 0, sizeof(rules->byte_class));
+    int class_count = 1;
+    size_t total = 0;
+    for (int r = 0; r < rules->rule_count; r++) {
+        const Pattern *pat = &rules->rules[r].pattern;
+        if (pat->regex) {
+            rules->has_regex = true;
+            continue;
+        }
+        for (size_t i = 0; i < pat->literal_len; i++) {
+            uint8_t c = fold((uint8_t)pat->literal[i]);
+            if (rules->byte_class[c] == 0) {
+                rules->byte_class[c] = (uint8_t)class_count++;
+            }
+        }
+        total += pat->literal_len;
+    }
+    for (int c = 'A'; c <= 'Z'; c++) {
+        rules->byte_class[c] = rules->byte_class[fold((uint8_t)c)];
+    }
+    rules->class_count = class_count;
+
+    // Trie of the literals; state 0 is the root, so 0 also means no edge yet
+    size_t max_states = total + 1;
+    size_t classes = (size_t)class_count;
+    uint16_t *next = (uint16_t *)calloc(max_states * classes, sizeof(uint16_t));
+    uint16_t *fail = (uint16_t *)calloc(max_states, sizeof(uint16_t));
+    uint16_t *order = (uint16_t *)malloc(max_states * sizeof(uint16_t));
+    int *term = (int *)malloc(max_states * sizeof(int));
+    int term_next[HIGHLIGHT_MAX_RULES];
+    rules->out_start = (uint32_t *)calloc(max_states + 1, sizeof(uint32_t));
+    if (!next || !fail || !order || !term || !rules->out_start) {
+        free(next);
+        free(fail);
+        free(order);
+        free(term);
+        free_automaton(rules);
+        return false;
+    }
+
+    size_t state_count = 1;
+    for (size_t s = 0; s < max_states; s++) {
+        term[s] = -1;
+    }
+    for (int r = 0; r < rules->rule_count; r++) {
+        const Pattern *pat = &rules->rules[r].pattern;
+        if (pat->regex) {
+            continue;
+        }
+        size_t s = 0;
+        for (size_t i = 0; i < pat->literal_len; i++) {
+            uint16_t *edge = &next[s * classes + rules->byte_class[(uint8_t)pat->literal[i]]];
+            if (*edge == 0) {
+                *edge = (uint16_t)state_count++;
+            }
+            s = *edge;
+        }
+        term_next[r] = term[s];
+        term[s] = r;
+    }
+
+    // Breadth first: fill in failure links, and turn missing edges into the
+    // edge the failure state takes, so matching never backtracks
+    size_t order_count = 0;
+    order[order_count++] = 0;
+    for (size_t at = 0; at < order_count; at++) {
+        size_t s = order[at];
+        for (size_t c = 0; c < classes; c++) {
+            uint16_t *edge = &next[s * classes + c];
+            uint16_t via_fail = s == 0 ? 0 : next[fail[s] * classes + c];
+            if (*edge != 0) {
+                fail[*edge] = via_fail;
+                order[order_count++] = *edge;
+            } else {
+                *edge = via_fail;
+            }
+        }
+    }
+
+    // A state outputs its own rules and its failure state's (every literal
+    // ending there); failure states come earlier in breadth first order
+    uint32_t *out_start = rules->out_start;
+    uint32_t *counts = out_start + 1;
+    for (size_t at = 0; at < order_count; at++) {
+        size_t s = order[at];
+        uint32_t own = 0;
+        for (int r = term[s]; r >= 0; r = term_next[r]) {
+            own++;
+        }
+        counts[s] = own + (s == 0 ? 0 : counts[fail[s]]);
+    }
+    for (size_t s = 0; s < state_count; s++) {
+        out_start[s + 1] += out_start[s];
+    }
+
+    rules->outputs = (uint8_t *)malloc(out_start[state_count] ? out_start[state_count] : 1);
+    if (!rules->outputs) {
+        free(next);
+        free(fail);
+        free(order);
+        free(term);
+        free_automaton(rules);
+        return false;
+    }
+    for (size_t at = 0; at < order_count; at++) {
+        size_t s = order[at];
+        uint32_t k = out_start[s];
+        for (int r = term[s]; r >= 0; r = term_next[r]) {
+            rules->outputs[k++] = (uint8_t)r;
+        }
+        if (s != 0) {
+            uint32_t inherited = out_start[fail[s] + 1] - out_start[fail[s]];
+            memcpy(rules->outputs + k, rules->outputs + out_start[fail[s]], inherited);
+        }
+    }
+
+    // The matching table: each edge premultiplied, with the output flag
+    uint32_t *table = (uint32_t *)malloc(state_count * classes * sizeof(uint32_t));
+    if (table) {
+        for (size_t i = 0; i < state_count * classes; i++) {
+            uint32_t to = next[i];
+            table[i] = (uint32_t)(to * classes) << 1 | (out_start[to + 1] > out_start[to]);
+        }
+    }
+    free(next);
+    free(fail);
+    free(order);
+    free(term);
+    if (!table) {
+        free_automaton(rules);
+        return false;
+    }
+    rules->next = table;
+    rules->state_count = (int)state_count;
+    return true;
+}
+
+// A match found while classifying, with the rule that made it
+typedef struct {
+    size_t start;
+    size_t end;
+    int rule;
+} Match;
+
+typedef struct {
+    int line_rule;              // Best whole-line rule matched so far (rule_count: none)
+    Match matches[HIGHLIGHT_MAX_RUNS];
+    size_t count;
+} Classified;
+
+static void add_match(const HighlightRules *rules, Classified *found, int rule, size_t start, size_t end) {
+    if (rules->rules[rule].whole_line) {
+        if (rule < found->line_rule) {
+            found->line_rule = rule;
+        }
+    } else if (found->count < HIGHLIGHT_MAX_RUNS) {
+        Match *match = &found->matches[found->count++];
+        match->start = start;
+        match->end = end;
+        match->rule = rule;
+    }
+}
+
+void highlight_classify(HighlightRules *rules, const char *text, size_t len, HighlightLine *line) {
+    Classified found;
+    found.line_rule = rules->rule_count;
+    found.count = 0;
+
+    // Every literal in one pass
+    if (rules->state_count > 1) {
+        const uint32_t *next = rules->next;
+        const uint8_t *byte_class = rules->byte_class;
+        const uint32_t *out_start = rules->out_start;
+        size_t classes = (size_t)rules->class_count;
+        uint32_t edge = 0;
+        for (size_t i = 0; i < len; i++) {
+            edge = next[(edge >> 1) + byte_class[(uint8_t)text[i]]];
+            if (!(edge & 1)) {
+                continue;
+            }
+            size_t s = (edge >> 1) / classes;
+            for (uint32_t k = out_start[s]; k < out_start[s + 1]; k++) {
+                int r = rules->outputs[k];
+                const Pattern *pat = &rules->rules[r].pattern;
+                size_t start = i + 1 - pat->literal_len;
+                if (!pat->ignore_case && memcmp(text + start, pat->literal, pat->literal_len) != 0) {
+                    continue;
+                }
+                add_match(rules, &found, r, start, i + 1);
+            }
+        }
+    }
+
+    // Then each regex
+    for (int r = 0; rules->has_regex && r < rules->rule_count; r++) {
+        HighlightRule *rule = &rules->rules[r];
+        if (!rule->pattern.regex) {
+            continue;
+        }
+        if (rule->whole_line) {
+            if (r < found.line_rule && pattern_match(&rule->pattern, text, len)) {
+                found.line_rule = r;
+            }
+            continue;
+        }
+        size_t pos = 0;
+        size_t start;
+        size_t end;
+        while (pos <= len && found.count < HIGHLIGHT_MAX_RUNS &&
+               pattern_find(&rule->pattern, text + pos, len - pos, &start, &end)) {
+            if (end > start) {
+                add_match(rules, &found, r, pos + start, pos + end);
+            }
+            if (rule->pattern.anchored) {
+                break;      // ^ would match again at every restart
+            }
+            pos += end > start ? end : end + 1;
+        }
+    }
+
+    line->line_attr = found.line_rule < rules->rule_count ? rules->rules[found.line_rule].attr : COLOR_DEFAULT;
+
+    // Lowest priority first, so earlier rules are painted over later ones
+    for (size_t i = 1; i < found.count; i++) {
+        Match match = found.matches[i];
+        size_t j = i;
+        for (; j > 0 && found.matches[j - 1].rule < match.rule; j--) {
+            found.matches[j] = found.matches[j - 1];
+        }
+        found.matches[j] = match;
+    }
+
+    line->run_count = 0;
+    for (size_t i = 0; i < found.count; i++) {
+        const Match *match = &found.matches[i];
+        if (match->start >= HIGHLIGHT_MAX_OFFSET) {
+            continue;
+        }
+        HighlightRun *run = &line->runs[line->run_count++];
+        run->start = (uint16_t)match->start;
+        run->end = (uint16_t)(match->end < HIGHLIGHT_MAX_OFFSET ? match->end : HIGHLIGHT_MAX_OFFSET);
+        run->attr = rules->rules[match->rule].attr;
+    }
+}
+
+void highlight_init(LineHighlights *highlights, HighlightRules *rules) {
+    memset(highlights, 0, sizeof(LineHighlights));
+    highlights->rules = rules;
+}
+
+void highlight_destroy(LineHighlights *highlights) {
+    if (!highlights) {
+        return;
+    }
+    free(highlights->entries);
+    free(highlights->runs);
+    highlight_init(highlights, NULL);
+}
+
+// Make room for one more entry and count more runs, dropping the evicted
+// front of each array first if half of it is unused
+static bool reserve(LineHighlights *highlights, size_t runs) {
+    if (highlights->used == highlights->cap && highlights->first > 0 && highlights->first >= highlights->cap / 2) {
+        highlights->used -= highlights->first;
+        memmove(highlights->entries, highlights->entries + highlights->first,
+                highlights->used * sizeof(HighlightEntry));
+        highlights->first = 0;
+    }
+    if (highlights->used == highlights->cap) {
+        size_t new_cap = highlights->cap ? highlights->cap * 2 : 256;
+        HighlightEntry *entries = (HighlightEntry *)realloc(highlights->entries, new_cap * sizeof(HighlightEntry));
+        if (!entries) {
+            return false;
+        }
+        highlights->entries = entries;
+        highlights->cap = new_cap;
+    }
+
+    if (highlights->run_used + runs > highlights->run_cap && highlights->run_first > 0 &&
+        highlights->run_first >= highlights->run_cap / 2) {
+        highlights->run_used -= highlights->run_first;
+        memmove(highlights->runs, highlights->runs + highlights->run_first,
+                highlights->run_used * sizeof(HighlightRun));
+        highlights->run_base += highlights->run_first;
+        highlights->run_first = 0;
+    }
+    if (highlights->run_used + runs > highlights->run_cap) {
+        size_t new_cap = highlights->run_cap ? highlights->run_cap * 2 : 256;
+        HighlightRun *new_runs = (HighlightRun *)realloc(highlights->runs, new_cap * sizeof(HighlightRun));
+        if (!new_runs) {
+            return false;
+        }
+        highlights->runs = new_runs;
+        highlights->run_cap = new_cap;
+    }
+    return true;
+}
+
+void highlight_line_added(LineHighlights *highlights, const LineBuffer *buf) {
+    if (!highlights->rules || buf->count == 0) {
+        return;
+    }
+    const LineEntry *entry = linebuf_entry(buf, buf->count - 1);
+    if (!entry) {
+        return;
+    }
+
+    HighlightLine line;
+    highlight_classify(highlights->rules, entry->text, entry->length, &line);
+    if (line.line_attr == COLOR_DEFAULT && line.run_count == 0) {
+        return;     // Plain lines get no entry
+    }
+    if (!reserve(highlights, line.run_count)) {
+        return;     // Shown plain
+    }
+
+    HighlightEntry *added = &highlights->entries[highlights->used++];
+    added->seq = buf->first_seq + buf->count - 1;
+    added->run_pos = highlights->run_base + highlights->run_used;
+    added->line_attr = line.line_attr;
+    added->run_count = (uint16_t)line.run_count;
+    if (line.run_count > 0) {
+        memcpy(highlights->runs + highlights->run_used, line.runs, line.run_count * sizeof(HighlightRun));
+        highlights->run_used += line.run_count;
+    }
+}
+
+void highlight_trim(LineHighlights *highlights, const LineBuffer *buf) {
+    while (highlights->first < highlights->used && highlights->entries[highlights->first].seq < buf->first_seq) {
+        highlights->run_first += highlights->entries[highlights->first].run_count;
+        highlights->first++;
+    }
+    if (highlights->first == highlights->used) {
+        highlights->first = 0;
+        highlights->used = 0;
+        highlights->run_base += highlights->run_used;
+        highlights->run_first = 0;
+        highlights->run_used = 0;
+    }
+}
+
+const HighlightEntry *highlight_find(const LineHighlights *highlights, uint64_t seq, const HighlightRun **runs) {
+    size_t lo = highlights->first;
+    size_t hi = highlights->used;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (highlights->entries[mid].seq < seq) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == highlights->used || highlights->entries[lo].seq != seq) {
+        return NULL;
+    }
+
+    const HighlightEntry *entry = &highlights->entries[lo];
+    *runs = highlights->runs + (size_t)(entry->run_pos - highlights->run_base);
+    return entry;
+}
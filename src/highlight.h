@@ -0,0 +1,125 @@
+#ifndef HIGHLIGHT_H
+#define HIGHLIGHT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "console.h"
+#include "linebuf.h"
+#include "pattern.h"
+
+#define HIGHLIGHT_MAX_RULES 64      // Rules accepted in all
+#define HIGHLIGHT_MAX_RUNS 8        // Colored spans kept per line; later matches are dropped
+#define HIGHLIGHT_MAX_OFFSET 65535  // Spans are clipped to this many bytes into the line
+
+// One rule: a pattern (literal or /regex/, see pattern_compile_text) and
+// the color given to what it matches, or to the whole line
+typedef struct {
+    Pattern pattern;
+    ConsoleAttr attr;
+    bool whole_line;
+} HighlightRule;
+
+// Highlight rules, compiled once and shared by every pane.
+//
+// All literal rules are folded into one Aho-Corasick automaton, so a line
+// is scanned once however many there are: each byte is one table step
+// through the states. Bytes are mapped to classes first (all bytes no
+// literal contains share one), which keeps the table small. The automaton
+// matches case-folded text; a case-sensitive rule's hits are checked
+// against the original. Regex rules are run one by one after the scan.
+typedef struct {
+    HighlightRule rules[HIGHLIGHT_MAX_RULES];   // In priority order
+    int rule_count;
+
+    uint8_t byte_class[256];    // Byte -> class (case-folded)
+    int class_count;
+    int state_count;
+    uint32_t *next;             // [state * class_count + class]: next state * class_count, shifted
+                                // up one bit, with bit 0 set if it outputs rules
+    uint32_t *out_start;        // Rules matching at each state: outputs[out_start[s]..out_start[s + 1]]
+    uint8_t *outputs;
+    bool has_regex;
+} HighlightRules;
+
+// A colored span of a line, in bytes
+typedef struct {
+    uint16_t start;
+    uint16_t end;
+    ConsoleAttr attr;
+} HighlightRun;
+
+// What the rules made of one line: the color of the whole line (the
+// default when no line rule matched) and the spans painted over it
+typedef struct {
+    ConsoleAttr line_attr;
+    HighlightRun runs[HIGHLIGHT_MAX_RUNS];
+    size_t run_count;
+} HighlightLine;
+
+// One highlighted line in a pane's index
+typedef struct {
+    uint64_t seq;               // Line sequence number (LineBuffer.first_seq based)
+    uint64_t run_pos;           // Its first run among all runs ever stored
+    ConsoleAttr line_attr;
+    uint16_t run_count;
+} HighlightEntry;
+
+// A pane's highlighted lines. Lines are classified once as they are pushed
+// and only the ones something matched get an entry, so redraws never match
+// again and plain lines cost nothing. Entries (and their runs) are kept in
+// line order in arrays that drop evicted lines from the front, compacting
+// once half is unused.
+typedef struct {
+    HighlightRules *rules;      // NULL: highlighting off (shared; regex scratch space is written)
+    HighlightEntry *entries;
+    size_t first;               // First live entry
+    size_t used;                // Entries filled, live ones from first
+    size_t cap;
+    HighlightRun *runs;
+    uint64_t run_base;          // Run position of runs[0]
+    size_t run_first;           // First live run
+    size_t run_used;
+    size_t run_cap;
+} LineHighlights;
+
+// Set up rules with none in them
+void highlight_rules_init(HighlightRules *rules);
+
+// Free the rules
+void highlight_rules_destroy(HighlightRules *rules);
+
+// Add a rule from COLOR:PATTERN (colors: red, green, yellow, blue, magenta,
+// cyan, white). Rules added first win where they overlap. Returns false
+// with a reason in error if the spec is bad, the pattern does not compile
+// or there are too many rules.
+bool highlight_rules_add(HighlightRules *rules, const char *spec, bool whole_line, char *error, size_t error_size);
+
+// Add the built-in log level rules: lines with FATAL, ERROR or CRIT in red,
+// WARN in yellow
+bool highlight_rules_add_levels(HighlightRules *rules);
+
+// Build the automaton once every rule is added. Returns false if out of
+// memory.
+bool highlight_rules_compile(HighlightRules *rules);
+
+// Classify one line
+void highlight_classify(HighlightRules *rules, const char *text, size_t len, HighlightLine *line);
+
+// Set up an empty index classifying lines by rules (NULL for none)
+void highlight_init(LineHighlights *highlights, HighlightRules *rules);
+
+// Free the index
+void highlight_destroy(LineHighlights *highlights);
+
+// Classify the line just pushed to buf (the newest one)
+void highlight_line_added(LineHighlights *highlights, const LineBuffer *buf);
+
+// Drop entries for lines buf no longer holds
+void highlight_trim(LineHighlights *highlights, const LineBuffer *buf);
+
+// The highlighting of line seq, or NULL if it has none. *runs points at
+// its run_count runs, valid until the index changes.
+const HighlightEntry *highlight_find(const LineHighlights *highlights, uint64_t seq, const HighlightRun **runs);
+
+#endif // HIGHLIGHT_H
@@ -0,0 +1,531 @@
+#include "inflate.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Decoder states between inflate_next calls
+enum {
+    STATE_MEMBER,       // At a gzip member header (or the end of the file)
+    STATE_BLOCK,        // At a DEFLATE block header
+    STATE_STORED,       // Copying a stored block
+    STATE_CODES,        // Decoding a Huffman block
+    STATE_TRAILER,      // At a member's CRC and size
+    STATE_DONE,
+    STATE_FAILED
+};
+
+static const uint16_t length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// Order code length code lengths are sent in
+static const uint8_t length_order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+// Top the bit buffer up to at least 57 bits, or whatever input is left
+static bool refill(Inflater *inf) {
+    while (inf->bit_count <= 56) {
+        if (inf->in_pos == inf->in_len) {
+            if (inf->in_end) {
+                return true;
+            }
+            size_t got;
+            if (!inf->fill(inf->ctx, inf->in, INFLATE_INPUT, &got)) {
+                return false;
+            }
+            inf->in_pos = 0;
+            inf->in_len = got;
+            inf->in_end = got == 0;
+            continue;
+        }
+        inf->bits |= (uint64_t)inf->in[inf->in_pos++] << inf->bit_count;
+        inf->bit_count += 8;
+    }
+    return true;
+}
+
+// Take n (at most 32) bits. Fails at the end of the input.
+static bool get_bits(Inflater *inf, unsigned n, uint32_t *value) {
+    if (inf->bit_count < n && (!refill(inf) || inf->bit_count < n)) {
+        return false;
+    }
+    *value = (uint32_t)(inf->bits & ((1ULL << n) - 1));
+    inf->bits >>= n;
+    inf->bit_count -= n;
+    return true;
+}
+
+static bool get_byte(Inflater *inf, uint32_t *value) {
+    return get_bits(inf, 8, value);
+}
+
+// Skip to the next byte boundary
+static void align_byte(Inflater *inf) {
+    unsigned drop = inf->bit_count % 8;
+    inf->bits >>= drop;
+    inf->bit_count -= drop;
+}
+
+// Build a code from symbol lengths. Incomplete codes are allowed (a lone
+// distance code is common), over-full ones are not.
+static bool build_code(InflateCode *code, const uint8_t *lengths, int n) {
+    memset(code->count, 0, sizeof(code->count));
+    for (int i = 0; i < n; i++) {
+        code->count[lengths[i]]++;
+    }
+    code->count[0] = 0;
+
+    int left = 1;
+    for (int len = 1; len < 16; len++) {
+        left = left * 2 - code->count[len];
+        if (left < 0) {
+            return false;
+        }
+    }
+
+    uint16_t offsets[16];
+    offsets[1] = 0;
+    for (int len = 1; len < 15; len++) {
+        offsets[len + 1] = (uint16_t)(offsets[len] + code->count[len]);
+    }
+    for (int i = 0; i < n; i++) {
+        if (lengths[i]) {
+            code->symbol[offsets[lengths[i]]++] = (uint16_t)i;
+        }
+    }
+
+    // Codes are sent first bit first, so the table is indexed by their
+    // reversed bits, with every combination of the bits after them
+    memset(code->fast, 0, sizeof(code->fast));
+    uint32_t next = 0;
+    int index = 0;
+    for (int len = 1; len <= INFLATE_FAST_BITS; len++) {
+        for (int i = 0; i < code->count[len]; i++, next++) {
+            uint32_t reversed = 0;
+            for (int b = 0; b < len; b++) {
+                reversed |= ((next >> b) & 1) << (len - 1 - b);
+            }
+            uint16_t entry = (uint16_t)(code->symbol[index++] << 4 | len);
+            for (uint32_t fill = reversed; fill < (1u << INFLATE_FAST_BITS); fill += 1u << len) {
+                code->fast[fill] = entry;
+            }
+        }
+        next <<= 1;
+    }
+    return true;
+}
+
+// Next symbol: one lookup for short codes, a bit at a time for long ones
+static int decode(Inflater *inf, const InflateCode *code) {
+    if (inf->bit_count < 15 && !refill(inf)) {
+        return -1;
+    }
+    uint16_t entry = code->fast[inf->bits & ((1u << INFLATE_FAST_BITS) - 1)];
+    unsigned len = entry & 15;
+    if (entry && len <= inf->bit_count) {
+        inf->bits >>= len;
+        inf->bit_count -= len;
+        return entry >> 4;
+    }
+
+    int value = 0;
+    int first = 0;
+    int index = 0;
+    for (len = 1; len < 16; len++) {
+        uint32_t bit;
+        if (!get_bits(inf, 1, &bit)) {
+            return -1;
+        }
+        value |= (int)bit;
+        int count = code->count[len];
+        if (value - count < first) {
+            return code->symbol[index + (value - first)];
+        }
+        index += count;
+        first = (first + count) << 1;
+        value <<= 1;
+    }
+    return -1;
+}
+
+static void build_fixed(Inflater *inf) {
+    uint8_t lengths[288];
+    memset(lengths, 8, 144);
+    memset(lengths + 144, 9, 112);
+    memset(lengths + 256, 7, 24);
+    memset(lengths + 280, 8, 8);
+    build_code(&inf->lit, lengths, 288);
+    memset(lengths, 5, 30);
+    build_code(&inf->dist, lengths, 30);
+}
+
+static bool read_dynamic(Inflater *inf) {
+    uint32_t hlit;
+    uint32_t hdist;
+    uint32_t hclen;
+    if (!get_bits(inf, 5, &hlit) || !get_bits(inf, 5, &hdist) || !get_bits(inf, 4, &hclen)) {
+        return false;
+    }
+    hlit += 257;
+    hdist += 1;
+    hclen += 4;
+    if (hlit > 286 || hdist > 30) {
+        return false;
+    }
+
+    uint8_t lengths[320];
+    memset(lengths, 0, 19);
+    for (uint32_t i = 0; i < hclen; i++) {
+        uint32_t len;
+        if (!get_bits(inf, 3, &len)) {
+            return false;
+        }
+        lengths[length_order[i]] = (uint8_t)len;
+    }
+    // The distance code is free until the lengths are read
+    if (!build_code(&inf->dist, lengths, 19)) {
+        return false;
+    }
+
+    uint32_t i = 0;
+    while (i < hlit + hdist) {
+        int sym = decode(inf, &inf->dist);
+        if (sym < 0) {
+            return false;
+        }
+        if (sym < 16) {
+            lengths[i++] = (uint8_t)sym;
+            continue;
+        }
+
+        uint32_t repeat;
+        uint8_t len = 0;
+        if (sym == 16) {
+            if (i == 0 || !get_bits(inf, 2, &repeat)) {
+                return false;
+            }
+            len = lengths[i - 1];
+            repeat += 3;
+        } else if (sym == 17) {
+            if (!get_bits(inf, 3, &repeat)) {
+                return false;
+            }
+            repeat += 3;
+        } else {
+            if (!get_bits(inf, 7, &repeat)) {
+                return false;
+            }
+            repeat += 11;
+        }
+        if (i + repeat > hlit + hdist) {
+            return false;
+        }
+        memset(lengths + i, len, repeat);
+        i += repeat;
+    }
+
+    if (lengths[256] == 0) {
+        return false;   // No end-of-block code
+    }
+    return build_code(&inf->lit, lengths, (int)hlit) && build_code(&inf->dist, lengths + hlit, (int)hdist);
+}
+
+// Parse a member header, or find the end of the file. Whatever follows the
+// last member that is not another one is ignored, as gzip does.
+static bool read_member(Inflater *inf) {
+    if (!refill(inf)) {
+        return false;
+    }
+    uint32_t id1;
+    uint32_t id2;
+    if (inf->bit_count < 16 || !get_byte(inf, &id1) || !get_byte(inf, &id2) || id1 != 0x1f || id2 != 0x8b) {
+        inf->state = STATE_DONE;
+        return inf->members > 0;
+    }
+
+    uint32_t method;
+    uint32_t flags;
+    uint32_t skip;
+    if (!get_byte(inf, &method) || !get_byte(inf, &flags) || method != 8) {
+        return false;
+    }
+    for (int i = 0; i < 6; i++) {       // Time, extra flags, OS
+        if (!get_byte(inf, &skip)) {
+            return false;
+        }
+    }
+    if (flags & 4) {                    // Extra field
+        uint32_t lo;
+        uint32_t hi;
+        if (!get_byte(inf, &lo) || !get_byte(inf, &hi)) {
+            return false;
+        }
+        for (uint32_t n = lo | hi << 8; n > 0; n--) {
+            if (!get_byte(inf, &skip)) {
+                return false;
+            }
+        }
+    }
+    for (uint32_t flag = 8; flag <= 16; flag <<= 1) {   // Name, comment
+        if (flags & flag) {
+            do {
+                if (!get_byte(inf, &skip)) {
+                    return false;
+                }
+            } while (skip != 0);
+        }
+    }
+    if ((flags & 2) && !get_bits(inf, 16, &skip)) {     // Header CRC
+        return false;
+    }
+
+    inf->members++;
+    inf->member_out = 0;
+    inf->crc = 0xFFFFFFFFu;
+    inf->state = STATE_BLOCK;
+    return true;
+}
+
+static bool read_block_header(Inflater *inf) {
+    uint32_t last;
+    uint32_t type;
+    if (!get_bits(inf, 1, &last) || !get_bits(inf, 2, &type)) {
+        return false;
+    }
+    inf->last_block = last != 0;
+
+    if (type == 0) {
+        uint32_t len;
+        uint32_t nlen;
+        align_byte(inf);
+        if (!get_bits(inf, 16, &len) || !get_bits(inf, 16, &nlen) || (len ^ 0xFFFF) != nlen) {
+            return false;
+        }
+        inf->stored_left = len;
+        inf->state = STATE_STORED;
+        return true;
+    }
+    if (type == 1) {
+        build_fixed(inf);
+    } else if (type != 2 || !read_dynamic(inf)) {
+        return false;
+    }
+    inf->state = STATE_CODES;
+    return true;
+}
+
+static bool read_trailer(Inflater *inf) {
+    uint32_t crc;
+    uint32_t size;
+    align_byte(inf);
+    if (!get_bits(inf, 32, &crc) || !get_bits(inf, 32, &size)) {
+        return false;
+    }
+    if (crc != (inf->crc ^ 0xFFFFFFFFu) || size != (uint32_t)inf->member_out) {
+        return false;
+    }
+    inf->state = STATE_MEMBER;
+    return true;
+}
+
+// Copy a stored block's bytes, from the bit buffer first and then straight
+// from the input
+static bool copy_stored(Inflater *inf, unsigned char *end) {
+    unsigned char *op = inf->out + inf->out_pos;
+    while (inf->stored_left > 0 && op < end) {
+        if (inf->bit_count >= 8) {
+            *op++ = (unsigned char)inf->bits;
+            inf->bits >>= 8;
+            inf->bit_count -= 8;
+            inf->stored_left--;
+            continue;
+        }
+        if (inf->in_pos == inf->in_len) {
+            if (!refill(inf) || inf->bit_count < 8) {
+                return false;
+            }
+            continue;   // Bytes just taken into the bit buffer come first
+        }
+        size_t n = inf->in_len - inf->in_pos;
+        if (n > inf->stored_left) {
+            n = inf->stored_left;
+        }
+        if (n > (size_t)(end - op)) {
+            n = (size_t)(end - op);
+        }
+        memcpy(op, inf->in + inf->in_pos, n);
+        inf->in_pos += n;
+        op += n;
+        inf->stored_left -= n;
+    }
+
+    inf->member_out += (size_t)(op - (inf->out + inf->out_pos));
+    inf->out_pos = (size_t)(op - inf->out);
+    if (inf->stored_left == 0) {
+        inf->state = inf->last_block ? STATE_TRAILER : STATE_BLOCK;
+    }
+    return true;
+}
+
+// Copy a match, overlapping its own output for runs
+static unsigned char *copy_match(unsigned char *op, size_t dist, size_t len) {
+    const unsigned char *from = op - dist;
+    if (dist >= len) {
+        memcpy(op, from, len);
+        return op + len;
+    }
+    while (len-- > 0) {
+        *op++ = *from++;
+    }
+    return op;
+}
+
+// Decode a Huffman block until it ends or the output block is full
+static bool decode_codes(Inflater *inf, unsigned char *end) {
+    unsigned char *start = inf->out + inf->out_pos;
+    unsigned char *op = start;
+    bool ok = true;
+
+    while (op < end) {
+        if (inf->match_len > 0) {
+            size_t n = inf->match_len < (size_t)(end - op) ? inf->match_len : (size_t)(end - op);
+            op = copy_match(op, inf->match_dist, n);
+            inf->match_len -= n;
+            continue;
+        }
+
+        int sym = decode(inf, &inf->lit);
+        if (sym < 0) {
+            ok = false;
+            break;
+        }
+        if (sym < 256) {
+            *op++ = (unsigned char)sym;
+            continue;
+        }
+        if (sym == 256) {
+            inf->state = inf->last_block ? STATE_TRAILER : STATE_BLOCK;
+            break;
+        }
+
+        sym -= 257;
+        uint32_t extra;
+        if (sym >= 29 || !get_bits(inf, length_extra[sym], &extra)) {
+            ok = false;
+            break;
+        }
+        size_t len = length_base[sym] + extra;
+        int dsym = decode(inf, &inf->dist);
+        if (dsym < 0 || dsym >= 30 || !get_bits(inf, dist_extra[dsym], &extra)) {
+            ok = false;
+            break;
+        }
+        size_t dist = dist_base[dsym] + extra;
+        if (dist > inf->member_out + (uint64_t)(op - start)) {
+            ok = false;     // Reaches back before the member
+            break;
+        }
+        inf->match_len = len;
+        inf->match_dist = dist;
+    }
+
+    inf->member_out += (size_t)(op - start);
+    inf->out_pos = (size_t)(op - inf->out);
+    return ok;
+}
+
+bool inflate_init(Inflater *inf, InflateFill fill, void *ctx) {
+    memset(inf, 0, sizeof(Inflater));
+    inf->in = (unsigned char *)malloc(INFLATE_INPUT);
+    inf->out = (unsigned char *)malloc(INFLATE_WINDOW + INFLATE_BLOCK);
+    if (!inf->in || !inf->out) {
+        inflate_free(inf);
+        return false;
+    }
+    inf->fill = fill;
+    inf->ctx = ctx;
+    inf->out_pos = INFLATE_WINDOW;
+    inf->state = STATE_MEMBER;
+
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        inf->crc_table[i] = c;
+    }
+    return true;
+}
+
+void inflate_free(Inflater *inf) {
+    free(inf->in);
+    free(inf->out);
+    inf->in = NULL;
+    inf->out = NULL;
+}
+
+// Fold output from from to the current position into the member's CRC
+static void update_crc(Inflater *inf, size_t from) {
+    uint32_t crc = inf->crc;
+    for (size_t i = from; i < inf->out_pos; i++) {
+        crc = inf->crc_table[(crc ^ inf->out[i]) & 0xFF] ^ (crc >> 8);
+    }
+    inf->crc = crc;
+}
+
+bool inflate_next(Inflater *inf, const unsigned char **data, size_t *len) {
+    // Keep just the history matches can reach
+    if (inf->out_pos > INFLATE_WINDOW) {
+        memmove(inf->out, inf->out + inf->out_pos - INFLATE_WINDOW, INFLATE_WINDOW);
+        inf->out_pos = INFLATE_WINDOW;
+    }
+
+    unsigned char *end = inf->out + INFLATE_WINDOW + INFLATE_BLOCK;
+    size_t start = inf->out_pos;
+    size_t unchecked = start;       // Output not yet in the CRC
+    bool ok = true;
+    while (ok && inf->out + inf->out_pos < end && inf->state != STATE_DONE) {
+        switch (inf->state) {
+        case STATE_MEMBER:
+            ok = read_member(inf);
+            break;
+        case STATE_BLOCK:
+            ok = read_block_header(inf);
+            break;
+        case STATE_STORED:
+            ok = copy_stored(inf, end);
+            break;
+        case STATE_CODES:
+            ok = decode_codes(inf, end);
+            break;
+        case STATE_TRAILER:
+            update_crc(inf, unchecked);
+            unchecked = inf->out_pos;
+            ok = read_trailer(inf);
+            break;
+        default:
+            ok = false;
+            break;
+        }
+    }
+
+    if (!ok) {
+        inf->state = STATE_FAILED;
+        return false;
+    }
+    update_crc(inf, unchecked);
+    *data = inf->out + start;
+    *len = inf->out_pos - start;
+    return true;
+}
@@ -0,0 +1,66 @@
+#ifndef INFLATE_H
+#define INFLATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming gzip (DEFLATE) decoder for rotated log archives. Compressed
+// input is pulled through a callback; output comes out a block at a time
+// from a buffer that also holds the 32 KB of history matches refer to, so
+// callers can split lines straight out of it.
+
+#define INFLATE_WINDOW (32 * 1024)          // History DEFLATE matches can reach
+#define INFLATE_BLOCK (128 * 1024)          // Bytes produced per inflate_next call (at most)
+#define INFLATE_INPUT (64 * 1024)           // Compressed bytes pulled per fill
+#define INFLATE_FAST_BITS 10                // Codes this short decode with one table lookup
+
+// Read up to cap more compressed bytes into buf. *got is 0 at the end of
+// the input. Returns false on a read error.
+typedef bool (*InflateFill)(void *ctx, unsigned char *buf, size_t cap, size_t *got);
+
+// Canonical Huffman code
+typedef struct {
+    uint16_t fast[1 << INFLATE_FAST_BITS];  // symbol << 4 | length by the next bits, 0 = longer code
+    uint16_t count[16];                     // Codes of each length
+    uint16_t symbol[288];                   // Symbols ordered by code
+} InflateCode;
+
+typedef struct {
+    InflateFill fill;
+    void *ctx;
+    unsigned char *in;
+    size_t in_pos;
+    size_t in_len;
+    bool in_end;                // fill reported the end of the input
+    uint64_t bits;              // Bit buffer, next bit lowest
+    unsigned bit_count;
+
+    unsigned char *out;         // History, then the block being produced
+    size_t out_pos;
+    int state;
+    bool last_block;            // Current block ends the gzip member
+    size_t stored_left;         // Bytes still to copy from a stored block
+    size_t match_len;           // Match cut short by a full block
+    size_t match_dist;
+    size_t members;             // gzip members started
+    uint64_t member_out;        // Bytes produced by the current member
+    uint32_t crc;
+    InflateCode lit;
+    InflateCode dist;
+    uint32_t crc_table[256];
+} Inflater;
+
+// Set up a decoder reading a gzip file (one or more members) through fill.
+// Returns false if out of memory.
+bool inflate_init(Inflater *inf, InflateFill fill, void *ctx);
+
+// Free the decoder's buffers
+void inflate_free(Inflater *inf);
+
+// Decode the next block. *data points into the decoder and stays valid
+// until the next call; *len is 0 at the end of the archive. Returns false
+// if the archive is corrupt, truncated or unreadable.
+bool inflate_next(Inflater *inf, const unsigned char **data, size_t *len);
+
+#endif // INFLATE_H
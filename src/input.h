@@ -13,14 +13,34 @@ typedef enum {
     INPUT_TAB_PREV,
     INPUT_SCROLL_UP,
     INPUT_SCROLL_DOWN,
+    INPUT_SCROLL_LEFT,
+    INPUT_SCROLL_RIGHT,
     INPUT_PAGE_UP,
     INPUT_PAGE_DOWN,
     INPUT_HOME,
     INPUT_END,
-    INPUT_RESIZE
+    INPUT_RESIZE,
+    INPUT_FILTER_INCLUDE,
+    INPUT_FILTER_EXCLUDE,
+    INPUT_FILTER_CLEAR,
+    INPUT_SEARCH_FORWARD,
+    INPUT_SEARCH_BACKWARD,
+    INPUT_SEARCH_NEXT,
+    INPUT_SEARCH_PREV,
+    INPUT_METRICS,
+    INPUT_WRAP,
+    INPUT_JSON,
+
+    // Text entry (text mode only)
+    INPUT_CHAR,
+    INPUT_ENTER,
+    INPUT_BACKSPACE,
+    INPUT_CANCEL
 } InputAction;
 
-// Poll for input (non-blocking). Returns the action type.
-InputAction input_poll(Console *con);
+// Poll for input (non-blocking). Returns the action type. In text mode
+// printable keys come back as INPUT_CHAR with the character in *ch, and
+// Escape / Ctrl+C cancel instead of quitting.
+InputAction input_poll(Console *con, bool text_mode, char *ch);
 
 #endif // INPUT_H
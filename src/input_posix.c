@@ -0,0 +1,174 @@
+#include "input.h"
+#include <errno.h>
+#include <unistd.h>
+
+// Read one byte without blocking. Returns -1 if none is available.
+static int read_byte(int fd) {
+    unsigned char byte;
+    ssize_t n;
+    do {
+        n = read(fd, &byte, 1);
+    } while (n < 0 && errno == EINTR);
+    return n == 1 ? byte : -1;
+}
+
+// Decode the rest of an escape sequence (the ESC has been consumed).
+// Sequences arrive in one write from the terminal, so they are read whole.
+static InputAction read_escape(int fd) {
+    int intro = read_byte(fd);
+    if (intro < 0) {
+        return INPUT_CANCEL;    // Bare ESC
+    }
+    if (intro != '[' && intro != 'O') {
+        return INPUT_NONE;      // Alt+key
+    }
+
+    int ch = read_byte(fd);
+    switch (ch) {
+        case 'A': return INPUT_SCROLL_UP;
+        case 'B': return INPUT_SCROLL_DOWN;
+        case 'C': return INPUT_SCROLL_RIGHT;
+        case 'D': return INPUT_SCROLL_LEFT;
+        case 'H': return INPUT_HOME;
+        case 'F': return INPUT_END;
+        case 'Z': return INPUT_TAB_PREV;     // Shift+Tab (CSI Z)
+        default: break;
+    }
+
+    // Numbered keys: CSI <n> ~
+    if (ch < '0' || ch > '9') {
+        return INPUT_NONE;
+    }
+    int code = ch - '0';
+    while ((ch = read_byte(fd)) >= '0' && ch <= '9') {
+        code = code * 10 + (ch - '0');
+    }
+    // Skip modifier parameters (e.g. "5;2~")
+    while (ch == ';' || (ch >= '0' && ch <= '9')) {
+        ch = read_byte(fd);
+    }
+    if (ch != '~') {
+        return INPUT_NONE;
+    }
+
+    switch (code) {
+        case 1: case 7: return INPUT_HOME;
+        case 4: case 8: return INPUT_END;
+        case 5: return INPUT_PAGE_UP;
+        case 6: return INPUT_PAGE_DOWN;
+        default: return INPUT_NONE;
+    }
+}
+
+// Map a key typed into a prompt
+static InputAction text_key(int fd, int key, char *ch) {
+    switch (key) {
+        case 0x03:              // Ctrl+C
+            return INPUT_CANCEL;
+        case '\r':
+        case '\n':
+            return INPUT_ENTER;
+        case 0x7F:
+        case 0x08:
+            return INPUT_BACKSPACE;
+        case 0x1b: {
+            InputAction action = read_escape(fd);
+            return action == INPUT_CANCEL ? INPUT_CANCEL : INPUT_NONE;
+        }
+        default:
+            if (key >= 0x20 && key < 0x7F) {
+                *ch = (char)key;
+                return INPUT_CHAR;
+            }
+            return INPUT_NONE;
+    }
+}
+
+InputAction input_poll(Console *con, bool text_mode, char *ch) {
+    if (!con) {
+        return INPUT_NONE;
+    }
+
+    // A byte on the wake pipe means the terminal was resized
+    if (con->wake_handle != PLAT_INVALID_HANDLE) {
+        bool resized = false;
+        while (read_byte(con->wake_handle) >= 0) {
+            resized = true;
+        }
+        if (resized) {
+            return INPUT_RESIZE;
+        }
+    }
+
+    // Process one key at a time; the rest stays queued in the terminal
+    int key;
+    while ((key = read_byte(con->in_handle)) >= 0) {
+        InputAction action = INPUT_NONE;
+
+        if (text_mode) {
+            action = text_key(con->in_handle, key, ch);
+            if (action != INPUT_NONE) {
+                return action;
+            }
+            continue;
+        }
+
+        switch (key) {
+            case 0x03:              // Ctrl+C (ISIG is off in raw mode)
+            case 'q':
+            case 'Q':
+                action = INPUT_QUIT;
+                break;
+            case '\t':
+                action = INPUT_TAB_NEXT;
+                break;
+            case 'f':
+            case 'F':
+                action = INPUT_FILTER_INCLUDE;
+                break;
+            case 'x':
+            case 'X':
+                action = INPUT_FILTER_EXCLUDE;
+                break;
+            case 'c':
+            case 'C':
+                action = INPUT_FILTER_CLEAR;
+                break;
+            case '/':
+                action = INPUT_SEARCH_FORWARD;
+                break;
+            case '?':
+                action = INPUT_SEARCH_BACKWARD;
+                break;
+            case 'n':
+                action = INPUT_SEARCH_NEXT;
+                break;
+            case 'N':
+                action = INPUT_SEARCH_PREV;
+                break;
+            case 'm':
+            case 'M':
+                action = INPUT_METRICS;
+                break;
+            case 'w':
+            case 'W':
+                action = INPUT_WRAP;
+                break;
+            case 'j':
+            case 'J':
+                action = INPUT_JSON;
+                break;
+            case 0x1b:
+                action = read_escape(con->in_handle);
+                break;
+            default:
+                break;
+        }
+
+        if (action != INPUT_NONE) {
+            return action;
+        }
+    }
+
+    return INPUT_NONE;
+}
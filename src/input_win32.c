@@ -1,6 +1,7 @@
 #include "input.h"
+#include <windows.h>
 
-InputAction input_poll(Console *con) {
+InputAction input_poll(Console *con, bool text_mode, char *ch) {
     if (!con) {
         return INPUT_NONE;
     }
@@ -31,7 +32,26 @@ InputAction input_poll(Console *con) {
 
             // Check for Ctrl+C
             if (vk == 'C' && (ctrl_state & (LEFT_CTRL_PRESSED | RIGHT_CTRL_PRESSED))) {
-                return INPUT_QUIT;
+                return text_mode ? INPUT_CANCEL : INPUT_QUIT;
+            }
+
+            // Prompt text entry
+            if (text_mode) {
+                if (vk == VK_RETURN) {
+                    return INPUT_ENTER;
+                }
+                if (vk == VK_BACK) {
+                    return INPUT_BACKSPACE;
+                }
+                if (vk == VK_ESCAPE) {
+                    return INPUT_CANCEL;
+                }
+                char typed = key->uChar.AsciiChar;
+                if (typed >= 0x20 && typed < 0x7F) {
+                    *ch = typed;
+                    return INPUT_CHAR;
+                }
+                continue;
             }
 
             // Check for 'q' or 'Q'
@@ -39,6 +59,35 @@ InputAction input_poll(Console *con) {
                 return INPUT_QUIT;
             }
 
+            // Filters
+            if (vk == 'F') {
+                return INPUT_FILTER_INCLUDE;
+            }
+            if (vk == 'X') {
+                return INPUT_FILTER_EXCLUDE;
+            }
+            if (vk == 'C') {
+                return INPUT_FILTER_CLEAR;
+            }
+            if (vk == 'M') {
+                return INPUT_METRICS;
+            }
+            if (vk == 'W') {
+                return INPUT_WRAP;
+            }
+            if (vk == 'J') {
+                return INPUT_JSON;
+            }
+
+            // Search keys depend on the keyboard layout - go by the character
+            switch (key->uChar.AsciiChar) {
+                case '/': return INPUT_SEARCH_FORWARD;
+                case '?': return INPUT_SEARCH_BACKWARD;
+                case 'n': return INPUT_SEARCH_NEXT;
+                case 'N': return INPUT_SEARCH_PREV;
+                default: break;
+            }
+
             // Tab navigation
             if (vk == VK_TAB) {
                 if (ctrl_state & SHIFT_PRESSED) {
@@ -54,6 +103,12 @@ InputAction input_poll(Console *con) {
             if (vk == VK_DOWN) {
                 return INPUT_SCROLL_DOWN;
             }
+            if (vk == VK_LEFT) {
+                return INPUT_SCROLL_LEFT;
+            }
+            if (vk == VK_RIGHT) {
+                return INPUT_SCROLL_RIGHT;
+            }
 
             // Page up/down
             if (vk == VK_PRIOR) {  // Page Up
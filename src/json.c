@@ -0,0 +1,382 @@
+#include "json.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "linescan.h"
+#include "utf8.h"
+
+bool json_fields_parse(JsonFields *fields, const char *spec, char *error, size_t error_size) {
+    memset(fields, 0, sizeof(JsonFields));
+
+    const char *pos = spec;
+    for (;;) {
+        if (fields->count >= JSON_MAX_FIELDS) {
+            snprintf(error, error_size, "more than %d fields", JSON_MAX_FIELDS);
+            return false;
+        }
+        JsonField *field = &fields->fields[fields->count];
+
+        // Keys of this column, up to the next comma
+        for (;;) {
+            size_t len = strcspn(pos, ",|");
+            if (len == 0) {
+                snprintf(error, error_size, "empty field name");
+                return false;
+            }
+            if (len > JSON_MAX_NAME) {
+                snprintf(error, error_size, "field name longer than %d", JSON_MAX_NAME);
+                return false;
+            }
+            if (field->name_count >= JSON_MAX_NAMES) {
+                snprintf(error, error_size, "more than %d names for a field", JSON_MAX_NAMES);
+                return false;
+            }
+            memcpy(field->names[field->name_count], pos, len);
+            field->name_lens[field->name_count] = (uint8_t)len;
+            field->name_count++;
+            pos += len;
+            if (*pos != '|') {
+                break;
+            }
+            pos++;
+        }
+        fields->count++;
+
+        if (*pos == '\0') {
+            return true;
+        }
+        pos++;      // ','
+    }
+}
+
+static size_t skip_space(const char *text, size_t len, size_t i) {
+    while (i < len && (text[i] == ' ' || text[i] == '\t' || text[i] == '\r' || text[i] == '\n')) {
+        i++;
+    }
+    return i;
+}
+
+// The closing quote of a string whose contents start at i (len if it does
+// not close). *escaped is set if it holds a backslash escape.
+static size_t string_end(const char *text, size_t len, size_t i, bool *escaped) {
+    for (;;) {
+        i += linescan_find_quote(text + i, len - i);
+        if (i >= len || text[i] == '"') {
+            return i;
+        }
+        *escaped = true;
+        i += 2;     // The backslash and the byte it escapes
+        if (i >= len) {
+            return len;
+        }
+    }
+}
+
+// Past a value that is not a string: a nested object or array, or a bare
+// number, true, false or null
+static size_t value_end(const char *text, size_t len, size_t i) {
+    if (text[i] != '{' && text[i] != '[') {
+        while (i < len && text[i] != ',' && text[i] != '}' && text[i] != ']' && text[i] != ' ' &&
+               text[i] != '\t' && text[i] != '\r' && text[i] != '\n') {
+            i++;
+        }
+        return i;
+    }
+
+    int depth = 0;
+    while (i < len) {
+        char c = text[i];
+        if (c == '"') {
+            bool escaped = false;
+            i = string_end(text, len, i + 1, &escaped);
+            if (i >= len) {
+                return len;
+            }
+        } else if (c == '{' || c == '[') {
+            depth++;
+        } else if ((c == '}' || c == ']') && --depth == 0) {
+            return i + 1;
+        }
+        i++;
+    }
+    return len;
+}
+
+// The column a key belongs to, or -1
+static int match_field(const JsonFields *fields, const char *key, size_t len) {
+    for (int f = 0; f < fields->count; f++) {
+        const JsonField *field = &fields->fields[f];
+        for (int n = 0; n < field->name_count; n++) {
+            if (field->name_lens[n] == len && memcmp(field->names[n], key, len) == 0) {
+                return f;
+            }
+        }
+    }
+    return -1;
+}
+
+bool json_scan(const JsonFields *fields, const char *text, size_t len, JsonLine *line) {
+    line->found = 0;
+    line->escaped = 0;
+
+    size_t i = skip_space(text, len, 0);
+    if (i >= len || text[i] != '{') {
+        return false;
+    }
+    i++;
+
+    int missing = fields->count;
+    while (missing > 0) {
+        // "key": value
+        i = skip_space(text, len, i);
+        if (i >= len || text[i] != '"') {
+            break;      // The closing brace, or not JSON after all
+        }
+        bool key_escaped = false;
+        size_t key = i + 1;
+        size_t key_end = string_end(text, len, key, &key_escaped);
+        i = skip_space(text, len, key_end + 1);
+        if (i >= len || text[i] != ':') {
+            break;
+        }
+        i = skip_space(text, len, i + 1);
+        if (i >= len) {
+            break;
+        }
+
+        size_t start;
+        size_t end;
+        bool escaped = false;
+        if (text[i] == '"') {
+            start = i + 1;
+            end = string_end(text, len, start, &escaped);
+            i = end + 1;
+        } else {
+            start = i;
+            end = value_end(text, len, i);
+            i = end;
+        }
+
+        // Keys with escapes never name a field; the first of a column's keys present wins
+        int field = key_escaped ? -1 : match_field(fields, text + key, key_end - key);
+        uint8_t bit = (uint8_t)(1u << (field >= 0 ? field : 0));
+        if (field >= 0 && !(line->found & bit) && start <= JSON_MAX_OFFSET) {
+            line->spans[field].start = (uint16_t)start;
+            line->spans[field].end = (uint16_t)(end < JSON_MAX_OFFSET ? end : JSON_MAX_OFFSET);
+            line->found |= bit;
+            if (escaped) {
+                line->escaped |= bit;
+            }
+            missing--;
+        }
+
+        i = skip_space(text, len, i);
+        if (i >= len || text[i] != ',') {
+            break;
+        }
+        i++;
+    }
+    return line->found != 0;
+}
+
+void json_init(LineJson *json, const JsonFields *fields) {
+    memset(json, 0, sizeof(LineJson));
+    json->fields = fields;
+}
+
+void json_destroy(LineJson *json) {
+    if (!json) {
+        return;
+    }
+    free(json->entries);
+    json_init(json, NULL);
+}
+
+// Make room for one more entry, dropping the evicted front first if half
+// of the array is unused
+static bool reserve(LineJson *json) {
+    if (json->used == json->cap && json->first > 0 && json->first >= json->cap / 2) {
+        json->used -= json->first;
+        memmove(json->entries, json->entries + json->first, json->used * sizeof(JsonEntry));
+        json->first = 0;
+    }
+    if (json->used == json->cap) {
+        size_t new_cap = json->cap ? json->cap * 2 : 256;
+        JsonEntry *entries = (JsonEntry *)realloc(json->entries, new_cap * sizeof(JsonEntry));
+        if (!entries) {
+            return false;
+        }
+        json->entries = entries;
+        json->cap = new_cap;
+    }
+    return true;
+}
+
+void json_line_added(LineJson *json, const LineBuffer *buf) {
+    if (!json->fields || buf->count == 0) {
+        return;
+    }
+    const LineEntry *entry = linebuf_entry(buf, buf->count - 1);
+    if (!entry) {
+        return;
+    }
+
+    JsonLine line;
+    if (!json_scan(json->fields, entry->text, entry->length, &line) || !reserve(json)) {
+        return;     // Shown as it is
+    }
+
+    JsonEntry *added = &json->entries[json->used++];
+    added->seq = buf->first_seq + buf->count - 1;
+    added->line = line;
+
+    // Widen the columns to fit (escaped strings are measured as written,
+    // which is never narrower)
+    json->seen |= line.found;
+    for (int f = 0; f < json->fields->count - 1; f++) {
+        if (line.found & (1u << f)) {
+            const JsonSpan *span = &line.spans[f];
+            size_t used;
+            utf8_fit(entry->text + span->start, span->end - span->start, JSON_COLUMN_MAX, &used);
+            if (used > json->widths[f]) {
+                json->widths[f] = (uint16_t)used;
+            }
+        }
+    }
+}
+
+void json_trim(LineJson *json, const LineBuffer *buf) {
+    while (json->first < json->used && json->entries[json->first].seq < buf->first_seq) {
+        json->first++;
+    }
+    if (json->first == json->used) {
+        json->first = 0;
+        json->used = 0;
+    }
+}
+
+const JsonEntry *json_find(const LineJson *json, uint64_t seq) {
+    size_t lo = json->first;
+    size_t hi = json->used;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (json->entries[mid].seq < seq) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == json->used || json->entries[lo].seq != seq) {
+        return NULL;
+    }
+    return &json->entries[lo];
+}
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// The four hex digits of a \u escape at text (len bytes left), or -1
+static int32_t hex4(const char *text, size_t len) {
+    if (len < 4) {
+        return -1;
+    }
+    int32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        int digit = hex_digit(text[i]);
+        if (digit < 0) {
+            return -1;
+        }
+        value = value * 16 + digit;
+    }
+    return value;
+}
+
+// Decode a string's escapes into out. Never longer than the input: control
+// escapes become a space, \uXXXX (six bytes) at most three bytes of UTF-8.
+static size_t unescape(const char *text, size_t len, char *out) {
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (text[i] != '\\' || i + 1 >= len) {
+            out[n++] = text[i];
+            continue;
+        }
+
+        char c = text[++i];
+        if (c == 'u') {
+            int32_t cp = hex4(text + i + 1, len - i - 1);
+            if (cp < 0) {
+                out[n++] = '\\';
+                out[n++] = 'u';
+                continue;
+            }
+            i += 4;
+            // A surrogate pair is one character
+            if (cp >= 0xD800 && cp <= 0xDBFF && i + 6 < len && text[i + 1] == '\\' && text[i + 2] == 'u') {
+                int32_t low = hex4(text + i + 3, len - i - 3);
+                if (low >= 0xDC00 && low <= 0xDFFF) {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    i += 6;
+                }
+            }
+            n += utf8_encode((uint32_t)cp, out + n);
+        } else if (c == 'n' || c == 'r' || c == 't' || c == 'b' || c == 'f') {
+            out[n++] = ' ';
+        } else {
+            out[n++] = c;   // \" \\ \/
+        }
+    }
+    return n;
+}
+
+size_t json_format_size(const LineJson *json, size_t len) {
+    int count = json->fields ? json->fields->count : 0;
+    return len + (size_t)count * (JSON_COLUMN_MAX + JSON_COLUMN_GAP);
+}
+
+size_t json_format(const LineJson *json, const JsonEntry *entry, const char *text, size_t len, char *out) {
+    const JsonLine *line = &entry->line;
+    int count = json->fields->count;
+    size_t n = 0;
+
+    for (int f = 0; f < count; f++) {
+        uint8_t bit = (uint8_t)(1u << f);
+        if (!(json->seen & bit)) {
+            continue;       // No line had it: no column
+        }
+
+        size_t start = n;
+        if (line->found & bit) {
+            const JsonSpan *span = &line->spans[f];
+            size_t end = span->end < len ? span->end : len;
+            if (span->start < end) {
+                if (line->escaped & bit) {
+                    n += unescape(text + span->start, end - span->start, out + n);
+                } else {
+                    memcpy(out + n, text + span->start, end - span->start);
+                    n += end - span->start;
+                }
+            }
+        }
+        if (f == count - 1) {
+            break;
+        }
+
+        // Cut to the column's width, then pad to it and the gap
+        size_t used;
+        n = start + utf8_fit(out + start, n - start, json->widths[f], &used);
+        size_t pad = json->widths[f] - used + JSON_COLUMN_GAP;
+        memset(out + n, ' ', pad);
+        n += pad;
+    }
+    return n;
+}
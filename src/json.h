@@ -0,0 +1,105 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "linebuf.h"
+
+#define JSON_MAX_FIELDS 8           // Columns picked out of each line
+#define JSON_MAX_NAMES 4            // Keys one column accepts
+#define JSON_MAX_NAME 31            // Longest key
+#define JSON_MAX_OFFSET 65535       // Values are clipped to this many bytes into the line
+#define JSON_COLUMN_MAX 40          // Widest a column other than the last grows
+#define JSON_COLUMN_GAP 2           // Spaces between columns
+
+// Columns shown by default, each with the keys common loggers use for it
+#define JSON_DEFAULT_FIELDS "timestamp|time|ts|@timestamp,level|severity|lvl,trace_id|traceId|trace,msg|message"
+
+// One column: the keys whose value it shows (the first one present wins)
+typedef struct {
+    char names[JSON_MAX_NAMES][JSON_MAX_NAME + 1];
+    uint8_t name_lens[JSON_MAX_NAMES];
+    int name_count;
+} JsonField;
+
+// The columns to pick out, shared by every pane
+typedef struct {
+    JsonField fields[JSON_MAX_FIELDS];
+    int count;
+} JsonFields;
+
+// Where one field's value is in a line, in bytes: inside the quotes for a
+// string, the raw text for anything else (numbers, nested objects)
+typedef struct {
+    uint16_t start;
+    uint16_t end;
+} JsonSpan;
+
+// What a scan found in one line
+typedef struct {
+    JsonSpan spans[JSON_MAX_FIELDS];
+    uint8_t found;              // Bit per field: it is present
+    uint8_t escaped;            // Bit per field: its string has backslash escapes
+} JsonLine;
+
+// One JSON line in a pane's index
+typedef struct {
+    uint64_t seq;               // Line sequence number (LineBuffer.first_seq based)
+    JsonLine line;
+} JsonEntry;
+
+// A pane's JSON lines, scanned once as they are pushed so redraws show their
+// fields without parsing again. The scan walks the top-level object once
+// without allocating: string values are skipped with linescan_find_quote,
+// nested objects and arrays by counting brackets, and it stops as soon as
+// every field is found. Only lines that are objects with at least one of the
+// fields get an entry; entries are kept in line order in an array that
+// drops evicted lines from the front, compacting once half is unused.
+//
+// Columns line up across the pane: each one is as wide as the widest value
+// it has shown (up to JSON_COLUMN_MAX), except the last, which takes the
+// rest of the row.
+typedef struct {
+    const JsonFields *fields;   // NULL: lines are not scanned
+    JsonEntry *entries;
+    size_t first;               // First live entry
+    size_t used;                // Entries filled, live ones from first
+    size_t cap;
+    uint16_t widths[JSON_MAX_FIELDS];   // Columns each field's values have needed
+    uint8_t seen;               // Bit per field: some line had it (others get no column)
+} LineJson;
+
+// Parse a field list: columns separated by commas, each a key or several
+// joined by '|'. Returns false with a reason in error if it is empty or too
+// long.
+bool json_fields_parse(JsonFields *fields, const char *spec, char *error, size_t error_size);
+
+// Scan one line. Returns true if it is a JSON object holding at least one of
+// the fields.
+bool json_scan(const JsonFields *fields, const char *text, size_t len, JsonLine *line);
+
+// Set up an empty index picking fields out of lines (NULL for none)
+void json_init(LineJson *json, const JsonFields *fields);
+
+// Free the index
+void json_destroy(LineJson *json);
+
+// Scan the line just pushed to buf (the newest one)
+void json_line_added(LineJson *json, const LineBuffer *buf);
+
+// Drop entries for lines buf no longer holds
+void json_trim(LineJson *json, const LineBuffer *buf);
+
+// The fields of line seq, or NULL if it is not a JSON line
+const JsonEntry *json_find(const LineJson *json, uint64_t seq);
+
+// Bytes json_format may write for a line of len bytes
+size_t json_format_size(const LineJson *json, size_t len);
+
+// Lay the fields of a line (text, len) out as aligned columns in out (room
+// for json_format_size bytes). Escapes in strings are decoded. Returns the
+// bytes written.
+size_t json_format(const LineJson *json, const JsonEntry *entry, const char *text, size_t len, char *out);
+
+#endif // JSON_H
@@ -0,0 +1,83 @@
+#include "layout.h"
+#include <stdlib.h>
+#include <string.h>
+#include "linescan.h"
+#include "utf8.h"
+
+void layout_init(LineLayout *layout) {
+    memset(layout, 0, sizeof(LineLayout));
+}
+
+void layout_destroy(LineLayout *layout) {
+    free(layout->slots);
+    memset(layout, 0, sizeof(LineLayout));
+}
+
+void layout_set_width(LineLayout *layout, size_t width) {
+    if (width > UINT32_MAX) {
+        width = UINT32_MAX;
+    }
+    layout->width = width;
+}
+
+static size_t measure(const LineLayout *layout, const LineBuffer *buf, size_t index) {
+    const LineEntry *entry = linebuf_entry(buf, index);
+    if (!entry || entry->length == 0 || layout->width == 0) {
+        return 1;
+    }
+
+    // ASCII lines (nearly all) take a column a byte
+    if (linescan_find_non_ascii(entry->text, entry->length) == entry->length) {
+        return (entry->length + layout->width - 1) / layout->width;
+    }
+
+    size_t rows = 0;
+    for (size_t pos = 0; pos < entry->length; rows++) {
+        pos += layout_row_bytes(layout, entry->text + pos, entry->length - pos);
+    }
+    return rows;
+}
+
+size_t layout_rows(LineLayout *layout, const LineBuffer *buf, size_t index) {
+    if (!layout->slots && layout->width > 0) {
+        layout->slots = (LayoutSlot *)calloc(LAYOUT_CACHE_LINES, sizeof(LayoutSlot));
+        if (!layout->slots) {
+            return measure(layout, buf, index);
+        }
+    }
+    if (!layout->slots) {
+        return 1;
+    }
+
+    uint64_t seq = buf->first_seq + index;
+    LayoutSlot *slot = &layout->slots[seq & (LAYOUT_CACHE_LINES - 1)];
+    if (slot->seq != seq || slot->width != (uint32_t)layout->width) {
+        size_t rows = measure(layout, buf, index);
+        slot->seq = seq;
+        slot->width = (uint32_t)layout->width;
+        slot->rows = rows > UINT32_MAX ? UINT32_MAX : (uint32_t)rows;
+    }
+    return slot->rows;
+}
+
+size_t layout_row_bytes(const LineLayout *layout, const char *text, size_t len) {
+    size_t bytes = utf8_fit(text, len, layout->width, NULL);
+    if (bytes == 0 && len > 0) {
+        uint32_t cp;
+        bytes = utf8_decode(text, len, &cp);
+    }
+    return bytes;
+}
+
+size_t layout_row_offset(const LineLayout *layout, const char *text, size_t len, size_t row) {
+    size_t ascii = row * layout->width;
+    if (ascii <= len && linescan_find_non_ascii(text, ascii) == ascii) {
+        return ascii;
+    }
+
+    size_t pos = 0;
+    for (size_t i = 0; i < row && pos < len; i++) {
+        pos += layout_row_bytes(layout, text + pos, len - pos);
+    }
+    return pos;
+}
@@ -0,0 +1,54 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "linebuf.h"
+
+#define LAYOUT_CACHE_LINES 4096     // Row counts remembered per pane (a power of two)
+
+// One remembered row count
+typedef struct {
+    uint64_t seq;               // Line sequence number (LineBuffer.first_seq based)
+    uint32_t width;             // Width it was measured at (0: slot empty)
+    uint32_t rows;
+} LayoutSlot;
+
+// How many screen rows each line takes when a pane wraps long lines.
+//
+// A wrapped view is positioned by its top line and the row within it, so
+// scrolling only has to measure the lines it moves across, never the whole
+// scrollback. Counts are measured the first time they are needed and kept
+// in a small table indexed by line sequence number, where the lines around
+// the view stay while it is scrolled and redrawn. Lines never change once
+// pushed, so a count only goes stale when the width does: each slot notes
+// the width it was measured at, and a resize just makes the lines looked at
+// afterwards measure again. Widths are display columns (see utf8.h), and
+// rows break between characters.
+typedef struct {
+    LayoutSlot *slots;          // LAYOUT_CACHE_LINES slots, allocated on first use (NULL: measure every time)
+    size_t width;               // Columns lines wrap at (0: not known yet)
+} LineLayout;
+
+// Set up an empty layout
+void layout_init(LineLayout *layout);
+
+// Free the table
+void layout_destroy(LineLayout *layout);
+
+// Wrap at width columns from now on
+void layout_set_width(LineLayout *layout, size_t width);
+
+// Rows the line at index of buf takes (at least 1)
+size_t layout_rows(LineLayout *layout, const LineBuffer *buf, size_t index);
+
+// Bytes of text shown on the wrapped row it starts: as many characters as
+// fit the width, but at least one (a character wider than the pane gets a
+// row of its own)
+size_t layout_row_bytes(const LineLayout *layout, const char *text, size_t len);
+
+// Byte offset of wrapped row of a line's text
+size_t layout_row_offset(const LineLayout *layout, const char *text, size_t len, size_t row);
+
+#endif // LAYOUT_H
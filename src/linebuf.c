@@ -1,87 +1,822 @@
 #include "linebuf.h"
+#include "codec.h"
+#include "platform.h"
 #include <stdlib.h>
 #include <string.h>
 
-bool linebuf_init(LineBuffer *buf, size_t capacity) {
-    if (!buf || capacity == 0) {
-        return false;
+// Memory accounting: every byte a buffer allocates or frees moves its budget too
+static void charge(LineBuffer *buf, size_t bytes) {
+    buf->bytes += bytes;
+    if (buf->budget) {
+        buf->budget->used += bytes;
+    }
+}
+
+static void credit(LineBuffer *buf, size_t bytes) {
+    buf->bytes -= bytes;
+    if (buf->budget) {
+        buf->budget->used -= bytes;
+    }
+}
+
+static size_t chunk_bytes(const LineChunk *chunk) {
+    return sizeof(LineChunk) + chunk->size;
+}
+
+static LineChunk *chunk_acquire(LineBuffer *buf, size_t need) {
+    LineChunk *chunk;
+
+    // Reuse a released chunk when the line fits a standard chunk
+    if (need <= LINEBUF_CHUNK_SIZE && buf->spare) {
+        chunk = buf->spare;
+        buf->spare = chunk->next;
+        buf->spare_count--;
+    } else {
+        size_t size = need > LINEBUF_CHUNK_SIZE ? need : LINEBUF_CHUNK_SIZE;
+        chunk = (LineChunk *)malloc(sizeof(LineChunk) + size);
+        if (!chunk) {
+            return NULL;
+        }
+        buf->allocations++;
+        chunk->size = size;
+        charge(buf, chunk_bytes(chunk));
+    }
+
+    chunk->next = NULL;
+    chunk->used = 0;
+    chunk->live = 0;
+    return chunk;
+}
+
+static void chunk_release(LineBuffer *buf, LineChunk *chunk) {
+    // Only standard-size chunks are worth keeping around
+    if (chunk->size == LINEBUF_CHUNK_SIZE && buf->spare_count < LINEBUF_MAX_SPARE_CHUNKS) {
+        chunk->next = buf->spare;
+        buf->spare = chunk;
+        buf->spare_count++;
+    } else {
+        credit(buf, chunk_bytes(chunk));
+        free(chunk);
+    }
+}
+
+static void free_chunk_list(LineChunk *chunk) {
+    while (chunk) {
+        LineChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
     }
+}
+
+// Lines with an index entry (not compressed)
+static size_t hot_count(const LineBuffer *buf) {
+    return buf->count - buf->cold_count;
+}
 
-    buf->lines = (char **)calloc(capacity, sizeof(char *));
-    if (!buf->lines) {
+// Move the index into an allocation of new_cap entries (>= hot_count)
+static bool resize_index(LineBuffer *buf, size_t new_cap) {
+    LineEntry *lines = (LineEntry *)malloc(new_cap * sizeof(LineEntry));
+    if (!lines) {
         return false;
     }
+    buf->allocations++;
 
-    buf->capacity = capacity;
-    buf->count = 0;
+    for (size_t i = 0; i < hot_count(buf); i++) {
+        lines[i] = buf->lines[(buf->head + i) % buf->index_cap];
+    }
+    free(buf->lines);
+    credit(buf, buf->index_cap * sizeof(LineEntry));
+    charge(buf, new_cap * sizeof(LineEntry));
+
+    buf->lines = lines;
+    buf->index_cap = new_cap;
     buf->head = 0;
     return true;
 }
 
-void linebuf_destroy(LineBuffer *buf) {
-    if (!buf || !buf->lines) {
+// Drop the oldest line, releasing its chunk once nothing else lives in it.
+// Only for a buffer without compressed lines.
+static void evict_oldest(LineBuffer *buf) {
+    LineChunk *chunk = buf->oldest;
+    buf->head = (buf->head + 1) % buf->index_cap;
+    buf->count--;
+    buf->first_seq++;
+
+    if (!chunk) {
         return;
     }
 
-    for (size_t i = 0; i < buf->capacity; i++) {
-        free(buf->lines[i]);
+    chunk->live--;
+    if (chunk->live > 0) {
+        return;
+    }
+
+    if (chunk == buf->newest) {
+        // Last chunk is now empty - rewind it instead of releasing
+        chunk->used = 0;
+        return;
+    }
+
+    buf->oldest = chunk->next;
+    buf->chunk_count--;
+    chunk_release(buf, chunk);
+}
+
+static LineFrame *frame_at(const LineBuffer *buf, size_t i) {
+    return buf->frames[(buf->frame_head + i) % buf->frame_cap];
+}
+
+static size_t frame_bytes(const LineFrame *frame) {
+    return sizeof(LineFrame) + frame->packed_size;
+}
+
+static void cache_free(LineBuffer *buf) {
+    for (int i = 0; i < LINEBUF_CACHE_FRAMES; i++) {
+        LineFrameCache *slot = &buf->cache[i];
+        credit(buf, slot->lines_cap * sizeof(LineEntry) + slot->raw_cap);
+        free(slot->lines);
+        free(slot->raw);
+        memset(slot, 0, sizeof(LineFrameCache));
+    }
+}
+
+// Make room for one more frame in the list
+static bool reserve_frame(LineBuffer *buf) {
+    if (buf->frame_count < buf->frame_cap) {
+        return true;
+    }
+
+    size_t new_cap = buf->frame_cap ? buf->frame_cap * 2 : 16;
+    LineFrame **frames = (LineFrame **)malloc(new_cap * sizeof(LineFrame *));
+    if (!frames) {
+        return false;
+    }
+    buf->allocations++;
+    for (size_t i = 0; i < buf->frame_count; i++) {
+        frames[i] = frame_at(buf, i);
+    }
+    free(buf->frames);
+    credit(buf, buf->frame_cap * sizeof(LineFrame *));
+    charge(buf, new_cap * sizeof(LineFrame *));
+
+    buf->frames = frames;
+    buf->frame_cap = new_cap;
+    buf->frame_head = 0;
+    return true;
+}
+
+// Make frame (holding the oldest chunk's lines) the newest cold one and
+// release the chunk
+static void add_frame(LineBuffer *buf, LineFrame *frame) {
+    LineChunk *chunk = buf->oldest;
+    size_t count = chunk->live;
+
+    frame->first_seq = buf->first_seq + buf->cold_count;
+    frame->count = count;
+    buf->frames[(buf->frame_head + buf->frame_count) % buf->frame_cap] = frame;
+    buf->frame_count++;
+    charge(buf, frame_bytes(frame));
+
+    buf->head = (buf->head + count) % buf->index_cap;
+    buf->cold_count += count;
+    buf->oldest = chunk->next;
+    buf->chunk_count--;
+    chunk_release(buf, chunk);
+}
+
+// Move the oldest chunk's lines into a compressed frame and release the
+// chunk. Only for a buffer with more than one chunk.
+static bool compress_oldest(LineBuffer *buf) {
+    LineChunk *chunk = buf->oldest;
+    size_t count = chunk->live;
+
+    // Lengths and sources up front, then the texts with their terminators
+    size_t table_size = count * 2 * sizeof(uint32_t);
+    size_t raw_size = table_size;
+    for (size_t i = 0; i < count; i++) {
+        raw_size += buf->lines[(buf->head + i) % buf->index_cap].length + 1;
+    }
+
+    // Scratch for the raw frame and its packed form, which is only kept if
+    // smaller
+    unsigned char *raw = (unsigned char *)malloc(raw_size * 2);
+    if (!raw || !reserve_frame(buf)) {
+        free(raw);
+        return false;
+    }
+    buf->allocations++;
+
+    unsigned char *text = raw + table_size;
+    for (size_t i = 0; i < count; i++) {
+        const LineEntry *entry = &buf->lines[(buf->head + i) % buf->index_cap];
+        memcpy(raw + i * sizeof(uint32_t), &entry->length, sizeof(uint32_t));
+        memcpy(raw + (count + i) * sizeof(uint32_t), &entry->source, sizeof(uint32_t));
+        memcpy(text, entry->text, (size_t)entry->length + 1);
+        text += entry->length + 1;
+    }
+
+    // Lines that do not compress are stored as they are
+    unsigned char *data = raw + raw_size;
+    size_t packed = codec_compress(raw, raw_size, data, raw_size - 1);
+    if (packed == 0) {
+        data = raw;
+        packed = raw_size;
+    }
+    LineFrame *frame = (LineFrame *)malloc(sizeof(LineFrame) + packed);
+    if (!frame) {
+        free(raw);
+        return false;
+    }
+    buf->allocations++;
+    memcpy(frame->data, data, packed);
+    free(raw);
+
+    frame->raw_size = raw_size;
+    frame->packed_size = packed;
+    frame->file_offset = -1;
+    frame->source = 0;
+    add_frame(buf, frame);
+    return true;
+}
+
+// File offset a by-reference buffer stores in front of each line's text
+static int64_t line_offset(const LineEntry *entry) {
+    int64_t offset;
+    memcpy(&offset, entry->text - sizeof(int64_t), sizeof(offset));
+    return offset;
+}
+
+// Replace the oldest chunk's lines with their offsets in the buffer's file.
+// Fails, leaving them to be compressed, unless they are lines of the file
+// in order. Only for a by-reference buffer with more than one chunk.
+static bool reference_oldest(LineBuffer *buf) {
+    LineChunk *chunk = buf->oldest;
+    size_t count = chunk->live;
+    const LineEntry *first = &buf->lines[buf->head];
+    int64_t base = line_offset(first);
+    if (base < 0) {
+        return false;
+    }
+
+    // Each line must start past the end of the one before (re-reads put a
+    // NUL on the byte after each line)
+    size_t raw_size = 0;
+    int64_t next_free = base;
+    for (size_t i = 0; i < count; i++) {
+        const LineEntry *entry = &buf->lines[(buf->head + i) % buf->index_cap];
+        int64_t offset = line_offset(entry);
+        if (offset < next_free || offset - base > (int64_t)(UINT32_MAX - entry->length) ||
+            entry->source != first->source) {
+            return false;
+        }
+        next_free = offset + entry->length + 1;
+        raw_size += (size_t)entry->length + 1;
+    }
+
+    size_t table_size = count * 2 * sizeof(uint32_t);
+    LineFrame *frame = (LineFrame *)malloc(sizeof(LineFrame) + table_size);
+    if (!frame || !reserve_frame(buf)) {
+        free(frame);
+        return false;
+    }
+    buf->allocations++;
+    for (size_t i = 0; i < count; i++) {
+        const LineEntry *entry = &buf->lines[(buf->head + i) % buf->index_cap];
+        uint32_t start = (uint32_t)(line_offset(entry) - base);
+        memcpy(frame->data + i * sizeof(uint32_t), &start, sizeof(uint32_t));
+        memcpy(frame->data + (count + i) * sizeof(uint32_t), &entry->length, sizeof(uint32_t));
+    }
+
+    frame->raw_size = raw_size;
+    frame->packed_size = table_size;
+    frame->file_offset = base;
+    frame->source = first->source;
+    add_frame(buf, frame);
+    return true;
+}
+
+// Drop the oldest frame's lines
+static void drop_oldest_frame(LineBuffer *buf) {
+    LineFrame *frame = frame_at(buf, 0);
+    buf->frame_head = (buf->frame_head + 1) % buf->frame_cap;
+    buf->frame_count--;
+
+    buf->first_seq += frame->count;
+    buf->count -= frame->count;
+    buf->cold_count -= frame->count;
+    credit(buf, frame_bytes(frame));
+    free(frame);
+
+    if (buf->frame_count == 0) {
+        cache_free(buf);    // Nothing left to unpack
+    }
+}
+
+static void free_frames(LineBuffer *buf) {
+    for (size_t i = 0; i < buf->frame_count; i++) {
+        LineFrame *frame = frame_at(buf, i);
+        credit(buf, frame_bytes(frame));
+        free(frame);
+    }
+    buf->frame_head = 0;
+    buf->frame_count = 0;
+    buf->cold_count = 0;
+    cache_free(buf);
+}
+
+static bool reserve_raw(LineBuffer *buf, LineFrameCache *slot, size_t size) {
+    if (slot->raw_cap >= size) {
+        return true;
+    }
+    unsigned char *raw = (unsigned char *)realloc(slot->raw, size);
+    if (!raw) {
+        return false;
+    }
+    buf->allocations++;
+    charge(buf, size - slot->raw_cap);
+    slot->raw = raw;
+    slot->raw_cap = size;
+    return true;
+}
+
+static bool unpack_frame(LineBuffer *buf, const LineFrame *frame, LineFrameCache *slot) {
+    if (!reserve_raw(buf, slot, frame->raw_size)) {
+        return false;
+    }
+    if (frame->packed_size == frame->raw_size) {
+        memcpy(slot->raw, frame->data, frame->raw_size);
+    } else if (!codec_decompress(frame->data, frame->packed_size, slot->raw, frame->raw_size)) {
+        return false;
+    }
+
+    size_t table_size = frame->count * 2 * sizeof(uint32_t);
+    char *text = (char *)slot->raw + table_size;
+    for (size_t i = 0; i < frame->count; i++) {
+        LineEntry *entry = &slot->lines[i];
+        memcpy(&entry->length, slot->raw + i * sizeof(uint32_t), sizeof(uint32_t));
+        memcpy(&entry->source, slot->raw + (frame->count + i) * sizeof(uint32_t), sizeof(uint32_t));
+        entry->text = text;
+        text += entry->length + 1;
+    }
+    return true;
+}
+
+// Read exactly len bytes at offset (false if the file has shrunk)
+static bool read_exact(PlatHandle file, int64_t offset, unsigned char *out, size_t len) {
+    while (len > 0) {
+        size_t got;
+        if (!plat_file_read_at(file, offset, out, len, &got) || got == 0) {
+            return false;
+        }
+        offset += (int64_t)got;
+        out += got;
+        len -= got;
+    }
+    return true;
+}
+
+// The file at ref_path is still the one the lines were pushed from, as long
+// as it has not been replaced or cut short. Until the reader's rotation or
+// truncation record is drained, the path can already name another file.
+static bool same_file(const LineBuffer *buf, PlatHandle file) {
+    PlatFileId id;
+    int64_t size;
+    if (buf->ref_id_known &&
+        (!plat_file_id(file, &id) || id.volume != buf->ref_id.volume || id.index != buf->ref_id.index)) {
+        return false;
+    }
+    return plat_file_size(file, &size) && size >= buf->ref_end;
+}
+
+// Read a by-reference frame's lines back from the file: in one read when
+// they sit close together, otherwise line by line. Fails rather than read
+// from a file that no longer holds them.
+static bool read_frame(LineBuffer *buf, const LineFrame *frame, LineFrameCache *slot) {
+    uint32_t last_start;
+    uint32_t last_length;
+    memcpy(&last_start, frame->data + (frame->count - 1) * sizeof(uint32_t), sizeof(uint32_t));
+    memcpy(&last_length, frame->data + (2 * frame->count - 1) * sizeof(uint32_t), sizeof(uint32_t));
+    size_t span = (size_t)last_start + last_length;
+    bool whole = span <= frame->raw_size * 2;
+
+    if (!reserve_raw(buf, slot, whole ? span + 1 : frame->raw_size)) {
+        return false;
     }
+    PlatHandle file = plat_file_open(buf->ref_path);
+    if (file == PLAT_INVALID_HANDLE) {
+        return false;
+    }
+    if (!same_file(buf, file)) {
+        plat_file_close(file);
+        return false;
+    }
+
+    bool ok = !whole || read_exact(file, frame->file_offset, slot->raw, span);
+    size_t pos = 0;
+    for (size_t i = 0; ok && i < frame->count; i++) {
+        uint32_t start;
+        LineEntry *entry = &slot->lines[i];
+        memcpy(&start, frame->data + i * sizeof(uint32_t), sizeof(uint32_t));
+        memcpy(&entry->length, frame->data + (frame->count + i) * sizeof(uint32_t), sizeof(uint32_t));
+        entry->source = frame->source;
+
+        if (whole) {
+            pos = start;    // The terminator after it becomes its NUL
+        } else {
+            ok = read_exact(file, frame->file_offset + start, slot->raw + pos, entry->length);
+        }
+        entry->text = (char *)slot->raw + pos;
+        entry->text[entry->length] = '\0';
+        pos += (size_t)entry->length + 1;
+    }
+
+    plat_file_close(file);
+    return ok;
+}
+
+// Unpack (or read back) the frame into the cache, or find it there
+static LineFrameCache *cache_load(LineBuffer *buf, const LineFrame *frame) {
+    LineFrameCache *slot = &buf->cache[0];
+    for (int i = 0; i < LINEBUF_CACHE_FRAMES; i++) {
+        LineFrameCache *candidate = &buf->cache[i];
+        if (candidate->count > 0 && candidate->first_seq == frame->first_seq) {
+            candidate->last_used = ++buf->cache_clock;
+            return candidate;
+        }
+        if (candidate->last_used < slot->last_used) {
+            slot = candidate;
+        }
+    }
+
+    slot->count = 0;
+    if (slot->lines_cap < frame->count) {
+        LineEntry *lines = (LineEntry *)realloc(slot->lines, frame->count * sizeof(LineEntry));
+        if (!lines) {
+            return NULL;
+        }
+        buf->allocations++;
+        charge(buf, (frame->count - slot->lines_cap) * sizeof(LineEntry));
+        slot->lines = lines;
+        slot->lines_cap = frame->count;
+    }
+    bool loaded = frame->file_offset >= 0 ? read_frame(buf, frame, slot) : unpack_frame(buf, frame, slot);
+    if (!loaded) {
+        return NULL;
+    }
+
+    slot->first_seq = frame->first_seq;
+    slot->count = frame->count;
+    slot->last_used = ++buf->cache_clock;
+    return slot;
+}
+
+// Entry of a cold line, through the frame cache
+static const LineEntry *cold_entry(LineBuffer *buf, size_t index) {
+    uint64_t seq = buf->first_seq + index;
+
+    // Last frame starting at or before seq
+    size_t lo = 0;
+    size_t hi = buf->frame_count;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (frame_at(buf, mid)->first_seq <= seq) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    const LineFrame *frame = frame_at(buf, lo);
+    LineFrameCache *slot = cache_load(buf, frame);
+    return slot ? &slot->lines[seq - frame->first_seq] : NULL;
+}
+
+static bool index_sparse(const LineBuffer *buf) {
+    return buf->index_cap > LINEBUF_MIN_INDEX && hot_count(buf) <= buf->index_cap / 4;
+}
+
+// How a buffer can give memory back: 2 without losing lines, 1 only by
+// dropping its oldest ones, 0 not at all
+static int shrink_rank(const LineBuffer *buf) {
+    if (buf->spare || index_sparse(buf) || buf->chunk_count > LINEBUF_HOT_CHUNKS) {
+        return 2;
+    }
+    if (buf->frame_count > 0 || buf->chunk_count > 1) {
+        return 1;
+    }
+    return 0;
+}
+
+// Give some memory back: a spare chunk, half of a mostly empty index, the
+// oldest chunk compressed, the oldest frame, or (with nothing compressed)
+// the oldest chunk's lines
+static void shrink(LineBuffer *buf) {
+    if (buf->spare) {
+        LineChunk *chunk = buf->spare;
+        buf->spare = chunk->next;
+        buf->spare_count--;
+        credit(buf, chunk_bytes(chunk));
+        free(chunk);
+        return;
+    }
+
+    if (index_sparse(buf) && resize_index(buf, buf->index_cap / 2)) {
+        return;
+    }
+
+    if (buf->chunk_count > LINEBUF_HOT_CHUNKS &&
+        ((buf->ref_path && reference_oldest(buf)) || compress_oldest(buf))) {
+        return;
+    }
+
+    if (buf->frame_count > 0) {
+        drop_oldest_frame(buf);
+        return;
+    }
+
+    // Evicting the oldest chunk's last line puts it on the spare list,
+    // from where the next round frees it
+    LineChunk *oldest = buf->oldest;
+    while (buf->count > 0 && buf->oldest == oldest) {
+        evict_oldest(buf);
+    }
+}
+
+void linebudget_init(LineBudget *budget, size_t limit) {
+    memset(budget, 0, sizeof(LineBudget));
+    budget->limit = limit;
+}
+
+void linebudget_destroy(LineBudget *budget) {
+    free(budget->buffers);
+    memset(budget, 0, sizeof(LineBudget));
+}
+
+bool linebudget_trim(LineBudget *budget) {
+    bool trimmed = false;
+
+    while (budget->used > budget->limit) {
+        // Compress anywhere before dropping lines; among equals take from
+        // the largest buffer
+        LineBuffer *largest = NULL;
+        int largest_rank = 0;
+        for (size_t i = 0; i < budget->count; i++) {
+            LineBuffer *buf = budget->buffers[i];
+            int rank = shrink_rank(buf);
+            if (rank > largest_rank || (rank > 0 && rank == largest_rank && buf->bytes > largest->bytes)) {
+                largest = buf;
+                largest_rank = rank;
+            }
+        }
+        if (!largest) {
+            break;      // Every buffer is down to the chunk it is filling
+        }
+
+        uint64_t first_seq = largest->first_seq;
+        shrink(largest);
+        if (largest->first_seq != first_seq) {
+            trimmed = true;
+        }
+    }
+    return trimmed;
+}
+
+bool linebuf_init(LineBuffer *buf, LineBudget *budget) {
+    if (!buf) {
+        return false;
+    }
+
+    memset(buf, 0, sizeof(LineBuffer));
+    if (!budget) {
+        return true;
+    }
+
+    if (budget->count == budget->cap) {
+        size_t new_cap = budget->cap ? budget->cap * 2 : 16;
+        LineBuffer **buffers = (LineBuffer **)realloc(budget->buffers, new_cap * sizeof(LineBuffer *));
+        if (!buffers) {
+            return false;
+        }
+        budget->buffers = buffers;
+        budget->cap = new_cap;
+    }
+    buf->budget = budget;
+    buf->budget_slot = budget->count;
+    budget->buffers[budget->count++] = buf;
+    return true;
+}
+
+void linebuf_file_changed(LineBuffer *buf, const PlatFileId *id) {
+    if (!buf || !buf->ref_path) {
+        return;
+    }
+    if (id) {
+        buf->ref_id = *id;
+        buf->ref_id_known = true;
+    }
+    buf->ref_end = 0;
+
+    // Frames drop oldest first, up to the newest one that points into the file
+    size_t drop = 0;
+    for (size_t i = 0; i < buf->frame_count; i++) {
+        if (frame_at(buf, i)->file_offset >= 0) {
+            drop = i + 1;
+        }
+    }
+    while (drop-- > 0) {
+        drop_oldest_frame(buf);
+    }
+
+    // Hot lines will be compressed instead
+    int64_t none = -1;
+    for (size_t i = 0; i < hot_count(buf); i++) {
+        memcpy(buf->lines[(buf->head + i) % buf->index_cap].text - sizeof(int64_t), &none, sizeof(none));
+    }
+}
+
+void linebuf_destroy(LineBuffer *buf) {
+    if (!buf) {
+        return;
+    }
+
+    free_chunk_list(buf->oldest);
+    free_chunk_list(buf->spare);
     free(buf->lines);
+    free_frames(buf);
+    free(buf->frames);
+    free(buf->ref_path);
 
-    buf->lines = NULL;
-    buf->capacity = 0;
-    buf->count = 0;
-    buf->head = 0;
+    // Leave the budget: the last buffer takes this one's slot
+    LineBudget *budget = buf->budget;
+    if (budget) {
+        budget->used -= buf->bytes;
+        LineBuffer *last = budget->buffers[--budget->count];
+        budget->buffers[buf->budget_slot] = last;
+        last->budget_slot = buf->budget_slot;
+    }
+
+    memset(buf, 0, sizeof(LineBuffer));
 }
 
 void linebuf_clear(LineBuffer *buf) {
-    if (!buf || !buf->lines) {
+    if (!buf) {
         return;
     }
 
-    for (size_t i = 0; i < buf->capacity; i++) {
-        free(buf->lines[i]);
-        buf->lines[i] = NULL;
+    LineChunk *chunk = buf->oldest;
+    while (chunk) {
+        LineChunk *next = chunk->next;
+        chunk_release(buf, chunk);
+        chunk = next;
     }
+    free_frames(buf);
 
+    buf->oldest = NULL;
+    buf->newest = NULL;
+    buf->chunk_count = 0;
+    buf->first_seq += buf->count;
     buf->count = 0;
     buf->head = 0;
+    buf->ref_end = 0;
 }
 
-bool linebuf_push(LineBuffer *buf, const char *line) {
-    if (!buf || !buf->lines || !line) {
+bool linebuf_set_file(LineBuffer *buf, const char *path) {
+    if (!buf || !path || buf->count > 0 || buf->oldest) {
         return false;
     }
 
-    // Calculate the physical index where we'll store the new line
-    size_t physical_index;
-    if (buf->count < buf->capacity) {
-        // Buffer not full yet - append at the end
-        physical_index = (buf->head + buf->count) % buf->capacity;
-        buf->count++;
-    } else {
-        // Buffer full - overwrite oldest line and advance head
-        physical_index = buf->head;
-        free(buf->lines[physical_index]);
-        buf->head = (buf->head + 1) % buf->capacity;
+    char *copy = (char *)malloc(strlen(path) + 1);
+    if (!copy) {
+        return false;
+    }
+    strcpy(copy, path);
+    free(buf->ref_path);
+    buf->ref_path = copy;
+
+    // Lines will come from the file the path names now
+    PlatHandle file = plat_file_open(path);
+    if (file != PLAT_INVALID_HANDLE) {
+        buf->ref_id_known = plat_file_id(file, &buf->ref_id);
+        plat_file_close(file);
     }
+    return true;
+}
 
-    // Copy the line
-    buf->lines[physical_index] = _strdup(line);
-    if (!buf->lines[physical_index]) {
+bool linebuf_push_at(LineBuffer *buf, const char *line, size_t len, uint32_t source, int64_t offset) {
+    if (!buf || !line) {
         return false;
     }
 
+    if (len >= UINT32_MAX) {
+        len = UINT32_MAX - 1;
+    }
+
+    // Grow the index; without memory for that, give up the compressed
+    // history and recycle the oldest slot
+    if (hot_count(buf) == buf->index_cap) {
+        size_t new_cap = buf->index_cap ? buf->index_cap * 2 : LINEBUF_MIN_INDEX;
+        if (!resize_index(buf, new_cap)) {
+            if (hot_count(buf) == 0) {
+                return false;
+            }
+            while (buf->frame_count > 0) {
+                drop_oldest_frame(buf);
+            }
+            evict_oldest(buf);
+        }
+    }
+
+    // A by-reference buffer keeps each line's file offset just before it
+    size_t prefix = buf->ref_path ? sizeof(int64_t) : 0;
+    size_t need = prefix + len + 1;
+    LineChunk *chunk = buf->newest;
+    bool added_chunk = false;
+    if (!chunk || chunk->size - chunk->used < need) {
+        if (chunk && chunk->live == 0) {
+            // Buffer is empty - its only chunk is too small for this line
+            chunk_release(buf, chunk);
+            buf->oldest = NULL;
+            buf->newest = NULL;
+            buf->chunk_count = 0;
+        }
+        chunk = chunk_acquire(buf, need);
+        if (!chunk) {
+            return false;
+        }
+        added_chunk = true;
+        if (buf->newest) {
+            buf->newest->next = chunk;
+        } else {
+            buf->oldest = chunk;
+        }
+        buf->newest = chunk;
+        buf->chunk_count++;
+    }
+
+    char *text = chunk->data + chunk->used + prefix;
+    if (prefix) {
+        memcpy(text - prefix, &offset, sizeof(offset));
+        if (offset >= 0 && offset + (int64_t)len > buf->ref_end) {
+            buf->ref_end = offset + (int64_t)len;
+        }
+    }
+    memcpy(text, line, len);
+    text[len] = '\0';
+    chunk->used += need;
+    chunk->live++;
+
+    size_t physical_index = (buf->head + hot_count(buf)) % buf->index_cap;
+    buf->lines[physical_index].text = text;
+    buf->lines[physical_index].length = (uint32_t)len;
+    buf->lines[physical_index].source = source;
+    buf->count++;
+
+    // Lines past the hot chunks go back to the file right away: they cost
+    // far less as offsets than as text, so there is no point waiting for
+    // the budget to fill
+    if (added_chunk && buf->ref_path && buf->chunk_count > LINEBUF_HOT_CHUNKS) {
+        reference_oldest(buf);
+    }
     return true;
 }
 
+bool linebuf_push_source(LineBuffer *buf, const char *line, size_t len, uint32_t source) {
+    return linebuf_push_at(buf, line, len, source, -1);
+}
+
+bool linebuf_push_len(LineBuffer *buf, const char *line, size_t len) {
+    return linebuf_push_source(buf, line, len, 0);
+}
+
+bool linebuf_push(LineBuffer *buf, const char *line) {
+    if (!line) {
+        return false;
+    }
+    return linebuf_push_len(buf, line, strlen(line));
+}
+
 const char *linebuf_get(const LineBuffer *buf, size_t index) {
-    if (!buf || !buf->lines || index >= buf->count) {
+    const LineEntry *entry = linebuf_entry(buf, index);
+    return entry ? entry->text : NULL;
+}
+
+const LineEntry *linebuf_entry(const LineBuffer *buf, size_t index) {
+    if (!buf || index >= buf->count) {
         return NULL;
     }
 
-    size_t physical_index = (buf->head + index) % buf->capacity;
-    return buf->lines[physical_index];
+    if (index < buf->cold_count) {
+        // Unpacking only fills the cache, which is not part of the contents
+        return cold_entry((LineBuffer *)buf, index);
+    }
+
+    size_t physical_index = (buf->head + index - buf->cold_count) % buf->index_cap;
+    return &buf->lines[physical_index];
+}
+
+uint32_t linebuf_get_source(const LineBuffer *buf, size_t index) {
+    const LineEntry *entry = linebuf_entry(buf, index);
+    return entry ? entry->source : 0;
 }
 
 size_t linebuf_count(const LineBuffer *buf) {
@@ -90,3 +825,7 @@ size_t linebuf_count(const LineBuffer *buf) {
     }
     return buf->count;
 }
+
+size_t linebuf_bytes(const LineBuffer *buf) {
+    return buf ? buf->bytes : 0;
+}
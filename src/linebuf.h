@@ -3,32 +3,189 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include "platform.h"
 
-#define LINEBUF_DEFAULT_CAPACITY 100000
+#define LINEBUF_DEFAULT_BUDGET   (256u * 1024 * 1024)  // Scrollback memory shared by all panes
+#define LINEBUF_MIN_BUDGET       (4u * 1024 * 1024)
+#define LINEBUF_CHUNK_SIZE       (256 * 1024)   // Bytes per arena chunk
+#define LINEBUF_MAX_SPARE_CHUNKS 4              // Released chunks kept for reuse
+#define LINEBUF_MIN_INDEX        1024           // First index allocation, in lines; doubles as needed
+#define LINEBUF_HOT_CHUNKS       2              // Newest chunks that are never compressed
+#define LINEBUF_CACHE_FRAMES     4              // Decompressed frames kept for reading
 
+// A block of line storage. Lines are packed back to back as NUL-terminated
+// strings and never span chunks; lines larger than LINEBUF_CHUNK_SIZE get a
+// dedicated chunk of their own.
+typedef struct LineChunk {
+    struct LineChunk *next;     // Next (newer) chunk
+    size_t size;                // Usable bytes in data[]
+    size_t used;                // Bytes handed out so far
+    size_t live;                // Lines still stored in this chunk
+    char data[];
+} LineChunk;
+
+// Index entry for one stored line
+typedef struct {
+    char *text;                 // Points into a chunk's data[]
+    uint32_t length;            // Length excluding the NUL terminator
+    uint32_t source;            // Which file the line came from (multiplexed views)
+} LineEntry;
+
+// The lines of one former chunk, in one of two forms:
+// - packed: compressed with codec_compress. Once unpacked, data[] holds each
+//   line's length and source (uint32_t arrays of count entries) followed by
+//   the NUL-terminated texts.
+// - by reference (file_offset >= 0): data[] holds each line's start
+//   relative to file_offset and its length (uint32_t arrays of count
+//   entries); the text is read back from the buffer's file.
 typedef struct {
-    char **lines;       // Circular buffer of line strings
-    size_t capacity;    // Max lines to retain
-    size_t count;       // Current number of lines stored
-    size_t head;        // Index of oldest line (start of logical buffer)
+    uint64_t first_seq;         // Sequence number of the frame's first line
+    size_t count;               // Lines in the frame
+    size_t raw_size;            // Bytes once unpacked (by reference: of text and terminators)
+    size_t packed_size;         // Bytes in data[] (raw_size: stored as is)
+    int64_t file_offset;        // Where the first line starts in the file, or -1 if packed
+    uint32_t source;            // Source of every line (by reference)
+    unsigned char data[];
+} LineFrame;
+
+// An unpacked frame and its index
+typedef struct {
+    uint64_t first_seq;         // Frame held (valid when count > 0)
+    size_t count;
+    uint64_t last_used;         // For LRU replacement
+    LineEntry *lines;
+    size_t lines_cap;
+    unsigned char *raw;
+    size_t raw_cap;
+} LineFrameCache;
+
+struct LineBudget;
+
+// Scrollback of one pane. Lines are kept until the shared memory budget
+// (LineBudget) needs the space back; there is no line count limit.
+//
+// Storage has two tiers. Recent lines sit uncompressed in arena chunks with
+// an index entry each. When the budget runs short, whole chunks beyond the
+// newest LINEBUF_HOT_CHUNKS are compressed into frames (cold lines have no
+// index entry), and only once nothing is left to compress are the oldest
+// lines dropped. Reading a cold line unpacks its frame into a small LRU
+// cache.
+//
+// A by-reference buffer (linebuf_set_file) holds lines of one file and
+// remembers where each starts in it. Chunks beyond the hot ones become
+// frames of (offset, length) pairs as soon as they fill up, about 8 bytes a
+// line, and their text is read back from the file when needed.
+typedef struct LineBuffer {
+    LineEntry *lines;           // Circular index of the uncompressed lines, grown on demand
+    size_t index_cap;           // Entries allocated in lines
+    size_t count;               // Current number of lines stored, both tiers
+    size_t head;                // Index entry of the oldest uncompressed line
+    uint64_t first_seq;         // Sequence number of the oldest line (counts every line ever pushed)
+
+    LineChunk *oldest;          // Arena chunks, oldest first
+    LineChunk *newest;          // Chunk currently being filled
+    size_t chunk_count;         // Chunks from oldest to newest
+    LineChunk *spare;           // Released chunks kept for reuse
+    size_t spare_count;         // Number of chunks on the spare list
+
+    size_t cold_count;          // Oldest lines, held compressed
+    LineFrame **frames;         // Circular list of frames, oldest first
+    size_t frame_head;
+    size_t frame_count;
+    size_t frame_cap;
+    LineFrameCache cache[LINEBUF_CACHE_FRAMES];
+    uint64_t cache_clock;
+    char *ref_path;             // By-reference buffer: file cold lines are read back from
+    PlatFileId ref_id;          // The file the lines were pushed from, checked before reading back
+    bool ref_id_known;
+    int64_t ref_end;            // Furthest byte of it a line ends at: a shorter file was truncated
+
+    size_t bytes;               // Memory held: chunks (spares included), frames, cache and index
+    size_t allocations;         // Heap allocations made for it so far (for metrics)
+    struct LineBudget *budget;  // Budget the buffer counts against, or NULL
+    size_t budget_slot;         // Position in budget->buffers
 } LineBuffer;
 
-// Initialize a line buffer with given capacity
-bool linebuf_init(LineBuffer *buf, size_t capacity);
+// Memory budget shared by any number of line buffers. Pushing a line never
+// evicts anything; linebudget_trim (called once per main loop pass)
+// compresses old lines, then takes the oldest lines of whichever buffers
+// hold the most until the total fits. Panes with short lines keep more of
+// them, and a quiet pane keeps its history while a noisy one rolls over.
+// All buffers of a budget belong to one thread.
+typedef struct LineBudget {
+    size_t limit;               // Bytes all buffers together may hold
+    size_t used;                // Bytes they hold now
+    LineBuffer **buffers;
+    size_t count;
+    size_t cap;
+} LineBudget;
+
+// Set up an empty budget of limit bytes
+void linebudget_init(LineBudget *budget, size_t limit);
+
+// Free the budget. Its buffers must already be destroyed.
+void linebudget_destroy(LineBudget *budget);
+
+// Compress, then evict, old lines until the buffers fit the limit. Every
+// buffer compresses what it can before any loses lines; then the largest
+// give up space first, a frame or chunk at a time, and each keeps at least
+// the chunk it is filling. Returns true if any buffer lost lines.
+bool linebudget_trim(LineBudget *budget);
+
+// Initialize an empty line buffer counting against budget (NULL for no
+// limit). Returns false on allocation failure.
+bool linebuf_init(LineBuffer *buf, LineBudget *budget);
+
+// Make an empty buffer by-reference: cold lines are kept as offsets into
+// path and read back from it. Lines pushed with linebuf_push_at must come
+// from that file. Returns false if the buffer has lines or out of memory.
+bool linebuf_set_file(LineBuffer *buf, const char *path);
+
+// The by-reference buffer's file was truncated or replaced, so lines
+// already pushed no longer point into it: uncompressed ones are kept as
+// text, cold ones read back from the file are dropped (with any older
+// lines). id is the file later lines come from when it was replaced, NULL
+// when it was truncated. Does nothing to other buffers.
+void linebuf_file_changed(LineBuffer *buf, const PlatFileId *id);
 
 // Free all resources
 void linebuf_destroy(LineBuffer *buf);
 
-// Clear all lines but keep capacity
+// Clear all lines
 void linebuf_clear(LineBuffer *buf);
 
-// Add a line (makes a copy). Overwrites oldest if at capacity.
+// Add a line (makes a copy)
 bool linebuf_push(LineBuffer *buf, const char *line);
 
+// Add a line of the given length (need not be NUL-terminated)
+bool linebuf_push_len(LineBuffer *buf, const char *line, size_t len);
+
+// Add a line tagged with the index of the file it came from
+bool linebuf_push_source(LineBuffer *buf, const char *line, size_t len, uint32_t source);
+
+// Add a line that starts at offset in the file it came from. A by-reference
+// buffer keeps it as just that offset once it goes cold; others ignore it.
+bool linebuf_push_at(LineBuffer *buf, const char *line, size_t len, uint32_t source, int64_t offset);
+
 // Get line at logical index (0 = oldest). Returns NULL if out of range.
+// Like linebuf_entry, a compressed line's text is only good for a while.
 const char *linebuf_get(const LineBuffer *buf, size_t index);
 
+// Get the index entry (text, length, source) at logical index. Returns NULL
+// if out of range (or a compressed line could not be unpacked). The entry of
+// a compressed line lives in the frame cache: it stays valid until lines
+// from LINEBUF_CACHE_FRAMES other frames have been read or the buffer
+// changes.
+const LineEntry *linebuf_entry(const LineBuffer *buf, size_t index);
+
+// Get the source tag of the line at logical index (0 if out of range)
+uint32_t linebuf_get_source(const LineBuffer *buf, size_t index);
+
 // Get current line count
 size_t linebuf_count(const LineBuffer *buf);
 
+// Memory the buffer holds, in bytes
+size_t linebuf_bytes(const LineBuffer *buf);
+
 #endif // LINEBUF_H
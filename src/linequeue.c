@@ -0,0 +1,156 @@
+#include "linequeue.h"
+#include "platform.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define RECORD_ALIGN 8
+#define RECORD_PAD   UINT32_MAX     // Kind of the filler that skips to the end of the ring
+
+typedef struct {
+    uint32_t kind;
+    uint32_t length;
+    int64_t offset;
+} RecordHeader;
+
+static size_t record_size(size_t len) {
+    return (sizeof(RecordHeader) + len + RECORD_ALIGN - 1) & ~(size_t)(RECORD_ALIGN - 1);
+}
+
+bool linequeue_init(LineQueue *queue, size_t size) {
+    if (!queue || size == 0) {
+        return false;
+    }
+
+    memset(queue, 0, sizeof(LineQueue));
+
+    size_t ring = RECORD_ALIGN;
+    while (ring < size) {
+        ring *= 2;
+    }
+
+    queue->data = (char *)malloc(ring);
+    if (!queue->data) {
+        return false;
+    }
+    queue->size = ring;
+    return true;
+}
+
+void linequeue_destroy(LineQueue *queue) {
+    if (!queue) {
+        return;
+    }
+    free(queue->data);
+    memset(queue, 0, sizeof(LineQueue));
+}
+
+size_t linequeue_max_text(const LineQueue *queue) {
+    size_t max = queue->size / 4;
+    return max < LINEQUEUE_MAX_LINE ? max : LINEQUEUE_MAX_LINE;
+}
+
+char *linequeue_reserve(LineQueue *queue, size_t min, const char *keep, size_t keep_len, size_t *room) {
+    size_t head = queue->head;
+    size_t space = queue->size - (head - plat_atomic_load(&queue->tail));
+    size_t offset = head & (queue->size - 1);
+    size_t to_end = queue->size - offset;
+
+    // Records are contiguous; pad out the end of the ring if this one won't fit there
+    size_t pad = record_size(min) > to_end ? to_end : 0;
+    if (space < pad + record_size(min)) {
+        return NULL;
+    }
+    if (pad) {
+        space -= pad;
+        offset = 0;
+        to_end = queue->size;
+    }
+    if (space > to_end) {
+        space = to_end;
+    }
+
+    // The largest text whose record fits in space
+    size_t text_room = (space & ~(size_t)(RECORD_ALIGN - 1)) - sizeof(RecordHeader);
+    size_t max = linequeue_max_text(queue);
+    *room = text_room < max ? text_room : max;
+    queue->reserved_pad = pad;
+
+    char *text = queue->data + offset + sizeof(RecordHeader);
+    if (keep_len > 0) {
+        memmove(text, keep, keep_len);
+    }
+    return text;
+}
+
+void linequeue_commit(LineQueue *queue, uint32_t kind, int64_t file_offset, size_t len) {
+    size_t head = queue->head;
+    if (queue->reserved_pad) {
+        // Only the kind: the gap may be smaller than a whole header
+        uint32_t filler = RECORD_PAD;
+        memcpy(queue->data + (head & (queue->size - 1)), &filler, sizeof(filler));
+        head += queue->reserved_pad;
+        queue->reserved_pad = 0;
+    }
+
+    RecordHeader header = {kind, (uint32_t)len, file_offset};
+    memcpy(queue->data + (head & (queue->size - 1)), &header, sizeof(header));
+
+    // Publish the record (and any filler) to the consumer
+    plat_atomic_store(&queue->head, head + record_size(len));
+}
+
+bool linequeue_push(LineQueue *queue, uint32_t kind, int64_t file_offset, const char *text, size_t len) {
+    size_t max = linequeue_max_text(queue);
+    if (len > max) {
+        len = max;
+    }
+
+    size_t room;
+    char *dest = linequeue_reserve(queue, len, NULL, 0, &room);
+    if (!dest) {
+        return false;
+    }
+    if (len > 0) {
+        memcpy(dest, text, len);
+    }
+    linequeue_commit(queue, kind, file_offset, len);
+    return true;
+}
+
+bool linequeue_peek(LineQueue *queue, LineRecord *record) {
+    size_t tail = queue->tail;
+
+    for (;;) {
+        size_t head = plat_atomic_load(&queue->head);
+        if (head == tail) {
+            if (tail != queue->tail) {
+                plat_atomic_store(&queue->tail, tail);
+            }
+            return false;
+        }
+
+        size_t offset = tail & (queue->size - 1);
+        uint32_t kind;
+        memcpy(&kind, queue->data + offset, sizeof(kind));
+        if (kind == RECORD_PAD) {
+            tail += queue->size - offset;
+            continue;
+        }
+
+        RecordHeader header;
+        memcpy(&header, queue->data + offset, sizeof(header));
+
+        if (tail != queue->tail) {
+            plat_atomic_store(&queue->tail, tail);
+        }
+        record->kind = header.kind;
+        record->length = header.length;
+        record->offset = header.offset;
+        record->text = queue->data + offset + sizeof(header);
+        return true;
+    }
+}
+
+void linequeue_pop(LineQueue *queue, const LineRecord *record) {
+    plat_atomic_store(&queue->tail, queue->tail + record_size(record->length));
+}
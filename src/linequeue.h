@@ -0,0 +1,73 @@
+#ifndef LINEQUEUE_H
+#define LINEQUEUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LINEQUEUE_DEFAULT_SIZE (1024 * 1024)        // Bytes of queued line data per pane
+#define LINEQUEUE_MAX_LINE     (LINEQUEUE_DEFAULT_SIZE / 4)   // Longer lines are truncated
+
+// Record kinds
+#define LINEQUEUE_LINE  0u      // A complete line
+#define LINEQUEUE_RESET 1u      // The file was truncated - later lines start from its beginning
+#define LINEQUEUE_ROTATED 2u    // The file was replaced - later lines come from the new one (text: its PlatFileId)
+#define LINEQUEUE_BLOCK 3u      // Complete lines as read from the file, terminators included
+
+// Lock-free single-producer / single-consumer queue of lines. Records are
+// packed into a byte ring as [header][text] and never wrap: when a record
+// does not fit before the end of the ring, the producer pads to the end.
+// head and tail count bytes ever written/consumed, so head - tail is the
+// fill level.
+//
+// Besides copying a line in, the producer can reserve room and read file
+// data straight into the ring, then commit it as a block record of whole
+// lines. The bytes past the committed ones (an unfinished line) stay where
+// they are until the next reservation, which may move them to its start.
+typedef struct {
+    char *data;
+    size_t size;                // Ring size in bytes (a power of two)
+    volatile size_t head;       // Written by the producer only
+    volatile size_t tail;       // Written by the consumer only
+    size_t reserved_pad;        // Producer: filler the reserved record starts after
+} LineQueue;
+
+// One record handed to the consumer. text points into the ring and stays
+// valid until linequeue_pop is called.
+typedef struct {
+    uint32_t kind;
+    uint32_t length;
+    int64_t offset;             // Where the line starts in its file
+    const char *text;
+} LineRecord;
+
+// Initialize a queue of the given size (rounded up to a power of two)
+bool linequeue_init(LineQueue *queue, size_t size);
+
+// Free the ring. Neither side may be using the queue.
+void linequeue_destroy(LineQueue *queue);
+
+// Producer: append a record. Returns false if there is no room right now.
+bool linequeue_push(LineQueue *queue, uint32_t kind, int64_t offset, const char *text, size_t len);
+
+// Longest text a record can hold
+size_t linequeue_max_text(const LineQueue *queue);
+
+// Producer: reserve room for the text of one record, at least min bytes
+// (at most linequeue_max_text) and as much more as is free before the end
+// of the ring, up to that. Returns where to write it with the room in
+// *room, or NULL if less than min is free right now. The keep_len bytes at
+// keep (text written past the last commit) are moved to the start of the
+// room first.
+char *linequeue_reserve(LineQueue *queue, size_t min, const char *keep, size_t keep_len, size_t *room);
+
+// Producer: publish the reserved record with its first len bytes of text
+void linequeue_commit(LineQueue *queue, uint32_t kind, int64_t offset, size_t len);
+
+// Consumer: look at the oldest record. Returns false if the queue is empty.
+bool linequeue_peek(LineQueue *queue, LineRecord *record);
+
+// Consumer: release the record returned by the last linequeue_peek
+void linequeue_pop(LineQueue *queue, const LineRecord *record);
+
+#endif // LINEQUEUE_H
@@ -0,0 +1,567 @@
+#include "linescan.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define LINESCAN_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC lets any function use the intrinsics; GCC/Clang need a per-function target
+#if defined(_MSC_VER) || !defined(LINESCAN_X86)
+#define LINESCAN_TARGET(isa)
+#else
+#define LINESCAN_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+typedef size_t (*FindEolFn)(const char *data, size_t len);
+typedef size_t (*FindSubstrFn)(const char *data, size_t len, const char *needle, size_t needle_len, bool fold);
+typedef size_t (*FindNonAsciiFn)(const char *data, size_t len);
+typedef size_t (*FindQuoteFn)(const char *data, size_t len);
+
+static unsigned char fold_byte(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? (unsigned char)(c + ('a' - 'A')) : c;
+}
+
+static bool is_alpha(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+// Compare a candidate position against the (lower-case, when folding) needle
+static bool substr_equal(const char *data, const char *needle, size_t n, bool fold) {
+    if (!fold) {
+        return memcmp(data, needle, n) == 0;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (fold_byte((unsigned char)data[i]) != (unsigned char)needle[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Portable fallback: tests 8 bytes at a time with word-wide compares
+static size_t find_eol_scalar(const char *data, size_t len) {
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highs = 0x8080808080808080ULL;
+    const uint64_t lf = ones * '\n';
+    const uint64_t cr = ones * '\r';
+
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+
+        // A byte of x/y is zero exactly where word holds LF/CR
+        uint64_t x = word ^ lf;
+        uint64_t y = word ^ cr;
+        if ((((x - ones) & ~x) | ((y - ones) & ~y)) & highs) {
+            break;
+        }
+    }
+
+    for (; i < len; i++) {
+        if (data[i] == '\n' || data[i] == '\r') {
+            return i;
+        }
+    }
+    return len;
+}
+
+static size_t find_non_ascii_scalar(const char *data, size_t len) {
+    const uint64_t highs = 0x8080808080808080ULL;
+
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        if (word & highs) {
+            break;
+        }
+    }
+
+    for (; i < len; i++) {
+        if ((unsigned char)data[i] >= 0x80) {
+            return i;
+        }
+    }
+    return len;
+}
+
+static size_t find_quote_scalar(const char *data, size_t len) {
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highs = 0x8080808080808080ULL;
+    const uint64_t quote = ones * '"';
+    const uint64_t backslash = ones * '\\';
+
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+
+        uint64_t x = word ^ quote;
+        uint64_t y = word ^ backslash;
+        if ((((x - ones) & ~x) | ((y - ones) & ~y)) & highs) {
+            break;
+        }
+    }
+
+    for (; i < len; i++) {
+        if (data[i] == '"' || data[i] == '\\') {
+            return i;
+        }
+    }
+    return len;
+}
+
+static size_t rfind_eol_scalar(const char *data, size_t len) {
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highs = 0x8080808080808080ULL;
+    const uint64_t lf = ones * '\n';
+    const uint64_t cr = ones * '\r';
+
+    size_t i = len;
+    for (; i >= 8; i -= 8) {
+        uint64_t word;
+        memcpy(&word, data + i - 8, sizeof(word));
+
+        uint64_t x = word ^ lf;
+        uint64_t y = word ^ cr;
+        if ((((x - ones) & ~x) | ((y - ones) & ~y)) & highs) {
+            break;
+        }
+    }
+
+    while (i > 0) {
+        i--;
+        if (data[i] == '\n' || data[i] == '\r') {
+            return i;
+        }
+    }
+    return len;
+}
+
+// Portable fallback: memchr for the first byte (both cases when folding), then compare
+static size_t find_substr_scalar(const char *data, size_t len, const char *needle, size_t needle_len, bool fold) {
+    if (needle_len == 0) {
+        return 0;
+    }
+    if (needle_len > len) {
+        return len;
+    }
+
+    unsigned char first = (unsigned char)needle[0];
+    bool both_cases = fold && is_alpha(first);
+    size_t last = len - needle_len;
+
+    for (size_t i = 0; i <= last; i++) {
+        if (!both_cases) {
+            const char *hit = (const char *)memchr(data + i, first, last - i + 1);
+            if (!hit) {
+                return len;
+            }
+            i = (size_t)(hit - data);
+        } else if (fold_byte((unsigned char)data[i]) != first) {
+            continue;
+        }
+        if (substr_equal(data + i + 1, needle + 1, needle_len - 1, fold)) {
+            return i;
+        }
+    }
+    return len;
+}
+
+#ifdef LINESCAN_X86
+
+static unsigned first_set_bit(uint32_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (unsigned)index;
+#else
+    return (unsigned)__builtin_ctz(mask);
+#endif
+}
+
+static unsigned last_set_bit(uint32_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse(&index, mask);
+    return (unsigned)index;
+#else
+    return 31u - (unsigned)__builtin_clz(mask);
+#endif
+}
+
+LINESCAN_TARGET("sse2")
+static size_t find_eol_sse2(const char *data, size_t len) {
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)(data + i));
+        __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(block, lf), _mm_cmpeq_epi8(block, cr));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(hits);
+        if (mask) {
+            return i + first_set_bit(mask);
+        }
+    }
+
+    return i + find_eol_scalar(data + i, len - i);
+}
+
+LINESCAN_TARGET("sse2")
+static size_t rfind_eol_sse2(const char *data, size_t len) {
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+
+    size_t i = len;
+    for (; i >= 16; i -= 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)(data + i - 16));
+        __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(block, lf), _mm_cmpeq_epi8(block, cr));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(hits);
+        if (mask) {
+            return i - 16 + last_set_bit(mask);
+        }
+    }
+
+    size_t found = rfind_eol_scalar(data, i);
+    return found < i ? found : len;
+}
+
+// The sign bits of the bytes are exactly the non-ASCII ones
+LINESCAN_TARGET("sse2")
+static size_t find_non_ascii_sse2(const char *data, size_t len) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)(data + i));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(block);
+        if (mask) {
+            return i + first_set_bit(mask);
+        }
+    }
+
+    return i + find_non_ascii_scalar(data + i, len - i);
+}
+
+LINESCAN_TARGET("sse2")
+static size_t find_quote_sse2(const char *data, size_t len) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)(data + i));
+        __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(block, quote), _mm_cmpeq_epi8(block, backslash));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(hits);
+        if (mask) {
+            return i + first_set_bit(mask);
+        }
+    }
+
+    return i + find_quote_scalar(data + i, len - i);
+}
+
+LINESCAN_TARGET("avx2")
+static size_t find_eol_avx2(const char *data, size_t len) {
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i cr = _mm256_set1_epi8('\r');
+
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(data + i));
+        __m256i hits = _mm256_or_si256(_mm256_cmpeq_epi8(block, lf), _mm256_cmpeq_epi8(block, cr));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(hits);
+        if (mask) {
+            return i + first_set_bit(mask);
+        }
+    }
+
+    // Clear the upper halves before the SSE2 tail (and the SSE code of the
+    // caller), which would otherwise pay for a state transition on each call
+    _mm256_zeroupper();
+    return i + find_eol_sse2(data + i, len - i);
+}
+
+LINESCAN_TARGET("avx2")
+static size_t find_non_ascii_avx2(const char *data, size_t len) {
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(data + i));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(block);
+        if (mask) {
+            return i + first_set_bit(mask);
+        }
+    }
+
+    _mm256_zeroupper();
+    return i + find_non_ascii_sse2(data + i, len - i);
+}
+
+LINESCAN_TARGET("avx2")
+static size_t find_quote_avx2(const char *data, size_t len) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(data + i));
+        __m256i hits = _mm256_or_si256(_mm256_cmpeq_epi8(block, quote), _mm256_cmpeq_epi8(block, backslash));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(hits);
+        if (mask) {
+            return i + first_set_bit(mask);
+        }
+    }
+
+    _mm256_zeroupper();
+    return i + find_quote_sse2(data + i, len - i);
+}
+
+LINESCAN_TARGET("avx2")
+static size_t rfind_eol_avx2(const char *data, size_t len) {
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i cr = _mm256_set1_epi8('\r');
+
+    size_t i = len;
+    for (; i >= 32; i -= 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(data + i - 32));
+        __m256i hits = _mm256_or_si256(_mm256_cmpeq_epi8(block, lf), _mm256_cmpeq_epi8(block, cr));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(hits);
+        if (mask) {
+            return i - 32 + last_set_bit(mask);
+        }
+    }
+
+    _mm256_zeroupper();
+    size_t found = rfind_eol_sse2(data, i);
+    return found < i ? found : len;
+}
+
+// Substring search after Mula's "generic SIMD" method: compare the needle's
+// first and last bytes against 16/32 positions at once and only verify
+// positions where both agree. When folding, letters are compared with the
+// 0x20 bit forced on (a superset of the real matches; verification is exact).
+LINESCAN_TARGET("sse2")
+static size_t find_substr_sse2(const char *data, size_t len, const char *needle, size_t needle_len, bool fold) {
+    if (needle_len < 2 || needle_len > len) {
+        return find_substr_scalar(data, len, needle, needle_len, fold);
+    }
+
+    unsigned char first_byte = (unsigned char)needle[0];
+    unsigned char last_byte = (unsigned char)needle[needle_len - 1];
+    const __m128i first = _mm_set1_epi8((char)first_byte);
+    const __m128i last = _mm_set1_epi8((char)last_byte);
+    const __m128i first_fold = _mm_set1_epi8((fold && is_alpha(first_byte)) ? 0x20 : 0);
+    const __m128i last_fold = _mm_set1_epi8((fold && is_alpha(last_byte)) ? 0x20 : 0);
+
+    size_t i = 0;
+    for (; i + needle_len - 1 + 16 <= len; i += 16) {
+        __m128i block_first = _mm_or_si128(_mm_loadu_si128((const __m128i *)(data + i)), first_fold);
+        __m128i block_last = _mm_or_si128(_mm_loadu_si128((const __m128i *)(data + i + needle_len - 1)), last_fold);
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(block_first, first), _mm_cmpeq_epi8(block_last, last)));
+
+        while (mask) {
+            unsigned bit = first_set_bit(mask);
+            if (substr_equal(data + i + bit, needle, needle_len, fold)) {
+                return i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    size_t rest = find_substr_scalar(data + i, len - i, needle, needle_len, fold);
+    return rest < len - i ? i + rest : len;
+}
+
+LINESCAN_TARGET("avx2")
+static size_t find_substr_avx2(const char *data, size_t len, const char *needle, size_t needle_len, bool fold) {
+    if (needle_len < 2 || needle_len > len) {
+        return find_substr_scalar(data, len, needle, needle_len, fold);
+    }
+
+    unsigned char first_byte = (unsigned char)needle[0];
+    unsigned char last_byte = (unsigned char)needle[needle_len - 1];
+    const __m256i first = _mm256_set1_epi8((char)first_byte);
+    const __m256i last = _mm256_set1_epi8((char)last_byte);
+    const __m256i first_fold = _mm256_set1_epi8((fold && is_alpha(first_byte)) ? 0x20 : 0);
+    const __m256i last_fold = _mm256_set1_epi8((fold && is_alpha(last_byte)) ? 0x20 : 0);
+
+    size_t i = 0;
+    for (; i + needle_len - 1 + 32 <= len; i += 32) {
+        __m256i block_first = _mm256_or_si256(_mm256_loadu_si256((const __m256i *)(data + i)), first_fold);
+        __m256i block_last = _mm256_or_si256(_mm256_loadu_si256((const __m256i *)(data + i + needle_len - 1)), last_fold);
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(block_first, first), _mm256_cmpeq_epi8(block_last, last)));
+
+        while (mask) {
+            unsigned bit = first_set_bit(mask);
+            if (substr_equal(data + i + bit, needle, needle_len, fold)) {
+                return i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    _mm256_zeroupper();
+    size_t rest = find_substr_sse2(data + i, len - i, needle, needle_len, fold);
+    return rest < len - i ? i + rest : len;
+}
+
+static bool cpu_has_sse2(void) {
+#if defined(_M_X64) || defined(__x86_64__)
+    return true;    // Part of the x86-64 baseline
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+#endif
+}
+
+static bool cpu_has_avx2(void) {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+
+    // AVX state must be enabled by the OS (OSXSAVE + XCR0 bits 1-2)
+    __cpuid(info, 1);
+    if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28))) {
+        return false;
+    }
+    if ((_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // LINESCAN_X86
+
+static size_t find_eol_resolve(const char *data, size_t len);
+static size_t rfind_eol_resolve(const char *data, size_t len);
+
+static size_t find_substr_resolve(const char *data, size_t len, const char *needle, size_t needle_len, bool fold);
+static size_t find_non_ascii_resolve(const char *data, size_t len);
+static size_t find_quote_resolve(const char *data, size_t len);
+
+static FindEolFn find_eol_impl = find_eol_resolve;
+static FindEolFn rfind_eol_impl = rfind_eol_resolve;
+static FindSubstrFn find_substr_impl = find_substr_resolve;
+static FindNonAsciiFn find_non_ascii_impl = find_non_ascii_resolve;
+static FindQuoteFn find_quote_impl = find_quote_resolve;
+static const char *find_eol_name = "scalar";
+
+static void select_impl(void) {
+    FindEolFn impl = find_eol_scalar;
+    FindEolFn rimpl = rfind_eol_scalar;
+    FindSubstrFn simpl = find_substr_scalar;
+    FindNonAsciiFn aimpl = find_non_ascii_scalar;
+    FindQuoteFn qimpl = find_quote_scalar;
+    const char *name = "scalar";
+
+    // MULTITAIL_LINESCAN=scalar|sse2 caps the implementation (for comparisons)
+    const char *limit = getenv("MULTITAIL_LINESCAN");
+    bool allow_sse2 = !limit || strcmp(limit, "scalar") != 0;
+    bool allow_avx2 = allow_sse2 && (!limit || strcmp(limit, "sse2") != 0);
+
+#ifdef LINESCAN_X86
+    if (allow_avx2 && cpu_has_avx2()) {
+        impl = find_eol_avx2;
+        rimpl = rfind_eol_avx2;
+        simpl = find_substr_avx2;
+        aimpl = find_non_ascii_avx2;
+        qimpl = find_quote_avx2;
+        name = "avx2";
+    } else if (allow_sse2 && cpu_has_sse2()) {
+        impl = find_eol_sse2;
+        rimpl = rfind_eol_sse2;
+        simpl = find_substr_sse2;
+        aimpl = find_non_ascii_sse2;
+        qimpl = find_quote_sse2;
+        name = "sse2";
+    }
+#else
+    (void)allow_avx2;
+#endif
+
+    // Racing first calls all resolve to the same choice, so plain stores suffice
+    find_eol_name = name;
+    find_substr_impl = simpl;
+    find_non_ascii_impl = aimpl;
+    find_quote_impl = qimpl;
+    rfind_eol_impl = rimpl;
+    find_eol_impl = impl;
+}
+
+static size_t find_eol_resolve(const char *data, size_t len) {
+    select_impl();
+    return find_eol_impl(data, len);
+}
+
+static size_t rfind_eol_resolve(const char *data, size_t len) {
+    select_impl();
+    return rfind_eol_impl(data, len);
+}
+
+static size_t find_substr_resolve(const char *data, size_t len, const char *needle, size_t needle_len, bool fold) {
+    select_impl();
+    return find_substr_impl(data, len, needle, needle_len, fold);
+}
+
+void linescan_init(void) {
+    if (find_eol_impl == find_eol_resolve) {
+        select_impl();
+    }
+}
+
+size_t linescan_find_eol(const char *data, size_t len) {
+    return find_eol_impl(data, len);
+}
+
+size_t linescan_rfind_eol(const char *data, size_t len) {
+    return rfind_eol_impl(data, len);
+}
+
+size_t linescan_find_substr(const char *data, size_t len, const char *needle, size_t needle_len, bool fold) {
+    return find_substr_impl(data, len, needle, needle_len, fold);
+}
+
+static size_t find_non_ascii_resolve(const char *data, size_t len) {
+    select_impl();
+    return find_non_ascii_impl(data, len);
+}
+
+size_t linescan_find_non_ascii(const char *data, size_t len) {
+    return find_non_ascii_impl(data, len);
+}
+
+static size_t find_quote_resolve(const char *data, size_t len) {
+    select_impl();
+    return find_quote_impl(data, len);
+}
+
+size_t linescan_find_quote(const char *data, size_t len) {
+    return find_quote_impl(data, len);
+}
+
+const char *linescan_impl_name(void) {
+    linescan_init();
+    return find_eol_name;
+}
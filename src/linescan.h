@@ -0,0 +1,33 @@
+#ifndef LINESCAN_H
+#define LINESCAN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Pick the implementation now. Call before starting threads that scan;
+// otherwise the first scan picks it lazily.
+void linescan_init(void);
+
+// Find the first line terminator ('\r' or '\n') in data. Returns len if none.
+// Uses AVX2 or SSE2 when the CPU supports it, chosen once at runtime.
+size_t linescan_find_eol(const char *data, size_t len);
+
+// Find the last line terminator in data. Returns len if none.
+size_t linescan_rfind_eol(const char *data, size_t len);
+
+// Find the first occurrence of needle in data. Returns len if none (0 for an
+// empty needle). With fold set, ASCII letters in data match case-insensitively
+// and needle must already be lower-case.
+size_t linescan_find_substr(const char *data, size_t len, const char *needle, size_t needle_len, bool fold);
+
+// Find the first byte that is not ASCII (0x80 or above). Returns len if none.
+size_t linescan_find_non_ascii(const char *data, size_t len);
+
+// Find the first double quote or backslash (the bytes that can end a JSON
+// string). Returns len if none.
+size_t linescan_find_quote(const char *data, size_t len);
+
+// Name of the scanner implementation in use ("avx2", "sse2" or "scalar")
+const char *linescan_impl_name(void);
+
+#endif // LINESCAN_H
@@ -0,0 +1,266 @@
+// Checks that lines come out of the readers exactly as a plain byte loop
+// splits them. ctest runs it once per implementation (MULTITAIL_LINESCAN
+// caps the choice, which is made once per process).
+//
+// Random text mixed with CR, LF and CRLF is appended to a file in chunks
+// of random size, and a reader pool reads each one as it lands: the blocks
+// it queues and the pane's split of them are the ones the viewer uses,
+// with the unfinished line carried over and a CR ending a read waiting
+// for a LF at the start of the next. The pane's lines must match a
+// byte-by-byte split of the whole input. The scanner itself is checked
+// from every offset of a short window as well.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "linescan.h"
+#include "linebuf.h"
+#include "pane.h"
+#include "platform.h"
+#include "reader.h"
+
+#define TEST_INPUT_SIZE (64 * 1024)     // Bytes of text per round
+#define TEST_ROUNDS 6
+#define TEST_MAX_CHUNK 300              // Usual longest append; short enough to end reads inside CRLF pairs often
+#define TEST_LONG_CHUNK 8192            // One append in TEST_LONG_ODDS is up to this long
+#define TEST_LONG_ODDS 16
+
+typedef struct {
+    size_t start;
+    size_t length;
+} Span;
+
+typedef struct {
+    Span *spans;
+    size_t count;
+    size_t cap;
+} SpanList;
+
+static int failures;
+
+static uint32_t next_random(uint32_t *state) {
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+static void span_add(SpanList *list, size_t start, size_t length) {
+    if (list->count == list->cap) {
+        list->cap = list->cap ? list->cap * 2 : 1024;
+        list->spans = (Span *)realloc(list->spans, list->cap * sizeof(Span));
+        if (!list->spans) {
+            fprintf(stderr, "out of memory\n");
+            exit(2);
+        }
+    }
+    list->spans[list->count].start = start;
+    list->spans[list->count].length = length;
+    list->count++;
+}
+
+// Text with terminators of every kind, runs of them included; sometimes
+// long stretches without one so the vector loops run whole blocks. It
+// ends in a LF: the readers hold an unfinished last line back.
+static void fill_input(char *data, size_t len, uint32_t *state) {
+    static const char text[] = "abcdefghijklmnopqrstuvwxyz0123456789 =:/.-_\t\x80\xff";
+    uint32_t terminator_odds = 4 + next_random(state) % 200;
+    for (size_t i = 0; i < len; i++) {
+        uint32_t r = next_random(state);
+        if (r % terminator_odds == 0) {
+            static const char terminators[] = {'\n', '\r', '\n'};
+            data[i] = terminators[(r >> 8) % 3];
+            if ((r >> 12) % 3 == 0 && i + 1 < len) {
+                data[i++] = '\r';       // CRLF
+                data[i] = '\n';
+            }
+        } else {
+            data[i] = text[r % (sizeof(text) - 1)];
+        }
+    }
+    data[len - 1] = '\n';
+}
+
+// The reference: one byte at a time over the whole input
+static void split_reference(const char *data, size_t len, SpanList *out) {
+    size_t start = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] == '\n' || data[i] == '\r') {
+            span_add(out, start, i - start);
+            if (data[i] == '\r' && i + 1 < len && data[i + 1] == '\n') {
+                i++;
+            }
+            start = i + 1;
+        }
+    }
+    if (start < len) {
+        span_add(out, start, len - start);
+    }
+}
+
+// Drain the pane until the pool has read everything it was kicked for.
+// Draining while waiting keeps a full queue from stalling the reader.
+static void wait_read(ReaderPool *pool, TailPane *pane) {
+    for (;;) {
+        pane_drain(pane, SIZE_MAX);
+        plat_mutex_lock(&pool->lock);
+        bool idle = !pane->queued && !pane->active;
+        plat_mutex_unlock(&pool->lock);
+        if (idle) {
+            pane_drain(pane, SIZE_MAX);
+            return;
+        }
+        plat_sleep_ms(1);
+    }
+}
+
+// Append the input to a fresh file a chunk at a time, letting the pool read
+// each chunk before the next lands, and compare the pane's lines with want
+static bool run_round(const char *data, size_t len, const SpanList *want, uint32_t *state, int round) {
+    char path[64];
+    snprintf(path, sizeof(path), "multitail_linescan_test_%s_%llu.log", linescan_impl_name(),
+             (unsigned long long)plat_now_us());
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "cannot create %s\n", path);
+        return false;
+    }
+
+    static TailPane pane;
+    LineBudget budget;
+    PlatSignal ui_wake;
+    ReaderPool pool;
+    linebudget_init(&budget, LINEBUF_DEFAULT_BUDGET);
+    bool ok = pane_init(&pane, path, 0, NULL, &budget) && plat_signal_init(&ui_wake);
+    if (ok && !(ok = reader_pool_init(&pool, 1, 0, &ui_wake))) {
+        plat_signal_destroy(&ui_wake);
+    }
+    if (ok && !(ok = reader_pool_start(&pool))) {
+        reader_pool_destroy(&pool);
+        plat_signal_destroy(&ui_wake);
+    }
+    if (!ok) {
+        fprintf(stderr, "cannot start a reader for %s\n", path);
+        pane_destroy(&pane);
+        linebudget_destroy(&budget);
+        fclose(file);
+        remove(path);
+        return false;
+    }
+
+    // The startup scan of the empty file first, so no line counts as old
+    reader_pool_kick(&pool, &pane);
+    wait_read(&pool, &pane);
+
+    size_t pos = 0;
+    while (pos < len && ok) {
+        uint32_t r = next_random(state);
+        size_t chunk = 1 + (r % TEST_LONG_ODDS == 0 ? (r >> 4) % TEST_LONG_CHUNK : (r >> 4) % TEST_MAX_CHUNK);
+        if (chunk > len - pos) {
+            chunk = len - pos;
+        }
+        if (fwrite(data + pos, 1, chunk, file) != chunk || fflush(file) != 0) {
+            fprintf(stderr, "cannot write %s\n", path);
+            ok = false;
+            break;
+        }
+        pos += chunk;
+        reader_pool_kick(&pool, &pane);
+        wait_read(&pool, &pane);
+    }
+
+    size_t count = linebuf_count(&pane.buffer);
+    if (ok && count != want->count) {
+        fprintf(stderr, "round %d: %zu lines, want %zu\n", round, count, want->count);
+        failures++;
+    }
+    for (size_t i = 0; ok && i < count && i < want->count; i++) {
+        const LineEntry *entry = linebuf_entry(&pane.buffer, i);
+        const Span *w = &want->spans[i];
+        if (!entry || entry->length != w->length || memcmp(entry->text, data + w->start, w->length) != 0) {
+            fprintf(stderr, "round %d: line %zu (at byte %zu) differs, want %zu bytes\n", round, i, w->start,
+                    w->length);
+            failures++;
+            break;
+        }
+    }
+
+    reader_pool_destroy(&pool);
+    plat_signal_destroy(&ui_wake);
+    pane_destroy(&pane);
+    linebudget_destroy(&budget);
+    fclose(file);
+    remove(path);
+    return ok;
+}
+
+// find_eol and rfind_eol from every start offset of a short window, so each
+// alignment and every tail length of the vector loops is covered
+static void check_offsets(const char *data, size_t len) {
+    for (size_t start = 0; start < len; start++) {
+        size_t first = len - start;
+        size_t last = len - start;
+        for (size_t k = start; k < len; k++) {
+            if (data[k] == '\n' || data[k] == '\r') {
+                if (first == len - start) {
+                    first = k - start;
+                }
+                last = k - start;
+            }
+        }
+        size_t got = linescan_find_eol(data + start, len - start);
+        if (got != first) {
+            fprintf(stderr, "find_eol at %zu of %zu: got %zu, want %zu\n", start, len, got, first);
+            failures++;
+            return;
+        }
+        got = linescan_rfind_eol(data + start, len - start);
+        if (got != last) {
+            fprintf(stderr, "rfind_eol at %zu of %zu: got %zu, want %zu\n", start, len, got, last);
+            failures++;
+            return;
+        }
+    }
+}
+
+int main(void) {
+    linescan_init();
+    printf("linescan: %s\n", linescan_impl_name());
+
+    char *data = (char *)malloc(TEST_INPUT_SIZE);
+    if (!data) {
+        fprintf(stderr, "out of memory\n");
+        return 2;
+    }
+
+    uint32_t state = 20261017;
+    SpanList want = {NULL, 0, 0};
+    for (int round = 0; round < TEST_ROUNDS && failures == 0; round++) {
+        fill_input(data, TEST_INPUT_SIZE, &state);
+        want.count = 0;
+        split_reference(data, TEST_INPUT_SIZE, &want);
+        if (!run_round(data, TEST_INPUT_SIZE, &want, &state, round)) {
+            free(want.spans);
+            free(data);
+            return 2;
+        }
+        check_offsets(data, 200);
+    }
+
+    // A terminator as the very first or last byte of a window, and none at all
+    memset(data, 'x', 200);
+    check_offsets(data, 200);
+    data[199] = '\r';
+    check_offsets(data, 200);
+    data[0] = '\n';
+    check_offsets(data, 200);
+
+    free(want.spans);
+    free(data);
+    if (failures > 0) {
+        printf("FAILED: %d mismatches\n", failures);
+        return 1;
+    }
+    printf("ok: %d rounds of %d bytes\n", TEST_ROUNDS, TEST_INPUT_SIZE);
+    return 0;
+}
@@ -1,33 +1,101 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
-#include <windows.h>
+#include <string.h>
 
 #include "console.h"
 #include "pane.h"
 #include "input.h"
 #include "statusbar.h"
-
-#define POLL_INTERVAL_MS 50
+#include "watch.h"
+#include "linescan.h"
+#include "reader.h"
+#include "schedule.h"
+#include "trace.h"
+
+#define POLL_INTERVAL_MS 50     // Fallback poll rate for files that cannot be watched
+#define MIN_PANE_HEIGHT 3       // Header plus two lines; fewer rows per file switches to one merged view
+#define HEADLESS_WIDTH 160      // Size of the console drawn to with -Q
+#define HEADLESS_HEIGHT 50
+
+typedef enum {
+    PROMPT_NONE,
+    PROMPT_INCLUDE,
+    PROMPT_EXCLUDE,
+    PROMPT_SEARCH_FORWARD,
+    PROMPT_SEARCH_BACKWARD
+} PromptKind;
+
+// Line editor shown in the status bar
+typedef struct {
+    PromptKind kind;                        // What the text is for; PROMPT_NONE when closed
+    char text[PATTERN_MAX_LENGTH + 3];      // Room for a regex's slashes
+    size_t len;
+    char error[64];                         // Why the last Enter was rejected
+} Prompt;
 
 typedef struct {
     Console console;
-    TailPane panes[MAX_PANES];
+    TailPane *files;            // One per tailed file
+    int file_count;
+    TailPane mux;               // Merged view when there are too many files to split the screen
+    LineBudget budget;          // Scrollback memory shared by all panes
+    HighlightRules highlights;  // Colors for matching lines, shared by all panes
+    JsonFields json_fields;     // Fields shown as columns for JSON lines (count 0: off)
+    TailPane *panes;            // Panes on screen: files, or just the merged view
     int pane_count;
     int active_pane;
+    Prompt prompt;
+    char message[PATTERN_MAX_LENGTH + 48];  // Search result note, shown until the next key
+    bool show_metrics;          // Metrics overlay above the status bar
+    const char *stats_path;     // File the metrics are rewritten to, or NULL
     bool running;
 } MultiTail;
 
 static void print_usage(const char *prog) {
-    fprintf(stderr, "Usage: %s <file1> [file2] ... [file8]\n", prog);
+    fprintf(stderr, "Usage: %s [-m] [-t] [-r] [-z] [-b MB] [-R fps] [-s file] [-f pattern] [-x pattern] [-H color:pattern] [-L color:pattern] [-N] [-w] [-j] [-J fields] [-T file] [-Q secs] <file1> [file2] ...\n", prog);
     fprintf(stderr, "Tail multiple files simultaneously.\n\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -m         - Show all files in one merged view, each line tagged with its file\n");
+    fprintf(stderr, "               (automatic when the files do not fit on screen)\n");
+    fprintf(stderr, "  -t         - Merge the files in the order of the timestamps their lines start with\n");
+    fprintf(stderr, "  -r         - Keep old scrollback in the files and re-read it when viewed,\n");
+    fprintf(stderr, "               holding far more history in the same memory (not when merged)\n");
+    fprintf(stderr, "  -z         - Load rotated copies (FILE.1, FILE.2.gz, ...) ahead of each file\n");
+    fprintf(stderr, "  -b MB      - Scrollback memory shared by all files (default %u)\n",
+            (unsigned)(LINEBUF_DEFAULT_BUDGET / (1024 * 1024)));
+    fprintf(stderr, "  -R fps     - Redraw at most fps times a second (default %u)\n", SCHEDULE_DEFAULT_FPS);
+    fprintf(stderr, "  -s file    - Rewrite file with per-file metrics every second (Prometheus text format)\n");
+    fprintf(stderr, "  -f pattern - Only show lines containing pattern (/regex/ for a regex)\n");
+    fprintf(stderr, "  -x pattern - Hide lines containing pattern\n");
+    fprintf(stderr, "  -H color:pattern - Color text matching pattern (red, green, yellow, blue, magenta,\n");
+    fprintf(stderr, "               cyan, white); repeatable, the first matching rule wins\n");
+    fprintf(stderr, "  -L color:pattern - Color whole lines containing pattern\n");
+    fprintf(stderr, "  -N         - Do not color FATAL, ERROR, CRIT and WARN lines\n");
+    fprintf(stderr, "  -w         - Wrap long lines (W toggles it per pane)\n");
+    fprintf(stderr, "  -j         - Show JSON lines as aligned columns of their timestamp, level,\n");
+    fprintf(stderr, "               trace_id and msg fields (J toggles it per pane)\n");
+    fprintf(stderr, "  -J fields  - The same with other fields: comma-separated, each one key or\n");
+    fprintf(stderr, "               several joined by '|' (first present wins), e.g. ts,level,msg|message\n");
+    fprintf(stderr, "  -T file    - Record when and how much each file grows to file, for multitail_replay\n");
+    fprintf(stderr, "  -Q secs    - Run without a terminal, drawing to an unseen %dx%d screen; quit once\n",
+            HEADLESS_WIDTH, HEADLESS_HEIGHT);
+    fprintf(stderr, "               nothing has been read for secs and print what was read\n\n");
     fprintf(stderr, "Controls:\n");
     fprintf(stderr, "  Tab        - Switch to next pane\n");
     fprintf(stderr, "  Shift+Tab  - Switch to previous pane\n");
     fprintf(stderr, "  Up/Down    - Scroll in active pane\n");
+    fprintf(stderr, "  Left/Right - Scroll sideways through long lines\n");
+    fprintf(stderr, "  W          - Wrap long lines in the active pane, or stop\n");
+    fprintf(stderr, "  J          - Show JSON lines in the active pane as columns or as they are\n");
     fprintf(stderr, "  PgUp/PgDn  - Scroll by page\n");
     fprintf(stderr, "  Home       - Jump to start of buffer\n");
     fprintf(stderr, "  End        - Resume live following\n");
+    fprintf(stderr, "  F / X      - Set include / exclude filter for the active pane\n");
+    fprintf(stderr, "  C          - Clear the active pane's filters\n");
+    fprintf(stderr, "  / / ?      - Search forward / backward in the active pane\n");
+    fprintf(stderr, "  n / N      - Next / previous match\n");
+    fprintf(stderr, "  M          - Show / hide the active pane's metrics\n");
     fprintf(stderr, "  Q / Ctrl+C - Quit\n");
 }
 
@@ -49,9 +117,78 @@ static void calculate_pane_regions(MultiTail *app) {
     }
 }
 
-static void handle_input(MultiTail *app, InputAction action) {
+// Open the prompt. Filters start from the pane's current pattern, searches
+// from nothing (n / N repeat the last one).
+static void prompt_open(MultiTail *app, PromptKind kind) {
+    TailPane *active = &app->panes[app->active_pane];
+    Prompt *prompt = &app->prompt;
+    prompt->kind = kind;
+    prompt->error[0] = '\0';
+    prompt->text[0] = '\0';
+    if (kind == PROMPT_INCLUDE || kind == PROMPT_EXCLUDE) {
+        pattern_describe(kind == PROMPT_EXCLUDE ? &active->filter.exclude : &active->filter.include,
+                         prompt->text, sizeof(prompt->text));
+    }
+    prompt->len = strlen(prompt->text);
+}
+
+static void prompt_input(MultiTail *app, InputAction action, char ch) {
+    Prompt *prompt = &app->prompt;
+    TailPane *active = &app->panes[app->active_pane];
+
+    switch (action) {
+        case INPUT_CHAR:
+            if (prompt->len + 1 < sizeof(prompt->text)) {
+                prompt->text[prompt->len++] = ch;
+                prompt->text[prompt->len] = '\0';
+            }
+            break;
+
+        case INPUT_BACKSPACE:
+            if (prompt->len > 0) {
+                prompt->text[--prompt->len] = '\0';
+            }
+            break;
+
+        case INPUT_ENTER:
+            if (prompt->kind == PROMPT_SEARCH_FORWARD || prompt->kind == PROMPT_SEARCH_BACKWARD) {
+                if (!pane_search(active, prompt->text, prompt->kind == PROMPT_SEARCH_BACKWARD,
+                                 app->message, sizeof(app->message))) {
+                    snprintf(prompt->error, sizeof(prompt->error), "%.63s", app->message);
+                    app->message[0] = '\0';
+                    return;
+                }
+            } else if (!pane_set_filter(active, prompt->kind == PROMPT_EXCLUDE, prompt->text,
+                                        prompt->error, sizeof(prompt->error))) {
+                return;     // Keep the prompt open to fix the pattern
+            }
+            prompt->kind = PROMPT_NONE;
+            break;
+
+        case INPUT_CANCEL:
+            prompt->kind = PROMPT_NONE;
+            break;
+
+        default:
+            return;
+    }
+    prompt->error[0] = '\0';
+}
+
+static void handle_input(MultiTail *app, InputAction action, char ch) {
     TailPane *active = &app->panes[app->active_pane];
 
+    if (action != INPUT_NONE && action != INPUT_RESIZE && app->message[0]) {
+        app->message[0] = '\0';
+        active->dirty = true;
+    }
+
+    if (app->prompt.kind != PROMPT_NONE && action != INPUT_RESIZE) {
+        prompt_input(app, action, ch);
+        active->dirty = true;   // Redraw the status bar
+        return;
+    }
+
     switch (action) {
         case INPUT_QUIT:
             app->running = false;
@@ -73,6 +210,19 @@ static void handle_input(MultiTail *app, InputAction action) {
             pane_scroll_down(active);
             break;
 
+        case INPUT_SCROLL_LEFT:
+        case INPUT_SCROLL_RIGHT:
+            pane_scroll_side(active, action == INPUT_SCROLL_RIGHT);
+            break;
+
+        case INPUT_WRAP:
+            pane_set_wrap(active, !active->wrap);
+            break;
+
+        case INPUT_JSON:
+            pane_set_json_view(active, !active->json_view);
+            break;
+
         case INPUT_PAGE_UP:
             pane_page_up(active);
             break;
@@ -89,6 +239,40 @@ static void handle_input(MultiTail *app, InputAction action) {
             pane_scroll_end(active);
             break;
 
+        case INPUT_FILTER_INCLUDE:
+            prompt_open(app, PROMPT_INCLUDE);
+            active->dirty = true;
+            break;
+
+        case INPUT_FILTER_EXCLUDE:
+            prompt_open(app, PROMPT_EXCLUDE);
+            active->dirty = true;
+            break;
+
+        case INPUT_FILTER_CLEAR:
+            pane_clear_filter(active);
+            break;
+
+        case INPUT_SEARCH_FORWARD:
+            prompt_open(app, PROMPT_SEARCH_FORWARD);
+            active->dirty = true;
+            break;
+
+        case INPUT_SEARCH_BACKWARD:
+            prompt_open(app, PROMPT_SEARCH_BACKWARD);
+            active->dirty = true;
+            break;
+
+        case INPUT_SEARCH_NEXT:
+        case INPUT_SEARCH_PREV:
+            pane_search_next(active, action == INPUT_SEARCH_PREV, app->message, sizeof(app->message));
+            break;
+
+        case INPUT_METRICS:
+            app->show_metrics = !app->show_metrics;
+            app->panes[app->pane_count - 1].dirty = true;   // Its bottom row is under the overlay
+            break;
+
         case INPUT_RESIZE:
             console_update_size(&app->console);
             calculate_pane_regions(app);
@@ -101,62 +285,422 @@ static void handle_input(MultiTail *app, InputAction action) {
     }
 }
 
+static void destroy_files(MultiTail *app, int count) {
+    for (int i = 0; i < count; i++) {
+        pane_destroy(&app->files[i]);
+    }
+    free(app->files);
+    app->files = NULL;
+    if (app->panes == &app->mux) {
+        pane_destroy(&app->mux);
+    }
+    linebudget_destroy(&app->budget);
+    highlight_rules_destroy(&app->highlights);
+}
+
+// Bytes read from all files so far
+static size_t total_bytes_read(const MultiTail *app) {
+    size_t total = 0;
+    for (int i = 0; i < app->file_count; i++) {
+        total += plat_atomic_load(&app->files[i].metrics.bytes_read);
+    }
+    return total;
+}
+
+// What a headless run read, for comparing runs: per file, then the whole
+// run up to the last byte read
+static void print_summary(const MultiTail *app, uint64_t busy_us, const TraceRecorder *trace) {
+    size_t bytes = 0;
+    size_t lines = 0;
+    for (int i = 0; i < app->file_count; i++) {
+        MetricsIngest ingest;
+        metrics_ingest(&app->files[i], &ingest);
+        printf("%s: %zu lines, %zu bytes\n", app->files[i].filepath, ingest.lines_read, ingest.bytes_read);
+        bytes += ingest.bytes_read;
+        lines += ingest.lines_read;
+    }
+
+    double secs = (double)busy_us / 1e6;
+    printf("total: %zu lines, %zu bytes in %.3f s", lines, bytes, secs);
+    if (secs > 0) {
+        printf(" (%.1f MB/s, %.0f lines/s)", (double)bytes / (1024.0 * 1024.0) / secs, (double)lines / secs);
+    }
+    printf("\n");
+    if (trace) {
+        printf("trace: %llu events\n", (unsigned long long)trace->events);
+    }
+}
+
+// Roll the metrics over to a new interval once one has passed, refreshing
+// the overlay and the stats file
+static void sample_metrics(MultiTail *app) {
+    uint64_t now = plat_now_ms();
+    bool sampled = false;
+    for (int i = 0; i < app->file_count; i++) {
+        sampled |= metrics_sample(&app->files[i].metrics, now);
+    }
+    if (app->panes == &app->mux) {
+        sampled |= metrics_sample(&app->mux.metrics, now);
+    }
+    if (!sampled) {
+        return;
+    }
+
+    if (app->show_metrics) {
+        app->panes[app->active_pane].dirty = true;
+    }
+    if (app->stats_path) {
+        metrics_write_file(app->stats_path, app->files, app->file_count, app->panes, app->pane_count);
+    }
+}
+
+// Status bar text while the prompt is open, or the last search message
+static const char *prompt_line(const MultiTail *app, char *line, size_t size) {
+    const Prompt *prompt = &app->prompt;
+    if (prompt->kind == PROMPT_NONE) {
+        if (!app->message[0]) {
+            return NULL;
+        }
+        snprintf(line, size, " %s", app->message);
+        return line;
+    }
+
+    const char *label = "Include";
+    switch (prompt->kind) {
+        case PROMPT_EXCLUDE: label = "Exclude"; break;
+        case PROMPT_SEARCH_FORWARD: label = "Search"; break;
+        case PROMPT_SEARCH_BACKWARD: label = "Search backward"; break;
+        default: break;
+    }
+    if (prompt->error[0]) {
+        snprintf(line, size, " %s: %s_   [%s]", label, prompt->text, prompt->error);
+    } else {
+        snprintf(line, size, " %s (/regex/, empty = none): %s_", label, prompt->text);
+    }
+    return line;
+}
+
 int main(int argc, char *argv[]) {
-    if (argc < 2) {
+    int first_file = 1;
+    bool merged = false;
+    bool ordered = false;
+    bool by_reference = false;
+    bool archives = false;
+    size_t budget = LINEBUF_DEFAULT_BUDGET;
+    const char *include = NULL;
+    const char *exclude = NULL;
+    const char *stats_path = NULL;
+    unsigned fps = SCHEDULE_DEFAULT_FPS;
+    bool levels = true;
+    bool wrap = false;
+    const char *json_spec = NULL;
+    const char *trace_path = NULL;
+    unsigned long quit_idle = 0;    // -Q: headless, quitting after this many idle seconds
+    HighlightRules highlights;
+    highlight_rules_init(&highlights);
+
+    while (first_file < argc && argv[first_file][0] == '-') {
+        const char *opt = argv[first_file];
+        if (strcmp(opt, "-m") == 0) {
+            merged = true;
+        } else if (strcmp(opt, "-t") == 0) {
+            merged = true;
+            ordered = true;
+        } else if (strcmp(opt, "-r") == 0) {
+            by_reference = true;
+        } else if (strcmp(opt, "-z") == 0) {
+            archives = true;
+        } else if (strcmp(opt, "-b") == 0 && first_file + 1 < argc) {
+            char *end;
+            unsigned long mb = strtoul(argv[++first_file], &end, 10);
+            if (*end != '\0' || mb == 0 || mb > SIZE_MAX / (1024 * 1024)) {
+                print_usage(argv[0]);
+                return 1;
+            }
+            budget = (size_t)mb * 1024 * 1024;
+            if (budget < LINEBUF_MIN_BUDGET) {
+                budget = LINEBUF_MIN_BUDGET;
+            }
+        } else if (strcmp(opt, "-R") == 0 && first_file + 1 < argc) {
+            char *end;
+            unsigned long rate = strtoul(argv[++first_file], &end, 10);
+            if (*end != '\0' || rate == 0 || rate > SCHEDULE_MAX_FPS) {
+                print_usage(argv[0]);
+                return 1;
+            }
+            fps = (unsigned)rate;
+        } else if (strcmp(opt, "-s") == 0 && first_file + 1 < argc) {
+            stats_path = argv[++first_file];
+        } else if (strcmp(opt, "-f") == 0 && first_file + 1 < argc) {
+            include = argv[++first_file];
+        } else if (strcmp(opt, "-x") == 0 && first_file + 1 < argc) {
+            exclude = argv[++first_file];
+        } else if ((strcmp(opt, "-H") == 0 || strcmp(opt, "-L") == 0) && first_file + 1 < argc) {
+            char error[64];
+            const char *spec = argv[++first_file];
+            if (!highlight_rules_add(&highlights, spec, opt[1] == 'L', error, sizeof(error))) {
+                fprintf(stderr, "Error: Bad highlight rule '%s': %s\n", spec, error);
+                return 1;
+            }
+        } else if (strcmp(opt, "-N") == 0) {
+            levels = false;
+        } else if (strcmp(opt, "-w") == 0) {
+            wrap = true;
+        } else if (strcmp(opt, "-j") == 0) {
+            json_spec = JSON_DEFAULT_FIELDS;
+        } else if (strcmp(opt, "-J") == 0 && first_file + 1 < argc) {
+            json_spec = argv[++first_file];
+        } else if (strcmp(opt, "-T") == 0 && first_file + 1 < argc) {
+            trace_path = argv[++first_file];
+        } else if (strcmp(opt, "-Q") == 0 && first_file + 1 < argc) {
+            char *end;
+            quit_idle = strtoul(argv[++first_file], &end, 10);
+            if (*end != '\0' || quit_idle == 0 || quit_idle > 86400) {
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(opt, "--") == 0) {
+            first_file++;
+            break;
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+        first_file++;
+    }
+
+    if (argc - first_file < 1) {
         print_usage(argv[0]);
         return 1;
     }
 
-    if (argc - 1 > MAX_PANES) {
-        fprintf(stderr, "Error: Maximum of %d files allowed.\n", MAX_PANES);
+    // Rules given first take priority over the log levels
+    if ((levels && !highlight_rules_add_levels(&highlights)) || !highlight_rules_compile(&highlights)) {
+        highlight_rules_destroy(&highlights);
+        fprintf(stderr, "Error: Out of memory.\n");
         return 1;
     }
 
     MultiTail app = {0};
     app.running = true;
     app.active_pane = 0;
-    app.pane_count = 0;
+    app.stats_path = stats_path;
+    app.file_count = argc - first_file;
+    app.highlights = highlights;
+    if (json_spec) {
+        char error[64];
+        if (!json_fields_parse(&app.json_fields, json_spec, error, sizeof(error))) {
+            highlight_rules_destroy(&app.highlights);
+            fprintf(stderr, "Error: Bad field list '%s': %s\n", json_spec, error);
+            return 1;
+        }
+    }
+    linebudget_init(&app.budget, budget);
 
     // Initialize console first
-    if (!console_init(&app.console)) {
+    bool console_ok = quit_idle > 0 ? console_init_headless(&app.console, HEADLESS_WIDTH, HEADLESS_HEIGHT)
+                                    : console_init(&app.console);
+    if (!console_ok) {
         fprintf(stderr, "Error: Failed to initialize console.\n");
         return 1;
     }
 
+    app.files = (TailPane *)calloc((size_t)app.file_count, sizeof(TailPane));
+    if (!app.files) {
+        console_cleanup(&app.console);
+        fprintf(stderr, "Error: Out of memory.\n");
+        return 1;
+    }
+
+    // Split the screen while every file gets a usable pane, otherwise merge
+    if (app.file_count * MIN_PANE_HEIGHT > app.console.height - 1) {
+        merged = true;
+    }
+    if (merged) {
+        if (!pane_init_mux(&app.mux, app.files, app.file_count, &app.budget) ||
+            (ordered && !pane_order_by_time(&app.mux, MERGE_WINDOW_MS))) {
+            pane_destroy(&app.mux);
+            free(app.files);
+            console_cleanup(&app.console);
+            fprintf(stderr, "Error: Out of memory.\n");
+            return 1;
+        }
+        app.panes = &app.mux;
+        app.pane_count = 1;
+    } else {
+        app.panes = app.files;
+        app.pane_count = app.file_count;
+    }
+
     // Initialize panes for each file
-    for (int i = 1; i < argc; i++) {
-        if (!pane_init(&app.panes[app.pane_count], argv[i])) {
-            fprintf(stderr, "Error: Failed to open file: %s\n", argv[i]);
+    for (int i = 0; i < app.file_count; i++) {
+        if (!pane_init(&app.files[i], argv[first_file + i], (uint32_t)i, merged ? &app.mux : NULL,
+                       &app.budget)) {
             // Cleanup already initialized panes
-            for (int j = 0; j < app.pane_count; j++) {
-                pane_destroy(&app.panes[j]);
-            }
+            destroy_files(&app, i);
+            console_cleanup(&app.console);
+            fprintf(stderr, "Error: Failed to open file: %s\n", argv[first_file + i]);
+            return 1;
+        }
+        // Each file's startup scrollback gets an equal share of the budget
+        app.files[i].initial_bytes = app.budget.limit / (size_t)app.file_count;
+        if (by_reference && !merged) {
+            pane_reference_file(&app.files[i]);
+        }
+        if (archives && !pane_find_archives(&app.files[i])) {
+            destroy_files(&app, i + 1);
             console_cleanup(&app.console);
+            fprintf(stderr, "Error: Out of memory.\n");
             return 1;
         }
-        app.pane_count++;
+    }
+
+    // Filters and highlights from the command line apply to every pane
+    for (int i = 0; i < app.pane_count; i++) {
+        pane_set_highlights(&app.panes[i], app.highlights.rule_count > 0 ? &app.highlights : NULL);
+        pane_set_wrap(&app.panes[i], wrap);
+        pane_set_json(&app.panes[i], app.json_fields.count > 0 ? &app.json_fields : NULL);
+        char error[64];
+        const char *bad = NULL;
+        if (include && !pane_set_filter(&app.panes[i], false, include, error, sizeof(error))) {
+            bad = include;
+        } else if (exclude && !pane_set_filter(&app.panes[i], true, exclude, error, sizeof(error))) {
+            bad = exclude;
+        }
+        if (bad) {
+            destroy_files(&app, app.file_count);
+            console_cleanup(&app.console);
+            fprintf(stderr, "Error: Bad pattern '%s': %s\n", bad, error);
+            return 1;
+        }
+    }
+
+    // Fail now rather than silently every second
+    if (stats_path && !metrics_write_file(stats_path, app.files, app.file_count, app.panes, app.pane_count)) {
+        destroy_files(&app, app.file_count);
+        console_cleanup(&app.console);
+        fprintf(stderr, "Error: Cannot write stats file: %s\n", stats_path);
+        return 1;
     }
 
     // Calculate initial pane regions
     calculate_pane_regions(&app);
 
+    // A small pool of reader threads serves every file and raises ui_wake when
+    // lines are queued. The line scanner is chosen up front so the readers
+    // never race to pick it.
+    linescan_init();
+    PlatSignal ui_wake;
+    if (!plat_signal_init(&ui_wake)) {
+        destroy_files(&app, app.file_count);
+        console_cleanup(&app.console);
+        fprintf(stderr, "Error: Failed to create wake signal.\n");
+        return 1;
+    }
+    ReaderPool pool;
+    if (!reader_pool_init(&pool, (size_t)app.file_count, 0, &ui_wake)) {
+        plat_signal_destroy(&ui_wake);
+        destroy_files(&app, app.file_count);
+        console_cleanup(&app.console);
+        fprintf(stderr, "Error: Out of memory.\n");
+        return 1;
+    }
+
+    // Recording starts before the readers so their first reads are in it
+    TraceRecorder *trace = NULL;
+    if (trace_path) {
+        trace = (TraceRecorder *)malloc(sizeof(TraceRecorder));
+        if (!trace || !trace_open(trace, trace_path, (uint32_t)app.file_count)) {
+            free(trace);
+            reader_pool_destroy(&pool);
+            plat_signal_destroy(&ui_wake);
+            destroy_files(&app, app.file_count);
+            console_cleanup(&app.console);
+            fprintf(stderr, "Error: Cannot write trace file: %s\n", trace_path);
+            return 1;
+        }
+        pool.trace = trace;
+    }
+
+    if (!reader_pool_start(&pool)) {
+        reader_pool_destroy(&pool);
+        if (trace) {
+            trace_close(trace);
+            free(trace);
+        }
+        plat_signal_destroy(&ui_wake);
+        destroy_files(&app, app.file_count);
+        console_cleanup(&app.console);
+        fprintf(stderr, "Error: Failed to start reader threads.\n");
+        return 1;
+    }
+
+    // Wake on file changes instead of polling every pane
+    FileWatch watch;
+    if (!watch_init(&watch, app.files, app.file_count)) {
+        reader_pool_destroy(&pool);
+        if (trace) {
+            trace_close(trace);
+            free(trace);
+        }
+        plat_signal_destroy(&ui_wake);
+        destroy_files(&app, app.file_count);
+        console_cleanup(&app.console);
+        fprintf(stderr, "Error: Out of memory.\n");
+        return 1;
+    }
+    unsigned wait_timeout = watch_timeout(&watch, POLL_INTERVAL_MS);
+
     int prev_active = -1;  // Track active pane changes
+    Schedule schedule;
+    schedule_init(&schedule, fps);
+    bool input_seen = false;    // Draw the next frame at once, whatever the cap
+    uint64_t start_us = plat_now_us();
+    uint64_t last_read_us = start_us;   // When total_bytes_read last moved (headless)
+    size_t last_total = 0;
 
     // Main loop
     while (app.running) {
-        // Handle input
-        InputAction action = input_poll(&app.console);
-        handle_input(&app, action);
+        // Headless: done once the files have been quiet long enough
+        if (quit_idle > 0) {
+            size_t total = total_bytes_read(&app);
+            uint64_t now = plat_now_us();
+            if (total != last_total) {
+                last_total = total;
+                last_read_us = now;
+            } else if (now - last_read_us >= (uint64_t)quit_idle * 1000000) {
+                break;
+            }
+        }
 
-        if (!app.running) {
-            break;
+        // Send readers to changed files and take the lines they have queued,
+        // for a time slice at most so input and frames keep up during bursts
+        for (int i = 0; i < app.file_count; i++) {
+            if (watch_take_change(&watch, i)) {
+                reader_pool_kick(&pool, &app.files[i]);
+            }
+        }
+        bool backlog = schedule_ingest(&schedule, app.files, app.file_count);
+        bool holding = false;
+        pane_drain_ordered(&app.mux, &holding);
+
+        // Keep scrollback within the memory budget, taking from the largest
+        if (linebudget_trim(&app.budget)) {
+            for (int i = 0; i < app.pane_count; i++) {
+                pane_trim(&app.panes[i]);
+            }
         }
 
-        // Update all panes (check for new file content)
+        // Re-filter scrollback a batch at a time so keys stay responsive
+        bool rescanning = false;
         for (int i = 0; i < app.pane_count; i++) {
-            pane_update(&app.panes[i]);
+            if (pane_filter_step(&app.panes[i])) {
+                rescanning = true;
+            }
         }
 
+        sample_metrics(&app);
+
         // Check if active pane changed
         bool active_changed = (prev_active != app.active_pane);
         if (active_changed) {
@@ -177,25 +721,60 @@ int main(int argc, char *argv[]) {
             }
         }
 
-        // Only render if something changed
-        if (needs_redraw) {
+        // Only render if something changed, and no more often than the frame
+        // cap: lines arriving in between are drawn together
+        unsigned frame_wait = wait_timeout;
+        if (needs_redraw && (input_seen || schedule_frame_due(&schedule, &frame_wait))) {
             for (int i = 0; i < app.pane_count; i++) {
                 if (app.panes[i].dirty) {
                     pane_render(&app.panes[i], &app.console, i == app.active_pane);
                 }
             }
-            statusbar_render(&app.console, app.panes, app.pane_count, app.active_pane);
+            char prompt[PATTERN_MAX_LENGTH + 128];
+            statusbar_render(&app.console, app.panes, app.pane_count, app.active_pane,
+                             prompt_line(&app, prompt, sizeof(prompt)), app.show_metrics);
+            console_present(&app.console);
+            schedule_frame_drawn(&schedule);
+            input_seen = false;
         }
 
-        // Small sleep to avoid busy-waiting
-        Sleep(POLL_INTERVAL_MS);
+        // Sleep until a key is pressed, a file changes, a reader queued lines
+        // or the fallback poll is due (just check for keys while re-filtering
+        // or lines are left over, and come back soon for lines a time-ordered
+        // view holds back or a frame the cap held back)
+        unsigned timeout = (rescanning || backlog) ? 0 : wait_timeout;
+        if (holding && timeout > PANE_MERGE_POLL_MS) {
+            timeout = PANE_MERGE_POLL_MS;
+        }
+        if (needs_redraw && frame_wait < timeout) {
+            timeout = frame_wait;
+        }
+        if (watch_wait(&watch, &app.console, &ui_wake, timeout) == WATCH_INPUT) {
+            char ch = 0;
+            InputAction action = input_poll(&app.console, app.prompt.kind != PROMPT_NONE, &ch);
+            handle_input(&app, action, ch);
+            input_seen = true;
+        }
     }
 
-    // Cleanup
-    for (int i = 0; i < app.pane_count; i++) {
-        pane_destroy(&app.panes[i]);
+    watch_destroy(&watch);
+
+    // Cleanup: stop the readers before tearing down the panes they read into
+    reader_pool_destroy(&pool);
+    int status = 0;
+    if (quit_idle > 0) {
+        print_summary(&app, last_read_us - start_us, trace);
+    }
+    if (trace) {
+        if (!trace_close(trace)) {
+            fprintf(stderr, "Error: Failed to write trace file: %s\n", trace_path);
+            status = 1;
+        }
+        free(trace);
     }
+    destroy_files(&app, app.file_count);
+    plat_signal_destroy(&ui_wake);
     console_cleanup(&app.console);
 
-    return 0;
+    return status;
 }
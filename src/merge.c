@@ -0,0 +1,108 @@
+#include "merge.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Heap order: earlier timestamp, then earlier arrival
+static bool before(const LineMerge *merge, int a, int b) {
+    const MergeSource *sa = &merge->sources[a];
+    const MergeSource *sb = &merge->sources[b];
+    if (sa->head_ts != sb->head_ts) {
+        return sa->head_ts < sb->head_ts;
+    }
+    return sa->head_seq < sb->head_seq;
+}
+
+static void sift_up(LineMerge *merge, int i) {
+    int *heap = merge->heap;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!before(merge, heap[i], heap[parent])) {
+            break;
+        }
+        int tmp = heap[i];
+        heap[i] = heap[parent];
+        heap[parent] = tmp;
+        i = parent;
+    }
+}
+
+static void sift_down(LineMerge *merge, int i) {
+    int *heap = merge->heap;
+    for (;;) {
+        int least = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+        if (left < merge->heap_count && before(merge, heap[left], heap[least])) {
+            least = left;
+        }
+        if (right < merge->heap_count && before(merge, heap[right], heap[least])) {
+            least = right;
+        }
+        if (least == i) {
+            return;
+        }
+        int tmp = heap[i];
+        heap[i] = heap[least];
+        heap[least] = tmp;
+        i = least;
+    }
+}
+
+bool merge_init(LineMerge *merge, int source_count, unsigned window_ms) {
+    memset(merge, 0, sizeof(LineMerge));
+    merge->sources = (MergeSource *)calloc((size_t)source_count, sizeof(MergeSource));
+    merge->heap = (int *)calloc((size_t)source_count, sizeof(int));
+    if (!merge->sources || !merge->heap) {
+        merge_destroy(merge);
+        return false;
+    }
+    merge->source_count = source_count;
+    merge->window_ms = window_ms;
+    return true;
+}
+
+void merge_destroy(LineMerge *merge) {
+    free(merge->sources);
+    free(merge->heap);
+    memset(merge, 0, sizeof(LineMerge));
+}
+
+void merge_offer(LineMerge *merge, int source, bool has_ts, int64_t ts, uint64_t since_ms) {
+    MergeSource *src = &merge->sources[source];
+    src->head_ts = has_ts ? ts : src->last_ts;
+    src->head_seq = merge->next_seq++;
+    src->head_since = since_ms;
+    src->has_head = true;
+    if (src->head_ts > merge->newest_ts) {
+        merge->newest_ts = src->head_ts;
+    }
+
+    merge->heap[merge->heap_count] = source;
+    sift_up(merge, merge->heap_count++);
+}
+
+int merge_next(const LineMerge *merge, uint64_t now_ms) {
+    if (merge->heap_count == 0) {
+        return -1;
+    }
+    int source = merge->heap[0];
+    const MergeSource *src = &merge->sources[source];
+    if (merge->heap_count == merge->source_count || src->head_ts <= merge->newest_ts - (int64_t)merge->window_ms ||
+        now_ms - src->head_since >= merge->window_ms) {
+        return source;
+    }
+    return -1;
+}
+
+void merge_take(LineMerge *merge) {
+    MergeSource *src = &merge->sources[merge->heap[0]];
+    src->last_ts = src->head_ts;
+    src->has_head = false;
+
+    merge->heap[0] = merge->heap[--merge->heap_count];
+    sift_down(merge, 0);
+}
+
+bool merge_pending(const LineMerge *merge) {
+    return merge->heap_count > 0;
+}
@@ -0,0 +1,60 @@
+#ifndef MERGE_H
+#define MERGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define MERGE_WINDOW_MS 250     // Default reorder window
+
+// k-way merge of per-source line streams into timestamp order. The caller
+// offers each source's oldest pending line (its head) with its timestamp;
+// a heap keyed on (timestamp, arrival) says which head goes next.
+//
+// Each source's lines are taken to be in order already. The earliest head
+// is only let out once nothing earlier can still turn up: every source has
+// a head of its own, the head is at least window_ms older than the newest
+// timestamp seen, or it arrived window_ms ago. A writer running late by
+// less than the window still lands in order; a quiet source holds the rest
+// up by at most the window.
+typedef struct {
+    int64_t head_ts;            // Timestamp of the source's head
+    uint64_t head_seq;          // Arrival order of the head, for equal timestamps
+    uint64_t head_since;        // When the head arrived (ms)
+    int64_t last_ts;            // Timestamp of the source's last line, for lines without one
+    bool has_head;
+} MergeSource;
+
+typedef struct {
+    MergeSource *sources;
+    int *heap;                  // Sources with a head, earliest first
+    int heap_count;
+    int source_count;
+    uint64_t next_seq;
+    int64_t newest_ts;          // Latest head timestamp seen
+    unsigned window_ms;
+} LineMerge;
+
+// Set up a merge of source_count streams. Returns false if out of memory.
+bool merge_init(LineMerge *merge, int source_count, unsigned window_ms);
+
+// Free the heap
+void merge_destroy(LineMerge *merge);
+
+// Offer source's new head, stamped ts (or, with has_ts false, the same as
+// the source's previous line), which arrived at since_ms. The source must
+// have none. A line that was already waiting behind the last head arrived
+// no later than it did: pass its since_ms to let a backlog through at once.
+void merge_offer(LineMerge *merge, int source, bool has_ts, int64_t ts, uint64_t since_ms);
+
+// Source of the head to take next, or -1 if every head must wait. Taking it
+// is confirmed with merge_take.
+int merge_next(const LineMerge *merge, uint64_t now_ms);
+
+// Remove the head returned by merge_next
+void merge_take(LineMerge *merge);
+
+// True while some heads are waiting
+bool merge_pending(const LineMerge *merge);
+
+#endif // MERGE_H
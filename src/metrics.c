@@ -0,0 +1,204 @@
+#include "metrics.h"
+#include "pane.h"
+#include <stdio.h>
+#include <string.h>
+
+void metrics_read(PaneMetrics *metrics, size_t len) {
+    plat_atomic_store(&metrics->bytes_read, plat_atomic_load(&metrics->bytes_read) + len);
+}
+
+void metrics_lag(PaneMetrics *metrics, int64_t lag) {
+    plat_atomic_store(&metrics->lag_bytes, lag > 0 ? (size_t)lag : 0);
+}
+
+void metrics_taken(PaneMetrics *metrics, size_t lines) {
+    metrics->lines_read += lines;
+}
+
+void metrics_rendered(PaneMetrics *metrics, uint64_t us) {
+    metrics->render_us = us;
+    if (us > metrics->render_peak_us) {
+        metrics->render_peak_us = us;
+    }
+    metrics->frames++;
+}
+
+bool metrics_sample(PaneMetrics *metrics, uint64_t now_ms) {
+    uint64_t elapsed = now_ms - metrics->sample_ms;
+    if (elapsed < METRICS_INTERVAL_MS) {
+        return false;
+    }
+
+    // Counters wrap on 32-bit builds; the unsigned differences stay right
+    size_t bytes = plat_atomic_load(&metrics->bytes_read);
+    size_t lines = metrics->lines_read;
+    if (metrics->sample_ms != 0) {
+        metrics->bytes_per_sec = (size_t)((uint64_t)(bytes - metrics->sample_bytes) * 1000 / elapsed);
+        metrics->lines_per_sec = (size_t)((uint64_t)(lines - metrics->sample_lines) * 1000 / elapsed);
+    }
+    metrics->sample_ms = now_ms;
+    metrics->sample_bytes = bytes;
+    metrics->sample_lines = lines;
+    metrics->last_peak_us = metrics->render_peak_us;
+    metrics->render_peak_us = 0;
+    return true;
+}
+
+static void add_ingest(const TailPane *pane, MetricsIngest *ingest) {
+    const PaneMetrics *metrics = &pane->metrics;
+    ingest->bytes_read += plat_atomic_load(&metrics->bytes_read);
+    ingest->lines_read += metrics->lines_read;
+    ingest->lag_bytes += plat_atomic_load(&metrics->lag_bytes);
+    ingest->bytes_per_sec += metrics->bytes_per_sec;
+    ingest->lines_per_sec += metrics->lines_per_sec;
+}
+
+void metrics_ingest(const TailPane *pane, MetricsIngest *ingest) {
+    memset(ingest, 0, sizeof(MetricsIngest));
+    if (pane->sources) {
+        for (int i = 0; i < pane->source_count; i++) {
+            add_ingest(&pane->sources[i], ingest);
+        }
+    } else {
+        add_ingest(pane, ingest);
+    }
+}
+
+// One metric family: a value per file, or per pane on screen
+typedef struct {
+    const char *name;
+    const char *type;
+    const char *help;
+    double (*value)(const TailPane *pane);
+} MetricFamily;
+
+static double read_bytes(const TailPane *pane) {
+    return (double)plat_atomic_load(&pane->metrics.bytes_read);
+}
+
+static double read_lines(const TailPane *pane) {
+    return (double)pane->metrics.lines_read;
+}
+
+static double read_bytes_rate(const TailPane *pane) {
+    return (double)pane->metrics.bytes_per_sec;
+}
+
+static double read_lines_rate(const TailPane *pane) {
+    return (double)pane->metrics.lines_per_sec;
+}
+
+static double lag_bytes(const TailPane *pane) {
+    return (double)plat_atomic_load(&pane->metrics.lag_bytes);
+}
+
+static double scrollback_bytes(const TailPane *pane) {
+    return (double)linebuf_bytes(&pane->buffer);
+}
+
+static double scrollback_lines(const TailPane *pane) {
+    return (double)linebuf_count(&pane->buffer);
+}
+
+static double evicted_lines(const TailPane *pane) {
+    return (double)pane->buffer.first_seq;
+}
+
+static double allocations(const TailPane *pane) {
+    return (double)pane->buffer.allocations;
+}
+
+static double render_seconds(const TailPane *pane) {
+    return (double)pane->metrics.render_us / 1e6;
+}
+
+static double render_peak_seconds(const TailPane *pane) {
+    return (double)pane->metrics.last_peak_us / 1e6;
+}
+
+static double frames(const TailPane *pane) {
+    return (double)pane->metrics.frames;
+}
+
+static const MetricFamily file_families[] = {
+    {"multitail_read_bytes_total", "counter", "Bytes read from the file", read_bytes},
+    {"multitail_read_lines_total", "counter", "Lines read from the file", read_lines},
+    {"multitail_read_bytes_per_second", "gauge", "Bytes read per second over the last interval", read_bytes_rate},
+    {"multitail_read_lines_per_second", "gauge", "Lines read per second over the last interval", read_lines_rate},
+    {"multitail_lag_bytes", "gauge", "File size minus the read position", lag_bytes},
+};
+
+static const MetricFamily pane_families[] = {
+    {"multitail_scrollback_bytes", "gauge", "Memory held by the pane's scrollback", scrollback_bytes},
+    {"multitail_scrollback_lines", "gauge", "Lines in the pane's scrollback", scrollback_lines},
+    {"multitail_evicted_lines_total", "counter", "Lines dropped from the scrollback", evicted_lines},
+    {"multitail_allocations_total", "counter", "Heap allocations made for the scrollback", allocations},
+    {"multitail_render_seconds", "gauge", "Time the last render of the pane took", render_seconds},
+    {"multitail_render_peak_seconds", "gauge", "Slowest render of the pane over the last interval",
+     render_peak_seconds},
+    {"multitail_frames_total", "counter", "Renders of the pane", frames},
+};
+
+// Label value with backslashes, quotes and newlines escaped
+static void write_label(FILE *out, const char *text) {
+    for (const char *p = text; *p; p++) {
+        if (*p == '\\' || *p == '"') {
+            fputc('\\', out);
+            fputc(*p, out);
+        } else if (*p == '\n') {
+            fputs("\\n", out);
+        } else {
+            fputc(*p, out);
+        }
+    }
+}
+
+static void write_families(FILE *out, const MetricFamily *families, size_t family_count, const char *label,
+                           const TailPane *panes, int pane_count) {
+    for (size_t f = 0; f < family_count; f++) {
+        const MetricFamily *family = &families[f];
+        fprintf(out, "# HELP %s %s\n# TYPE %s %s\n", family->name, family->help, family->name, family->type);
+        for (int i = 0; i < pane_count; i++) {
+            fprintf(out, "%s{%s=\"", family->name, label);
+            write_label(out, panes[i].filepath);
+            fprintf(out, "\"} %.15g\n", family->value(&panes[i]));
+        }
+    }
+}
+
+bool metrics_write_file(const char *path, const TailPane *files, int file_count, const TailPane *panes,
+                        int pane_count) {
+    size_t len = strlen(path);
+    char temp[4096];
+    if (len + 5 > sizeof(temp)) {
+        return false;
+    }
+    memcpy(temp, path, len);
+    memcpy(temp + len, ".tmp", 5);
+
+    FILE *out = fopen(temp, "w");
+    if (!out) {
+        return false;
+    }
+
+    write_families(out, file_families, sizeof(file_families) / sizeof(file_families[0]), "file", files,
+                   file_count);
+    write_families(out, pane_families, sizeof(pane_families) / sizeof(pane_families[0]), "pane", panes,
+                   pane_count);
+
+    const LineBudget *budget = pane_count > 0 ? panes[0].buffer.budget : NULL;
+    if (budget) {
+        fprintf(out, "# HELP multitail_budget_bytes Scrollback memory budget shared by all panes\n"
+                     "# TYPE multitail_budget_bytes gauge\nmultitail_budget_bytes %zu\n", budget->limit);
+        fprintf(out, "# HELP multitail_budget_used_bytes Scrollback memory in use\n"
+                     "# TYPE multitail_budget_used_bytes gauge\nmultitail_budget_used_bytes %zu\n", budget->used);
+    }
+
+    bool ok = !ferror(out);
+    ok = fclose(out) == 0 && ok;
+    if (!ok || !plat_rename_over(temp, path)) {
+        remove(temp);
+        return false;
+    }
+    return true;
+}
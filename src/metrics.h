@@ -0,0 +1,71 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define METRICS_INTERVAL_MS 1000    // Rates are averaged over (and the stats file rewritten) this often
+
+struct TailPane;
+
+// Counters kept per pane, cheap enough to leave on all the time. The
+// reading side is stored by the pool thread servicing the pane (one writer
+// at a time, so plain load and store suffice) and read by the UI thread.
+typedef struct {
+    // Reader side
+    volatile size_t bytes_read;     // Bytes read from the file (decoded, for archives)
+    volatile size_t lag_bytes;      // File size minus read position, as of the last read
+
+    // UI thread side
+    size_t lines_read;              // Lines taken from the queue (the reader hands them over in blocks)
+    uint64_t render_us;             // Time the last render took
+    uint64_t render_peak_us;        // Slowest render in the current interval
+    size_t frames;                  // Renders so far
+
+    // Rates over the last whole interval (UI thread)
+    uint64_t sample_ms;
+    size_t sample_bytes;
+    size_t sample_lines;
+    size_t bytes_per_sec;
+    size_t lines_per_sec;
+    uint64_t last_peak_us;          // Slowest render in the last interval
+} PaneMetrics;
+
+// Ingest figures of a pane: its own, or its sources' summed for a
+// multiplexed view
+typedef struct {
+    size_t bytes_read;
+    size_t lines_read;
+    size_t lag_bytes;
+    size_t bytes_per_sec;
+    size_t lines_per_sec;
+} MetricsIngest;
+
+// Reader: count len bytes read
+void metrics_read(PaneMetrics *metrics, size_t len);
+
+// Reader: how far the read position is behind the end of the file
+void metrics_lag(PaneMetrics *metrics, int64_t lag);
+
+// UI: count lines taken from the queue
+void metrics_taken(PaneMetrics *metrics, size_t lines);
+
+// UI: count a render that took us microseconds
+void metrics_rendered(PaneMetrics *metrics, uint64_t us);
+
+// UI: close the interval if METRICS_INTERVAL_MS have passed, updating the
+// rates. Returns true if it did.
+bool metrics_sample(PaneMetrics *metrics, uint64_t now_ms);
+
+// Sum up a pane's ingest
+void metrics_ingest(const struct TailPane *pane, MetricsIngest *ingest);
+
+// Rewrite path with the metrics of every file and every pane on screen, in
+// the Prometheus text format (for node_exporter's textfile collector and
+// the like). Written to a temporary file first, so readers never see half
+// of it. Returns false if it could not be written.
+bool metrics_write_file(const char *path, const struct TailPane *files, int file_count,
+                        const struct TailPane *panes, int pane_count);
+
+#endif // METRICS_H
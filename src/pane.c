@@ -2,49 +2,325 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include "linescan.h"
+#include "timestamp.h"
+#include "utf8.h"
 
-static void process_read_data(TailPane *pane, const char *data, DWORD len);
+static char *copy_string(const char *text) {
+    size_t len = strlen(text);
+    char *copy = (char *)malloc(len + 1);
+    if (copy) {
+        memcpy(copy, text, len + 1);
+    }
+    return copy;
+}
 
-bool pane_init(TailPane *pane, const char *filepath) {
-    if (!pane || !filepath) {
-        return false;
+static const char *base_name(const char *path) {
+    const char *name = strrchr(path, '\\');
+    const char *slash = strrchr(path, '/');
+    if (!name || (slash && slash > name)) {
+        name = slash;
     }
+    return name ? name + 1 : path;
+}
 
-    memset(pane, 0, sizeof(TailPane));
-    strncpy(pane->filepath, filepath, MAX_PATH - 1);
-    pane->filepath[MAX_PATH - 1] = '\0';
+// Logical buffer index of a view row (SIZE_MAX past the end of a filtered view)
+static size_t row_line(const TailPane *pane, size_t row) {
+    if (filter_active(&pane->filter)) {
+        return filter_line(&pane->filter, &pane->buffer, row);
+    }
+    return row;
+}
 
-    // Initialize line buffer
-    if (!linebuf_init(&pane->buffer, LINEBUF_DEFAULT_CAPACITY)) {
-        return false;
+// View row of a logical buffer line; the next row after it if the filter hides it
+static size_t line_row(const TailPane *pane, size_t line) {
+    if (filter_active(&pane->filter)) {
+        return filter_row_of(&pane->filter, &pane->buffer, line);
     }
+    return line;
+}
 
-    // Open file for reading with share permissions
-    pane->file_handle = CreateFileA(
-        filepath,
-        GENERIC_READ,
-        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
-        NULL,
-        OPEN_EXISTING,
-        FILE_ATTRIBUTE_NORMAL,
-        NULL
-    );
+static bool wrapping(const TailPane *pane) {
+    return pane->wrap && pane->layout.width > 0;
+}
 
-    if (pane->file_handle == INVALID_HANDLE_VALUE) {
-        linebuf_destroy(&pane->buffer);
+// The fields of a line shown as columns, or NULL if it is shown as it is
+static const JsonEntry *json_columns(const TailPane *pane, size_t line) {
+    if (!pane->json_view || line >= pane->buffer.count) {
+        return NULL;
+    }
+    return json_find(&pane->json, pane->buffer.first_seq + line);
+}
+
+// Screen rows a view row takes (1 unless wrapping; columns are never wrapped)
+static size_t row_height(TailPane *pane, size_t row) {
+    if (!wrapping(pane)) {
+        return 1;
+    }
+    size_t line = row_line(pane, row);
+    if (json_columns(pane, line)) {
+        return 1;
+    }
+    return layout_rows(&pane->layout, &pane->buffer, line);
+}
+
+// Where the view starts when it ends with the last row: only the lines on
+// screen are measured
+static void end_position(TailPane *pane, size_t *row, size_t *sub) {
+    size_t line_count = pane_line_count(pane);
+    *sub = 0;
+    if (!wrapping(pane) || pane->content_height <= 0) {
+        *row = line_count > (size_t)pane->content_height ? line_count - pane->content_height : 0;
+        return;
+    }
+
+    size_t left = (size_t)pane->content_height;
+    for (size_t r = line_count; r > 0; r--) {
+        size_t rows = row_height(pane, r - 1);
+        if (rows >= left) {
+            *row = r - 1;
+            *sub = rows - left;
+            return;
+        }
+        left -= rows;
+    }
+    *row = 0;
+}
+
+// True if the view is at (or past) the end position
+static bool at_end(TailPane *pane) {
+    size_t row;
+    size_t sub;
+    end_position(pane, &row, &sub);
+    return pane->view_line > row || (pane->view_line == row && pane->view_sub >= sub);
+}
+
+static void move_to_end(TailPane *pane) {
+    end_position(pane, &pane->view_line, &pane->view_sub);
+}
+
+// Move the view up by count screen rows, stopping at the top
+static void step_up(TailPane *pane, size_t count) {
+    if (!wrapping(pane)) {
+        pane->view_line = pane->view_line > count ? pane->view_line - count : 0;
+        pane->view_sub = 0;
+        return;
+    }
+
+    while (count > pane->view_sub && pane->view_line > 0) {
+        count -= pane->view_sub + 1;
+        pane->view_line--;
+        pane->view_sub = row_height(pane, pane->view_line) - 1;
+    }
+    pane->view_sub = count < pane->view_sub ? pane->view_sub - count : 0;
+}
+
+// Move the view down by count screen rows (the caller stops it at the end)
+static void step_down(TailPane *pane, size_t count) {
+    if (!wrapping(pane)) {
+        pane->view_line += count;
+        return;
+    }
+
+    size_t line_count = pane_line_count(pane);
+    while (count > 0 && pane->view_line < line_count) {
+        size_t rest = row_height(pane, pane->view_line) - pane->view_sub;
+        if (count < rest) {
+            pane->view_sub += count;
+            return;
+        }
+        count -= rest;
+        pane->view_line++;
+        pane->view_sub = 0;
+    }
+}
+
+// True if the first screen row of a view row is on screen
+static bool row_visible(TailPane *pane, size_t row) {
+    if (row < pane->view_line) {
         return false;
     }
+    if (!wrapping(pane)) {
+        return row < pane->view_line + (size_t)pane->content_height;
+    }
+
+    size_t used = 0;
+    for (size_t r = pane->view_line; r < row; r++) {
+        used += row_height(pane, r) - (r == pane->view_line ? pane->view_sub : 0);
+        if (used >= (size_t)pane->content_height) {
+            return false;
+        }
+    }
+    return used < (size_t)pane->content_height;
+}
 
-    pane->read_pos = 0;
+static void init_display(TailPane *pane) {
     pane->following = true;
     pane->view_line = 0;
-    pane->partial_line = NULL;
-    pane->partial_len = 0;
     pane->top_row = 0;
     pane->height = 1;
     pane->content_height = 0;
     pane->dirty = true;
+}
+
+bool pane_init(TailPane *pane, const char *filepath, uint32_t source_id, TailPane *sink, LineBudget *budget) {
+    if (!pane || !filepath) {
+        return false;
+    }
+
+    memset(pane, 0, sizeof(TailPane));
+    pane->source_id = source_id;
+    pane->sink = sink;
+    pane->file_handle = PLAT_INVALID_HANDLE;
+
+    // Make sure the file can be opened; the reader pool opens it for real
+    PlatHandle probe = plat_file_open(filepath);
+    if (probe == PLAT_INVALID_HANDLE) {
+        return false;
+    }
+    plat_file_close(probe);
+
+    pane->filepath = copy_string(filepath);
+    if (!pane->filepath) {
+        return false;
+    }
+
+    // Files feeding a multiplexed view share its scrollback and get a small queue
+    size_t queue_size = LINEQUEUE_DEFAULT_SIZE;
+    if (sink) {
+        queue_size = PANE_MUX_QUEUE_SIZE;
+        budget = sink->buffer.budget;
+    } else {
+        if (!linebuf_init(&pane->buffer, budget)) {
+            free(pane->filepath);
+            pane->filepath = NULL;
+            return false;
+        }
+        filter_init(&pane->filter);
+        search_index_init(&pane->search_index);
+        highlight_init(&pane->highlights, NULL);
+        json_init(&pane->json, NULL);
+        layout_init(&pane->layout);
+    }
+    pane->initial_bytes = budget ? budget->limit : SIZE_MAX;
+
+    // Hand-off to the UI thread
+    if (!linequeue_init(&pane->queue, queue_size)) {
+        linebuf_destroy(&pane->buffer);
+        free(pane->filepath);
+        pane->filepath = NULL;
+        return false;
+    }
+
+    init_display(pane);
+    return true;
+}
+
+bool pane_reference_file(TailPane *pane) {
+    if (!pane || pane->sink || !linebuf_set_file(&pane->buffer, pane->filepath)) {
+        return false;
+    }
+    if (pane->initial_bytes <= SIZE_MAX / PANE_REF_SCAN_FACTOR) {
+        pane->initial_bytes *= PANE_REF_SCAN_FACTOR;
+    } else {
+        pane->initial_bytes = SIZE_MAX;
+    }
+    return true;
+}
+
+bool pane_find_archives(TailPane *pane) {
+    static const char *const suffixes[] = {"", ".gz", ".zst"};
+    size_t path_size = strlen(pane->filepath) + 16;
+    char *path = (char *)malloc(path_size);
+    pane->archives = (char **)calloc(PANE_MAX_ARCHIVES, sizeof(char *));
+    if (!path || !pane->archives) {
+        free(path);
+        return false;
+    }
+
+    bool ok = true;
+    for (int n = 1; ok && n <= PANE_MAX_ARCHIVES; n++) {
+        bool found = false;
+        for (size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]) && !found; i++) {
+            snprintf(path, path_size, "%s.%d%s", pane->filepath, n, suffixes[i]);
+            PlatHandle probe = plat_file_open(path);
+            if (probe != PLAT_INVALID_HANDLE) {
+                plat_file_close(probe);
+                found = true;
+            }
+        }
+        if (!found) {
+            break;
+        }
+        pane->archives[pane->archive_count] = copy_string(path);
+        ok = pane->archives[pane->archive_count] != NULL;
+        pane->archive_count += ok;
+    }
+    free(path);
+    return ok;
+}
+
+bool pane_init_mux(TailPane *pane, TailPane *sources, int source_count, LineBudget *budget) {
+    if (!pane || !sources || source_count <= 0) {
+        return false;
+    }
+
+    memset(pane, 0, sizeof(TailPane));
+    pane->file_handle = PLAT_INVALID_HANDLE;
+    pane->sources = sources;
+    pane->source_count = source_count;
+
+    char label[64];
+    snprintf(label, sizeof(label), "%d files", source_count);
+    pane->filepath = copy_string(label);
+    if (!pane->filepath) {
+        return false;
+    }
+
+    if (!linebuf_init(&pane->buffer, budget)) {
+        free(pane->filepath);
+        pane->filepath = NULL;
+        return false;
+    }
+    filter_init(&pane->filter);
+    search_index_init(&pane->search_index);
+    highlight_init(&pane->highlights, NULL);
+    json_init(&pane->json, NULL);
+    layout_init(&pane->layout);
+
+    init_display(pane);
+    return true;
+}
+
+bool pane_order_by_time(TailPane *pane, unsigned window_ms) {
+    if (!pane || !pane->sources) {
+        return false;
+    }
+    pane->year = timestamp_current_year();
+    return merge_init(&pane->merge, pane->source_count, window_ms);
+}
+
+void pane_set_highlights(TailPane *pane, HighlightRules *rules) {
+    if (pane && !pane->sink) {
+        pane->highlights.rules = rules;
+    }
+}
+
+void pane_set_json(TailPane *pane, const JsonFields *fields) {
+    if (pane && !pane->sink) {
+        pane->json.fields = fields;
+        pane->json_view = fields != NULL;
+    }
+}
 
+bool pane_set_json_view(TailPane *pane, bool on) {
+    if (!pane || !pane->json.fields) {
+        return false;
+    }
+    pane->json_view = on;
+    pane->view_sub = 0;
+    pane->scroll_col = 0;
+    pane->dirty = true;
     return true;
 }
 
@@ -53,165 +329,599 @@ void pane_destroy(TailPane *pane) {
         return;
     }
 
-    if (pane->file_handle != INVALID_HANDLE_VALUE) {
-        CloseHandle(pane->file_handle);
-        pane->file_handle = INVALID_HANDLE_VALUE;
+    if (pane->file_handle != PLAT_INVALID_HANDLE) {
+        plat_file_close(pane->file_handle);
+        pane->file_handle = PLAT_INVALID_HANDLE;
     }
 
+    linequeue_destroy(&pane->queue);
+    merge_destroy(&pane->merge);
+    filter_destroy(&pane->filter);
+    pattern_free(&pane->search);
+    search_index_destroy(&pane->search_index);
+    highlight_destroy(&pane->highlights);
+    json_destroy(&pane->json);
+    free(pane->json_text);
+    pane->json_text = NULL;
+    pane->json_cap = 0;
+    layout_destroy(&pane->layout);
     linebuf_destroy(&pane->buffer);
     free(pane->partial_line);
     pane->partial_line = NULL;
+    pane->partial_len = 0;
+    pane->partial_cap = 0;
+    free(pane->filepath);
+    pane->filepath = NULL;
+    for (size_t i = 0; i < pane->archive_count; i++) {
+        free(pane->archives[i]);
+    }
+    free(pane->archives);
+    pane->archives = NULL;
+    pane->archive_count = 0;
 }
 
-void pane_update(TailPane *pane) {
-    if (!pane || pane->file_handle == INVALID_HANDLE_VALUE) {
-        return;
+// Move one queued record into target's scrollback
+static void take_record(TailPane *target, const LineRecord *record, uint32_t source_id) {
+    bool pushed;
+    if (record->kind == LINEQUEUE_LINE) {
+        pushed = linebuf_push_at(&target->buffer, record->text, record->length, source_id, record->offset);
+    } else {
+        // The file starts over: keep the scrollback and mark where
+        const char *marker = record->kind == LINEQUEUE_ROTATED ? PANE_ROTATED_MARKER : PANE_TRUNCATED_MARKER;
+        PlatFileId id;
+        bool replaced = record->kind == LINEQUEUE_ROTATED && record->length == sizeof(PlatFileId);
+        if (replaced) {
+            memcpy(&id, record->text, sizeof(id));
+        }
+        linebuf_file_changed(&target->buffer, replaced ? &id : NULL);
+        pushed = linebuf_push_source(&target->buffer, marker, strlen(marker), source_id);
+    }
+    if (pushed) {
+        filter_line_added(&target->filter, &target->buffer);
+        search_index_add(&target->search_index, &target->buffer);
+        highlight_line_added(&target->highlights, &target->buffer);
+        json_line_added(&target->json, &target->buffer);
     }
+}
 
-    // Get current file size
-    LARGE_INTEGER file_size;
-    if (!GetFileSizeEx(pane->file_handle, &file_size)) {
-        return;
+static void lines_taken(TailPane *target) {
+    pane_trim(target);     // A file starting over may have dropped lines
+    filter_trim(&target->filter, &target->buffer);
+    target->dirty = true;
+}
+
+// Look at the next line in a pane's queue: record is the oldest record and
+// line the part of it that is the line. A block record holds several; the
+// line spans its text up to the next terminator.
+static bool next_line(TailPane *pane, LineRecord *record, LineRecord *line) {
+    if (!linequeue_peek(&pane->queue, record)) {
+        return false;
     }
+    *line = *record;
+    if (record->kind == LINEQUEUE_BLOCK) {
+        size_t pos = pane->block_pos;
+        line->kind = LINEQUEUE_LINE;
+        line->text = record->text + pos;
+        line->length = (uint32_t)linescan_find_eol(line->text, record->length - pos);
+        line->offset = record->offset + (int64_t)pos;
+    }
+    return true;
+}
 
-    // Check if file was truncated
-    if (file_size.QuadPart < pane->read_pos) {
-        pane->read_pos = 0;
-        linebuf_clear(&pane->buffer);
-        free(pane->partial_line);
-        pane->partial_line = NULL;
-        pane->partial_len = 0;
-        pane->view_line = 0;
-        pane->dirty = true;
+// Move past the line from next_line, releasing its record after the last one
+static void line_done(TailPane *pane, const LineRecord *record, const LineRecord *line) {
+    if (record->kind == LINEQUEUE_BLOCK) {
+        const char *text = record->text;
+        size_t next = (size_t)(line->text - text) + line->length + 1;
+        if (text[next - 1] == '\r' && next < record->length && text[next] == '\n') {
+            next++;
+        }
+        if (next < record->length) {
+            pane->block_pos = next;
+            return;
+        }
+        pane->block_pos = 0;
     }
+    linequeue_pop(&pane->queue, record);
+}
 
-    // Check if there's new content
-    if (file_size.QuadPart <= pane->read_pos) {
-        return;
+size_t pane_drain(TailPane *pane, size_t max_bytes) {
+    if (!pane || !pane->queue.data) {
+        return 0;
     }
 
-    // Seek to read position
-    LARGE_INTEGER pos;
-    pos.QuadPart = pane->read_pos;
-    if (!SetFilePointerEx(pane->file_handle, pos, NULL, FILE_BEGIN)) {
-        return;
+    // Lines from a file feeding a multiplexed view land in the view's buffer
+    TailPane *target = pane->sink ? pane->sink : pane;
+    plat_atomic_store(&pane->follow_tail, target->following);
+
+    // A time-ordered view pulls its sources' lines itself
+    if (target->merge.sources) {
+        return 0;
     }
 
-    // Read new content
-    char read_buf[READ_BUFFER_SIZE];
-    DWORD bytes_read;
+    size_t consumed = 0;
+    size_t lines = 0;
+    LineRecord record;
+    LineRecord line;
+    while (consumed < max_bytes && next_line(pane, &record, &line)) {
+        take_record(target, &line, pane->source_id);
+        consumed += line.length + 1;
+        if (line.kind == LINEQUEUE_LINE) {
+            lines++;
+        }
+        line_done(pane, &record, &line);
+    }
 
-    while (pane->read_pos < file_size.QuadPart) {
-        if (!ReadFile(pane->file_handle, read_buf, READ_BUFFER_SIZE, &bytes_read, NULL)) {
-            break;
+    if (consumed > 0) {
+        metrics_taken(&pane->metrics, lines);
+        lines_taken(target);
+    }
+
+    return consumed;
+}
+
+// Offer a source's oldest queued line to the merge, stamped when it is first seen
+static void offer_head(TailPane *pane, int source, uint64_t since) {
+    LineRecord record;
+    LineRecord line;
+    if (next_line(&pane->sources[source], &record, &line)) {
+        int64_t ts = 0;
+        bool has_ts = line.kind == LINEQUEUE_LINE && timestamp_parse(line.text, line.length, pane->year, &ts);
+        merge_offer(&pane->merge, source, has_ts, ts, since);
+    }
+}
+
+bool pane_drain_ordered(TailPane *pane, bool *holding) {
+    *holding = false;
+    if (!pane || !pane->merge.sources) {
+        return false;
+    }
+
+    LineMerge *merge = &pane->merge;
+    uint64_t now = plat_now_ms();
+    for (int i = 0; i < pane->source_count; i++) {
+        if (!merge->sources[i].has_head) {
+            offer_head(pane, i, now);
         }
-        if (bytes_read == 0) {
-            break;
+    }
+
+    // The same bound as draining each source on its own
+    size_t budget = (size_t)pane->source_count * PANE_MUX_QUEUE_SIZE;
+    size_t consumed = 0;
+    bool any = false;
+    LineRecord record;
+    LineRecord line;
+    int source;
+
+    while (consumed < budget && (source = merge_next(merge, now)) >= 0) {
+        TailPane *from = &pane->sources[source];
+        uint64_t since = merge->sources[source].head_since;
+        if (!next_line(from, &record, &line)) {
+            break;      // Offered heads stay queued, so not reached
+        }
+        take_record(pane, &line, from->source_id);
+        consumed += line.length + 1;
+        if (line.kind == LINEQUEUE_LINE) {
+            metrics_taken(&from->metrics, 1);
         }
+        line_done(from, &record, &line);
+        merge_take(merge);
+        offer_head(pane, source, since);     // Queued behind the one taken
+        any = true;
+    }
 
-        process_read_data(pane, read_buf, bytes_read);
-        pane->read_pos += bytes_read;
-        pane->dirty = true;
+    if (any) {
+        lines_taken(pane);
     }
+
+    *holding = merge_pending(merge);
+    return any;
 }
 
-static void process_read_data(TailPane *pane, const char *data, DWORD len) {
-    size_t start = 0;
+// The part of a line drawn on one row: shown bytes from skip
+typedef struct {
+    const char *text;
+    size_t skip;
+    size_t shown;
+    bool ascii;                 // Those bytes are all ASCII: a cell each
+} VisibleText;
 
-    for (size_t i = 0; i < len; i++) {
-        if (data[i] == '\n' || data[i] == '\r') {
-            size_t line_len = i - start;
+static void visible_text(VisibleText *vis, const LineEntry *entry, size_t skip, size_t width) {
+    vis->text = entry ? entry->text : NULL;
+    vis->skip = skip;
+    vis->shown = 0;
+    vis->ascii = true;
+    if (entry && entry->length > skip) {
+        const char *text = entry->text + skip;
+        size_t len = entry->length - skip;
+        size_t room = len < width ? len : width;
+        vis->shown = room;
+        if (linescan_find_non_ascii(text, room) != room) {
+            vis->shown = utf8_fit(text, len, width, NULL);
+            vis->ascii = false;
+        }
+    }
+}
 
-            // Build complete line
-            size_t total_len = pane->partial_len + line_len;
-            char *line = (char *)malloc(total_len + 1);
-            if (line) {
-                if (pane->partial_line && pane->partial_len > 0) {
-                    memcpy(line, pane->partial_line, pane->partial_len);
-                }
-                if (line_len > 0) {
-                    memcpy(line + pane->partial_len, data + start, line_len);
-                }
-                line[total_len] = '\0';
+// Cell (from the text column) where a byte of the line is drawn, clipped to the row
+static size_t visible_column(const VisibleText *vis, size_t byte) {
+    if (byte <= vis->skip) {
+        return 0;
+    }
+    size_t len = byte - vis->skip < vis->shown ? byte - vis->skip : vis->shown;
+    return vis->ascii ? len : utf8_width(vis->text + vis->skip, len);
+}
 
-                linebuf_push(&pane->buffer, line);
-                free(line);
-            }
+// Color the cells showing bytes start..end of a line drawn at (row, col)
+static void paint_bytes(Console *con, int row, int col, const VisibleText *vis, size_t start, size_t end,
+                        ConsoleAttr attr) {
+    size_t from = visible_column(vis, start);
+    size_t to = visible_column(vis, end);
+    if (to > from) {
+        console_set_attr(con, row, col + (int)from, (int)(to - from), attr);
+    }
+}
 
-            // Clear partial line
-            free(pane->partial_line);
-            pane->partial_line = NULL;
-            pane->partial_len = 0;
+// Highlight search matches in the visible part of a line drawn at (row, col)
+static void highlight_matches(TailPane *pane, Console *con, int row, int col, const LineEntry *entry,
+                              const VisibleText *vis, bool current) {
+    size_t limit = vis->skip + vis->shown;
+    ConsoleAttr attr = current ? COLOR_MATCH_CURRENT : COLOR_MATCH;
+    size_t pos = 0;
 
-            // Skip \r\n sequence
-            if (data[i] == '\r' && i + 1 < len && data[i + 1] == '\n') {
-                i++;
-            }
-            start = i + 1;
+    while (pos < limit && pos <= entry->length) {
+        size_t start;
+        size_t end;
+        if (!pattern_find(&pane->search, entry->text + pos, entry->length - pos, &start, &end)) {
+            break;
+        }
+        start += pos;
+        end += pos;
+        if (start >= limit) {
+            break;
+        }
+
+        paint_bytes(con, row, col, vis, start, end, attr);
+        if (pane->search.anchored) {
+            break;      // ^ would match again at every restart
         }
+        pos = end > start ? end : start + 1;
     }
+}
 
-    // Handle remaining partial line
-    if (start < len) {
-        size_t remaining = len - start;
-        size_t new_len = pane->partial_len + remaining;
-        char *new_partial = (char *)realloc(pane->partial_line, new_len + 1);
-        if (new_partial) {
-            memcpy(new_partial + pane->partial_len, data + start, remaining);
-            new_partial[new_len] = '\0';
-            pane->partial_line = new_partial;
-            pane->partial_len = new_len;
+// Lay a JSON line out as columns in the pane's scratch text, as the line
+// shown instead. Returns false (shown as it is) if out of memory.
+static bool lay_out_columns(TailPane *pane, const JsonEntry *fields, const LineEntry *line, LineEntry *shown) {
+    size_t size = json_format_size(&pane->json, line->length);
+    if (size > pane->json_cap) {
+        char *text = (char *)realloc(pane->json_text, size);
+        if (!text) {
+            return false;
         }
+        pane->json_text = text;
+        pane->json_cap = size;
     }
+
+    *shown = *line;
+    shown->text = pane->json_text;
+    shown->length = (uint32_t)json_format(&pane->json, fields, line->text, line->length, pane->json_text);
+    return true;
 }
 
 void pane_render(TailPane *pane, Console *con, bool is_active) {
     if (!pane || !con) {
         return;
     }
+    uint64_t started = plat_now_us();
 
-    // Render header
+    // Render header: name, filters, active marker
     char header[256];
-    const char *basename = strrchr(pane->filepath, '\\');
-    if (!basename) {
-        basename = strrchr(pane->filepath, '/');
-    }
-    basename = basename ? basename + 1 : pane->filepath;
+    const char *basename = base_name(pane->filepath);
+    const LineFilter *filter = &pane->filter;
 
-    snprintf(header, sizeof(header), " [%s]%s", basename, is_active ? " *" : "");
+    int len = snprintf(header, sizeof(header), " [%.120s]", basename);
+    if (filter->include.source) {
+        len += snprintf(header + len, sizeof(header) - len, filter->include.regex ? " +/%.50s/" : " +%.50s",
+            filter->include.source);
+    }
+    if (filter->exclude.source) {
+        len += snprintf(header + len, sizeof(header) - len, filter->exclude.regex ? " -/%.50s/" : " -%.50s",
+            filter->exclude.source);
+    }
+    if (pane->json_view) {
+        len += snprintf(header + len, sizeof(header) - len, " (json)");
+    }
+    if (pane->wrap) {
+        len += snprintf(header + len, sizeof(header) - len, " (wrap)");
+    } else if (pane->scroll_col > 0) {
+        len += snprintf(header + len, sizeof(header) - len, " (from col %zu)", pane->scroll_col + 1);
+    }
+    snprintf(header + len, sizeof(header) - len, "%s%s",
+        filter->rescanning ? " (filtering)" : "", is_active ? " *" : "");
 
-    WORD header_attr = is_active ? COLOR_HEADER_ACTIVE : COLOR_HEADER;
+    ConsoleAttr header_attr = is_active ? COLOR_HEADER_ACTIVE : COLOR_HEADER;
     console_fill_row(con, pane->top_row, ' ', header_attr);
     console_write_at(con, pane->top_row, 0, header, header_attr);
 
-    // Calculate view position for following mode
-    size_t line_count = linebuf_count(&pane->buffer);
-    if (pane->following && line_count > 0) {
-        if (line_count > (size_t)pane->content_height) {
-            pane->view_line = line_count - pane->content_height;
-        } else {
-            pane->view_line = 0;
+    // Multiplexed view: size the source tag column once all names are known
+    if (pane->sources && pane->tag_width == 0) {
+        for (int i = 0; i < pane->source_count; i++) {
+            const char *name = base_name(pane->sources[i].filepath);
+            int len = (int)utf8_width(name, strlen(name));
+            if (len > pane->tag_width) {
+                pane->tag_width = len;
+            }
         }
+        if (pane->tag_width > PANE_TAG_MAX_WIDTH) {
+            pane->tag_width = PANE_TAG_MAX_WIDTH;
+        }
+    }
+    int text_col = pane->sources ? pane->tag_width + 1 : 0;
+    if (text_col >= con->width) {
+        text_col = 0;
     }
 
+    // Lines wrap at the text width; after a resize only the lines measured
+    // from here on are measured again
+    layout_set_width(&pane->layout, (size_t)(con->width - text_col));
+    if (pane->following) {
+        move_to_end(pane);
+    } else if (pane->view_sub > 0 && pane->view_sub >= row_height(pane, pane->view_line)) {
+        pane->view_sub = row_height(pane, pane->view_line) - 1;    // Fewer rows at a new width
+    }
+    size_t width = (size_t)(con->width - text_col);
+
     // Render content lines
+    size_t row = pane->view_line;
+    size_t sub = wrapping(pane) ? pane->view_sub : 0;
+    size_t skip = 0;            // Bytes of the line before this row
+    pane->widest = 0;
     for (int i = 0; i < pane->content_height; i++) {
         int console_row = pane->top_row + 1 + i;
-        size_t line_index = pane->view_line + i;
+        size_t line_index = row_line(pane, row);
+
+        const LineEntry *line = linebuf_entry(&pane->buffer, line_index);
+        const JsonEntry *fields = line ? json_columns(pane, line_index) : NULL;
+        LineEntry columns;
+        if (fields && lay_out_columns(pane, fields, line, &columns)) {
+            line = &columns;        // Drawn, scrolled and searched like any line, never wrapped
+        } else {
+            fields = NULL;
+        }
+        size_t rows = 1;
+        if (line && wrapping(pane) && !fields) {
+            rows = layout_rows(&pane->layout, &pane->buffer, line_index);
+            if (i == 0) {
+                skip = layout_row_offset(&pane->layout, line->text, line->length, sub);
+            }
+        } else if (line) {
+            skip = pane->scroll_col > 0 ? utf8_fit(line->text, line->length, pane->scroll_col, NULL) : 0;
+        }
+        if (line && line->length > pane->widest) {
+            pane->widest = line->length;
+        }
+        VisibleText vis;
+        visible_text(&vis, line, skip, width);
+
+        if (text_col > 0) {
+            const char *tag = NULL;
+            if (line && sub == 0 && line->source < (uint32_t)pane->source_count) {
+                tag = base_name(pane->sources[line->source].filepath);
+            }
+            console_write_fixed(con, console_row, 0, tag, text_col - 1, COLOR_SOURCE_TAG);
+            console_write_fixed(con, console_row, text_col - 1, NULL, 1, COLOR_DEFAULT);
+        }
+        uint64_t seq = pane->buffer.first_seq + line_index;
+        const HighlightRun *runs = NULL;
+        const HighlightEntry *colors = line ? highlight_find(&pane->highlights, seq, &runs) : NULL;
+        console_write_span(con, console_row, text_col, vis.shown ? line->text + skip : NULL, vis.shown,
+                           (int)width, colors ? colors->line_attr : COLOR_DEFAULT);
+        for (size_t r = 0; colors && !fields && r < colors->run_count; r++) {
+            paint_bytes(con, console_row, text_col, &vis, runs[r].start, runs[r].end, runs[r].attr);
+        }
+
+        if (line && pane->search.source) {
+            bool current = pane->has_match && pane->match_seq == seq;
+            highlight_matches(pane, con, console_row, text_col, line, &vis, current);
+        }
 
-        const char *line = linebuf_get(&pane->buffer, line_index);
-        console_write_fixed(con, console_row, 0, line, con->width, COLOR_DEFAULT);
+        // The next wrapped row carries on where this one stopped
+        if (++sub < rows) {
+            skip += layout_row_bytes(&pane->layout, line->text + skip, line->length - skip);
+        } else {
+            row++;
+            sub = 0;
+            skip = 0;
+        }
     }
+    pane->view_end = sub > 0 ? row + 1 : row;
 
     pane->dirty = false;
+    metrics_rendered(&pane->metrics, plat_now_us() - started);
+}
+
+void pane_trim(TailPane *pane) {
+    if (!pane || pane->sink || pane->buffer.first_seq == pane->trimmed_seq) {
+        return;
+    }
+
+    size_t dropped = (size_t)(pane->buffer.first_seq - pane->trimmed_seq);
+    if (filter_active(&pane->filter)) {
+        size_t before = filter_count(&pane->filter);
+        filter_trim(&pane->filter, &pane->buffer);
+        dropped = before - filter_count(&pane->filter);
+    }
+    highlight_trim(&pane->highlights, &pane->buffer);
+    json_trim(&pane->json, &pane->buffer);
+    pane->trimmed_seq = pane->buffer.first_seq;
+
+    if (!pane->following) {
+        if (pane->view_line < dropped) {
+            pane->view_sub = 0;
+        }
+        pane->view_line = pane->view_line > dropped ? pane->view_line - dropped : 0;
+    }
+    pane->dirty = true;
+}
+
+bool pane_set_filter(TailPane *pane, bool exclude, const char *text, char *error, size_t error_size) {
+    if (!pane || pane->sink) {
+        return false;
+    }
+    if (!filter_set(&pane->filter, exclude, text, &pane->buffer, error, error_size)) {
+        return false;
+    }
+
+    // Row numbers mean something else now - go back to the live end
+    pane_filter_step(pane);
+    pane_scroll_end(pane);
+    return true;
+}
+
+void pane_clear_filter(TailPane *pane) {
+    if (!pane) {
+        return;
+    }
+    filter_clear(&pane->filter);
+    pane_scroll_end(pane);
+}
+
+bool pane_filter_step(TailPane *pane) {
+    if (!pane || !pane->filter.rescanning) {
+        return false;
+    }
+
+    bool more = filter_rescan(&pane->filter, &pane->buffer, FILTER_RESCAN_BATCH);
+    pane->dirty = true;
+    return more;
+}
+
+// Bring a match into view: leave the view alone if it is already on screen,
+// otherwise show it about a third of the way down the pane
+static void jump_to_row(TailPane *pane, size_t row) {
+    pane->following = false;
+    pane->dirty = true;
+    if (row_visible(pane, row)) {
+        return;
+    }
+
+    pane->view_line = row;
+    pane->view_sub = 0;
+    step_up(pane, (size_t)(pane->content_height / 3));
+    if (at_end(pane)) {
+        move_to_end(pane);
+    }
+}
+
+static bool find_match(TailPane *pane, size_t from_row, bool backward, bool wrapped_already,
+                       char *message, size_t message_size) {
+    size_t row;
+    bool wrapped;
+    pane->dirty = true;
+
+    if (!search_find(&pane->search_index, &pane->buffer, &pane->filter, &pane->search,
+                     from_row, backward, &row, &wrapped)) {
+        char text[PATTERN_MAX_LENGTH + 3];
+        pattern_describe(&pane->search, text, sizeof(text));
+        snprintf(message, message_size, "Pattern not found: %s", text);
+        pane->has_match = false;
+        return false;
+    }
+
+    pane->match_seq = pane->buffer.first_seq + row_line(pane, row);
+    pane->has_match = true;
+    jump_to_row(pane, row);
+
+    if (wrapped || wrapped_already) {
+        snprintf(message, message_size, "%s", backward ? "Search hit top, continuing at bottom"
+                                                       : "Search hit bottom, continuing at top");
+    }
+    return true;
+}
+
+bool pane_search(TailPane *pane, const char *text, bool backward, char *message, size_t message_size) {
+    message[0] = '\0';
+    if (!pane || pane->sink || !text) {
+        return false;
+    }
+
+    if (text[0] == '\0') {
+        pattern_free(&pane->search);
+        pane->has_match = false;
+        pane->dirty = true;
+        return true;
+    }
+
+    Pattern compiled;
+    if (!pattern_compile_text(&compiled, text, message, message_size)) {
+        return false;
+    }
+    pattern_free(&pane->search);
+    pane->search = compiled;
+    pane->search_backward = backward;
+
+    // Start from what is on screen
+    size_t from = pane->view_line;
+    if (backward) {
+        from += pane->content_height > 0 ? (size_t)pane->content_height - 1 : 0;
+        size_t line_count = pane_line_count(pane);
+        if (from >= line_count) {
+            from = line_count > 0 ? line_count - 1 : 0;
+        }
+    }
+    find_match(pane, from, backward, false, message, message_size);
+    return true;
+}
+
+bool pane_search_next(TailPane *pane, bool reverse, char *message, size_t message_size) {
+    message[0] = '\0';
+    if (!pane || !pane->search.source) {
+        snprintf(message, message_size, "No previous search");
+        return false;
+    }
+
+    bool backward = pane->search_backward != reverse;
+    size_t line_count = pane_line_count(pane);
+    if (line_count == 0) {
+        return find_match(pane, 0, backward, false, message, message_size);
+    }
+
+    // Continue from the current match if it is still in the scrollback,
+    // otherwise from the top of the screen
+    size_t from = pane->view_line;
+    if (pane->has_match && pane->match_seq >= pane->buffer.first_seq) {
+        size_t line = (size_t)(pane->match_seq - pane->buffer.first_seq);
+        size_t row = line_row(pane, line);
+        bool exact = row < line_count && row_line(pane, row) == line;
+
+        if (!backward) {
+            from = exact ? row + 1 : row;
+        } else {
+            from = row > 0 ? row - 1 : line_count;  // line_count: wrap to the bottom
+        }
+    }
+
+    bool wrapped = false;
+    if (from >= line_count) {
+        from = backward ? line_count - 1 : 0;
+        wrapped = true;
+    }
+    return find_match(pane, from, backward, wrapped, message, message_size);
+}
+
+size_t pane_line_count(const TailPane *pane) {
+    if (filter_active(&pane->filter)) {
+        return filter_count(&pane->filter);
+    }
+    return linebuf_count(&pane->buffer);
 }
 
 bool pane_scroll_up(TailPane *pane) {
-    if (!pane || pane->view_line == 0) {
+    if (!pane || (pane->view_line == 0 && pane->view_sub == 0)) {
         return false;
     }
 
-    pane->view_line--;
+    step_up(pane, 1);
     pane->following = false;
     pane->dirty = true;
     return true;
@@ -222,19 +932,13 @@ bool pane_scroll_down(TailPane *pane) {
         return false;
     }
 
-    size_t line_count = linebuf_count(&pane->buffer);
-    size_t max_view = 0;
-    if (line_count > (size_t)pane->content_height) {
-        max_view = line_count - pane->content_height;
-    }
-
-    if (pane->view_line >= max_view) {
+    if (at_end(pane)) {
         // At the end - resume following
         pane->following = true;
         return false;
     }
 
-    pane->view_line++;
+    step_down(pane, 1);
     pane->dirty = true;
     return true;
 }
@@ -244,12 +948,7 @@ void pane_page_up(TailPane *pane) {
         return;
     }
 
-    int page = pane->content_height > 0 ? pane->content_height : 1;
-    if (pane->view_line >= (size_t)page) {
-        pane->view_line -= page;
-    } else {
-        pane->view_line = 0;
-    }
+    step_up(pane, pane->content_height > 0 ? (size_t)pane->content_height : 1);
     pane->following = false;
     pane->dirty = true;
 }
@@ -259,17 +958,9 @@ void pane_page_down(TailPane *pane) {
         return;
     }
 
-    size_t line_count = linebuf_count(&pane->buffer);
-    size_t max_view = 0;
-    if (line_count > (size_t)pane->content_height) {
-        max_view = line_count - pane->content_height;
-    }
-
-    int page = pane->content_height > 0 ? pane->content_height : 1;
-    pane->view_line += page;
-
-    if (pane->view_line >= max_view) {
-        pane->view_line = max_view;
+    step_down(pane, pane->content_height > 0 ? (size_t)pane->content_height : 1);
+    if (at_end(pane)) {
+        move_to_end(pane);
         pane->following = true;
     }
     pane->dirty = true;
@@ -280,6 +971,7 @@ void pane_scroll_home(TailPane *pane) {
         return;
     }
     pane->view_line = 0;
+    pane->view_sub = 0;
     pane->following = false;
     pane->dirty = true;
 }
@@ -289,13 +981,40 @@ void pane_scroll_end(TailPane *pane) {
         return;
     }
 
-    size_t line_count = linebuf_count(&pane->buffer);
-    if (line_count > (size_t)pane->content_height) {
-        pane->view_line = line_count - pane->content_height;
+    move_to_end(pane);
+    pane->following = true;
+    pane->dirty = true;
+}
+
+bool pane_scroll_side(TailPane *pane, bool right) {
+    if (!pane || pane->wrap) {
+        return false;
+    }
+
+    size_t width = pane->layout.width > 0 ? pane->layout.width : 80;
+    size_t step = width / 2 > 0 ? width / 2 : 1;
+    if (right) {
+        if (pane->scroll_col + width >= pane->widest) {
+            return false;       // The longest line on screen already ends in view
+        }
+        pane->scroll_col += step;
     } else {
-        pane->view_line = 0;
+        if (pane->scroll_col == 0) {
+            return false;
+        }
+        pane->scroll_col = pane->scroll_col > step ? pane->scroll_col - step : 0;
     }
-    pane->following = true;
+    pane->dirty = true;
+    return true;
+}
+
+void pane_set_wrap(TailPane *pane, bool wrap) {
+    if (!pane) {
+        return;
+    }
+    pane->wrap = wrap;
+    pane->view_sub = 0;
+    pane->scroll_col = 0;
     pane->dirty = true;
 }
 
@@ -2,24 +2,104 @@
 #define PANE_H
 
 #include <stdbool.h>
-#include <windows.h>
+#include <stdint.h>
+#include "platform.h"
 #include "linebuf.h"
+#include "linequeue.h"
 #include "console.h"
+#include "filter.h"
+#include "search.h"
+#include "highlight.h"
+#include "json.h"
+#include "layout.h"
+#include "merge.h"
+#include "metrics.h"
 
-#define MAX_PANES 8
 #define READ_BUFFER_SIZE 65536
-
-typedef struct {
-    char filepath[MAX_PATH];   // File being tailed
-    HANDLE file_handle;        // File handle for reading
-    LONGLONG read_pos;         // Current read position in file
-
-    LineBuffer buffer;         // Scrollback buffer
-    size_t view_line;          // Top line of current view (logical index)
-    bool following;            // True = auto-scroll to new content
-
-    char *partial_line;        // Incomplete line from last read
+#define TAIL_SCAN_VIEW_SIZE (16 * 1024 * 1024)  // Mapped window size for the startup scan
+#define PANE_MUX_QUEUE_SIZE (64 * 1024)         // Queue per file feeding a multiplexed view
+#define PANE_TAG_MAX_WIDTH 20                   // Widest source tag column in a multiplexed view
+#define PANE_TRUNCATED_MARKER "--- file truncated ---"   // Scrollback line where a file starts over
+#define PANE_ROTATED_MARKER "--- file rotated ---"       // ...or where a new file takes over
+#define PANE_MAX_ARCHIVES 100                   // Rotated copies looked for per file
+#define PANE_REF_SCAN_FACTOR 8                  // Startup scrollback multiplier when lines stay in the file
+#define PANE_MERGE_POLL_MS 20                   // Recheck rate while a time-ordered view holds lines back
+#define PANE_SKIP_MIN_BYTES (64 * 1024 * 1024)  // A following pane further behind than this (and its startup share) skips ahead
+#define PANE_SKIPPED_FORMAT "--- skipped %llu MB to catch up ---"   // Scrollback line where it did
+
+struct ReaderPool;
+
+// A pane either tails one file into its own scrollback, or (with sink set)
+// feeds a shared multiplexed view pane, which has sources instead of a file.
+//
+// Files are read by the reader pool (reader.h). Whichever pool thread is
+// servicing a pane owns its file handle, read position and partial-line
+// state; completed lines reach the UI thread through the lock-free queue.
+// The scrollback buffer, view and display fields belong to the UI thread.
+typedef struct TailPane {
+    char *filepath;            // File being tailed (label for a multiplexed view)
+    uint32_t source_id;        // Index of the file among all tailed files
+
+    // Reader side
+    PlatHandle file_handle;    // Open handle, or PLAT_INVALID_HANDLE while closed to save descriptors
+    int64_t read_pos;          // Current read position in file
+    PlatFileId file_id;        // Identity of the file being read (spots rotation across reopens)
+    size_t initial_bytes;      // Scrollback to load from the end of the file on first read
+    bool scanned;              // Startup scan done
+    bool compressed;           // The file is an archive: decoded once, not tailed
+    char **archives;           // Rotated copies loaded ahead of the file, newest first
+    size_t archive_count;
+    char *ring_tail;           // Incomplete line from last read, in the queue's free space past its last record
+    size_t ring_tail_len;      // Length of it (it ends at read_pos)
+    bool discarding;           // Dropping the rest of a line too long to queue
+    char *partial_line;        // Incomplete decoded line of an archive (reused across reads)
     size_t partial_len;        // Length of partial line
+    size_t partial_cap;        // Allocated size of partial_line
+    int64_t partial_offset;    // File offset where the partial line starts
+    bool pending_cr;           // Last read ended in '\r' (may pair with a leading '\n')
+
+    // Reader pool bookkeeping, guarded by the pool lock
+    bool queued;               // Waiting in the pool's work list
+    bool active;               // A pool thread is reading it right now
+    bool rekick;               // Kicked again while active
+    bool in_lru;               // On the pool's list of open, idle files
+    struct TailPane *lru_prev;
+    struct TailPane *lru_next;
+
+    // Hand-off between the threads
+    LineQueue queue;           // Completed lines, reader -> UI
+    PaneMetrics metrics;       // Ingest counters (reader) and render times (UI)
+    volatile size_t follow_tail;   // UI -> reader: the view follows the end, so a reader far behind may skip ahead
+
+    // UI thread side
+    struct TailPane *sink;     // Multiplexed view this pane feeds, or NULL
+    struct TailPane *sources;  // Multiplexed view: the panes feeding it
+    int source_count;
+    LineMerge merge;           // Time-ordered multiplexed view: the sources' next lines
+    int year;                  // Year for syslog timestamps in a time-ordered view
+    int tag_width;             // Width of the source tag column
+    LineBuffer buffer;         // Scrollback buffer (unused when sink is set)
+    LineFilter filter;         // Include/exclude filter and its line index
+    Pattern search;            // Current search (search.source is NULL when none)
+    SearchIndex search_index;  // Trigram summary of the scrollback for searches
+    LineHighlights highlights; // Colors the highlight rules gave the lines
+    LineJson json;             // Fields picked out of JSON lines
+    bool json_view;            // Show JSON lines as columns of their fields
+    char *json_text;           // A JSON line laid out as columns, while drawing it
+    size_t json_cap;
+    uint64_t match_seq;        // Line sequence number of the current match
+    bool has_match;
+    bool search_backward;      // Direction of the last / or ? search
+    size_t block_pos;          // Bytes of the queue's oldest record already taken (a block holds many lines)
+    size_t view_line;          // Top row of current view (line index, or filter index when filtered)
+    size_t view_sub;           // Wrapped rows of the top line scrolled past
+    size_t view_end;           // Row after the last one on screen at the last render
+    bool following;            // True = auto-scroll to new content
+    bool wrap;                 // Wrap long lines onto more rows instead of cutting them off
+    size_t scroll_col;         // Columns scrolled to the right (not wrapping)
+    size_t widest;             // Longest line on screen at the last render, in bytes (at least its columns)
+    LineLayout layout;         // Rows each line takes when wrapping
+    uint64_t trimmed_seq;      // buffer.first_seq when the view last caught up with evictions
 
     // Display region
     int top_row;               // Console row where pane starts
@@ -29,14 +109,84 @@ typedef struct {
     bool dirty;                // True if pane needs redraw
 } TailPane;
 
-// Initialize a pane for the given file path
-bool pane_init(TailPane *pane, const char *filepath);
-
-// Free pane resources
+// Initialize a pane for the given file path. The file is opened once to
+// check it is readable; the reader pool reopens it as needed. The scrollback
+// counts against budget. With sink set, lines go to that multiplexed view
+// instead (budget is unused). Startup loads up to the whole budget from the
+// end of the file; lower initial_bytes to give each file a share.
+bool pane_init(TailPane *pane, const char *filepath, uint32_t source_id, TailPane *sink, LineBudget *budget);
+
+// Keep old scrollback in the file instead of memory (linebuf_set_file), and
+// load PANE_REF_SCAN_FACTOR times more of it at startup. Call before the
+// reader starts; not for a file feeding a multiplexed view.
+bool pane_reference_file(TailPane *pane);
+
+// Look for the file's rotated copies (FILE.1, FILE.2.gz, FILE.3.zst, ...,
+// up to the first number with none) to load ahead of it at startup. Call
+// before the reader starts. Returns false if out of memory.
+bool pane_find_archives(TailPane *pane);
+
+// Initialize a multiplexed view fed by source_count panes starting at sources
+bool pane_init_mux(TailPane *pane, TailPane *sources, int source_count, LineBudget *budget);
+
+// Interleave a multiplexed view's lines by the timestamps they start with
+// (see timestamp.h) instead of by arrival, holding each back up to
+// window_ms for an earlier one from another file. The view then pulls its
+// sources' lines with pane_drain_ordered. Returns false if out of memory.
+bool pane_order_by_time(TailPane *pane, unsigned window_ms);
+
+// Color lines by rules as they arrive (NULL for none). Call before the
+// reader starts; not for a file feeding a multiplexed view.
+void pane_set_highlights(TailPane *pane, HighlightRules *rules);
+
+// Pick fields out of JSON lines as they arrive and show them as columns
+// (NULL for none). Call before the reader starts; not for a file feeding a
+// multiplexed view.
+void pane_set_json(TailPane *pane, const JsonFields *fields);
+
+// Show JSON lines as columns or as they are (only when the pane picks
+// fields out). Returns false if it does not.
+bool pane_set_json_view(TailPane *pane, bool on);
+
+// Free pane resources. The reader pool must already be stopped.
 void pane_destroy(TailPane *pane);
 
-// Check file for new content and read it into buffer
-void pane_update(TailPane *pane);
+// Move queued lines into the scrollback buffer (UI thread), stopping once
+// about max_bytes of line text are taken. Returns the bytes taken (0 if none
+// arrived).
+size_t pane_drain(TailPane *pane, size_t max_bytes);
+
+// Merge the sources' queued lines into a time-ordered view (UI thread).
+// Returns true if any arrived; holding says some are still held back, to
+// be retried within PANE_MERGE_POLL_MS.
+bool pane_drain_ordered(TailPane *pane, bool *holding);
+
+// Catch up after linebudget_trim evicted old lines: drop them from the
+// filter index and keep a scrolled view on the lines it showed
+void pane_trim(TailPane *pane);
+
+// Set the include (or exclude) filter; see filter_set for the syntax.
+// Returns false with a reason in error if the pattern does not compile.
+bool pane_set_filter(TailPane *pane, bool exclude, const char *text, char *error, size_t error_size);
+
+// Remove both filters
+void pane_clear_filter(TailPane *pane);
+
+// Advance a rescan after a filter change. Returns true while one is running.
+bool pane_filter_step(TailPane *pane);
+
+// Search the view from the top (bottom, when backward) visible row and
+// jump to the first match. Empty text clears the search. Returns false with
+// the reason in message if the pattern is bad; otherwise message notes a
+// miss or a wrap around the end (empty when neither).
+bool pane_search(TailPane *pane, const char *text, bool backward, char *message, size_t message_size);
+
+// Jump to the next match in the search's direction (or against it with
+// reverse). Returns false if there is no search or no match.
+bool pane_search_next(TailPane *pane, bool reverse, char *message, size_t message_size);
+
+// Rows in the current view: all lines, or the ones passing the filter
+size_t pane_line_count(const TailPane *pane);
 
 // Render the pane to the console
 void pane_render(TailPane *pane, Console *con, bool is_active);
@@ -59,6 +209,13 @@ void pane_scroll_home(TailPane *pane);
 // Resume following mode (jump to end)
 void pane_scroll_end(TailPane *pane);
 
+// Scroll left (or right) by half the pane's width; does nothing while
+// wrapping. Returns true if scrolled.
+bool pane_scroll_side(TailPane *pane, bool right);
+
+// Turn wrapping long lines on or off
+void pane_set_wrap(TailPane *pane, bool wrap);
+
 // Set pane display region
 void pane_set_region(TailPane *pane, int top_row, int height);
 
@@ -0,0 +1,759 @@
+#include "pattern.h"
+#include "linescan.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum {
+    OP_CHAR,        // Match byte c
+    OP_ANY,         // Match any byte
+    OP_CLASS,       // Match a byte in classes[x]
+    OP_BOL,         // Start of line
+    OP_EOL,         // End of line
+    OP_SPLIT,       // Continue at x, then (lower priority) at y
+    OP_JMP,         // Continue at x
+    OP_MATCH
+} PatternOp;
+
+typedef struct PatternInst {
+    uint8_t op;
+    uint8_t c;
+    int x;
+    int y;
+} PatternInst;
+
+typedef struct PatternThread {
+    int pc;
+    size_t start;
+} PatternThread;
+
+// Parse tree, only alive during compilation
+typedef enum {
+    NODE_CHAR, NODE_ANY, NODE_CLASS, NODE_BOL, NODE_EOL, NODE_EMPTY,
+    NODE_CAT, NODE_ALT, NODE_STAR, NODE_PLUS, NODE_QUEST
+} NodeType;
+
+typedef struct {
+    uint8_t type;
+    uint8_t c;
+    bool lazy;
+    int left;       // Child (or class index for NODE_CLASS)
+    int right;
+} Node;
+
+typedef struct {
+    const char *text;
+    size_t pos;
+    bool ignore_case;
+    Node *nodes;
+    int node_count;
+    int node_cap;
+    uint8_t (*classes)[32];
+    int class_count;
+    int class_cap;
+    const char *error;
+} Parser;
+
+static uint8_t fold(uint8_t c) {
+    return (c >= 'A' && c <= 'Z') ? (uint8_t)(c + ('a' - 'A')) : c;
+}
+
+static void set_add(uint8_t *set, uint8_t c) {
+    set[c >> 3] |= (uint8_t)(1u << (c & 7));
+}
+
+static bool set_has(const uint8_t *set, uint8_t c) {
+    return (set[c >> 3] >> (c & 7)) & 1;
+}
+
+// Node and class storage. Bounds were reserved up front from the pattern
+// length, so these cannot fail.
+static int new_node(Parser *p, NodeType type, int left, int right) {
+    Node *node = &p->nodes[p->node_count];
+    memset(node, 0, sizeof(Node));
+    node->type = (uint8_t)type;
+    node->left = left;
+    node->right = right;
+    return p->node_count++;
+}
+
+static int new_class(Parser *p) {
+    memset(p->classes[p->class_count], 0, 32);
+    return p->class_count++;
+}
+
+// Add the bytes of a \d, \w or \s style escape to set. Returns false if
+// esc is not a class escape.
+static bool add_class_escape(uint8_t *set, char esc) {
+    uint8_t tmp[32] = {0};
+    char lower = (char)fold((uint8_t)esc);
+
+    if (lower == 'd') {
+        for (int c = '0'; c <= '9'; c++) set_add(tmp, (uint8_t)c);
+    } else if (lower == 'w') {
+        for (int c = '0'; c <= '9'; c++) set_add(tmp, (uint8_t)c);
+        for (int c = 'a'; c <= 'z'; c++) set_add(tmp, (uint8_t)c);
+        for (int c = 'A'; c <= 'Z'; c++) set_add(tmp, (uint8_t)c);
+        set_add(tmp, '_');
+    } else if (lower == 's') {
+        static const char spaces[] = " \t\r\n\v\f";
+        for (const char *s = spaces; *s; s++) set_add(tmp, (uint8_t)*s);
+    } else {
+        return false;
+    }
+
+    bool negate = (esc != lower);   // \D \W \S
+    for (int i = 0; i < 32; i++) {
+        set[i] |= negate ? (uint8_t)~tmp[i] : tmp[i];
+    }
+    return true;
+}
+
+static uint8_t escape_char(char esc) {
+    switch (esc) {
+        case 't': return '\t';
+        case 'n': return '\n';
+        case 'r': return '\r';
+        default: return (uint8_t)esc;
+    }
+}
+
+// [...] - the opening bracket has been consumed
+static int parse_class(Parser *p) {
+    int index = new_class(p);
+    uint8_t *set = p->classes[index];
+
+    bool negate = false;
+    if (p->text[p->pos] == '^') {
+        negate = true;
+        p->pos++;
+    }
+
+    bool first = true;
+    for (;;) {
+        char ch = p->text[p->pos];
+        if (ch == '\0') {
+            p->error = "unterminated [";
+            return -1;
+        }
+        if (ch == ']' && !first) {
+            p->pos++;
+            break;
+        }
+        first = false;
+        p->pos++;
+
+        uint8_t lo = (uint8_t)ch;
+        if (ch == '\\') {
+            char esc = p->text[p->pos];
+            if (esc == '\0') {
+                p->error = "trailing \\";
+                return -1;
+            }
+            p->pos++;
+            if (add_class_escape(set, esc)) {
+                continue;
+            }
+            lo = escape_char(esc);
+        }
+
+        uint8_t hi = lo;
+        if (p->text[p->pos] == '-' && p->text[p->pos + 1] != ']' && p->text[p->pos + 1] != '\0') {
+            hi = (uint8_t)p->text[p->pos + 1];
+            p->pos += 2;
+            if (hi < lo) {
+                p->error = "bad range in [";
+                return -1;
+            }
+        }
+        for (int c = lo; c <= hi; c++) {
+            set_add(set, (uint8_t)c);
+        }
+    }
+
+    if (p->ignore_case) {
+        for (int c = 'a'; c <= 'z'; c++) {
+            if (set_has(set, (uint8_t)c) || set_has(set, (uint8_t)(c - 'a' + 'A'))) {
+                set_add(set, (uint8_t)c);
+                set_add(set, (uint8_t)(c - 'a' + 'A'));
+            }
+        }
+    }
+    if (negate) {
+        for (int i = 0; i < 32; i++) {
+            set[i] = (uint8_t)~set[i];
+        }
+    }
+
+    int node = new_node(p, NODE_CLASS, index, -1);
+    return node;
+}
+
+static int parse_alt(Parser *p);
+
+static int parse_atom(Parser *p) {
+    char ch = p->text[p->pos++];
+    int node;
+
+    switch (ch) {
+        case '(':
+            node = parse_alt(p);
+            if (node < 0) {
+                return -1;
+            }
+            if (p->text[p->pos] != ')') {
+                p->error = "unbalanced (";
+                return -1;
+            }
+            p->pos++;
+            return node;
+        case '[':
+            return parse_class(p);
+        case '.':
+            return new_node(p, NODE_ANY, -1, -1);
+        case '^':
+            return new_node(p, NODE_BOL, -1, -1);
+        case '$':
+            return new_node(p, NODE_EOL, -1, -1);
+        case '*':
+        case '+':
+        case '?':
+            p->error = "nothing to repeat";
+            return -1;
+        case '\\': {
+            char esc = p->text[p->pos];
+            if (esc == '\0') {
+                p->error = "trailing \\";
+                return -1;
+            }
+            p->pos++;
+            int index = new_class(p);
+            if (add_class_escape(p->classes[index], esc)) {
+                return new_node(p, NODE_CLASS, index, -1);
+            }
+            p->class_count--;
+            ch = (char)escape_char(esc);
+            break;
+        }
+        default:
+            break;
+    }
+
+    node = new_node(p, NODE_CHAR, -1, -1);
+    p->nodes[node].c = p->ignore_case ? fold((uint8_t)ch) : (uint8_t)ch;
+    return node;
+}
+
+static int parse_repeat(Parser *p) {
+    int node = parse_atom(p);
+    if (node < 0) {
+        return -1;
+    }
+
+    for (;;) {
+        char ch = p->text[p->pos];
+        NodeType type;
+        if (ch == '*') {
+            type = NODE_STAR;
+        } else if (ch == '+') {
+            type = NODE_PLUS;
+        } else if (ch == '?') {
+            type = NODE_QUEST;
+        } else {
+            return node;
+        }
+        p->pos++;
+
+        node = new_node(p, type, node, -1);
+        if (p->text[p->pos] == '?') {
+            p->nodes[node].lazy = true;
+            p->pos++;
+        }
+    }
+}
+
+static int parse_concat(Parser *p) {
+    int node = -1;
+    for (;;) {
+        char ch = p->text[p->pos];
+        if (ch == '\0' || ch == '|' || ch == ')') {
+            break;
+        }
+        int next = parse_repeat(p);
+        if (next < 0) {
+            return -1;
+        }
+        node = node < 0 ? next : new_node(p, NODE_CAT, node, next);
+    }
+    return node < 0 ? new_node(p, NODE_EMPTY, -1, -1) : node;
+}
+
+static int parse_alt(Parser *p) {
+    int node = parse_concat(p);
+    while (node >= 0 && p->text[p->pos] == '|') {
+        p->pos++;
+        int right = parse_concat(p);
+        if (right < 0) {
+            return -1;
+        }
+        node = new_node(p, NODE_ALT, node, right);
+    }
+    return node;
+}
+
+// Instructions needed for a subtree
+static int count_insts(const Parser *p, int index) {
+    const Node *node = &p->nodes[index];
+    switch (node->type) {
+        case NODE_EMPTY: return 0;
+        case NODE_CAT: return count_insts(p, node->left) + count_insts(p, node->right);
+        case NODE_ALT: return 2 + count_insts(p, node->left) + count_insts(p, node->right);
+        case NODE_STAR: return 2 + count_insts(p, node->left);
+        case NODE_PLUS: return 1 + count_insts(p, node->left);
+        case NODE_QUEST: return 1 + count_insts(p, node->left);
+        default: return 1;
+    }
+}
+
+static PatternInst *emit(const Parser *p, int index, PatternInst *pc, PatternInst *base) {
+    const Node *node = &p->nodes[index];
+    PatternInst *split;
+    PatternInst *jmp;
+
+    switch (node->type) {
+        case NODE_EMPTY:
+            break;
+        case NODE_CHAR:
+            pc->op = OP_CHAR;
+            pc->c = node->c;
+            pc++;
+            break;
+        case NODE_ANY:
+            pc->op = OP_ANY;
+            pc++;
+            break;
+        case NODE_CLASS:
+            pc->op = OP_CLASS;
+            pc->x = node->left;
+            pc++;
+            break;
+        case NODE_BOL:
+            pc->op = OP_BOL;
+            pc++;
+            break;
+        case NODE_EOL:
+            pc->op = OP_EOL;
+            pc++;
+            break;
+        case NODE_CAT:
+            pc = emit(p, node->left, pc, base);
+            pc = emit(p, node->right, pc, base);
+            break;
+        case NODE_ALT:
+            split = pc++;
+            split->op = OP_SPLIT;
+            split->x = (int)(pc - base);
+            pc = emit(p, node->left, pc, base);
+            jmp = pc++;
+            jmp->op = OP_JMP;
+            split->y = (int)(pc - base);
+            pc = emit(p, node->right, pc, base);
+            jmp->x = (int)(pc - base);
+            break;
+        case NODE_QUEST:
+            split = pc++;
+            split->op = OP_SPLIT;
+            split->x = (int)(pc - base);
+            pc = emit(p, node->left, pc, base);
+            split->y = (int)(pc - base);
+            if (node->lazy) {
+                int t = split->x; split->x = split->y; split->y = t;
+            }
+            break;
+        case NODE_STAR:
+            split = pc++;
+            split->op = OP_SPLIT;
+            split->x = (int)(pc - base);
+            pc = emit(p, node->left, pc, base);
+            pc->op = OP_JMP;
+            pc->x = (int)(split - base);
+            pc++;
+            split->y = (int)(pc - base);
+            if (node->lazy) {
+                int t = split->x; split->x = split->y; split->y = t;
+            }
+            break;
+        case NODE_PLUS: {
+            int loop = (int)(pc - base);
+            pc = emit(p, node->left, pc, base);
+            pc->op = OP_SPLIT;
+            pc->x = loop;
+            pc->y = (int)(pc - base) + 1;
+            if (node->lazy) {
+                int t = pc->x; pc->x = pc->y; pc->y = t;
+            }
+            pc++;
+            break;
+        }
+    }
+    return pc;
+}
+
+// Byte every match must start with, or -1 - lets the matcher skip ahead with memchr
+static int required_first_byte(const Parser *p, int index) {
+    const Node *node = &p->nodes[index];
+    switch (node->type) {
+        case NODE_CHAR:
+            if (p->ignore_case && node->c >= 'a' && node->c <= 'z') {
+                return -1;
+            }
+            return node->c;
+        case NODE_CAT:
+            if (p->nodes[node->left].type == NODE_EMPTY) {
+                return required_first_byte(p, node->right);
+            }
+            return required_first_byte(p, node->left);
+        case NODE_PLUS:
+            return required_first_byte(p, node->left);
+        default:
+            return -1;
+    }
+}
+
+static char *copy_text(const char *text, size_t len) {
+    char *copy = (char *)malloc(len + 1);
+    if (copy) {
+        memcpy(copy, text, len);
+        copy[len] = '\0';
+    }
+    return copy;
+}
+
+static bool fail(Pattern *pat, char *error, size_t error_size, const char *reason) {
+    if (error && error_size > 0) {
+        snprintf(error, error_size, "%s", reason);
+    }
+    pattern_free(pat);
+    return false;
+}
+
+static bool compile_regex(Pattern *pat, const char *text, size_t len, char *error, size_t error_size) {
+    // Each byte yields at most a node, the CAT above it and an empty branch
+    Parser p;
+    memset(&p, 0, sizeof(p));
+    p.text = text;
+    p.ignore_case = pat->ignore_case;
+    p.node_cap = (int)(len * 3 + 4);
+    p.class_cap = (int)(len + 1);
+    p.nodes = (Node *)malloc((size_t)p.node_cap * sizeof(Node));
+    p.classes = (uint8_t (*)[32])malloc((size_t)p.class_cap * 32);
+    if (!p.nodes || !p.classes) {
+        free(p.nodes);
+        free(p.classes);
+        return fail(pat, error, error_size, "out of memory");
+    }
+
+    int root = parse_alt(&p);
+    if (root >= 0 && p.text[p.pos] != '\0') {
+        p.error = "unbalanced )";
+        root = -1;
+    }
+    if (root < 0) {
+        free(p.nodes);
+        free(p.classes);
+        return fail(pat, error, error_size, p.error ? p.error : "bad pattern");
+    }
+
+    int count = count_insts(&p, root) + 1;
+    pat->prog = (PatternInst *)calloc((size_t)count, sizeof(PatternInst));
+    pat->threads = (PatternThread *)malloc((size_t)count * 2 * sizeof(PatternThread));
+    pat->marks = (uint32_t *)calloc((size_t)count, sizeof(uint32_t));
+    if (!pat->prog || !pat->threads || !pat->marks) {
+        free(p.nodes);
+        free(p.classes);
+        return fail(pat, error, error_size, "out of memory");
+    }
+
+    PatternInst *end = emit(&p, root, pat->prog, pat->prog);
+    end->op = OP_MATCH;
+    pat->prog_len = count;
+    pat->first_byte = required_first_byte(&p, root);
+    pat->anchored = pat->prog[0].op == OP_BOL;
+
+    pat->classes = p.classes;
+    pat->class_count = p.class_count;
+    free(p.nodes);
+    return true;
+}
+
+bool pattern_compile(Pattern *pat, const char *text, bool regex, bool ignore_case,
+                     char *error, size_t error_size) {
+    if (!pat || !text) {
+        return false;
+    }
+
+    memset(pat, 0, sizeof(Pattern));
+    pat->regex = regex;
+    pat->ignore_case = ignore_case;
+    pat->first_byte = -1;
+
+    size_t len = strlen(text);
+    if (len > PATTERN_MAX_LENGTH) {
+        return fail(pat, error, error_size, "pattern too long");
+    }
+
+    pat->source = copy_text(text, len);
+    if (!pat->source) {
+        return fail(pat, error, error_size, "out of memory");
+    }
+
+    if (regex) {
+        return compile_regex(pat, text, len, error, error_size);
+    }
+
+    pat->literal = copy_text(text, len);
+    if (!pat->literal) {
+        return fail(pat, error, error_size, "out of memory");
+    }
+    pat->literal_len = len;
+    if (ignore_case) {
+        for (size_t i = 0; i < len; i++) {
+            pat->literal[i] = (char)fold((uint8_t)pat->literal[i]);
+        }
+    }
+    return true;
+}
+
+// Smart case: an upper-case letter in the pattern makes it case-sensitive.
+// In a regex the byte after a backslash is an escape (\S, \W, \D), not a letter.
+static bool has_upper(const char *text, bool regex) {
+    for (; *text; text++) {
+        if (regex && text[0] == '\\' && text[1]) {
+            text++;
+        } else if (*text >= 'A' && *text <= 'Z') {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool pattern_compile_text(Pattern *pat, const char *text, char *error, size_t error_size) {
+    if (!pat || !text) {
+        return false;
+    }
+
+    size_t len = strlen(text);
+    if (len < 2 || text[0] != '/' || text[len - 1] != '/') {
+        return pattern_compile(pat, text, false, !has_upper(text, false), error, error_size);
+    }
+
+    char body[PATTERN_MAX_LENGTH + 1];
+    if (len - 2 > PATTERN_MAX_LENGTH) {
+        memset(pat, 0, sizeof(Pattern));
+        pat->first_byte = -1;
+        if (error && error_size > 0) {
+            snprintf(error, error_size, "pattern too long");
+        }
+        return false;
+    }
+    memcpy(body, text + 1, len - 2);
+    body[len - 2] = '\0';
+    return pattern_compile(pat, body, true, !has_upper(body, true), error, error_size);
+}
+
+void pattern_describe(const Pattern *pat, char *out, size_t out_size) {
+    if (out_size == 0) {
+        return;
+    }
+    out[0] = '\0';
+    if (pat->source) {
+        snprintf(out, out_size, pat->regex ? "/%s/" : "%s", pat->source);
+    }
+}
+
+void pattern_free(Pattern *pat) {
+    if (!pat) {
+        return;
+    }
+
+    free(pat->source);
+    free(pat->literal);
+    free(pat->prog);
+    free(pat->classes);
+    free(pat->threads);
+    free(pat->marks);
+    memset(pat, 0, sizeof(Pattern));
+    pat->first_byte = -1;
+}
+
+static bool find_literal(const Pattern *pat, const char *text, size_t len, size_t *start, size_t *end) {
+    size_t pos = linescan_find_substr(text, len, pat->literal, pat->literal_len, pat->ignore_case);
+    if (pos == len && pat->literal_len > 0) {
+        return false;
+    }
+    if (start) *start = pos;
+    if (end) *end = pos + pat->literal_len;
+    return true;
+}
+
+// Add a thread at pc, following jumps and zero-width instructions. Threads
+// are kept in priority order; an instruction already on the list is skipped.
+static void add_thread(Pattern *pat, PatternThread *list, int *count, int pc, size_t pos, size_t start, size_t len) {
+    if (pat->marks[pc] == pat->generation) {
+        return;
+    }
+    pat->marks[pc] = pat->generation;
+
+    const PatternInst *inst = &pat->prog[pc];
+    switch (inst->op) {
+        case OP_JMP:
+            add_thread(pat, list, count, inst->x, pos, start, len);
+            break;
+        case OP_SPLIT:
+            add_thread(pat, list, count, inst->x, pos, start, len);
+            add_thread(pat, list, count, inst->y, pos, start, len);
+            break;
+        case OP_BOL:
+            if (pos == 0) {
+                add_thread(pat, list, count, pc + 1, pos, start, len);
+            }
+            break;
+        case OP_EOL:
+            if (pos == len) {
+                add_thread(pat, list, count, pc + 1, pos, start, len);
+            }
+            break;
+        default:
+            list[*count].pc = pc;
+            list[*count].start = start;
+            (*count)++;
+            break;
+    }
+}
+
+// Start a fresh thread list. Marks from an older generation never match.
+static void next_generation(Pattern *pat) {
+    if (++pat->generation == 0) {
+        memset(pat->marks, 0, (size_t)pat->prog_len * sizeof(uint32_t));
+        pat->generation = 1;
+    }
+}
+
+static bool find_regex(Pattern *pat, const char *text, size_t len, size_t *start, size_t *end, bool need_span) {
+    PatternThread *clist = pat->threads;
+    PatternThread *nlist = pat->threads + pat->prog_len;
+    int ccount = 0;
+    int ncount = 0;
+    bool matched = false;
+    size_t match_start = 0;
+    size_t match_end = 0;
+
+    size_t pos = 0;
+    if (pat->first_byte >= 0) {
+        const char *p = (const char *)memchr(text, pat->first_byte, len);
+        if (!p) {
+            return false;
+        }
+        pos = (size_t)(p - text);
+    }
+
+    next_generation(pat);
+    add_thread(pat, clist, &ccount, 0, pos, pos, len);
+
+    for (;; pos++) {
+        if (ccount == 0) {
+            if (matched || pat->anchored || pos > len) {
+                break;
+            }
+            // No live threads - skip to the next place a match could start
+            if (pat->first_byte >= 0) {
+                const char *p = pos < len ? (const char *)memchr(text + pos, pat->first_byte, len - pos) : NULL;
+                if (!p) {
+                    break;
+                }
+                pos = (size_t)(p - text);
+            }
+            next_generation(pat);
+            add_thread(pat, clist, &ccount, 0, pos, pos, len);
+        }
+
+        next_generation(pat);
+        ncount = 0;
+        uint8_t ch = pos < len ? (uint8_t)text[pos] : 0;
+        if (pat->ignore_case) {
+            ch = fold(ch);
+        }
+
+        for (int i = 0; i < ccount; i++) {
+            const PatternThread *t = &clist[i];
+            const PatternInst *inst = &pat->prog[t->pc];
+            bool step = false;
+
+            switch (inst->op) {
+                case OP_MATCH:
+                    if (!need_span) {
+                        return true;
+                    }
+                    matched = true;
+                    match_start = t->start;
+                    match_end = pos;
+                    i = ccount;     // Lower-priority threads lose to this match
+                    continue;
+                case OP_CHAR:
+                    step = pos < len && ch == inst->c;
+                    break;
+                case OP_ANY:
+                    step = pos < len;
+                    break;
+                case OP_CLASS:
+                    step = pos < len && set_has(pat->classes[inst->x], (uint8_t)text[pos]);
+                    break;
+                default:
+                    break;
+            }
+            if (step) {
+                add_thread(pat, nlist, &ncount, t->pc + 1, pos + 1, t->start, len);
+            }
+        }
+
+        if (pos >= len) {
+            break;
+        }
+
+        // Start a new attempt at the next position, behind all existing threads
+        if (!matched && !pat->anchored) {
+            add_thread(pat, nlist, &ncount, 0, pos + 1, pos + 1, len);
+        }
+
+        PatternThread *swap = clist;
+        clist = nlist;
+        nlist = swap;
+        ccount = ncount;
+    }
+
+    if (matched) {
+        if (start) *start = match_start;
+        if (end) *end = match_end;
+    }
+    return matched;
+}
+
+bool pattern_find(Pattern *pat, const char *text, size_t len, size_t *start, size_t *end) {
+    if (!pat || !pat->source || !text) {
+        return false;
+    }
+    if (!pat->regex) {
+        return find_literal(pat, text, len, start, end);
+    }
+    return find_regex(pat, text, len, start, end, true);
+}
+
+bool pattern_match(Pattern *pat, const char *text, size_t len) {
+    if (!pat || !pat->source || !text) {
+        return false;
+    }
+    if (!pat->regex) {
+        return find_literal(pat, text, len, NULL, NULL);
+    }
+    return find_regex(pat, text, len, NULL, NULL, false);
+}
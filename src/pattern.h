@@ -0,0 +1,60 @@
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define PATTERN_MAX_LENGTH 256  // Longest pattern text accepted
+
+// A compiled literal or regular expression, matched anywhere in a line.
+//
+// Regex syntax: . [abc] [^a-z] \d \w \s (and \D \W \S) ^ $ ( ) | * + ?
+// with lazy *? +? ??. Matching runs the compiled program as a Pike VM, so it
+// is linear in the line length whatever the pattern - a log line can never
+// make a pattern blow up.
+typedef struct {
+    char *source;               // Pattern text as given (owned)
+    bool regex;
+    bool ignore_case;
+
+    // Literal
+    char *literal;              // Case-folded when ignore_case (owned)
+    size_t literal_len;
+
+    // Regex program and match scratch space
+    struct PatternInst *prog;
+    int prog_len;
+    uint8_t (*classes)[32];     // Byte sets for [...] and \d-style classes
+    int class_count;
+    int first_byte;             // Byte every match starts with, or -1
+    bool anchored;              // Pattern starts with ^
+    struct PatternThread *threads;  // Two thread lists of prog_len entries each
+    uint32_t *marks;            // Per-instruction generation marks
+    uint32_t generation;
+} Pattern;
+
+// Compile text as a literal or a regex. ignore_case folds ASCII letters.
+// On failure returns false with a short reason in error.
+bool pattern_compile(Pattern *pat, const char *text, bool regex, bool ignore_case,
+                     char *error, size_t error_size);
+
+// Compile text as typed by the user: wrapped in slashes (/.../) it is a
+// regex, anything else a literal. Either ignores case unless the text has an
+// upper-case letter.
+bool pattern_compile_text(Pattern *pat, const char *text, char *error, size_t error_size);
+
+// Write the pattern back in the form pattern_compile_text accepts
+void pattern_describe(const Pattern *pat, char *out, size_t out_size);
+
+// Free a compiled pattern (safe on a zeroed one)
+void pattern_free(Pattern *pat);
+
+// Find the leftmost match in text. start/end (either may be NULL) receive
+// the match span.
+bool pattern_find(Pattern *pat, const char *text, size_t len, size_t *start, size_t *end);
+
+// True if the pattern matches anywhere in text
+bool pattern_match(Pattern *pat, const char *text, size_t len);
+
+#endif // PATTERN_H
@@ -0,0 +1,166 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Thin OS layer: file access, threads and timing. The console, input and
+// file watching modules have their own per-platform backends on top of this.
+
+#ifdef _WIN32
+typedef void *PlatHandle;                           // Win32 HANDLE
+#define PLAT_INVALID_HANDLE ((PlatHandle)(intptr_t)-1)
+#define PLAT_MAX_PATH 260
+#else
+#include <pthread.h>
+typedef int PlatHandle;                             // File descriptor
+#define PLAT_INVALID_HANDLE (-1)
+#define PLAT_MAX_PATH 4096
+#endif
+
+// Identity of a file, stable across renames (volume and file index, or
+// device and inode)
+typedef struct {
+    uint64_t volume;
+    uint64_t index;
+} PlatFileId;
+
+// Open a file for reading without blocking writers, renames or deletes.
+// Returns PLAT_INVALID_HANDLE on failure.
+PlatHandle plat_file_open(const char *path);
+
+// Close a file opened with plat_file_open
+void plat_file_close(PlatHandle file);
+
+// Query the current size of an open file
+bool plat_file_size(PlatHandle file, int64_t *size);
+
+// Get the identity of an open file
+bool plat_file_id(PlatHandle file, PlatFileId *id);
+
+// True if path now names a different file than the open one (the log was
+// rotated: renamed away and recreated). False while path is missing.
+bool plat_file_replaced(PlatHandle file, const char *path);
+
+// Read up to len bytes starting at offset. Sets *bytes_read (0 at EOF).
+bool plat_file_read_at(PlatHandle file, int64_t offset, void *buf, size_t len, size_t *bytes_read);
+
+// Alignment required for plat_file_map offsets
+size_t plat_map_granularity(void);
+
+// Map len bytes of the file read-only starting at offset (a multiple of
+// plat_map_granularity). Returns NULL on failure.
+const char *plat_file_map(PlatHandle file, int64_t offset, size_t len);
+
+// Release a view returned by plat_file_map
+void plat_file_unmap(const char *view, size_t len);
+
+// Rename from to to, replacing any file there in one step
+bool plat_rename_over(const char *from, const char *to);
+
+// Sleep for the given number of milliseconds
+void plat_sleep_ms(unsigned ms);
+
+// Monotonic clock in milliseconds
+uint64_t plat_now_ms(void);
+
+// Monotonic clock in microseconds, for measuring short intervals
+uint64_t plat_now_us(void);
+
+// Peak resident memory of the process so far, in bytes (0 if unknown)
+size_t plat_peak_memory(void);
+
+// How many files this process may hold open at once (0 if unlimited/unknown)
+size_t plat_open_file_limit(void);
+
+// Threads
+
+typedef void (*PlatThreadFn)(void *arg);
+
+#ifdef _WIN32
+typedef void *PlatThread;
+#else
+typedef pthread_t PlatThread;
+#endif
+
+// Start a thread running fn(arg)
+bool plat_thread_start(PlatThread *thread, PlatThreadFn fn, void *arg);
+
+// Wait for a thread to finish
+void plat_thread_join(PlatThread thread);
+
+// Mutexes and condition variables, for coordination off the line hot path
+
+#ifdef _WIN32
+typedef struct { void *opaque; } PlatMutex;         // SRWLOCK
+typedef struct { void *opaque; } PlatCond;          // CONDITION_VARIABLE
+#else
+typedef pthread_mutex_t PlatMutex;
+typedef pthread_cond_t PlatCond;
+#endif
+
+void plat_mutex_init(PlatMutex *mutex);
+void plat_mutex_destroy(PlatMutex *mutex);
+void plat_mutex_lock(PlatMutex *mutex);
+void plat_mutex_unlock(PlatMutex *mutex);
+
+void plat_cond_init(PlatCond *cond);
+void plat_cond_destroy(PlatCond *cond);
+void plat_cond_wait(PlatCond *cond, PlatMutex *mutex);
+void plat_cond_signal(PlatCond *cond);
+void plat_cond_broadcast(PlatCond *cond);
+
+// Signals: a latch that one side raises and the other waits on. The handle
+// can also be waited on together with other handles (see watch_wait).
+typedef struct {
+    PlatHandle handle;          // Auto-reset event (Win32) or pipe read end (POSIX)
+    PlatHandle write_handle;    // Pipe write end (POSIX), unused on Win32
+} PlatSignal;
+
+bool plat_signal_init(PlatSignal *signal);
+void plat_signal_destroy(PlatSignal *signal);
+
+// Raise the signal. Safe to call from any thread; repeated raises coalesce.
+void plat_signal_raise(PlatSignal *signal);
+
+// Reset the signal after its handle was seen ready by an external wait
+void plat_signal_clear(PlatSignal *signal);
+
+// Wait up to timeout_ms for the signal and reset it. Returns true if it was raised.
+bool plat_signal_wait(PlatSignal *signal, unsigned timeout_ms);
+
+// Atomics: acquire loads and release stores, enough for single-producer /
+// single-consumer hand-off between threads
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#if defined(_M_ARM64)
+static inline size_t plat_atomic_load(const volatile size_t *p) {
+    return (size_t)__ldar64((const volatile unsigned __int64 *)p);
+}
+static inline void plat_atomic_store(volatile size_t *p, size_t value) {
+    __stlr64((volatile unsigned __int64 *)p, value);
+}
+#else
+// x86/x64 loads and stores are already acquire/release; only stop the compiler reordering
+static inline size_t plat_atomic_load(const volatile size_t *p) {
+    size_t value = *p;
+    _ReadWriteBarrier();
+    return value;
+}
+static inline void plat_atomic_store(volatile size_t *p, size_t value) {
+    _ReadWriteBarrier();
+    *p = value;
+}
+#endif
+#else
+static inline size_t plat_atomic_load(const volatile size_t *p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+static inline void plat_atomic_store(volatile size_t *p, size_t value) {
+    __atomic_store_n(p, value, __ATOMIC_RELEASE);
+}
+#endif
+
+#endif // PLATFORM_H
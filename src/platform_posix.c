@@ -0,0 +1,262 @@
+#include "platform.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+PlatHandle plat_file_open(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return PLAT_INVALID_HANDLE;
+    }
+
+    // Tailing a directory or similar would only ever read errors
+    struct stat st;
+    if (fstat(fd, &st) != 0 || S_ISDIR(st.st_mode)) {
+        close(fd);
+        return PLAT_INVALID_HANDLE;
+    }
+    return fd;
+}
+
+void plat_file_close(PlatHandle file) {
+    if (file != PLAT_INVALID_HANDLE) {
+        close(file);
+    }
+}
+
+bool plat_file_size(PlatHandle file, int64_t *size) {
+    struct stat st;
+    if (fstat(file, &st) != 0) {
+        return false;
+    }
+    *size = (int64_t)st.st_size;
+    return true;
+}
+
+bool plat_file_id(PlatHandle file, PlatFileId *id) {
+    struct stat st;
+    if (fstat(file, &st) != 0) {
+        return false;
+    }
+    id->volume = (uint64_t)st.st_dev;
+    id->index = (uint64_t)st.st_ino;
+    return true;
+}
+
+bool plat_file_replaced(PlatHandle file, const char *path) {
+    PlatFileId open_id;
+    struct stat path_st;
+    if (!plat_file_id(file, &open_id) || stat(path, &path_st) != 0) {
+        return false;
+    }
+    return open_id.volume != (uint64_t)path_st.st_dev || open_id.index != (uint64_t)path_st.st_ino;
+}
+
+bool plat_file_read_at(PlatHandle file, int64_t offset, void *buf, size_t len, size_t *bytes_read) {
+    ssize_t n;
+    do {
+        n = pread(file, buf, len, (off_t)offset);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0) {
+        *bytes_read = 0;
+        return false;
+    }
+
+    *bytes_read = (size_t)n;
+    return true;
+}
+
+size_t plat_map_granularity(void) {
+    long page = sysconf(_SC_PAGESIZE);
+    return page > 0 ? (size_t)page : 4096;
+}
+
+const char *plat_file_map(PlatHandle file, int64_t offset, size_t len) {
+    void *view = mmap(NULL, len, PROT_READ, MAP_SHARED, file, (off_t)offset);
+    if (view == MAP_FAILED) {
+        return NULL;
+    }
+    return (const char *)view;
+}
+
+void plat_file_unmap(const char *view, size_t len) {
+    if (view) {
+        munmap((void *)view, len);
+    }
+}
+
+bool plat_rename_over(const char *from, const char *to) {
+    return rename(from, to) == 0;
+}
+
+void plat_sleep_ms(unsigned ms) {
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (long)(ms % 1000) * 1000000L;
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+typedef struct {
+    PlatThreadFn fn;
+    void *arg;
+} ThreadStart;
+
+static void *thread_trampoline(void *param) {
+    ThreadStart start = *(ThreadStart *)param;
+    free(param);
+    start.fn(start.arg);
+    return NULL;
+}
+
+uint64_t plat_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+uint64_t plat_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+size_t plat_peak_memory(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return (size_t)usage.ru_maxrss;             // Bytes
+#else
+    return (size_t)usage.ru_maxrss * 1024;      // Kilobytes
+#endif
+}
+
+size_t plat_open_file_limit(void) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0 || limit.rlim_cur == RLIM_INFINITY) {
+        return 0;
+    }
+    return (size_t)limit.rlim_cur;
+}
+
+bool plat_thread_start(PlatThread *thread, PlatThreadFn fn, void *arg) {
+    ThreadStart *start = (ThreadStart *)malloc(sizeof(ThreadStart));
+    if (!start) {
+        return false;
+    }
+    start->fn = fn;
+    start->arg = arg;
+
+    if (pthread_create(thread, NULL, thread_trampoline, start) != 0) {
+        free(start);
+        return false;
+    }
+    return true;
+}
+
+void plat_thread_join(PlatThread thread) {
+    pthread_join(thread, NULL);
+}
+
+void plat_mutex_init(PlatMutex *mutex) {
+    pthread_mutex_init(mutex, NULL);
+}
+
+void plat_mutex_destroy(PlatMutex *mutex) {
+    pthread_mutex_destroy(mutex);
+}
+
+void plat_mutex_lock(PlatMutex *mutex) {
+    pthread_mutex_lock(mutex);
+}
+
+void plat_mutex_unlock(PlatMutex *mutex) {
+    pthread_mutex_unlock(mutex);
+}
+
+void plat_cond_init(PlatCond *cond) {
+    pthread_cond_init(cond, NULL);
+}
+
+void plat_cond_destroy(PlatCond *cond) {
+    pthread_cond_destroy(cond);
+}
+
+void plat_cond_wait(PlatCond *cond, PlatMutex *mutex) {
+    pthread_cond_wait(cond, mutex);
+}
+
+void plat_cond_signal(PlatCond *cond) {
+    pthread_cond_signal(cond);
+}
+
+void plat_cond_broadcast(PlatCond *cond) {
+    pthread_cond_broadcast(cond);
+}
+
+bool plat_signal_init(PlatSignal *signal) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        signal->handle = PLAT_INVALID_HANDLE;
+        signal->write_handle = PLAT_INVALID_HANDLE;
+        return false;
+    }
+
+    for (int i = 0; i < 2; i++) {
+        fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+        fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+    }
+    signal->handle = fds[0];
+    signal->write_handle = fds[1];
+    return true;
+}
+
+void plat_signal_destroy(PlatSignal *signal) {
+    if (signal->handle != PLAT_INVALID_HANDLE) {
+        close(signal->handle);
+        close(signal->write_handle);
+        signal->handle = PLAT_INVALID_HANDLE;
+        signal->write_handle = PLAT_INVALID_HANDLE;
+    }
+}
+
+void plat_signal_raise(PlatSignal *signal) {
+    char byte = 1;
+    // A full pipe means the signal is already raised
+    while (write(signal->write_handle, &byte, 1) < 0 && errno == EINTR) {
+    }
+}
+
+void plat_signal_clear(PlatSignal *signal) {
+    char drain[64];
+    while (read(signal->handle, drain, sizeof(drain)) > 0) {
+    }
+}
+
+bool plat_signal_wait(PlatSignal *signal, unsigned timeout_ms) {
+    struct pollfd pfd;
+    pfd.fd = signal->handle;
+    pfd.events = POLLIN;
+
+    int ready;
+    do {
+        ready = poll(&pfd, 1, (int)timeout_ms);
+    } while (ready < 0 && errno == EINTR);
+
+    if (ready <= 0) {
+        return false;
+    }
+    plat_signal_clear(signal);
+    return true;
+}
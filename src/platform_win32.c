@@ -0,0 +1,237 @@
+#include "platform.h"
+#include <stdlib.h>
+#include <windows.h>
+#include <psapi.h>
+
+PlatHandle plat_file_open(const char *path) {
+    HANDLE file = CreateFileA(
+        path,
+        GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        NULL
+    );
+    return file == INVALID_HANDLE_VALUE ? PLAT_INVALID_HANDLE : file;
+}
+
+void plat_file_close(PlatHandle file) {
+    if (file != PLAT_INVALID_HANDLE) {
+        CloseHandle(file);
+    }
+}
+
+bool plat_file_size(PlatHandle file, int64_t *size) {
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size)) {
+        return false;
+    }
+    *size = file_size.QuadPart;
+    return true;
+}
+
+bool plat_file_id(PlatHandle file, PlatFileId *id) {
+    BY_HANDLE_FILE_INFORMATION info;
+    if (!GetFileInformationByHandle(file, &info)) {
+        return false;
+    }
+    id->volume = info.dwVolumeSerialNumber;
+    id->index = ((uint64_t)info.nFileIndexHigh << 32) | info.nFileIndexLow;
+    return true;
+}
+
+bool plat_file_replaced(PlatHandle file, const char *path) {
+    // Attribute-only access never conflicts with the writer's sharing mode
+    HANDLE current = CreateFileA(path, 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                 NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (current == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    PlatFileId open_id;
+    PlatFileId path_id;
+    bool replaced = plat_file_id(file, &open_id) && plat_file_id(current, &path_id) &&
+                    (open_id.volume != path_id.volume || open_id.index != path_id.index);
+    CloseHandle(current);
+    return replaced;
+}
+
+bool plat_file_read_at(PlatHandle file, int64_t offset, void *buf, size_t len, size_t *bytes_read) {
+    // Positioned read: the offset travels in the OVERLAPPED block
+    OVERLAPPED overlapped = {0};
+    overlapped.Offset = (DWORD)(offset & 0xFFFFFFFF);
+    overlapped.OffsetHigh = (DWORD)(offset >> 32);
+
+    DWORD chunk = len > 0x7FFFFFFF ? 0x7FFFFFFF : (DWORD)len;
+    DWORD read = 0;
+    if (!ReadFile(file, buf, chunk, &read, &overlapped)) {
+        *bytes_read = 0;
+        return GetLastError() == ERROR_HANDLE_EOF;
+    }
+
+    *bytes_read = read;
+    return true;
+}
+
+size_t plat_map_granularity(void) {
+    SYSTEM_INFO sys_info;
+    GetSystemInfo(&sys_info);
+    return sys_info.dwAllocationGranularity;
+}
+
+const char *plat_file_map(PlatHandle file, int64_t offset, size_t len) {
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping) {
+        return NULL;
+    }
+
+    const char *view = (const char *)MapViewOfFile(mapping, FILE_MAP_READ,
+        (DWORD)(offset >> 32), (DWORD)(offset & 0xFFFFFFFF), len);
+
+    // The view keeps the mapping object alive until it is unmapped
+    CloseHandle(mapping);
+    return view;
+}
+
+void plat_file_unmap(const char *view, size_t len) {
+    (void)len;
+    if (view) {
+        UnmapViewOfFile(view);
+    }
+}
+
+bool plat_rename_over(const char *from, const char *to) {
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+void plat_sleep_ms(unsigned ms) {
+    Sleep(ms);
+}
+
+uint64_t plat_now_ms(void) {
+    return GetTickCount64();
+}
+
+uint64_t plat_now_us(void) {
+    static LARGE_INTEGER frequency;
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (uint64_t)(now.QuadPart / frequency.QuadPart) * 1000000 +
+           (uint64_t)(now.QuadPart % frequency.QuadPart) * 1000000 / (uint64_t)frequency.QuadPart;
+}
+
+size_t plat_peak_memory(void) {
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return 0;
+    }
+    return counters.PeakWorkingSetSize;
+}
+
+size_t plat_open_file_limit(void) {
+    return 0;   // Kernel handles have no practical per-process cap
+}
+
+typedef struct {
+    PlatThreadFn fn;
+    void *arg;
+} ThreadStart;
+
+static DWORD WINAPI thread_trampoline(LPVOID param) {
+    ThreadStart start = *(ThreadStart *)param;
+    free(param);
+    start.fn(start.arg);
+    return 0;
+}
+
+bool plat_thread_start(PlatThread *thread, PlatThreadFn fn, void *arg) {
+    ThreadStart *start = (ThreadStart *)malloc(sizeof(ThreadStart));
+    if (!start) {
+        return false;
+    }
+    start->fn = fn;
+    start->arg = arg;
+
+    HANDLE handle = CreateThread(NULL, 0, thread_trampoline, start, 0, NULL);
+    if (!handle) {
+        free(start);
+        return false;
+    }
+    *thread = handle;
+    return true;
+}
+
+void plat_thread_join(PlatThread thread) {
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+void plat_mutex_init(PlatMutex *mutex) {
+    InitializeSRWLock((PSRWLOCK)&mutex->opaque);
+}
+
+void plat_mutex_destroy(PlatMutex *mutex) {
+    (void)mutex;    // SRW locks need no cleanup
+}
+
+void plat_mutex_lock(PlatMutex *mutex) {
+    AcquireSRWLockExclusive((PSRWLOCK)&mutex->opaque);
+}
+
+void plat_mutex_unlock(PlatMutex *mutex) {
+    ReleaseSRWLockExclusive((PSRWLOCK)&mutex->opaque);
+}
+
+void plat_cond_init(PlatCond *cond) {
+    InitializeConditionVariable((PCONDITION_VARIABLE)&cond->opaque);
+}
+
+void plat_cond_destroy(PlatCond *cond) {
+    (void)cond;
+}
+
+void plat_cond_wait(PlatCond *cond, PlatMutex *mutex) {
+    SleepConditionVariableSRW((PCONDITION_VARIABLE)&cond->opaque, (PSRWLOCK)&mutex->opaque, INFINITE, 0);
+}
+
+void plat_cond_signal(PlatCond *cond) {
+    WakeConditionVariable((PCONDITION_VARIABLE)&cond->opaque);
+}
+
+void plat_cond_broadcast(PlatCond *cond) {
+    WakeAllConditionVariable((PCONDITION_VARIABLE)&cond->opaque);
+}
+
+bool plat_signal_init(PlatSignal *signal) {
+    signal->handle = CreateEventA(NULL, FALSE, FALSE, NULL);
+    signal->write_handle = PLAT_INVALID_HANDLE;
+    if (!signal->handle) {
+        signal->handle = PLAT_INVALID_HANDLE;
+        return false;
+    }
+    return true;
+}
+
+void plat_signal_destroy(PlatSignal *signal) {
+    if (signal->handle != PLAT_INVALID_HANDLE) {
+        CloseHandle(signal->handle);
+        signal->handle = PLAT_INVALID_HANDLE;
+    }
+}
+
+void plat_signal_raise(PlatSignal *signal) {
+    SetEvent(signal->handle);
+}
+
+void plat_signal_clear(PlatSignal *signal) {
+    // Auto-reset: the wait that saw the event already consumed it
+    (void)signal;
+}
+
+bool plat_signal_wait(PlatSignal *signal, unsigned timeout_ms) {
+    return WaitForSingleObject(signal->handle, timeout_ms) == WAIT_OBJECT_0;
+}
@@ -0,0 +1,676 @@
+#include "reader.h"
+#include "archive.h"
+#include "linescan.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Find the file offset where the scrollback starts: the first line that
+// begins within the last max_bytes of the file. A line too long to find its
+// end in one mapped window is cut at the limit instead.
+static int64_t find_scrollback_start(PlatHandle file, int64_t file_size, size_t max_bytes) {
+    if (file_size <= 0 || (uint64_t)file_size <= max_bytes) {
+        return 0;
+    }
+
+    int64_t limit = file_size - (int64_t)max_bytes;
+
+    // Map from the byte before the limit: a terminator there means a line starts right at it
+    int64_t granularity = (int64_t)plat_map_granularity();
+    int64_t view_start = (limit - 1) - (limit - 1) % granularity;
+    size_t view_len = (size_t)(file_size - view_start);
+    if (view_len > TAIL_SCAN_VIEW_SIZE) {
+        view_len = TAIL_SCAN_VIEW_SIZE;
+    }
+
+    const char *view = plat_file_map(file, view_start, view_len);
+    if (!view) {
+        return limit;
+    }
+
+    size_t from = (size_t)(limit - 1 - view_start);
+    size_t i = from + linescan_find_eol(view + from, view_len - from);
+    int64_t start = limit;
+    if (i < view_len) {
+        start = view_start + (int64_t)i + 1;
+        if (view[i] == '\r' && i + 1 < view_len && view[i + 1] == '\n') {
+            start++;    // Both halves of a CRLF
+        }
+    }
+
+    plat_file_unmap(view, view_len);
+    return start;
+}
+
+// Let the UI thread drain a full queue before trying again. Returns false
+// if the pool is being stopped instead.
+static bool wait_for_room(ReaderPool *pool) {
+    if (plat_atomic_load(&pool->stopping)) {
+        return false;
+    }
+    plat_signal_raise(pool->ui_wake);
+    plat_sleep_ms(READER_BLOCKED_WAIT_MS);
+    return true;
+}
+
+// Hand a record to the UI thread, waiting for room if the queue is full.
+// Returns false if the pool is being stopped.
+static bool queue_record(ReaderPool *pool, TailPane *pane, uint32_t kind, int64_t offset, const char *text,
+                         size_t len) {
+    while (!linequeue_push(&pane->queue, kind, offset, text, len)) {
+        if (!wait_for_room(pool)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Reserve room for at least min bytes of text in the queue, starting with
+// the unfinished line (moved there if need be), waiting if the queue is
+// full. Returns NULL if the pool is being stopped.
+static char *reserve_room(ReaderPool *pool, TailPane *pane, size_t min, size_t *room) {
+    char *text;
+    while (!(text = linequeue_reserve(&pane->queue, min, pane->ring_tail, pane->ring_tail_len, room))) {
+        if (!wait_for_room(pool)) {
+            return NULL;
+        }
+    }
+    pane->ring_tail = text;
+    return text;
+}
+
+// Queue the unfinished line as it is: the rest of it is not coming
+static bool flush_ring_tail(ReaderPool *pool, TailPane *pane) {
+    size_t len = pane->ring_tail_len;
+    size_t room;
+    if (len == 0) {
+        return true;
+    }
+    if (!reserve_room(pool, pane, len, &room)) {
+        return false;
+    }
+    linequeue_commit(&pane->queue, LINEQUEUE_LINE, pane->read_pos - (int64_t)len, len);
+    pane->ring_tail_len = 0;
+    return true;
+}
+
+// Queue the complete lines among the len bytes just placed at the start of
+// the reserved room (from file offset start, the first known bytes of which
+// were the unfinished line and hold no terminator) as one block. What
+// follows the last one is the new unfinished line, left where it is.
+static bool queue_block(ReaderPool *pool, TailPane *pane, char *text, size_t len, int64_t start, size_t known) {
+    // Bytes the last read left to skip: the \n of a CRLF split across
+    // reads, or the rest of an overlong line. What follows is moved up.
+    size_t skip = 0;
+    if (pane->pending_cr) {
+        pane->pending_cr = false;
+        skip = text[0] == '\n' ? 1 : 0;
+    } else if (pane->discarding) {
+        size_t eol = linescan_find_eol(text, len);
+        skip = eol < len ? eol + 1 : len;
+        if (eol < len) {
+            pane->discarding = false;
+            if (text[eol] == '\r') {
+                if (skip == len) {
+                    pane->pending_cr = true;
+                } else if (text[skip] == '\n') {
+                    skip++;
+                }
+            }
+        }
+    }
+    if (skip > 0) {
+        pane->ring_tail = text + skip;
+        pane->ring_tail_len = len - skip;
+        len -= skip;
+        start += (int64_t)skip;
+        known = 0;
+        size_t room;
+        if (len == 0) {
+            return true;
+        }
+        if (!(text = reserve_room(pool, pane, len, &room))) {
+            return false;
+        }
+    }
+
+    size_t last = linescan_rfind_eol(text + known, len - known);
+    size_t end = last < len - known ? known + last + 1 : known;
+
+    if (end > known) {
+        // A \r ending the read may pair with a \n starting the next one
+        pane->pending_cr = end == len && text[end - 1] == '\r';
+        linequeue_commit(&pane->queue, LINEQUEUE_BLOCK, start, end);
+        pane->ring_tail = text + end;
+        pane->ring_tail_len = len - end;
+    } else if (len >= linequeue_max_text(&pane->queue)) {
+        // Too long for a record: queue what fits and drop the rest
+        linequeue_commit(&pane->queue, LINEQUEUE_LINE, start, len);
+        pane->ring_tail_len = 0;
+        pane->discarding = true;
+    } else {
+        pane->ring_tail = text;
+        pane->ring_tail_len = len;
+    }
+    return true;
+}
+
+// Append bytes to the pending partial line, growing its buffer only when needed
+static bool partial_append(TailPane *pane, const char *data, size_t len) {
+    size_t needed = pane->partial_len + len;
+    if (needed > pane->partial_cap) {
+        size_t new_cap = pane->partial_cap ? pane->partial_cap : 256;
+        while (new_cap < needed) {
+            new_cap *= 2;
+        }
+        char *new_partial = (char *)realloc(pane->partial_line, new_cap);
+        if (!new_partial) {
+            return false;
+        }
+        pane->partial_line = new_partial;
+        pane->partial_cap = new_cap;
+    }
+
+    memcpy(pane->partial_line + pane->partial_len, data, len);
+    pane->partial_len = needed;
+    return true;
+}
+
+// Queue the lines in data, which starts at file offset base (-1 for decoded
+// text, whose lines have no offsets)
+static bool process_read_data(ReaderPool *pool, TailPane *pane, const char *data, size_t len, int64_t base) {
+    size_t start = 0;
+
+    // Second half of a CRLF pair split across reads - the CR already ended the line
+    if (pane->pending_cr && len > 0 && data[0] == '\n') {
+        start = 1;
+    }
+    pane->pending_cr = false;
+
+    while (start < len) {
+        size_t eol = start + linescan_find_eol(data + start, len - start);
+        if (eol >= len) {
+            break;
+        }
+
+        size_t line_len = eol - start;
+        if (pane->partial_len > 0) {
+            // Line straddles a read boundary - complete it in the partial buffer
+            if (partial_append(pane, data + start, line_len) &&
+                !queue_record(pool, pane, LINEQUEUE_LINE, pane->partial_offset, pane->partial_line,
+                              pane->partial_len)) {
+                return false;
+            }
+            pane->partial_len = 0;
+        } else {
+            // Whole line is in this read - queue it straight from the read buffer
+            int64_t offset = base < 0 ? -1 : base + (int64_t)start;
+            if (!queue_record(pool, pane, LINEQUEUE_LINE, offset, data + start, line_len)) {
+                return false;
+            }
+        }
+
+        // Skip \r\n sequence
+        start = eol + 1;
+        if (data[eol] == '\r') {
+            if (start == len) {
+                pane->pending_cr = true;
+            } else if (data[start] == '\n') {
+                start++;
+            }
+        }
+    }
+
+    // Handle remaining partial line
+    if (start < len) {
+        if (pane->partial_len == 0) {
+            pane->partial_offset = base < 0 ? -1 : base + (int64_t)start;
+        }
+        partial_append(pane, data + start, len - start);
+    }
+    metrics_read(&pane->metrics, len);
+    return true;
+}
+
+// Continue from the start of the file (kind says why), keeping what was
+// already read. A partial line is passed on as it is: its rest is gone.
+static bool start_over(ReaderPool *pool, TailPane *pane, uint32_t kind) {
+    if (!flush_ring_tail(pool, pane)) {
+        return false;
+    }
+    if (pane->partial_len > 0 &&
+        !queue_record(pool, pane, LINEQUEUE_LINE, pane->partial_offset, pane->partial_line, pane->partial_len)) {
+        return false;
+    }
+    if (pool->trace) {
+        trace_restart(pool->trace, pane->source_id, kind == LINEQUEUE_RESET ? TRACE_TRUNCATE : TRACE_ROTATE);
+    }
+    pane->read_pos = 0;
+    pane->partial_len = 0;
+    pane->pending_cr = false;
+    pane->discarding = false;
+    // A new file is named in the record, so by-reference scrollback can tell
+    // it from the old one
+    bool replaced = kind == LINEQUEUE_ROTATED;
+    if (!queue_record(pool, pane, kind, 0, replaced ? (const char *)&pane->file_id : NULL,
+                      replaced ? sizeof(PlatFileId) : 0)) {
+        return false;
+    }
+    plat_signal_raise(pool->ui_wake);
+    return true;
+}
+
+// Jump to the part of a burst the scrollback would keep when the view
+// follows the end and reading it all would only push it through: more than
+// the startup share (and PANE_SKIP_MIN_BYTES) is waiting. A line notes the
+// skip. Returns false if the pool is being stopped.
+static bool skip_ahead(ReaderPool *pool, TailPane *pane, int64_t file_size) {
+    uint64_t behind = (uint64_t)(file_size - pane->read_pos);
+    if (!plat_atomic_load(&pane->follow_tail) || behind <= PANE_SKIP_MIN_BYTES || behind <= pane->initial_bytes) {
+        return true;
+    }
+
+    int64_t start = find_scrollback_start(pane->file_handle, file_size, pane->initial_bytes);
+    char note[64];
+    int len = snprintf(note, sizeof(note), PANE_SKIPPED_FORMAT,
+                       (unsigned long long)((start - pane->read_pos) / (1024 * 1024)));
+    pane->ring_tail_len = 0;    // Its rest is skipped too
+    pane->pending_cr = false;
+    pane->discarding = false;
+    pane->read_pos = start;
+    return queue_record(pool, pane, LINEQUEUE_LINE, -1, note, (size_t)len);
+}
+
+// Record one pass's growth: bytes skipped count with the lines the bytes
+// read suggest they held
+static void trace_growth(ReaderPool *pool, TailPane *pane, uint64_t read, uint64_t skipped, uint64_t lines,
+                         bool partial) {
+    if (read > 0 && skipped > 0) {
+        lines += (uint64_t)((double)lines * (double)skipped / (double)read);
+    }
+    trace_append(pool->trace, pane->source_id, read + skipped, lines, partial);
+}
+
+// Read whatever was appended since the last call and queue its lines.
+// Returns true if any data was read.
+static bool read_new_content(ReaderPool *pool, TailPane *pane) {
+    // Get current file size
+    int64_t file_size;
+    if (!plat_file_size(pane->file_handle, &file_size)) {
+        return false;
+    }
+
+    // Check if file was truncated (copytruncate rotation): what is there now
+    // is all new
+    if (file_size < pane->read_pos && !start_over(pool, pane, LINEQUEUE_RESET)) {
+        return false;
+    }
+
+    metrics_lag(&pane->metrics, file_size - pane->read_pos);
+
+    // Check if there's new content
+    if (file_size <= pane->read_pos) {
+        return false;
+    }
+
+    // Read straight into the queue, after the unfinished line from last time
+    size_t max_text = linequeue_max_text(&pane->queue);
+    uint64_t traced_read = 0;
+    uint64_t traced_skipped = 0;
+    uint64_t traced_lines = 0;
+    bool traced_partial = false;
+    while (pane->read_pos < file_size && !plat_atomic_load(&pool->stopping)) {
+        int64_t before_skip = pane->read_pos;
+        if (!skip_ahead(pool, pane, file_size)) {
+            return false;
+        }
+        traced_skipped += (uint64_t)(pane->read_pos - before_skip);
+
+        size_t known = pane->ring_tail_len;
+        size_t min = known + READER_MIN_READ < max_text ? known + READER_MIN_READ : max_text;
+        size_t room;
+        char *text = reserve_room(pool, pane, min, &room);
+        if (!text) {
+            return false;
+        }
+
+        size_t request = room - known < READ_BUFFER_SIZE ? room - known : READ_BUFFER_SIZE;
+        size_t bytes_read;
+        if (!plat_file_read_at(pane->file_handle, pane->read_pos, text + known, request, &bytes_read)) {
+            break;
+        }
+        if (bytes_read == 0) {
+            break;
+        }
+
+        int64_t start = pane->read_pos - (int64_t)known;
+        pane->read_pos += bytes_read;
+        metrics_read(&pane->metrics, bytes_read);
+        if (pool->trace) {
+            traced_read += bytes_read;
+            traced_lines += trace_count_lines(text + known, bytes_read);
+            traced_partial = text[known + bytes_read - 1] != '\n';
+        }
+        if (!queue_block(pool, pane, text, known + bytes_read, start, known)) {
+            return false;
+        }
+        metrics_lag(&pane->metrics, file_size - pane->read_pos);
+        plat_signal_raise(pool->ui_wake);
+    }
+
+    if (pool->trace) {
+        trace_growth(pool, pane, traced_read, traced_skipped, traced_lines, traced_partial);
+    }
+    return true;
+}
+
+// Pool bookkeeping below runs with pool->lock held
+
+static void lru_remove(ReaderPool *pool, TailPane *pane) {
+    if (!pane->in_lru) {
+        return;
+    }
+    if (pane->lru_prev) {
+        pane->lru_prev->lru_next = pane->lru_next;
+    } else {
+        pool->lru_head = pane->lru_next;
+    }
+    if (pane->lru_next) {
+        pane->lru_next->lru_prev = pane->lru_prev;
+    } else {
+        pool->lru_tail = pane->lru_prev;
+    }
+    pane->lru_prev = NULL;
+    pane->lru_next = NULL;
+    pane->in_lru = false;
+}
+
+static void lru_push(ReaderPool *pool, TailPane *pane) {
+    pane->lru_prev = pool->lru_tail;
+    pane->lru_next = NULL;
+    if (pool->lru_tail) {
+        pool->lru_tail->lru_next = pane;
+    } else {
+        pool->lru_head = pane;
+    }
+    pool->lru_tail = pane;
+    pane->in_lru = true;
+}
+
+static void work_push(ReaderPool *pool, TailPane *pane) {
+    pool->work[(pool->work_head + pool->work_count) % pool->work_cap] = pane;
+    pool->work_count++;
+    pane->queued = true;
+}
+
+static TailPane *work_pop(ReaderPool *pool) {
+    TailPane *pane = pool->work[pool->work_head];
+    pool->work_head = (pool->work_head + 1) % pool->work_cap;
+    pool->work_count--;
+    pane->queued = false;
+    return pane;
+}
+
+// Open the pane's file, first closing idle files if the budget is used up
+static bool acquire_handle(ReaderPool *pool, TailPane *pane) {
+    plat_mutex_lock(&pool->lock);
+    while (pool->open_count >= pool->open_budget && pool->lru_head) {
+        TailPane *victim = pool->lru_head;
+        lru_remove(pool, victim);
+        plat_file_close(victim->file_handle);
+        victim->file_handle = PLAT_INVALID_HANDLE;
+        pool->open_count--;
+    }
+    pool->open_count++;
+    plat_mutex_unlock(&pool->lock);
+
+    pane->file_handle = plat_file_open(pane->filepath);
+    if (pane->file_handle == PLAT_INVALID_HANDLE) {
+        plat_mutex_lock(&pool->lock);
+        pool->open_count--;
+        plat_mutex_unlock(&pool->lock);
+        return false;
+    }
+
+    // Reopened after an idle close onto a rotated log: the old file's unread
+    // tail is out of reach, so go straight on to the new one
+    PlatFileId id;
+    if (plat_file_id(pane->file_handle, &id)) {
+        bool replaced = pane->scanned && (id.volume != pane->file_id.volume || id.index != pane->file_id.index);
+        pane->file_id = id;
+        if (replaced) {
+            start_over(pool, pane, LINEQUEUE_ROTATED);
+        }
+    }
+    return true;
+}
+
+// The log was rotated: finish the old file, then continue from the start
+// of the new one
+static void follow_rotation(ReaderPool *pool, TailPane *pane) {
+    if (!plat_file_replaced(pane->file_handle, pane->filepath)) {
+        return;
+    }
+    PlatHandle fresh = plat_file_open(pane->filepath);
+    if (fresh == PLAT_INVALID_HANDLE) {
+        return;
+    }
+
+    while (read_new_content(pool, pane)) {
+    }
+
+    // Swapping handles keeps the pool's open count right. The new file is
+    // read whole: all of it came after the lines already shown.
+    plat_file_close(pane->file_handle);
+    pane->file_handle = fresh;
+    plat_file_id(fresh, &pane->file_id);
+    start_over(pool, pane, LINEQUEUE_ROTATED);
+}
+
+// Queue all lines of a (possibly compressed) file, decoded a block at a
+// time straight into the line splitter. Returns false if it is corrupt or
+// unreadable; the lines before the damage are kept.
+static bool read_archive(ReaderPool *pool, TailPane *pane, PlatHandle file) {
+    Archive archive;
+    if (!archive_open(&archive, file)) {
+        return false;
+    }
+
+    const char *data;
+    size_t len;
+    bool ok;
+    while ((ok = archive_next(&archive, &data, &len)) && len > 0 && !plat_atomic_load(&pool->stopping)) {
+        if (!process_read_data(pool, pane, data, len, -1)) {
+            break;
+        }
+        plat_signal_raise(pool->ui_wake);
+    }
+    archive_close(&archive);
+
+    // The file's last line needs no terminator
+    if (pane->partial_len > 0) {
+        queue_record(pool, pane, LINEQUEUE_LINE, -1, pane->partial_line, pane->partial_len);
+    }
+    pane->partial_len = 0;
+    pane->pending_cr = false;
+    plat_signal_raise(pool->ui_wake);
+    return ok;
+}
+
+// Load rotated copies ahead of the live file, as many (newest first) as
+// the startup scrollback has room for, oldest first
+static void load_archives(ReaderPool *pool, TailPane *pane, int64_t live_size) {
+    if (pane->archive_count == 0 || (uint64_t)live_size >= pane->initial_bytes) {
+        return;
+    }
+
+    uint64_t room = pane->initial_bytes - (uint64_t)live_size;
+    size_t take = 0;
+    while (take < pane->archive_count && room > 0) {
+        PlatHandle file = plat_file_open(pane->archives[take]);
+        int64_t size;
+        if (file == PLAT_INVALID_HANDLE || !plat_file_size(file, &size)) {
+            plat_file_close(file);
+            break;
+        }
+        uint64_t decoded = (uint64_t)archive_decoded_size(file, size);
+        plat_file_close(file);
+        room = decoded < room ? room - decoded : 0;
+        take++;
+    }
+
+    while (take-- > 0 && !plat_atomic_load(&pool->stopping)) {
+        PlatHandle file = plat_file_open(pane->archives[take]);
+        if (file != PLAT_INVALID_HANDLE) {
+            read_archive(pool, pane, file);
+            plat_file_close(file);
+        }
+    }
+}
+
+// One read pass over a pane, on a pool thread
+static void service_pane(ReaderPool *pool, TailPane *pane) {
+    if (pane->compressed) {
+        return;     // Decoded on the first pass; archives do not grow
+    }
+
+    if (pane->file_handle == PLAT_INVALID_HANDLE) {
+        if (!acquire_handle(pool, pane)) {
+            return;
+        }
+    } else {
+        follow_rotation(pool, pane);
+    }
+
+    // Large files: skip straight to the part that fits in the scrollback.
+    // A compressed one is read whole instead of tailed.
+    if (!pane->scanned) {
+        pane->scanned = true;
+        if (archive_format(pane->file_handle) != ARCHIVE_PLAIN) {
+            pane->compressed = true;
+            read_archive(pool, pane, pane->file_handle);
+            return;
+        }
+
+        int64_t file_size;
+        if (plat_file_size(pane->file_handle, &file_size)) {
+            load_archives(pool, pane, file_size);
+            if (file_size > READ_BUFFER_SIZE) {
+                pane->read_pos = find_scrollback_start(pane->file_handle, file_size, pane->initial_bytes);
+            }
+        }
+    }
+
+    // Keep going while the file grows underneath us
+    while (read_new_content(pool, pane)) {
+    }
+}
+
+static void pool_thread_main(void *arg) {
+    ReaderPool *pool = (ReaderPool *)arg;
+
+    plat_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->stopping && pool->work_count == 0) {
+            plat_cond_wait(&pool->work_ready, &pool->lock);
+        }
+        if (pool->stopping) {
+            break;
+        }
+
+        TailPane *pane = work_pop(pool);
+        pane->active = true;
+        lru_remove(pool, pane);     // Not a close candidate while in use
+        plat_mutex_unlock(&pool->lock);
+
+        service_pane(pool, pane);
+
+        plat_mutex_lock(&pool->lock);
+        pane->active = false;
+        if (pane->file_handle != PLAT_INVALID_HANDLE) {
+            lru_push(pool, pane);
+        }
+        if (pane->rekick) {
+            // Kicked while we were reading - the file may have grown since
+            pane->rekick = false;
+            work_push(pool, pane);
+            plat_cond_signal(&pool->work_ready);
+        }
+    }
+    plat_mutex_unlock(&pool->lock);
+}
+
+bool reader_pool_init(ReaderPool *pool, size_t pane_count, size_t open_budget, PlatSignal *ui_wake) {
+    if (!pool || pane_count == 0) {
+        return false;
+    }
+
+    memset(pool, 0, sizeof(ReaderPool));
+    pool->work = (TailPane **)calloc(pane_count, sizeof(TailPane *));
+    if (!pool->work) {
+        return false;
+    }
+    pool->work_cap = pane_count;
+    pool->ui_wake = ui_wake;
+
+    // Leave room for the console, pipes and watches under the process limit
+    if (open_budget == 0) {
+        size_t limit = plat_open_file_limit();
+        open_budget = READER_DEFAULT_BUDGET;
+        if (limit > 0) {
+            open_budget = limit > READER_RESERVED_FILES * 2 ? limit - READER_RESERVED_FILES : limit / 2;
+        }
+    }
+    if (open_budget < READER_POOL_THREADS) {
+        open_budget = READER_POOL_THREADS;
+    }
+    pool->open_budget = open_budget;
+
+    plat_mutex_init(&pool->lock);
+    plat_cond_init(&pool->work_ready);
+    return true;
+}
+
+bool reader_pool_start(ReaderPool *pool) {
+    size_t threads = pool->work_cap < READER_POOL_THREADS ? pool->work_cap : READER_POOL_THREADS;
+
+    for (size_t i = 0; i < threads; i++) {
+        if (!plat_thread_start(&pool->threads[i], pool_thread_main, pool)) {
+            return pool->thread_count > 0;
+        }
+        pool->thread_count++;
+    }
+    return true;
+}
+
+void reader_pool_destroy(ReaderPool *pool) {
+    if (!pool || !pool->work) {
+        return;
+    }
+
+    plat_mutex_lock(&pool->lock);
+    plat_atomic_store(&pool->stopping, 1);
+    plat_cond_broadcast(&pool->work_ready);
+    plat_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->thread_count; i++) {
+        plat_thread_join(pool->threads[i]);
+    }
+    pool->thread_count = 0;
+
+    plat_cond_destroy(&pool->work_ready);
+    plat_mutex_destroy(&pool->lock);
+    free(pool->work);
+    pool->work = NULL;
+}
+
+void reader_pool_kick(ReaderPool *pool, TailPane *pane) {
+    plat_mutex_lock(&pool->lock);
+    if (pane->active) {
+        pane->rekick = true;
+    } else if (!pane->queued) {
+        work_push(pool, pane);
+        plat_cond_signal(&pool->work_ready);
+    }
+    plat_mutex_unlock(&pool->lock);
+}
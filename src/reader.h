@@ -0,0 +1,55 @@
+#ifndef READER_H
+#define READER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "platform.h"
+#include "pane.h"
+#include "trace.h"
+
+#define READER_POOL_THREADS 4       // Reader threads shared by all panes
+#define READER_RESERVED_FILES 64    // Descriptors left for everything but tailed files
+#define READER_DEFAULT_BUDGET 1024  // Open-file budget when the OS reports no limit
+#define READER_BLOCKED_WAIT_MS 1    // Retry interval while a pane's queue is full
+#define READER_MIN_READ 4096        // Queue room to read into before waiting for more
+
+// A fixed set of threads that read files for any number of panes. Kicked
+// panes wait in a FIFO work list; each is serviced by one thread at a time.
+// At most open_budget files are held open: once the budget is used up, the
+// least recently serviced idle file is closed and reopened when next kicked.
+typedef struct ReaderPool {
+    PlatThread threads[READER_POOL_THREADS];
+    int thread_count;
+
+    PlatMutex lock;             // Guards everything below plus the panes' pool bookkeeping
+    PlatCond work_ready;
+    TailPane **work;            // Ring of kicked panes (each pane at most once)
+    size_t work_head;
+    size_t work_count;
+    size_t work_cap;
+
+    TailPane *lru_head;         // Open, idle panes, least recently serviced first
+    TailPane *lru_tail;
+    size_t open_count;
+    size_t open_budget;
+
+    volatile size_t stopping;   // Set once to shut the threads down
+    PlatSignal *ui_wake;        // Raised after lines are queued for the UI
+    TraceRecorder *trace;       // Appends and rotations are recorded here, or NULL (set before starting)
+} ReaderPool;
+
+// Set up a pool for up to pane_count panes. open_budget 0 picks one from the
+// process descriptor limit.
+bool reader_pool_init(ReaderPool *pool, size_t pane_count, size_t open_budget, PlatSignal *ui_wake);
+
+// Start the reader threads
+bool reader_pool_start(ReaderPool *pool);
+
+// Stop the threads and free the pool. Panes keep their state; files the pool
+// opened are closed by pane_destroy.
+void reader_pool_destroy(ReaderPool *pool);
+
+// Queue the pane for a read pass (its file may have changed)
+void reader_pool_kick(ReaderPool *pool, TailPane *pane);
+
+#endif // READER_H
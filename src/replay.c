@@ -0,0 +1,240 @@
+// Replays a trace recorded with multitail -T.
+//
+// Each traced file becomes a replay_N.log in the output directory, created
+// empty, and the trace's events are played against them on the recorded
+// schedule (or faster): appends write synthetic text of the same size, line
+// count and trailing partial line, truncations empty the file and rotations
+// rename it to replay_N.log.1 and start a new one. Tail the files with
+// multitail -Q to get repeatable end-to-end runs from a production write
+// pattern without its logs.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "platform.h"
+#include "trace.h"
+
+#define REPLAY_TEXT_POOL 65536          // Random text lines are cut from
+#define REPLAY_FILE_BUFFER 65536        // stdio buffer per file (flushed after each event)
+
+typedef struct {
+    FILE *file;
+    char path[PLAT_MAX_PATH];
+    size_t pool_pos;            // Where the next line's text is cut from
+} ReplayFile;
+
+typedef struct {
+    uint64_t events;
+    uint64_t bytes;
+    uint64_t lines;
+    uint64_t restarts;          // Truncations and rotations
+    uint64_t late_max_us;       // Furthest an event fell behind its schedule
+    uint64_t late_total_us;
+} ReplayStats;
+
+// Small deterministic generator so every run writes the same text
+static uint32_t next_random(uint32_t *state) {
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+static void fill_text_pool(char *pool, size_t size) {
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789=:/.-_";
+    uint32_t state = 12345;
+    for (size_t i = 0; i < size; i++) {
+        uint32_t r = next_random(&state);
+        pool[i] = (r % 7 == 0) ? ' ' : alphabet[r % (sizeof(alphabet) - 1)];
+    }
+}
+
+// Write len bytes of text, carrying on through the pool where the last
+// write stopped
+static void write_text(ReplayFile *rf, const char *pool, size_t len) {
+    while (len > 0) {
+        size_t take = REPLAY_TEXT_POOL - rf->pool_pos;
+        if (take > len) {
+            take = len;
+        }
+        fwrite(pool + rf->pool_pos, 1, take, rf->file);
+        rf->pool_pos = (rf->pool_pos + take) % REPLAY_TEXT_POOL;
+        len -= take;
+    }
+}
+
+// Append bytes holding lines line feeds, spread evenly over the lines, with
+// the last one left unfinished for a partial append
+static bool write_append(ReplayFile *rf, const char *pool, const TraceEvent *event) {
+    uint64_t lines = event->lines < event->bytes ? event->lines : event->bytes;
+    uint64_t text = event->bytes - lines;
+    uint64_t segments = lines + (event->partial || lines == 0 ? 1 : 0);
+    for (uint64_t i = 0; i < segments; i++) {
+        write_text(rf, pool, (size_t)(text / segments + (i < text % segments ? 1 : 0)));
+        if (i < lines) {
+            fputc('\n', rf->file);
+        }
+    }
+    return fflush(rf->file) == 0;
+}
+
+// Start the file over empty, keeping the old one as .1 for a rotation
+static bool restart_file(ReplayFile *rf, TraceKind kind) {
+    fclose(rf->file);
+    if (kind == TRACE_ROTATE) {
+        char rotated[PLAT_MAX_PATH + 2];
+        snprintf(rotated, sizeof(rotated), "%s.1", rf->path);
+        if (!plat_rename_over(rf->path, rotated)) {
+            rf->file = NULL;
+            return false;
+        }
+    }
+    rf->file = fopen(rf->path, "wb");
+    if (rf->file) {
+        setvbuf(rf->file, NULL, _IOFBF, REPLAY_FILE_BUFFER);
+    }
+    return rf->file != NULL;
+}
+
+// Wait for an event's turn: speed times faster than it was recorded, or
+// right away for speed 0. Returns how late it is.
+static uint64_t wait_for(uint64_t start_us, uint64_t time_us, double speed) {
+    if (speed <= 0) {
+        return 0;
+    }
+    uint64_t due = start_us + (uint64_t)((double)time_us / speed);
+    uint64_t now = plat_now_us();
+    if (now + 1000 <= due) {
+        plat_sleep_ms((unsigned)((due - now) / 1000));
+        now = plat_now_us();
+    }
+    return now > due ? now - due : 0;
+}
+
+static void print_usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-x speed] [-d dir] [-s secs] trace\n", prog);
+    fprintf(stderr, "Replay the file growth recorded with multitail -T into synthetic logs.\n\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -x speed   - Play speed times faster than recorded (default 1, 0 = no waiting)\n");
+    fprintf(stderr, "  -d dir     - Where to write replay_N.log, one per traced file (default .)\n");
+    fprintf(stderr, "  -s secs    - Wait this long after creating the files before the first event\n");
+}
+
+int main(int argc, char *argv[]) {
+    double speed = 1.0;
+    const char *dir = ".";
+    unsigned long delay = 0;
+
+    int arg = 1;
+    while (arg < argc && argv[arg][0] == '-') {
+        const char *opt = argv[arg];
+        char *end;
+        if (strcmp(opt, "-x") == 0 && arg + 1 < argc) {
+            speed = strtod(argv[++arg], &end);
+            if (*end != '\0' || speed < 0) {
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(opt, "-d") == 0 && arg + 1 < argc) {
+            dir = argv[++arg];
+        } else if (strcmp(opt, "-s") == 0 && arg + 1 < argc) {
+            delay = strtoul(argv[++arg], &end, 10);
+            if (*end != '\0' || delay > 3600) {
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+        arg++;
+    }
+    if (arg + 1 != argc) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    const char *trace_path = argv[arg];
+    TraceReader reader;
+    if (!trace_read_open(&reader, trace_path)) {
+        fprintf(stderr, "Error: Not a trace file: %s\n", trace_path);
+        return 1;
+    }
+
+    char *pool = (char *)malloc(REPLAY_TEXT_POOL);
+    ReplayFile *files = (ReplayFile *)calloc(reader.file_count ? reader.file_count : 1, sizeof(ReplayFile));
+    if (!pool || !files) {
+        free(pool);
+        free(files);
+        trace_read_close(&reader);
+        fprintf(stderr, "Error: Out of memory.\n");
+        return 1;
+    }
+    fill_text_pool(pool, REPLAY_TEXT_POOL);
+
+    int status = 0;
+    uint32_t opened = 0;
+    for (; opened < reader.file_count; opened++) {
+        ReplayFile *rf = &files[opened];
+        snprintf(rf->path, sizeof(rf->path), "%s/replay_%u.log", dir, (unsigned)opened);
+        rf->file = fopen(rf->path, "wb");
+        if (!rf->file) {
+            fprintf(stderr, "Error: Cannot create %s\n", rf->path);
+            status = 1;
+            goto done;
+        }
+        setvbuf(rf->file, NULL, _IOFBF, REPLAY_FILE_BUFFER);
+        rf->pool_pos = (size_t)opened * 4099 % REPLAY_TEXT_POOL;   // Files do not all repeat the same text
+        printf("%s\n", rf->path);
+    }
+    fflush(stdout);
+    plat_sleep_ms((unsigned)(delay * 1000));
+
+    ReplayStats stats;
+    memset(&stats, 0, sizeof(stats));
+    uint64_t start_us = plat_now_us();
+    TraceEvent event;
+    while (trace_read_next(&reader, &event)) {
+        uint64_t late = wait_for(start_us, event.time_us, speed);
+        if (late > stats.late_max_us) {
+            stats.late_max_us = late;
+        }
+        stats.late_total_us += late;
+
+        ReplayFile *rf = &files[event.file];
+        bool ok;
+        if (event.kind == TRACE_APPEND) {
+            ok = write_append(rf, pool, &event);
+            stats.bytes += event.bytes;
+            stats.lines += event.lines;
+        } else {
+            ok = restart_file(rf, event.kind);
+            stats.restarts++;
+        }
+        if (!ok) {
+            fprintf(stderr, "Error: Failed to write %s\n", rf->path);
+            status = 1;
+            goto done;
+        }
+        stats.events++;
+    }
+
+    double secs = (double)(plat_now_us() - start_us) / 1e6;
+    printf("replayed %llu events: %llu lines, %llu bytes, %llu truncations/rotations in %.3f s\n",
+           (unsigned long long)stats.events, (unsigned long long)stats.lines, (unsigned long long)stats.bytes,
+           (unsigned long long)stats.restarts, secs);
+    if (speed > 0 && stats.events > 0) {
+        printf("behind schedule: %.3f ms at most, %.3f ms on average\n", (double)stats.late_max_us / 1000.0,
+               (double)stats.late_total_us / 1000.0 / (double)stats.events);
+    }
+
+done:
+    for (uint32_t i = 0; i < opened; i++) {
+        if (files[i].file) {
+            fclose(files[i].file);
+        }
+    }
+    free(files);
+    free(pool);
+    trace_read_close(&reader);
+    return status;
+}
@@ -0,0 +1,49 @@
+#include "schedule.h"
+#include <string.h>
+
+void schedule_init(Schedule *schedule, unsigned fps) {
+    memset(schedule, 0, sizeof(Schedule));
+    if (fps == 0) {
+        fps = SCHEDULE_DEFAULT_FPS;
+    }
+    schedule->frame_us = 1000000 / fps;
+}
+
+bool schedule_ingest(Schedule *schedule, TailPane *files, int file_count) {
+    if (file_count <= 0) {
+        return false;
+    }
+
+    uint64_t deadline = plat_now_us() + SCHEDULE_SLICE_US;
+    int first = schedule->next_file;
+    schedule->next_file = (first + 1) % file_count;
+
+    // A file that filled its turn may have more; go round until none did
+    bool more = true;
+    while (more) {
+        more = false;
+        for (int n = 0; n < file_count; n++) {
+            TailPane *pane = &files[(first + n) % file_count];
+            if (pane_drain(pane, SCHEDULE_QUANTUM) >= SCHEDULE_QUANTUM) {
+                more = true;
+            }
+        }
+        if (more && plat_now_us() >= deadline) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool schedule_frame_due(const Schedule *schedule, unsigned *wait_ms) {
+    uint64_t since = plat_now_us() - schedule->last_frame_us;
+    if (since >= schedule->frame_us) {
+        return true;
+    }
+    *wait_ms = (unsigned)((schedule->frame_us - since + 999) / 1000);
+    return false;
+}
+
+void schedule_frame_drawn(Schedule *schedule) {
+    schedule->last_frame_us = plat_now_us();
+}
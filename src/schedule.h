@@ -0,0 +1,38 @@
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "pane.h"
+
+#define SCHEDULE_DEFAULT_FPS 30         // Redraws per second at most
+#define SCHEDULE_MAX_FPS 240
+#define SCHEDULE_SLICE_US 8000          // Time spent taking lines per main loop pass
+#define SCHEDULE_QUANTUM (16 * 1024)    // Line bytes taken from one file per turn
+
+// Paces the main loop during write bursts. Lines are taken from the files'
+// queues in small turns, round robin, for at most a time slice per pass, so
+// input is polled and frames drawn in between however much is queued. Frames
+// are capped at a rate: lines arriving in between are drawn together in the
+// next one.
+typedef struct {
+    uint64_t frame_us;          // Shortest time between frames
+    uint64_t last_frame_us;     // When the last frame was drawn
+    int next_file;              // Where the next pass starts taking turns
+} Schedule;
+
+// Set up a schedule drawing at most fps frames a second
+void schedule_init(Schedule *schedule, unsigned fps);
+
+// Take queued lines from the files for up to SCHEDULE_SLICE_US. Each pass
+// starts one file further on, so one busy file cannot starve the rest.
+// Returns true if lines are still queued.
+bool schedule_ingest(Schedule *schedule, TailPane *files, int file_count);
+
+// True if a frame may be drawn now; otherwise *wait_ms is how long until one may
+bool schedule_frame_due(const Schedule *schedule, unsigned *wait_ms);
+
+// Note that a frame was drawn
+void schedule_frame_drawn(Schedule *schedule);
+
+#endif // SCHEDULE_H
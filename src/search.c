@@ -0,0 +1,206 @@
+#include "search.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define WORDS_PER_BLOCK (SEARCH_BLOCK_BITS / 64)
+#define MAX_QUERY_TRIGRAMS 64   // Enough bits to prune with; more add little
+
+typedef struct {
+    uint16_t bits[MAX_QUERY_TRIGRAMS];
+    int count;
+} TrigramQuery;
+
+static unsigned char fold(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? (unsigned char)(c + ('a' - 'A')) : c;
+}
+
+static uint16_t trigram_bit(unsigned char a, unsigned char b, unsigned char c) {
+    uint32_t key = ((uint32_t)a << 16) | ((uint32_t)b << 8) | c;
+    return (uint16_t)((key * 0x9E3779B1u) >> (32 - 11));   // 11 bits -> 2048
+}
+
+static uint64_t *block_of(const SearchIndex *index, uint64_t seq) {
+    return index->blocks[(seq / SEARCH_BLOCK_LINES) % index->block_count];
+}
+
+void search_index_init(SearchIndex *index) {
+    memset(index, 0, sizeof(SearchIndex));
+
+    const char *setting = getenv("MULTITAIL_SEARCH_INDEX");
+    index->enabled = !setting || strcmp(setting, "off") != 0;
+}
+
+void search_index_destroy(SearchIndex *index) {
+    free(index->blocks);
+    index->blocks = NULL;
+    index->block_count = 0;
+}
+
+// Oldest block still in the ring: the newest line's block has taken the
+// slot of the one block_count before it
+static uint64_t first_valid_block(const SearchIndex *index, const LineBuffer *buf) {
+    uint64_t newest = (buf->first_seq + buf->count - 1) / SEARCH_BLOCK_LINES;
+    return newest >= index->block_count ? newest - index->block_count + 1 : 0;
+}
+
+// Make the ring cover buf's uncompressed lines (plus a spare block so the
+// newest never overwrites a live one), moving live blocks to their slots in
+// the new ring
+static bool reserve(SearchIndex *index, const LineBuffer *buf) {
+    size_t need = (buf->count - buf->cold_count) / SEARCH_BLOCK_LINES + 2;
+    if (need <= index->block_count) {
+        return true;
+    }
+
+    size_t count = index->block_count ? index->block_count : 64;
+    while (count < need) {
+        count *= 2;
+    }
+    uint64_t (*blocks)[WORDS_PER_BLOCK] = (uint64_t (*)[WORDS_PER_BLOCK])calloc(count, sizeof(*blocks));
+    if (!blocks) {
+        return false;
+    }
+
+    if (index->blocks && buf->count > 1) {
+        // Everything but the newest line, which is about to be indexed
+        uint64_t first = buf->first_seq / SEARCH_BLOCK_LINES;
+        uint64_t last = (buf->first_seq + buf->count - 2) / SEARCH_BLOCK_LINES;
+        uint64_t valid = last >= index->block_count ? last - index->block_count + 1 : 0;
+        if (first < valid) {
+            first = valid;
+        }
+        for (uint64_t block = first; block <= last; block++) {
+            memcpy(blocks[block % count], index->blocks[block % index->block_count], sizeof(*blocks));
+        }
+    }
+
+    free(index->blocks);
+    index->blocks = blocks;
+    index->block_count = count;
+    return true;
+}
+
+void search_index_add(SearchIndex *index, const LineBuffer *buf) {
+    if (!index->enabled || buf->count == 0) {
+        return;
+    }
+    if (!reserve(index, buf)) {
+        // Searching without an index still works, just slower
+        search_index_destroy(index);
+        index->enabled = false;
+        return;
+    }
+
+    uint64_t seq = buf->first_seq + buf->count - 1;
+    uint64_t *block = block_of(index, seq);
+    if (seq % SEARCH_BLOCK_LINES == 0) {
+        memset(block, 0, WORDS_PER_BLOCK * sizeof(uint64_t));
+    }
+
+    const LineEntry *entry = linebuf_entry(buf, buf->count - 1);
+    if (entry->length > SEARCH_MAX_INDEXED_LINE) {
+        memset(block, 0xFF, WORDS_PER_BLOCK * sizeof(uint64_t));
+        return;
+    }
+
+    const unsigned char *text = (const unsigned char *)entry->text;
+    for (uint32_t i = 0; i + 3 <= entry->length; i++) {
+        uint16_t bit = trigram_bit(fold(text[i]), fold(text[i + 1]), fold(text[i + 2]));
+        block[bit >> 6] |= 1ULL << (bit & 63);
+    }
+}
+
+// Trigram bits a line must have to contain the pattern. Only literals of
+// three or more bytes can be pruned this way.
+static void build_query(const SearchIndex *index, const Pattern *pat, TrigramQuery *query) {
+    query->count = 0;
+    if (!index->blocks || pat->regex || pat->literal_len < 3) {
+        return;
+    }
+
+    const unsigned char *lit = (const unsigned char *)pat->literal;
+    for (size_t i = 0; i + 3 <= pat->literal_len && query->count < MAX_QUERY_TRIGRAMS; i++) {
+        query->bits[query->count++] = trigram_bit(fold(lit[i]), fold(lit[i + 1]), fold(lit[i + 2]));
+    }
+}
+
+static bool block_may_match(const SearchIndex *index, const TrigramQuery *query, uint64_t first_block,
+                            uint64_t seq) {
+    if (seq / SEARCH_BLOCK_LINES < first_block) {
+        return true;    // Compressed history the ring no longer covers
+    }
+    const uint64_t *block = block_of(index, seq);
+    for (int i = 0; i < query->count; i++) {
+        uint16_t bit = query->bits[i];
+        if (!(block[bit >> 6] & (1ULL << (bit & 63)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool search_find(const SearchIndex *index, const LineBuffer *buf, const LineFilter *filter, Pattern *pat,
+                 size_t from_row, bool backward, size_t *found_row, bool *wrapped) {
+    bool filtered = filter_active(filter);
+    size_t rows = filtered ? filter_count(filter) : linebuf_count(buf);
+    *wrapped = false;
+    if (rows == 0 || !pat->source) {
+        return false;
+    }
+    if (from_row >= rows) {
+        from_row = backward ? rows - 1 : 0;
+    }
+
+    TrigramQuery query;
+    build_query(index, pat, &query);
+    uint64_t first_block = query.count > 0 ? first_valid_block(index, buf) : 0;
+
+    size_t row = from_row;
+    size_t remaining = rows;
+    while (remaining > 0) {
+        size_t line = filtered ? filter_line(filter, buf, row) : row;
+        uint64_t seq = buf->first_seq + line;
+        size_t step = 1;
+
+        if (query.count > 0 && !block_may_match(index, &query, first_block, seq)) {
+            // Unfiltered rows are consecutive lines - skip the rest of the block
+            if (!filtered) {
+                size_t offset = (size_t)(seq % SEARCH_BLOCK_LINES);
+                step = backward ? offset + 1 : SEARCH_BLOCK_LINES - offset;
+                if (!backward && step > rows - row) {
+                    step = rows - row;
+                } else if (backward && step > row + 1) {
+                    step = row + 1;
+                }
+            }
+        } else {
+            const LineEntry *entry = linebuf_entry(buf, line);
+            if (entry && pattern_match(pat, entry->text, entry->length)) {
+                *found_row = row;
+                return true;
+            }
+        }
+
+        if (step > remaining) {
+            step = remaining;
+        }
+        remaining -= step;
+
+        // Move, wrapping around the ends
+        if (backward) {
+            if (row < step) {
+                row = rows - (step - row);
+                *wrapped = true;
+            } else {
+                row -= step;
+            }
+        } else {
+            row += step;
+            if (row >= rows) {
+                row -= rows;
+                *wrapped = true;
+            }
+        }
+    }
+    return false;
+}
@@ -0,0 +1,47 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "linebuf.h"
+#include "filter.h"
+#include "pattern.h"
+
+#define SEARCH_BLOCK_LINES 16       // Lines summarized by one trigram bitmap
+#define SEARCH_BLOCK_BITS 2048      // Bits per bitmap
+#define SEARCH_MAX_INDEXED_LINE 1024    // Longer lines just mark their block "may match anything"
+
+// Trigram summary of a scrollback, kept up to date as lines are pushed.
+//
+// Every SEARCH_BLOCK_LINES consecutive lines share a bitmap with one bit set
+// per (case-folded, hashed) trigram they contain. A literal search of three
+// or more bytes only looks at blocks whose bitmap has all of the needle's
+// trigram bits, so repeated searches over a full buffer skip most of it.
+// Bitmaps live in a ring indexed by line sequence number that grows with the
+// uncompressed part of the scrollback; blocks of evicted lines are simply
+// overwritten, and compressed lines the ring no longer covers are scanned.
+// MULTITAIL_SEARCH_INDEX=off disables it.
+typedef struct {
+    uint64_t (*blocks)[SEARCH_BLOCK_BITS / 64];
+    size_t block_count;         // Ring size (covers at least the uncompressed lines)
+    bool enabled;               // False when disabled or out of memory: searches scan every line
+} SearchIndex;
+
+// Set up an empty index
+void search_index_init(SearchIndex *index);
+
+// Free the bitmaps
+void search_index_destroy(SearchIndex *index);
+
+// Record the line just pushed to buf (the newest one)
+void search_index_add(SearchIndex *index, const LineBuffer *buf);
+
+// Find the next view row matching pat, starting at from_row and moving
+// forward (or backward), wrapping around once. Rows are buffer lines, or the
+// filter's passing lines when it is active. *wrapped is set if the search
+// went past the end (start).
+bool search_find(const SearchIndex *index, const LineBuffer *buf, const LineFilter *filter, Pattern *pat,
+                 size_t from_row, bool backward, size_t *found_row, bool *wrapped);
+
+#endif // SEARCH_H
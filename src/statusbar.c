@@ -1,39 +1,107 @@
 #include "statusbar.h"
 #include <stdio.h>
 
-void statusbar_render(Console *con, TailPane *panes, int pane_count, int active_pane) {
+// Byte count as KB below a megabyte, MB above
+static void format_size(char *out, size_t out_size, size_t bytes) {
+    if (bytes < 1024 * 1024) {
+        snprintf(out, out_size, "%zu KB", (bytes + 1023) / 1024);
+    } else {
+        snprintf(out, out_size, "%.1f MB", (double)bytes / (1024.0 * 1024.0));
+    }
+}
+
+// Ingest rate, lag, render time and buffer churn of a pane, over the
+// bottom row of the pane area
+static void render_metrics(Console *con, int row, const TailPane *pane) {
+    MetricsIngest ingest;
+    metrics_ingest(pane, &ingest);
+    const PaneMetrics *metrics = &pane->metrics;
+
+    char rate[16];
+    char lag[16];
+    format_size(rate, sizeof(rate), ingest.bytes_per_sec);
+    format_size(lag, sizeof(lag), ingest.lag_bytes);
+
+    char text[256];
+    snprintf(text, sizeof(text),
+        " in %s/s, %zu lines/s | lag %s | render %.2f ms, peak %.2f ms | %zu frames | %llu evicted | %zu allocs",
+        rate, ingest.lines_per_sec, lag, (double)metrics->render_us / 1000.0,
+        (double)metrics->last_peak_us / 1000.0, metrics->frames, (unsigned long long)pane->buffer.first_seq,
+        pane->buffer.allocations);
+
+    console_fill_row(con, row, ' ', COLOR_STATUS);
+    console_write_at(con, row, 0, text, COLOR_STATUS);
+}
+
+void statusbar_render(Console *con, TailPane *panes, int pane_count, int active_pane, const char *prompt,
+                      bool show_metrics) {
     if (!con || !panes || pane_count <= 0) {
         return;
     }
 
     int status_row = con->height - 1;
+    if (show_metrics && status_row > 0) {
+        render_metrics(con, status_row - 1, &panes[active_pane]);
+    }
 
     // Fill status bar background
     console_fill_row(con, status_row, ' ', COLOR_STATUS);
 
+    if (prompt) {
+        console_write_at(con, status_row, 0, prompt, COLOR_STATUS);
+        return;
+    }
+
     // Get active pane info
     TailPane *active = &panes[active_pane];
-    size_t line_count = linebuf_count(&active->buffer);
+    size_t line_count = pane_line_count(active);
     size_t view_line = active->view_line;
 
+    // Filtered views count matching lines out of the whole scrollback
+    char total[32] = "";
+    if (filter_active(&active->filter)) {
+        snprintf(total, sizeof(total), " of %zu", linebuf_count(&active->buffer));
+    }
+
+    // Scrollback memory of this pane against everything the budget allows
+    char memory[64] = "";
+    const LineBudget *budget = active->buffer.budget;
+    if (budget) {
+        char own[16];
+        char used[16];
+        format_size(own, sizeof(own), linebuf_bytes(&active->buffer));
+        format_size(used, sizeof(used), budget->used);
+        snprintf(memory, sizeof(memory), " | %s (%s of %zu MB)", own, used, budget->limit / (1024 * 1024));
+    }
+
     // Build status text
-    char status[256];
+    char status[320];
     if (active->following) {
         snprintf(status, sizeof(status),
-            " Pane %d/%d | LIVE (%zu lines) | Tab:next  Arrows:scroll  End:follow  Q:quit",
-            active_pane + 1, pane_count, line_count);
+            " Pane %d/%d | LIVE (%zu%s lines)%s | Tab:next  Arrows:scroll  End:follow  F/X/C:filter  /?nN:search  Q:quit",
+            active_pane + 1, pane_count, line_count, total, memory);
     } else {
         // Calculate visible range
-        size_t view_end = view_line + active->content_height;
+        size_t view_end = active->view_end;
         if (view_end > line_count) {
             view_end = line_count;
         }
 
         snprintf(status, sizeof(status),
-            " Pane %d/%d | SCROLL %zu-%zu/%zu | Tab:next  Arrows:scroll  End:follow  Q:quit",
+            " Pane %d/%d | SCROLL %zu-%zu/%zu%s%s | Tab:next  Arrows:scroll  End:follow  F/X/C:filter  /?nN:search  Q:quit",
             active_pane + 1, pane_count,
-            view_line + 1, view_end, line_count);
+            view_line + 1, view_end, line_count, total, memory);
     }
 
     console_write_at(con, status_row, 0, status, COLOR_STATUS);
+
+    // Output cost of the previous frame, right-aligned
+    if (con->show_frame_stats) {
+        char stats[64];
+        int len = snprintf(stats, sizeof(stats), " frame: %zu cells %zu B %zu calls ",
+            con->last_frame.cells, con->last_frame.bytes, con->last_frame.calls);
+        if (len > 0 && len < con->width) {
+            console_write_at(con, status_row, con->width - len, stats, COLOR_STATUS);
+        }
+    }
 }
@@ -4,7 +4,10 @@
 #include "console.h"
 #include "pane.h"
 
-// Render the status bar at the bottom of the console
-void statusbar_render(Console *con, TailPane *panes, int pane_count, int active_pane);
+// Render the status bar at the bottom of the console. A non-NULL prompt
+// (text being typed, or a message) replaces the pane summary. With
+// show_metrics, the row above it shows the active pane's metrics.
+void statusbar_render(Console *con, TailPane *panes, int pane_count, int active_pane, const char *prompt,
+                      bool show_metrics);
 
 #endif // STATUSBAR_H
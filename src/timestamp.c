@@ -0,0 +1,181 @@
+#include "timestamp.h"
+#include <string.h>
+#include <time.h>
+
+#define MS_PER_DAY 86400000LL
+
+static bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// Value of n digits at p, or -1 if any is not a digit
+static int digits(const char *p, int n) {
+    int value = 0;
+    for (int i = 0; i < n; i++) {
+        if (!is_digit(p[i])) {
+            return -1;
+        }
+        value = value * 10 + (p[i] - '0');
+    }
+    return value;
+}
+
+// Days since 1970-01-01 of a proleptic Gregorian date
+static int64_t days_from_civil(int y, int m, int d) {
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+// hh:mm:ss at p (8 bytes available), as ms into the day
+static bool parse_clock(const char *p, int64_t *ms) {
+    int h = digits(p, 2);
+    int m = digits(p + 3, 2);
+    int s = digits(p + 6, 2);
+    if (h < 0 || m < 0 || s < 0 || p[2] != ':' || p[5] != ':' || h > 23 || m > 59 || s > 60) {
+        return false;
+    }
+    *ms = ((int64_t)h * 3600 + m * 60 + s) * 1000;
+    return true;
+}
+
+// Optional fraction of a second: its first three digits as ms
+static size_t parse_fraction(const char *p, size_t len, int64_t *ms) {
+    if (len < 2 || (p[0] != '.' && p[0] != ',') || !is_digit(p[1])) {
+        return 0;
+    }
+    size_t i = 1;
+    int scale = 100;
+    while (i < len && is_digit(p[i])) {
+        if (scale > 0) {
+            *ms += (p[i] - '0') * scale;
+            scale /= 10;
+        }
+        i++;
+    }
+    return i;
+}
+
+// Optional zone: Z or +hh[:mm] / -hhmm, as the offset to subtract
+static void parse_zone(const char *p, size_t len, int64_t *ms) {
+    if (len < 3 || (p[0] != '+' && p[0] != '-')) {
+        return;     // 'Z' and no zone are both UTC
+    }
+    int h = digits(p + 1, 2);
+    int m = 0;
+    if (len >= 6 && p[3] == ':') {
+        m = digits(p + 4, 2);
+    } else if (len >= 5 && is_digit(p[3])) {
+        m = digits(p + 3, 2);
+    }
+    if (h < 0 || m < 0 || h > 23 || m > 59) {
+        return;
+    }
+    int64_t offset = ((int64_t)h * 60 + m) * 60000;
+    *ms += p[0] == '+' ? -offset : offset;
+}
+
+static bool parse_iso(const char *p, size_t len, int64_t *ms) {
+    if (len < 19 || (p[4] != '-' && p[4] != '/') || p[7] != p[4] || (p[10] != 'T' && p[10] != ' ')) {
+        return false;
+    }
+    int y = digits(p, 4);
+    int mo = digits(p + 5, 2);
+    int d = digits(p + 8, 2);
+    int64_t clock;
+    if (y < 0 || mo < 1 || mo > 12 || d < 1 || d > 31 || !parse_clock(p + 11, &clock)) {
+        return false;
+    }
+
+    *ms = days_from_civil(y, mo, d) * MS_PER_DAY + clock;
+    size_t pos = 19 + parse_fraction(p + 19, len - 19, ms);
+    parse_zone(p + pos, len - pos, ms);
+    return true;
+}
+
+static bool parse_syslog(const char *p, size_t len, int year, int64_t *ms) {
+    static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    if (len < 15 || p[3] != ' ') {
+        return false;
+    }
+    const char *month = NULL;
+    for (int i = 0; i < 12 && !month; i++) {
+        if (memcmp(p, months + i * 3, 3) == 0) {
+            month = months + i * 3;
+        }
+    }
+    if (!month) {
+        return false;
+    }
+
+    // Day is space padded: "Oct  7"
+    int d = p[4] == ' ' ? digits(p + 5, 1) : digits(p + 4, 2);
+    int64_t clock;
+    if (d < 1 || d > 31 || p[6] != ' ' || !parse_clock(p + 7, &clock)) {
+        return false;
+    }
+    int mo = (int)(month - months) / 3 + 1;
+    *ms = days_from_civil(year, mo, d) * MS_PER_DAY + clock;
+    parse_fraction(p + 15, len - 15, ms);
+    return true;
+}
+
+static bool parse_epoch(const char *p, size_t len, int64_t *ms) {
+    size_t n = 0;
+    int64_t value = 0;
+    while (n < len && n < 14 && is_digit(p[n])) {
+        value = value * 10 + (p[n] - '0');
+        n++;
+    }
+    if (n < len && is_digit(p[n])) {
+        return false;
+    }
+    if (n == 13) {
+        *ms = value;
+        return true;
+    }
+    if (n != 10) {
+        return false;
+    }
+    *ms = value * 1000;
+    parse_fraction(p + n, len - n, ms);
+    return true;
+}
+
+bool timestamp_parse(const char *text, size_t len, int year, int64_t *ms) {
+    size_t pos = 0;
+    while (pos < len && pos < 8 && text[pos] == ' ') {
+        pos++;
+    }
+    if (pos < len && text[pos] == '<') {
+        size_t end = pos + 1;
+        while (end < len && end < pos + 5 && is_digit(text[end])) {
+            end++;
+        }
+        if (end < len && text[end] == '>') {
+            pos = end + 1;
+        }
+    }
+    if (pos < len && text[pos] == '[') {
+        pos++;
+    }
+
+    const char *p = text + pos;
+    len -= pos;
+    if (len == 0) {
+        return false;
+    }
+    if (is_digit(p[0])) {
+        return (len >= 5 && !is_digit(p[4])) ? parse_iso(p, len, ms) : parse_epoch(p, len, ms);
+    }
+    return parse_syslog(p, len, year, ms);
+}
+
+int timestamp_current_year(void) {
+    time_t now = time(NULL);
+    struct tm *utc = gmtime(&now);
+    return utc ? utc->tm_year + 1900 : 1970;
+}
@@ -0,0 +1,25 @@
+#ifndef TIMESTAMP_H
+#define TIMESTAMP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Fixed-format parser for the timestamp a log line starts with, after
+// optional spaces, a syslog priority ("<134>") and a '[':
+// - ISO-8601 / RFC 3339: 2026-10-17T12:00:00.123+02:00 ('T' or a space
+//   between date and time, '/' allowed in the date, fraction and zone
+//   optional)
+// - syslog: Oct 17 12:00:00 (in the given year)
+// - Unix time: 10 digits of seconds (optional fraction) or 13 of ms
+// Times without a zone are taken as UTC, so only compare them with times
+// written in the same zone.
+
+// Parse the start of text into milliseconds since the epoch. Returns false
+// if the line does not start with one of the formats.
+bool timestamp_parse(const char *text, size_t len, int year, int64_t *ms);
+
+// The current year (UTC), for syslog times
+int timestamp_current_year(void);
+
+#endif // TIMESTAMP_H
@@ -0,0 +1,165 @@
+#include "trace.h"
+#include <string.h>
+
+#define VARINT_MAX 10               // Bytes a 64-bit varint takes at most
+#define EVENT_MAX (VARINT_MAX * 4)  // Bytes one event takes at most
+
+static size_t put_varint(unsigned char *out, uint64_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (unsigned char)value;
+    return n;
+}
+
+// Returns false at the end of the file or on a varint that runs too long
+static bool get_varint(FILE *file, uint64_t *value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int c = fgetc(file);
+        if (c == EOF) {
+            return false;
+        }
+        *value |= (uint64_t)(c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Write out the buffered events (lock held)
+static void flush(TraceRecorder *trace) {
+    if (trace->used > 0 && !trace->failed && fwrite(trace->buf, 1, trace->used, trace->file) != trace->used) {
+        trace->failed = true;
+    }
+    trace->used = 0;
+}
+
+bool trace_open(TraceRecorder *trace, const char *path, uint32_t file_count) {
+    memset(trace, 0, sizeof(TraceRecorder));
+    if (file_count > TRACE_MAX_FILES) {
+        return false;
+    }
+    trace->file = fopen(path, "wb");
+    if (!trace->file) {
+        return false;
+    }
+
+    memcpy(trace->buf, TRACE_MAGIC, strlen(TRACE_MAGIC));
+    trace->used = strlen(TRACE_MAGIC);
+    trace->used += put_varint(trace->buf + trace->used, file_count);
+    plat_mutex_init(&trace->lock);
+    trace->last_us = plat_now_us();
+    return true;
+}
+
+uint64_t trace_count_lines(const char *data, size_t len) {
+    uint64_t lines = 0;
+    const char *end = data + len;
+    while ((data = memchr(data, '\n', (size_t)(end - data))) != NULL) {
+        lines++;
+        data++;
+    }
+    return lines;
+}
+
+static void add_event(TraceRecorder *trace, uint32_t file, TraceKind kind, uint64_t bytes, uint64_t lines,
+                      bool partial) {
+    plat_mutex_lock(&trace->lock);
+    if (trace->used + EVENT_MAX > TRACE_BUFFER_SIZE) {
+        flush(trace);
+    }
+
+    // Threads can take the lock out of time order: such an event is as
+    // good as simultaneous with the one before
+    uint64_t now = plat_now_us();
+    uint64_t delta = now > trace->last_us ? now - trace->last_us : 0;
+    trace->last_us += delta;
+
+    unsigned char *out = trace->buf + trace->used;
+    size_t n = put_varint(out, delta);
+    n += put_varint(out + n, (uint64_t)file << 3 | (uint64_t)partial << 2 | (uint64_t)kind);
+    if (kind == TRACE_APPEND) {
+        n += put_varint(out + n, bytes);
+        n += put_varint(out + n, lines);
+    }
+    trace->used += n;
+    trace->events++;
+    plat_mutex_unlock(&trace->lock);
+}
+
+void trace_append(TraceRecorder *trace, uint32_t file, uint64_t bytes, uint64_t lines, bool partial) {
+    if (bytes > 0) {
+        add_event(trace, file, TRACE_APPEND, bytes, lines, partial);
+    }
+}
+
+void trace_restart(TraceRecorder *trace, uint32_t file, TraceKind kind) {
+    add_event(trace, file, kind, 0, 0, false);
+}
+
+bool trace_close(TraceRecorder *trace) {
+    if (!trace->file) {
+        return true;
+    }
+    flush(trace);
+    if (fclose(trace->file) != 0) {
+        trace->failed = true;
+    }
+    trace->file = NULL;
+    plat_mutex_destroy(&trace->lock);
+    return !trace->failed;
+}
+
+bool trace_read_open(TraceReader *reader, const char *path) {
+    memset(reader, 0, sizeof(TraceReader));
+    reader->file = fopen(path, "rb");
+    if (!reader->file) {
+        return false;
+    }
+
+    char magic[sizeof(TRACE_MAGIC) - 1];
+    uint64_t file_count;
+    if (fread(magic, 1, sizeof(magic), reader->file) != sizeof(magic) ||
+        memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0 || !get_varint(reader->file, &file_count) ||
+        file_count > TRACE_MAX_FILES) {
+        trace_read_close(reader);
+        return false;
+    }
+    reader->file_count = (uint32_t)file_count;
+    return true;
+}
+
+bool trace_read_next(TraceReader *reader, TraceEvent *event) {
+    uint64_t delta;
+    uint64_t flags;
+    if (!get_varint(reader->file, &delta) || !get_varint(reader->file, &flags)) {
+        return false;
+    }
+
+    memset(event, 0, sizeof(TraceEvent));
+    event->kind = (TraceKind)(flags & 3);
+    event->partial = (flags & 4) != 0;
+    if ((flags >> 3) >= reader->file_count || event->kind > TRACE_ROTATE) {
+        return false;
+    }
+    event->file = (uint32_t)(flags >> 3);
+    if (event->kind == TRACE_APPEND &&
+        (!get_varint(reader->file, &event->bytes) || !get_varint(reader->file, &event->lines))) {
+        return false;
+    }
+
+    reader->time_us += delta;
+    event->time_us = reader->time_us;
+    return true;
+}
+
+void trace_read_close(TraceReader *reader) {
+    if (reader->file) {
+        fclose(reader->file);
+        reader->file = NULL;
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "platform.h"
+
+#define TRACE_MAGIC "MTTRACE1"      // First bytes of a trace file
+#define TRACE_BUFFER_SIZE 65536     // Events are written out in batches of this many bytes
+#define TRACE_MAX_FILES 65536       // Files a trace can describe
+
+// What happened to a file
+typedef enum {
+    TRACE_APPEND,                   // It grew
+    TRACE_TRUNCATE,                 // It was cut back (copytruncate rotation)
+    TRACE_ROTATE                    // A new file took its name (rename rotation)
+} TraceKind;
+
+// One event: when it was seen, to which file, and for an append how much
+// arrived. The contents are never recorded.
+typedef struct {
+    uint64_t time_us;               // Since recording started
+    uint32_t file;                  // Index among the tailed files
+    TraceKind kind;
+    uint64_t bytes;                 // Bytes appended
+    uint64_t lines;                 // Line feeds among them
+    bool partial;                   // The append ended inside a line
+} TraceEvent;
+
+// Records what the readers see of the tailed files, so a production write
+// pattern can be replayed elsewhere (multitail_replay) without its logs.
+//
+// The file holds TRACE_MAGIC and the file count, then one event after
+// another: the microseconds since the previous one, the file index and
+// kind (file << 3 | partial << 2 | kind), and for an append its bytes and
+// lines, each a LEB128 varint. A steady append takes about six bytes.
+// Reader threads add events under a lock into a buffer written out when full
+// and on close.
+typedef struct {
+    FILE *file;
+    PlatMutex lock;
+    uint64_t last_us;               // Time of the last event (deltas are from it)
+    unsigned char buf[TRACE_BUFFER_SIZE];
+    size_t used;
+    uint64_t events;
+    bool failed;                    // A write failed; the rest is dropped
+} TraceRecorder;
+
+// Reads a trace back event by event
+typedef struct {
+    FILE *file;
+    uint32_t file_count;
+    uint64_t time_us;
+} TraceReader;
+
+// Start recording to path, for file_count files. Returns false if it cannot
+// be created.
+bool trace_open(TraceRecorder *trace, const char *path, uint32_t file_count);
+
+// Line feeds in data (what trace_append wants for lines)
+uint64_t trace_count_lines(const char *data, size_t len);
+
+// Record that bytes holding lines line feeds were appended to a file,
+// partial if they end inside a line
+void trace_append(TraceRecorder *trace, uint32_t file, uint64_t bytes, uint64_t lines, bool partial);
+
+// Record a truncation or rotation of a file
+void trace_restart(TraceRecorder *trace, uint32_t file, TraceKind kind);
+
+// Write out the rest and close. Returns false if any write failed.
+bool trace_close(TraceRecorder *trace);
+
+// Open a trace for reading. Returns false if it cannot be read or is not a
+// trace.
+bool trace_read_open(TraceReader *reader, const char *path);
+
+// The next event. Returns false at the end (or where the file is cut off).
+bool trace_read_next(TraceReader *reader, TraceEvent *event);
+
+// Close a trace opened for reading
+void trace_read_close(TraceReader *reader);
+
+#endif // TRACE_H
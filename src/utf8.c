@@ -0,0 +1,189 @@
+#include "utf8.h"
+#include <stdbool.h>
+#include "linescan.h"
+
+typedef struct {
+    uint32_t first;
+    uint32_t last;
+} CodeRange;
+
+// Characters taking two columns: East Asian Wide and Fullwidth, and the
+// emoji blocks terminals draw wide
+static const CodeRange wide_ranges[] = {
+    {0x1100, 0x115F}, {0x231A, 0x231B}, {0x2329, 0x232A}, {0x23E9, 0x23EC}, {0x23F0, 0x23F0},
+    {0x23F3, 0x23F3}, {0x25FD, 0x25FE}, {0x2614, 0x2615}, {0x2648, 0x2653}, {0x267F, 0x267F},
+    {0x2693, 0x2693}, {0x26A1, 0x26A1}, {0x26AA, 0x26AB}, {0x26BD, 0x26BE}, {0x26C4, 0x26C5},
+    {0x26CE, 0x26CE}, {0x26D4, 0x26D4}, {0x26EA, 0x26EA}, {0x26F2, 0x26F3}, {0x26F5, 0x26F5},
+    {0x26FA, 0x26FA}, {0x26FD, 0x26FD}, {0x2705, 0x2705}, {0x270A, 0x270B}, {0x2728, 0x2728},
+    {0x274C, 0x274C}, {0x274E, 0x274E}, {0x2753, 0x2755}, {0x2757, 0x2757}, {0x2795, 0x2797},
+    {0x27B0, 0x27B0}, {0x27BF, 0x27BF}, {0x2B1B, 0x2B1C}, {0x2B50, 0x2B50}, {0x2B55, 0x2B55},
+    {0x2E80, 0x303E}, {0x3041, 0x33FF}, {0x3400, 0x4DBF}, {0x4E00, 0x9FFF}, {0xA000, 0xA4CF},
+    {0xA960, 0xA97F}, {0xAC00, 0xD7A3}, {0xF900, 0xFAFF}, {0xFE10, 0xFE19}, {0xFE30, 0xFE6F},
+    {0xFF00, 0xFF60}, {0xFFE0, 0xFFE6}, {0x16FE0, 0x16FE4}, {0x17000, 0x18CFF}, {0x1B000, 0x1B2FF},
+    {0x1F004, 0x1F004}, {0x1F0CF, 0x1F0CF}, {0x1F18E, 0x1F18E}, {0x1F191, 0x1F19A}, {0x1F200, 0x1F251},
+    {0x1F300, 0x1F64F}, {0x1F680, 0x1F6FF}, {0x1F7E0, 0x1F7EB}, {0x1F900, 0x1F9FF}, {0x1FA70, 0x1FAFF},
+    {0x20000, 0x2FFFD}, {0x30000, 0x3FFFD},
+};
+
+// Characters taking no column: combining marks, joiners, direction marks,
+// variation selectors and the byte order mark
+static const CodeRange zero_ranges[] = {
+    {0x0300, 0x036F}, {0x0483, 0x0489}, {0x0591, 0x05BD}, {0x05BF, 0x05BF}, {0x05C1, 0x05C2},
+    {0x05C4, 0x05C5}, {0x05C7, 0x05C7}, {0x0610, 0x061A}, {0x064B, 0x065F}, {0x0670, 0x0670},
+    {0x06D6, 0x06DC}, {0x06DF, 0x06E4}, {0x06E7, 0x06E8}, {0x06EA, 0x06ED}, {0x0E31, 0x0E31},
+    {0x0E34, 0x0E3A}, {0x0E47, 0x0E4E}, {0x1160, 0x11FF}, {0x1AB0, 0x1AFF}, {0x1DC0, 0x1DFF},
+    {0x200B, 0x200F}, {0x202A, 0x202E}, {0x2060, 0x2064}, {0x20D0, 0x20FF}, {0xFE00, 0xFE0F},
+    {0xFE20, 0xFE2F}, {0xFEFF, 0xFEFF}, {0xE0000, 0xE007F}, {0xE0100, 0xE01EF},
+};
+
+static bool in_ranges(uint32_t cp, const CodeRange *ranges, size_t count) {
+    if (cp < ranges[0].first || cp > ranges[count - 1].last) {
+        return false;
+    }
+
+    size_t low = 0;
+    size_t high = count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (cp > ranges[mid].last) {
+            low = mid + 1;
+        } else if (cp < ranges[mid].first) {
+            high = mid;
+        } else {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool continuation(unsigned char c) {
+    return (c & 0xC0) == 0x80;
+}
+
+size_t utf8_decode(const char *text, size_t len, uint32_t *cp) {
+    const unsigned char *s = (const unsigned char *)text;
+    unsigned char lead = s[0];
+    if (lead < 0x80) {
+        *cp = lead;
+        return 1;
+    }
+
+    // Sequence length and the range of the second byte (excludes overlong
+    // forms, surrogates and anything past U+10FFFF)
+    size_t n = 0;
+    unsigned char low = 0x80;
+    unsigned char high = 0xBF;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        n = 2;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        n = 3;
+        low = lead == 0xE0 ? 0xA0 : 0x80;
+        high = lead == 0xED ? 0x9F : 0xBF;
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        n = 4;
+        low = lead == 0xF0 ? 0x90 : 0x80;
+        high = lead == 0xF4 ? 0x8F : 0xBF;
+    }
+    if (n == 0 || len < n || s[1] < low || s[1] > high) {
+        *cp = UTF8_REPLACEMENT;
+        return 1;
+    }
+
+    uint32_t value = lead & (0x7F >> n);
+    for (size_t i = 1; i < n; i++) {
+        if (!continuation(s[i])) {
+            *cp = UTF8_REPLACEMENT;
+            return 1;
+        }
+        value = (value << 6) | (s[i] & 0x3F);
+    }
+    *cp = value;
+    return n;
+}
+
+size_t utf8_encode(uint32_t cp, char *out) {
+    if (cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) {
+        cp = UTF8_REPLACEMENT;
+    }
+    if (cp < 0x80) {
+        out[0] = (char)cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+int utf8_char_width(uint32_t cp) {
+    if (cp < 0x300) {
+        return 1;
+    }
+    if (in_ranges(cp, wide_ranges, sizeof(wide_ranges) / sizeof(wide_ranges[0]))) {
+        return 2;
+    }
+    if (in_ranges(cp, zero_ranges, sizeof(zero_ranges) / sizeof(zero_ranges[0]))) {
+        return 0;
+    }
+    return 1;
+}
+
+size_t utf8_width(const char *text, size_t len) {
+    size_t columns = 0;
+    size_t i = 0;
+    while (i < len) {
+        // ASCII runs are one column a byte
+        size_t ascii = linescan_find_non_ascii(text + i, len - i);
+        columns += ascii;
+        i += ascii;
+        if (i >= len) {
+            break;
+        }
+
+        uint32_t cp;
+        i += utf8_decode(text + i, len - i, &cp);
+        columns += (size_t)utf8_char_width(cp);
+    }
+    return columns;
+}
+
+size_t utf8_fit(const char *text, size_t len, size_t columns, size_t *used) {
+    size_t taken = 0;
+    size_t i = 0;
+    for (;;) {
+        size_t room = columns - taken;
+        size_t ascii = linescan_find_non_ascii(text + i, len - i < room ? len - i : room);
+        taken += ascii;
+        i += ascii;
+        if (i >= len || (taken == columns && (unsigned char)text[i] < 0x80)) {
+            break;
+        }
+
+        // Zero-width characters still fit once the columns are used up
+        uint32_t cp;
+        size_t n = utf8_decode(text + i, len - i, &cp);
+        size_t width = (size_t)utf8_char_width(cp);
+        if (taken + width > columns) {
+            break;
+        }
+        taken += width;
+        i += n;
+    }
+
+    if (used) {
+        *used = taken;
+    }
+    return i;
+}
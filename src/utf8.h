@@ -0,0 +1,33 @@
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define UTF8_REPLACEMENT 0xFFFD     // Shown for bytes that are not valid UTF-8
+
+// Decode the character at the start of text (len > 0) into *cp. Returns the
+// bytes it takes. A malformed, overlong, truncated or surrogate sequence
+// decodes as UTF8_REPLACEMENT taking one byte, so the next valid character
+// is still found.
+size_t utf8_decode(const char *text, size_t len, uint32_t *cp);
+
+// Encode cp into out (room for 4 bytes). Returns the bytes written.
+size_t utf8_encode(uint32_t cp, char *out);
+
+// Columns a character takes on screen: 2 for East Asian wide and fullwidth
+// characters (CJK, Hangul, most emoji), 0 for combining marks and other
+// zero-width characters, 1 otherwise. Control characters count 1: they are
+// shown as spaces.
+int utf8_char_width(uint32_t cp);
+
+// Columns text takes
+size_t utf8_width(const char *text, size_t len);
+
+// Bytes of the longest start of text that fits in columns, without
+// splitting a character; zero-width characters right after it are
+// included. *used (if not NULL) is set to the columns it takes: fewer than
+// columns when text runs out first or a wide character did not fit.
+size_t utf8_fit(const char *text, size_t len, size_t columns, size_t *used);
+
+#endif // UTF8_H
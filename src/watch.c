@@ -0,0 +1,161 @@
+#include "watch.h"
+#include <stdlib.h>
+#include <string.h>
+
+static char *copy_string(const char *text) {
+    size_t len = strlen(text) + 1;
+    char *copy = (char *)malloc(len);
+    if (copy) {
+        memcpy(copy, text, len);
+    }
+    return copy;
+}
+
+bool watch_tables_init(FileWatch *watch, int pane_count) {
+    memset(watch, 0, sizeof(FileWatch));
+    watch->notify_handle = PLAT_INVALID_HANDLE;
+    watch->last_full_check = plat_now_ms();
+
+    if (pane_count <= 0) {
+        return true;
+    }
+
+    size_t count = (size_t)pane_count;
+    watch->pane_dir = (int *)malloc(count * sizeof(int));
+    watch->pane_next = (int *)malloc(count * sizeof(int));
+    watch->pane_names = (char **)calloc(count, sizeof(char *));
+    watch->pane_changed = (bool *)malloc(count * sizeof(bool));
+    if (!watch->pane_dir || !watch->pane_next || !watch->pane_names || !watch->pane_changed) {
+        watch_tables_free(watch);
+        return false;
+    }
+
+    watch->pane_count = pane_count;
+    watch->unwatched_count = pane_count;
+    for (int i = 0; i < pane_count; i++) {
+        watch->pane_dir[i] = -1;
+        watch->pane_next[i] = -1;
+        watch->pane_changed[i] = true;
+    }
+    return true;
+}
+
+void watch_tables_free(FileWatch *watch) {
+    for (int i = 0; i < watch->dir_count; i++) {
+        free(watch->dir_paths[i]);
+    }
+    free(watch->dir_handles);
+    free(watch->dir_paths);
+    free(watch->dir_first_pane);
+    free(watch->wd_dir);
+
+    if (watch->pane_names) {
+        for (int i = 0; i < watch->pane_count; i++) {
+            free(watch->pane_names[i]);
+        }
+    }
+    free(watch->pane_names);
+    free(watch->pane_dir);
+    free(watch->pane_next);
+    free(watch->pane_changed);
+
+    PlatHandle notify_handle = watch->notify_handle;
+    memset(watch, 0, sizeof(FileWatch));
+    watch->notify_handle = notify_handle;
+}
+
+int watch_add_dir(FileWatch *watch, PlatHandle handle, const char *path) {
+    if (watch->dir_count == watch->dir_cap) {
+        int new_cap = watch->dir_cap ? watch->dir_cap * 2 : 16;
+        PlatHandle *handles = (PlatHandle *)realloc(watch->dir_handles, (size_t)new_cap * sizeof(PlatHandle));
+        if (!handles) {
+            return -1;
+        }
+        watch->dir_handles = handles;
+
+        char **paths = (char **)realloc(watch->dir_paths, (size_t)new_cap * sizeof(char *));
+        if (!paths) {
+            return -1;
+        }
+        watch->dir_paths = paths;
+
+        int *first = (int *)realloc(watch->dir_first_pane, (size_t)new_cap * sizeof(int));
+        if (!first) {
+            return -1;
+        }
+        watch->dir_first_pane = first;
+        watch->dir_cap = new_cap;
+    }
+
+    char *copy = copy_string(path);
+    if (!copy) {
+        return -1;
+    }
+
+    int index = watch->dir_count++;
+    watch->dir_handles[index] = handle;
+    watch->dir_paths[index] = copy;
+    watch->dir_first_pane[index] = -1;
+    return index;
+}
+
+void watch_attach_pane(FileWatch *watch, int pane_index, int dir_index) {
+    if (dir_index < 0 || watch->pane_dir[pane_index] >= 0) {
+        return;
+    }
+
+    watch->pane_dir[pane_index] = dir_index;
+    watch->pane_next[pane_index] = watch->dir_first_pane[dir_index];
+    watch->dir_first_pane[dir_index] = pane_index;
+    watch->unwatched_count--;
+}
+
+void watch_mark_dir(FileWatch *watch, int dir_index) {
+    for (int i = watch->dir_first_pane[dir_index]; i >= 0; i = watch->pane_next[i]) {
+        watch->pane_changed[i] = true;
+    }
+}
+
+void watch_mark_all(FileWatch *watch) {
+    for (int i = 0; i < watch->pane_count; i++) {
+        watch->pane_changed[i] = true;
+    }
+}
+
+void watch_mark_backstop(FileWatch *watch) {
+    uint64_t now = plat_now_ms();
+    if (now - watch->last_full_check >= WATCH_BACKSTOP_MS) {
+        watch->last_full_check = now;
+        watch_mark_all(watch);
+    }
+}
+
+void watch_mark_timeout(FileWatch *watch) {
+    if (watch->unwatched_count > 0) {
+        for (int i = 0; i < watch->pane_count; i++) {
+            if (watch->pane_dir[i] < 0) {
+                watch->pane_changed[i] = true;
+            }
+        }
+    }
+}
+
+unsigned watch_timeout(const FileWatch *watch, unsigned poll_interval_ms) {
+    if (watch->unwatched_count > 0) {
+        return poll_interval_ms;
+    }
+
+    // Writes over network filesystems and cached writes can raise no events,
+    // so keep a slow backstop
+    return WATCH_BACKSTOP_MS;
+}
+
+bool watch_take_change(FileWatch *watch, int pane_index) {
+    if (!watch || pane_index < 0 || pane_index >= watch->pane_count) {
+        return false;
+    }
+
+    bool changed = watch->pane_changed[pane_index];
+    watch->pane_changed[pane_index] = false;
+    return changed;
+}
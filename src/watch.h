@@ -0,0 +1,91 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "platform.h"
+#include "console.h"
+#include "pane.h"
+
+#define WATCH_BACKSTOP_MS 500   // Re-check every pane this often even without a notification
+
+typedef enum {
+    WATCH_TIMEOUT,              // Nothing happened before the timeout (polled panes marked changed)
+    WATCH_INPUT,                // Console input (or a resize) is waiting
+    WATCH_FILES,                // A watched file or directory changed
+    WATCH_WAKE                  // The wake signal was raised
+} WatchResult;
+
+// Change notifications for the directories holding the tailed files.
+// Panes sharing a directory share one watch, and an event only walks the
+// panes of its own directory. Win32 uses directory change notifications,
+// Linux uses inotify; other systems poll.
+typedef struct {
+    PlatHandle notify_handle;   // inotify instance (Linux), unused on Win32
+    PlatHandle *dir_handles;    // Change notification handle / inotify watch descriptor
+    char **dir_paths;           // Directory each handle watches (owned)
+    int *dir_first_pane;        // First pane in each directory, -1 if none
+    int dir_count;
+    int dir_cap;
+
+    int *wd_dir;                // inotify watch descriptor -> directory index (Linux)
+    int wd_cap;
+
+    int *pane_dir;              // Directory index per pane, -1 if unwatched
+    int *pane_next;             // Next pane in the same directory, -1 at the end
+    char **pane_names;          // File name part of each pane's path (owned)
+    bool *pane_changed;         // Pane should be re-checked for new content
+    int pane_count;
+    int unwatched_count;        // Panes that have to be polled
+
+    uint64_t last_full_check;   // plat_now_ms() of the last backstop pass
+} FileWatch;
+
+// Set up notifications for the given panes. Panes whose directory cannot be
+// watched fall back to polling. All panes start out marked as changed.
+// Returns false if out of memory.
+bool watch_init(FileWatch *watch, const TailPane *panes, int pane_count);
+
+// Close all notification handles
+void watch_destroy(FileWatch *watch);
+
+// Timeout to pass to watch_wait: the old poll interval if any pane is
+// unwatched, otherwise the backstop interval
+unsigned watch_timeout(const FileWatch *watch, unsigned poll_interval_ms);
+
+// Block until console input arrives, a watched file changes, wake is raised
+// or timeout_ms elapses. wake may be NULL.
+WatchResult watch_wait(FileWatch *watch, Console *con, PlatSignal *wake, unsigned timeout_ms);
+
+// Returns true (and clears the flag) if the pane should be re-checked
+bool watch_take_change(FileWatch *watch, int pane_index);
+
+// Backend helpers (watch.c)
+
+// Allocate the per-pane tables, all panes unwatched and marked changed.
+// Returns false on allocation failure.
+bool watch_tables_init(FileWatch *watch, int pane_count);
+
+// Free the tables (the backend closes its handles first)
+void watch_tables_free(FileWatch *watch);
+
+// Record a new watched directory. Returns its index, or -1 on allocation failure.
+int watch_add_dir(FileWatch *watch, PlatHandle handle, const char *path);
+
+// Attach a pane to a watched directory
+void watch_attach_pane(FileWatch *watch, int pane_index, int dir_index);
+
+// Flag every pane in a directory as changed
+void watch_mark_dir(FileWatch *watch, int dir_index);
+
+// Flag every pane as changed
+void watch_mark_all(FileWatch *watch);
+
+// After any wait: flag every pane once per backstop interval, so a steady
+// stream of input or events cannot hold the re-check off
+void watch_mark_backstop(FileWatch *watch);
+
+// After a timeout: flag the polled panes
+void watch_mark_timeout(FileWatch *watch);
+
+#endif // WATCH_H
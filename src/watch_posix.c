@@ -0,0 +1,236 @@
+#include "watch.h"
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/inotify.h>
+
+#define WATCH_MASK (IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE | \
+                    IN_MOVED_FROM | IN_MOVED_TO)
+#endif
+
+// Split path into its directory and file name, resolving symlinks first so
+// the watch lands on the directory that actually receives the writes
+static void split_path(const char *path, char *dir, size_t dir_size, char **name) {
+    char *resolved = realpath(path, NULL);
+    const char *full = resolved ? resolved : path;
+
+    const char *slash = strrchr(full, '/');
+    if (!slash) {
+        strncpy(dir, ".", dir_size - 1);
+        *name = strdup(full);
+    } else {
+        size_t len = slash == full ? 1 : (size_t)(slash - full);   // Keep "/" for the root
+        if (len >= dir_size) {
+            len = dir_size - 1;
+        }
+        memcpy(dir, full, len);
+        dir[len] = '\0';
+        *name = strdup(slash + 1);
+    }
+    dir[dir_size - 1] = '\0';
+
+    free(resolved);
+}
+
+#ifdef __linux__
+// Record which directory an inotify watch descriptor belongs to
+static bool map_wd(FileWatch *watch, int wd, int dir_index) {
+    if (wd >= watch->wd_cap) {
+        int new_cap = watch->wd_cap ? watch->wd_cap : 64;
+        while (new_cap <= wd) {
+            new_cap *= 2;
+        }
+        int *map = (int *)realloc(watch->wd_dir, (size_t)new_cap * sizeof(int));
+        if (!map) {
+            return false;
+        }
+        for (int i = watch->wd_cap; i < new_cap; i++) {
+            map[i] = -1;
+        }
+        watch->wd_dir = map;
+        watch->wd_cap = new_cap;
+    }
+    watch->wd_dir[wd] = dir_index;
+    return true;
+}
+
+static int dir_of_wd(const FileWatch *watch, int wd) {
+    return (wd >= 0 && wd < watch->wd_cap) ? watch->wd_dir[wd] : -1;
+}
+
+// Directories already watched are found by path; different spellings of the
+// same directory get the same descriptor back from inotify
+static int find_or_add_dir(FileWatch *watch, const char *dir) {
+    for (int i = 0; i < watch->dir_count; i++) {
+        if (strcmp(watch->dir_paths[i], dir) == 0) {
+            return i;
+        }
+    }
+
+    int wd = inotify_add_watch(watch->notify_handle, dir, WATCH_MASK);
+    if (wd < 0) {
+        return -1;
+    }
+
+    int index = dir_of_wd(watch, wd);
+    if (index >= 0) {
+        return index;
+    }
+
+    index = watch_add_dir(watch, wd, dir);
+    if (index >= 0 && !map_wd(watch, wd, index)) {
+        return -1;
+    }
+    return index;
+}
+
+// Flag panes matching an event; a NULL name flags every pane in the directory
+static void mark_changed(FileWatch *watch, int wd, const char *name) {
+    int dir = dir_of_wd(watch, wd);
+    if (dir < 0) {
+        return;
+    }
+    if (!name) {
+        watch_mark_dir(watch, dir);
+        return;
+    }
+
+    for (int i = watch->dir_first_pane[dir]; i >= 0; i = watch->pane_next[i]) {
+        if (!watch->pane_names[i] || strcmp(watch->pane_names[i], name) == 0) {
+            watch->pane_changed[i] = true;
+        }
+    }
+}
+
+// Drain pending inotify events, flagging the panes they concern
+static void drain_events(FileWatch *watch) {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    for (;;) {
+        ssize_t len = read(watch->notify_handle, buf, sizeof(buf));
+        if (len <= 0) {
+            break;
+        }
+
+        for (char *p = buf; p < buf + len; ) {
+            const struct inotify_event *event = (const struct inotify_event *)p;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                // Events were lost - re-check everything
+                watch_mark_all(watch);
+            } else {
+                mark_changed(watch, event->wd, event->len > 0 ? event->name : NULL);
+            }
+
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+}
+#endif // __linux__
+
+bool watch_init(FileWatch *watch, const TailPane *panes, int pane_count) {
+    if (!watch || !watch_tables_init(watch, pane_count)) {
+        return false;
+    }
+
+#ifdef __linux__
+    watch->notify_handle = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch->notify_handle < 0) {
+        watch->notify_handle = PLAT_INVALID_HANDLE;
+    }
+#endif
+
+    for (int i = 0; i < pane_count; i++) {
+        char dir[PLAT_MAX_PATH];
+        split_path(panes[i].filepath, dir, sizeof(dir), &watch->pane_names[i]);
+
+#ifdef __linux__
+        if (watch->notify_handle != PLAT_INVALID_HANDLE) {
+            watch_attach_pane(watch, i, find_or_add_dir(watch, dir));
+        }
+#endif
+    }
+    return true;
+}
+
+void watch_destroy(FileWatch *watch) {
+    if (!watch) {
+        return;
+    }
+
+    // Closing the inotify instance drops all of its watches
+    if (watch->notify_handle != PLAT_INVALID_HANDLE) {
+        close(watch->notify_handle);
+        watch->notify_handle = PLAT_INVALID_HANDLE;
+    }
+    watch_tables_free(watch);
+}
+
+WatchResult watch_wait(FileWatch *watch, Console *con, PlatSignal *wake, unsigned timeout_ms) {
+    struct pollfd fds[4];
+    nfds_t count = 0;
+
+    fds[count].fd = con->in_handle;
+    fds[count].events = POLLIN;
+    count++;
+
+    if (con->wake_handle != PLAT_INVALID_HANDLE) {
+        fds[count].fd = con->wake_handle;
+        fds[count].events = POLLIN;
+        count++;
+    }
+
+    int wake_index = -1;
+    if (wake) {
+        wake_index = (int)count;
+        fds[count].fd = wake->handle;
+        fds[count].events = POLLIN;
+        count++;
+    }
+
+    int notify_index = -1;
+    if (watch->notify_handle != PLAT_INVALID_HANDLE) {
+        notify_index = (int)count;
+        fds[count].fd = watch->notify_handle;
+        fds[count].events = POLLIN;
+        count++;
+    }
+
+    int ready = poll(fds, count, (int)timeout_ms);
+    watch_mark_backstop(watch);
+    if (ready < 0) {
+        if (errno == EINTR) {
+            return WATCH_INPUT;     // Most likely SIGWINCH - let input_poll look
+        }
+        plat_sleep_ms(timeout_ms);
+    }
+
+    if (ready > 0) {
+#ifdef __linux__
+        if (notify_index >= 0 && (fds[notify_index].revents & POLLIN)) {
+            drain_events(watch);
+        }
+#endif
+        for (nfds_t i = 0; i < count; i++) {
+            if ((int)i != notify_index && (int)i != wake_index && fds[i].revents) {
+                return WATCH_INPUT;
+            }
+        }
+        if (wake_index >= 0 && fds[wake_index].revents) {
+            plat_signal_clear(wake);
+            return WATCH_WAKE;
+        }
+        return WATCH_FILES;
+    }
+
+    // Timeout (or a wait failure): fall back to checking the files directly
+    watch_mark_timeout(watch);
+    return WATCH_TIMEOUT;
+}
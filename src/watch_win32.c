@@ -0,0 +1,138 @@
+#include "watch.h"
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+
+#define WATCH_FILTER (FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME)
+#define WATCH_MAX_DIRS (MAXIMUM_WAIT_OBJECTS - 2)   // Leaves room for the input and wake handles
+
+// Copy the directory part of path into dir ("." if there is none)
+static void directory_of(const char *path, char *dir, size_t dir_size) {
+    char full[PLAT_MAX_PATH];
+    char *file_part = NULL;
+
+    DWORD len = GetFullPathNameA(path, PLAT_MAX_PATH, full, &file_part);
+    if (len == 0 || len >= PLAT_MAX_PATH || !file_part) {
+        strncpy(dir, ".", dir_size - 1);
+        dir[dir_size - 1] = '\0';
+        return;
+    }
+
+    *file_part = '\0';
+    strncpy(dir, full, dir_size - 1);
+    dir[dir_size - 1] = '\0';
+}
+
+static char *file_name_of(const char *path) {
+    const char *name = strrchr(path, '\\');
+    const char *slash = strrchr(path, '/');
+    if (!name || (slash && slash > name)) {
+        name = slash;
+    }
+    return _strdup(name ? name + 1 : path);
+}
+
+static int find_or_add_dir(FileWatch *watch, const char *dir) {
+    for (int i = 0; i < watch->dir_count; i++) {
+        if (_stricmp(watch->dir_paths[i], dir) == 0) {
+            return i;
+        }
+    }
+
+    // One wait covers everything; directories past the limit are polled
+    if (watch->dir_count >= WATCH_MAX_DIRS) {
+        return -1;
+    }
+
+    HANDLE handle = FindFirstChangeNotificationA(dir, FALSE, WATCH_FILTER);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return -1;
+    }
+
+    int index = watch_add_dir(watch, handle, dir);
+    if (index < 0) {
+        FindCloseChangeNotification(handle);
+    }
+    return index;
+}
+
+// Flag every pane living in the given directory and re-arm its notification
+static void mark_dir_changed(FileWatch *watch, int dir_index) {
+    FindNextChangeNotification(watch->dir_handles[dir_index]);
+    watch_mark_dir(watch, dir_index);
+}
+
+bool watch_init(FileWatch *watch, const TailPane *panes, int pane_count) {
+    if (!watch || !watch_tables_init(watch, pane_count)) {
+        return false;
+    }
+
+    for (int i = 0; i < pane_count; i++) {
+        char dir[PLAT_MAX_PATH];
+        directory_of(panes[i].filepath, dir, sizeof(dir));
+        watch_attach_pane(watch, i, find_or_add_dir(watch, dir));
+        watch->pane_names[i] = file_name_of(panes[i].filepath);
+    }
+    return true;
+}
+
+void watch_destroy(FileWatch *watch) {
+    if (!watch) {
+        return;
+    }
+
+    for (int i = 0; i < watch->dir_count; i++) {
+        FindCloseChangeNotification(watch->dir_handles[i]);
+    }
+    watch_tables_free(watch);
+}
+
+WatchResult watch_wait(FileWatch *watch, Console *con, PlatSignal *wake, unsigned timeout_ms) {
+    HANDLE handles[MAXIMUM_WAIT_OBJECTS];
+    DWORD count = 0;
+    DWORD input_index = MAXIMUM_WAIT_OBJECTS;   // None: a headless console
+    if (con->in_handle != PLAT_INVALID_HANDLE) {
+        input_index = count;
+        handles[count++] = con->in_handle;
+    }
+    DWORD wake_index = MAXIMUM_WAIT_OBJECTS;
+    if (wake) {
+        wake_index = count;
+        handles[count++] = wake->handle;
+    }
+    DWORD first_dir = count;
+    for (int i = 0; i < watch->dir_count; i++) {
+        handles[count++] = watch->dir_handles[i];
+    }
+
+    DWORD result = WaitForMultipleObjects(count, handles, FALSE, timeout_ms);
+    watch_mark_backstop(watch);
+
+    if (result == WAIT_OBJECT_0 + input_index) {
+        return WATCH_INPUT;
+    }
+
+    if (result == WAIT_OBJECT_0 + wake_index) {
+        plat_signal_clear(wake);
+        return WATCH_WAKE;
+    }
+
+    if (result >= WAIT_OBJECT_0 + first_dir && result < WAIT_OBJECT_0 + count) {
+        mark_dir_changed(watch, (int)(result - WAIT_OBJECT_0 - first_dir));
+
+        // Pick up any other directories that fired at the same time
+        for (int i = 0; i < watch->dir_count; i++) {
+            if (WaitForSingleObject(watch->dir_handles[i], 0) == WAIT_OBJECT_0) {
+                mark_dir_changed(watch, i);
+            }
+        }
+        return WATCH_FILES;
+    }
+
+    // Timeout (or a wait failure): fall back to checking the files directly
+    watch_mark_timeout(watch);
+    if (result == WAIT_FAILED) {
+        plat_sleep_ms(timeout_ms);
+    }
+    return WATCH_TIMEOUT;
+}